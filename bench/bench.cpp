@@ -0,0 +1,153 @@
+#include "bench.h"
+#include "_math.h"
+#include "_corpus.h"
+#include "_log.h"
+
+#include <cmath>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+
+using namespace std;
+
+
+static double percentile(vector<double> values, double p) {
+  sort(values.begin(), values.end());
+  const double pos = p * (values.size() - 1);
+  const size_t lo = (size_t) floor(pos), hi = (size_t) ceil(pos);
+  return values[lo] + (pos - lo) * (values[hi] - values[lo]);
+}
+
+static string json_escape(const string& s) {
+  string escaped;
+  for (auto it = s.begin(); it != s.end(); ++it) {
+    if (*it == '"' || *it == '\\') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(*it);
+  }
+  return escaped;
+}
+
+
+//
+// BenchRunner
+//
+
+
+bool BenchRunner::enabled(const string& name) const {
+  return name.find(_filter) != string::npos;
+}
+
+void BenchRunner::run(const string& name, const BenchParams& params,
+                      const function<void (size_t n)>& op) {
+  if (! enabled(name)) {
+    return;
+  }
+
+  typedef chrono::steady_clock Clock;
+  auto time_batch = [&op](size_t n) {
+    const Clock::time_point start = Clock::now();
+    op(n);
+    return chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  size_t n = 1;
+  while (time_batch(n) < _min_sample_time && n < ((size_t) 1 << 40)) {
+    n *= 2;
+  }
+
+  BenchResult result;
+  result.name = name;
+  result.params = params;
+  result.ops_per_sample = n;
+  for (size_t s = 0; s < _num_samples; ++s) {
+    result.sample_ns_per_op.push_back(1e9 * time_batch(n) / n);
+  }
+
+  string param_str;
+  for (auto it = params.begin(); it != params.end(); ++it) {
+    param_str += " " + it->first + "=" + to_string(it->second);
+  }
+  info(__func__, name << param_str << ": " <<
+       percentile(result.sample_ns_per_op, 0.5) << " ns/op (median)\n");
+  _results.push_back(result);
+}
+
+void BenchRunner::write_json(ostream& stream) const {
+  const time_t now = time(NULL);
+  char date[64];
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+  stream << "{\n";
+  stream << "  \"context\": {\n";
+  stream << "    \"date\": \"" << date << "\",\n";
+  stream << "    \"compiler\": \"" << json_escape(__VERSION__) << "\",\n";
+#ifdef HAVE_CBLAS
+  stream << "    \"cblas\": true,\n";
+#else
+  stream << "    \"cblas\": false,\n";
+#endif
+  stream << "    \"num_samples\": " << _num_samples << ",\n";
+  stream << "    \"min_sample_time\": " << _min_sample_time << "\n";
+  stream << "  },\n";
+  stream << "  \"benchmarks\": [";
+  for (size_t i = 0; i < _results.size(); ++i) {
+    const BenchResult& result(_results[i]);
+    const vector<double>& samples(result.sample_ns_per_op);
+    const double mean = accumulate(samples.begin(), samples.end(), 0.) /
+      samples.size();
+    stream << (i == 0 ? "\n" : ",\n");
+    stream << "    {\n";
+    stream << "      \"name\": \"" << json_escape(result.name) << "\",\n";
+    stream << "      \"params\": {";
+    for (size_t j = 0; j < result.params.size(); ++j) {
+      stream << (j == 0 ? "" : ", ") << "\"" <<
+        json_escape(result.params[j].first) << "\": " <<
+        result.params[j].second;
+    }
+    stream << "},\n";
+    stream << "      \"ops_per_sample\": " << result.ops_per_sample << ",\n";
+    stream << "      \"ns_per_op\": " << mean << ",\n";
+    stream << "      \"ops_per_sec\": " << 1e9 / mean << ",\n";
+    stream << "      \"min_ns\": " << percentile(samples, 0) << ",\n";
+    stream << "      \"p50_ns\": " << percentile(samples, 0.5) << ",\n";
+    stream << "      \"p90_ns\": " << percentile(samples, 0.9) << ",\n";
+    stream << "      \"p99_ns\": " << percentile(samples, 0.99) << ",\n";
+    stream << "      \"max_ns\": " << percentile(samples, 1) << "\n";
+    stream << "    }";
+  }
+  stream << "\n  ]\n";
+  stream << "}\n";
+}
+
+
+//
+// workloads
+//
+
+
+vector<long> zipf_word_ids(size_t vocab_size, size_t n,
+                           size_t drift_interval) {
+  ZipfianCorpusGenerator generator(
+    vocab_size, 1, DEFAULT_CORPUS_SENTENCE_LENGTH, SENTENCE_LENGTH_FIXED,
+    drift_interval);
+  vector<long> word_ids(n);
+  for (size_t i = 0; i < n; ++i) {
+    word_ids[i] = generator.next_word_idx();
+  }
+  return word_ids;
+}
+
+vector<string> zipf_words(size_t vocab_size, size_t n,
+                          size_t drift_interval) {
+  vector<long> word_ids(zipf_word_ids(vocab_size, n, drift_interval));
+  vector<string> words(n);
+  for (size_t i = 0; i < n; ++i) {
+    words[i] = ZipfianCorpusGenerator::word(word_ids[i]);
+  }
+  return words;
+}
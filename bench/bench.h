@@ -0,0 +1,91 @@
+#ifndef ATHENA_BENCH_H
+#define ATHENA_BENCH_H
+
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <ostream>
+
+
+#define DEFAULT_BENCH_NUM_SAMPLES 25
+// seconds; batch size is doubled until one batch takes this long
+#define DEFAULT_BENCH_MIN_SAMPLE_TIME 5e-3
+
+
+typedef std::vector<std::pair<std::string,size_t> > BenchParams;
+
+
+struct BenchResult {
+  std::string name;
+  BenchParams params;
+  size_t ops_per_sample;
+  // nanoseconds per operation in each sample, in order
+  std::vector<double> sample_ns_per_op;
+};
+
+
+// Times benchmarks and collects results.  A benchmark is a function
+// that performs n operations; it is run with increasing n until one
+// call takes at least min_sample_time seconds, then num_samples more
+// times with that n.  Percentiles are taken over samples (per-operation
+// times are too short to measure individually).
+
+class BenchRunner final {
+  std::string _filter;
+  size_t _num_samples;
+  double _min_sample_time;
+  bool _quick;
+  std::vector<BenchResult> _results;
+
+  public:
+    BenchRunner(const std::string& filter = "",
+                size_t num_samples = DEFAULT_BENCH_NUM_SAMPLES,
+                double min_sample_time = DEFAULT_BENCH_MIN_SAMPLE_TIME,
+                bool quick = false):
+      _filter(filter),
+      _num_samples(num_samples),
+      _min_sample_time(min_sample_time),
+      _quick(quick),
+      _results() { }
+    // return true if benchmarks named name should run (use to skip
+    // expensive setup)
+    bool enabled(const std::string& name) const;
+    // return true if parameter sweeps should be cut short
+    bool quick() const { return _quick; }
+    void run(const std::string& name, const BenchParams& params,
+             const std::function<void (size_t n)>& op);
+    const std::vector<BenchResult>& results() const { return _results; }
+    void write_json(std::ostream& stream) const;
+};
+
+
+// Prevent the compiler from optimizing away computation of x.
+template <class T>
+inline void keep(const T& x) {
+  asm volatile("" : : "g"(&x) : "memory");
+}
+
+// Return n words drawn from a Zipf(1) distribution over vocab_size
+// word types (word i is "w<i>"), drifting every drift_interval tokens
+// if drift_interval is positive (see ZipfianCorpusGenerator).
+std::vector<std::string> zipf_words(size_t vocab_size, size_t n,
+                                    size_t drift_interval = 0);
+
+// Return n word indices drawn from a Zipf(1) distribution over
+// vocab_size word types, drifting as in zipf_words.
+std::vector<long> zipf_word_ids(size_t vocab_size, size_t n,
+                                size_t drift_interval = 0);
+
+
+// suites
+
+void core_benchmarks(BenchRunner& runner);
+void math_benchmarks(BenchRunner& runner);
+void cblas_benchmarks(BenchRunner& runner);
+void sgns_benchmarks(BenchRunner& runner);
+
+
+#endif
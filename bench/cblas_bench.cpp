@@ -0,0 +1,48 @@
+#include "bench.h"
+#include "_cblas.h"
+#include "_math.h"
+
+#include <vector>
+
+
+using namespace std;
+
+
+void cblas_benchmarks(BenchRunner& runner) {
+  const vector<size_t> dims(
+    runner.quick() ? vector<size_t>{100, 300} :
+                     vector<size_t>{50, 100, 200, 300, 500});
+
+  for (auto d = dims.begin(); d != dims.end(); ++d) {
+    const size_t dim = *d;
+    seed(3);
+    AlignedVector x(dim), y(dim);
+    sample_centered_uniform_vector(dim, x.data());
+    sample_centered_uniform_vector(dim, y.data());
+
+    runner.run("cblas_sdot", {{"dim", dim}}, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        keep(cblas_sdot(dim, x.data(), 1, y.data(), 1));
+      }
+    });
+    runner.run("cblas_saxpy", {{"dim", dim}}, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        // alternate sign so y stays bounded
+        cblas_saxpy(dim, (i % 2 == 0 ? 1e-3f : -1e-3f), x.data(), 1,
+                    y.data(), 1);
+      }
+      keep(y[0]);
+    });
+    runner.run("cblas_snrm2", {{"dim", dim}}, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        keep(cblas_snrm2(dim, x.data(), 1));
+      }
+    });
+    runner.run("cblas_sscal", {{"dim", dim}}, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        cblas_sscal(dim, (i % 2 == 0 ? 2.f : 0.5f), y.data(), 1);
+      }
+      keep(y[0]);
+    });
+  }
+}
@@ -0,0 +1,140 @@
+#include "bench.h"
+#include "_core.h"
+#include "_math.h"
+
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+#define CORE_BENCH_STREAM_SIZE (1 << 20)
+// tokens between popularity drift steps in the drifting stream
+#define CORE_BENCH_DRIFT_INTERVAL 1000
+
+
+void core_benchmarks(BenchRunner& runner) {
+  const vector<size_t> vocab_dims(
+    runner.quick() ? vector<size_t>{1000, 100000} :
+                     vector<size_t>{1000, 10000, 100000, 1000000});
+
+  for (auto v = vocab_dims.begin(); v != vocab_dims.end(); ++v) {
+    const size_t vocab_dim = *v;
+    if (! runner.enabled("SpaceSavingLanguageModel::increment") &&
+        ! runner.enabled("SpaceSavingLanguageModel::subsample") &&
+        ! runner.enabled("NaiveLanguageModel::lookup") &&
+        ! runner.enabled("FrozenLanguageModel::lookup")) {
+      break;
+    }
+    seed(1);
+    // stream draws from a vocabulary ten times the counter capacity,
+    // so ejections happen
+    const vector<string> words(zipf_words(10 * vocab_dim,
+                                          CORE_BENCH_STREAM_SIZE));
+
+    SpaceSavingLanguageModel space_saving_lm(vocab_dim);
+    size_t pos = 0;
+    runner.run("SpaceSavingLanguageModel::increment",
+               {{"vocab_dim", vocab_dim}, {"drift_interval", 0}},
+               [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        keep(space_saving_lm.increment(words[pos]));
+        pos = (pos + 1) % words.size();
+      }
+    });
+
+    if (runner.enabled("SpaceSavingLanguageModel::increment")) {
+      // heavy hitters change over the stream, so ejections keep coming
+      seed(1);
+      const vector<string> drift_words(zipf_words(
+        10 * vocab_dim, CORE_BENCH_STREAM_SIZE, CORE_BENCH_DRIFT_INTERVAL));
+      SpaceSavingLanguageModel drift_lm(vocab_dim);
+      size_t drift_pos = 0;
+      runner.run("SpaceSavingLanguageModel::increment",
+                 {{"vocab_dim", vocab_dim},
+                  {"drift_interval", CORE_BENCH_DRIFT_INTERVAL}},
+                 [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          keep(drift_lm.increment(drift_words[drift_pos]));
+          drift_pos = (drift_pos + 1) % drift_words.size();
+        }
+      });
+
+      // hashes computed up front, as the sentence reader does
+      vector<uint64_t> drift_hashes(drift_words.size());
+      for (size_t i = 0; i < drift_words.size(); ++i) {
+        drift_hashes[i] = word_hash(drift_words[i]);
+      }
+      for (int fingerprint_keyed = 0; fingerprint_keyed <= 1;
+           ++fingerprint_keyed) {
+        SpaceSavingLanguageModel hashed_lm(
+          vocab_dim, DEFAULT_SUBSAMPLE_THRESHOLD, fingerprint_keyed);
+        size_t hashed_pos = 0;
+        runner.run("SpaceSavingLanguageModel::increment",
+                   {{"vocab_dim", vocab_dim},
+                    {"drift_interval", CORE_BENCH_DRIFT_INTERVAL},
+                    {"hashed", 1},
+                    {"fingerprint_keyed", fingerprint_keyed}},
+                   [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            long word_idx;
+            keep(hashed_lm.increment(drift_words[hashed_pos],
+                                     drift_hashes[hashed_pos], word_idx));
+            hashed_pos = (hashed_pos + 1) % drift_words.size();
+          }
+        });
+      }
+    }
+
+    if (runner.enabled("SpaceSavingLanguageModel::subsample")) {
+      SpaceSavingLanguageModel subsample_lm(vocab_dim);
+      vector<long> word_idxs;
+      word_idxs.reserve(words.size());
+      for (auto it = words.begin(); it != words.end(); ++it) {
+        subsample_lm.increment(*it);
+        word_idxs.push_back(subsample_lm.lookup(*it));
+      }
+      size_t idx_pos = 0;
+      runner.run("SpaceSavingLanguageModel::subsample",
+                 {{"vocab_dim", vocab_dim}},
+                 [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          keep(subsample_lm.subsample(word_idxs[idx_pos]));
+          idx_pos = (idx_pos + 1) % word_idxs.size();
+        }
+      });
+    }
+
+    if (runner.enabled("NaiveLanguageModel::lookup")) {
+      NaiveLanguageModel naive_lm;
+      for (size_t i = 0; i < vocab_dim; ++i) {
+        naive_lm.increment("w" + to_string(i));
+      }
+      runner.run("NaiveLanguageModel::lookup",
+                 {{"vocab_dim", vocab_dim}},
+                 [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          keep(naive_lm.lookup(words[pos]));
+          pos = (pos + 1) % words.size();
+        }
+      });
+    }
+
+    if (runner.enabled("FrozenLanguageModel::lookup")) {
+      NaiveLanguageModel naive_lm;
+      for (size_t i = 0; i < vocab_dim; ++i) {
+        naive_lm.increment("w" + to_string(i));
+      }
+      const FrozenLanguageModel frozen_lm(naive_lm);
+      runner.run("FrozenLanguageModel::lookup",
+                 {{"vocab_dim", vocab_dim}},
+                 [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          keep(frozen_lm.lookup(words[pos]));
+          pos = (pos + 1) % words.size();
+        }
+      });
+    }
+  }
+}
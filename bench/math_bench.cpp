@@ -0,0 +1,107 @@
+#include "bench.h"
+#include "_math.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+using namespace std;
+
+
+void math_benchmarks(BenchRunner& runner) {
+  const vector<size_t> sizes(
+    runner.quick() ? vector<size_t>{1000, 100000} :
+                     vector<size_t>{1000, 10000, 100000, 1000000});
+
+  for (auto s = sizes.begin(); s != sizes.end(); ++s) {
+    const size_t size = *s;
+    seed(2);
+    vector<float> probabilities(size);
+    for (size_t i = 0; i < size; ++i) {
+      probabilities[i] = 1. / (i + 1);
+    }
+    ExponentCountNormalizer normalizer;
+    vector<size_t> counts(size);
+    for (size_t i = 0; i < size; ++i) {
+      counts[i] = size / (i + 1) + 1;
+    }
+    const vector<float> normalized(normalizer.normalize(counts));
+
+    if (runner.enabled("AliasSampler::sample")) {
+      AliasSampler alias_sampler(normalized);
+      runner.run("AliasSampler::sample", {{"size", size}}, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          keep(alias_sampler.sample());
+        }
+      });
+    }
+
+    if (runner.enabled("Discretization::sample")) {
+      Discretization discretization(normalized, 10 * size);
+      runner.run("Discretization::sample", {{"size", size}}, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          keep(discretization.sample());
+        }
+      });
+    }
+
+    ReservoirSampler<long> reservoir_sampler(size);
+    long val = 0;
+    // fill reservoir so sampling is valid even if inserts are filtered
+    for (size_t i = 0; i < size; ++i) {
+      reservoir_sampler.insert(val++);
+    }
+    runner.run("ReservoirSampler::insert", {{"size", size}}, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        keep(reservoir_sampler.insert(val++));
+      }
+    });
+    runner.run("ReservoirSampler::sample", {{"size", size}}, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        keep(reservoir_sampler.sample());
+      }
+    });
+  }
+
+  seed(2);
+  PRNG& urng(get_urng());
+  runner.run("PRNG::operator()", {}, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      keep(urng());
+    }
+  });
+  vector<uint32_t> bits(1024);
+  runner.run("PRNG::fill", {{"size", bits.size()}}, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      urng.fill(bits.data(), bits.size());
+      keep(bits[0]);
+    }
+  });
+  runner.run("sample_uniform_index", {}, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      keep(sample_uniform_index(1000));
+    }
+  });
+  uniform_int_distribution<size_t> uniform_int(0, 999);
+  runner.run("uniform_int_distribution", {}, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      keep(uniform_int(urng));
+    }
+  });
+
+  float x = -8;
+  fast_sigmoid(0);
+  runner.run("fast_sigmoid", {}, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      keep(fast_sigmoid(x));
+      x = (x >= 8 ? -8 : x + 1e-3f);
+    }
+  });
+  runner.run("sigmoid", {}, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      keep(sigmoid(x));
+      x = (x >= 8 ? -8 : x + 1e-3f);
+    }
+  });
+}
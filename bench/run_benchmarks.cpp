@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "_io.h"
+#include "_log.h"
+
+#include <cstdlib>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <unistd.h>
+
+
+using namespace std;
+
+
+void usage(ostream& s, const string& program) {
+  s << "Run microbenchmarks of core operations and write results as JSON.\n";
+  s << "\n";
+  s << "Usage: " << program << " [...]\n";
+  s << "\n";
+  s << "Optional arguments:\n";
+  s << "  -f <filter>\n";
+  s << "     Only run benchmarks whose names contain this string.\n";
+  s << "  -o <output-path>\n";
+  s << "     Write JSON results to this file (default: standard output).\n";
+  s << "  -n <num-samples>\n";
+  s << "     Set number of timed samples per benchmark.\n";
+  s << "     Default: " << DEFAULT_BENCH_NUM_SAMPLES << "\n";
+  s << "  -t <min-sample-time>\n";
+  s << "     Set minimum duration (in seconds) of each sample.\n";
+  s << "     Default: " << DEFAULT_BENCH_MIN_SAMPLE_TIME << "\n";
+  s << "  -q\n";
+  s << "     Sweep fewer vocabulary sizes and dimensions.\n";
+  s << "  -h\n";
+  s << "     Print this help and exit.\n";
+}
+
+int main(int argc, char **argv) {
+  string filter, output_path;
+  size_t num_samples(DEFAULT_BENCH_NUM_SAMPLES);
+  double min_sample_time(DEFAULT_BENCH_MIN_SAMPLE_TIME);
+  bool quick(false);
+
+  const string program(argv[0]);
+
+  int ret = 0;
+  while (ret != -1) {
+    ret = getopt(argc, argv, "f:o:n:t:qh");
+    switch (ret) {
+      case 'f':
+        filter = string(optarg);
+        break;
+      case 'o':
+        output_path = string(optarg);
+        break;
+      case 'n':
+        num_samples = stoull(string(optarg));
+        break;
+      case 't':
+        min_sample_time = stod(string(optarg));
+        break;
+      case 'q':
+        quick = true;
+        break;
+      case 'h':
+        usage(cout, program);
+        exit(0);
+      case '?':
+        usage(cerr, program);
+        exit(1);
+      case -1:
+        break;
+    }
+  }
+  if (optind != argc || num_samples == 0) {
+    usage(cerr, program);
+    exit(1);
+  }
+
+  BenchRunner runner(filter, num_samples, min_sample_time, quick);
+  core_benchmarks(runner);
+  math_benchmarks(runner);
+  cblas_benchmarks(runner);
+  sgns_benchmarks(runner);
+
+  if (output_path.empty()) {
+    runner.write_json(cout);
+  } else {
+    ofstream f;
+    f.open(output_path.c_str());
+    stream_ready_or_throw(f);
+    runner.write_json(f);
+    f.close();
+    info(__func__, "wrote " << runner.results().size() <<
+         " results to " << output_path << "\n");
+  }
+}
@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "_core.h"
+#include "_math.h"
+#include "_sgns.h"
+
+#include <vector>
+
+
+using namespace std;
+
+
+#define SGNS_BENCH_STREAM_SIZE (1 << 20)
+#define SGNS_BENCH_SENTENCE_LENGTH 20
+#define SGNS_BENCH_NEG_SAMPLES 5
+#define SGNS_BENCH_SYMM_CONTEXT 5
+
+
+typedef SGNSTokenLearner<NaiveLanguageModel, UniformSamplingStrategy<NaiveLanguageModel> > BenchTokenLearner;
+typedef SGNSSentenceLearner<BenchTokenLearner, DynamicContextStrategy> BenchSentenceLearner;
+
+
+void sgns_benchmarks(BenchRunner& runner) {
+  if (! runner.enabled("SGNSTokenLearner::token_train") &&
+      ! runner.enabled("SGNSSentenceLearner::sentence_train")) {
+    return;
+  }
+
+  const vector<size_t> vocab_dims(
+    runner.quick() ? vector<size_t>{10000} :
+                     vector<size_t>{1000, 10000, 100000});
+  const vector<size_t> embedding_dims(
+    runner.quick() ? vector<size_t>{100} :
+                     vector<size_t>{50, 100, 300});
+
+  for (auto v = vocab_dims.begin(); v != vocab_dims.end(); ++v) {
+    for (auto e = embedding_dims.begin(); e != embedding_dims.end(); ++e) {
+      const size_t vocab_dim = *v, embedding_dim = *e;
+      seed(4);
+      NaiveLanguageModel language_model;
+      for (size_t i = 0; i < vocab_dim; ++i) {
+        language_model.increment("w" + to_string(i));
+      }
+      BenchSentenceLearner sentence_learner(
+        BenchTokenLearner(
+          WordContextFactorization(vocab_dim, embedding_dim),
+          UniformSamplingStrategy<NaiveLanguageModel>(),
+          move(language_model),
+          SGD(vocab_dim, 1.7e7, 2.5e-2, 2.5e-6)),
+        DynamicContextStrategy(SGNS_BENCH_SYMM_CONTEXT),
+        SGNS_BENCH_NEG_SAMPLES);
+      const vector<long> word_ids(zipf_word_ids(vocab_dim,
+                                                SGNS_BENCH_STREAM_SIZE));
+      fast_sigmoid(0);
+
+      size_t pos = 0;
+      runner.run("SGNSTokenLearner::token_train",
+                 {{"vocab_dim", vocab_dim}, {"embedding_dim", embedding_dim}},
+                 [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          sentence_learner.token_learner.token_train(
+            word_ids[pos], word_ids[pos + 1], SGNS_BENCH_NEG_SAMPLES);
+          pos = (pos + 2) % (word_ids.size() - 1);
+        }
+      });
+
+      vector<long> sentence(SGNS_BENCH_SENTENCE_LENGTH);
+      runner.run("SGNSSentenceLearner::sentence_train",
+                 {{"vocab_dim", vocab_dim}, {"embedding_dim", embedding_dim},
+                  {"sentence_length", SGNS_BENCH_SENTENCE_LENGTH}},
+                 [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          if (pos + sentence.size() > word_ids.size()) {
+            pos = 0;
+          }
+          sentence.assign(word_ids.begin() + pos,
+                          word_ids.begin() + pos + sentence.size());
+          pos += sentence.size();
+          sentence_learner.sentence_train(sentence);
+        }
+      });
+    }
+  }
+}
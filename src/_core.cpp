@@ -3,55 +3,155 @@
 #include "_serialization.h"
 #include "_cblas.h"
 #include "_log.h"
+#include "_trace.h"
 
 #include <fstream>
 #include <iostream>
 #include <cmath>
 #include <vector>
 #include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
 
 
 using namespace std;
 
 
+uint32_t keep_threshold(float subsample_threshold, size_t count,
+                        size_t total) {
+  const double scaled_total = (double) subsample_threshold * total;
+  if (count <= scaled_total) {
+    return UINT32_MAX;
+  }
+  // (the root can round up to 1, whose product does not fit 32 bits)
+  const double threshold = sqrt(scaled_total / count) * 4294967296.;
+  return (threshold >= 4294967296.) ? UINT32_MAX : (uint32_t) threshold;
+}
+
+// return next count (or total) at which a value computed from current
+// count (or total) c is out of tolerance
+static size_t keep_threshold_refresh_count(size_t c) {
+  return c + c / KEEP_THRESHOLD_TOLERANCE_INV + 1;
+}
+
+// return word indices in word_idxs kept after subsampling with
+// per-word keep thresholds keep_thresholds
+static vector<long> subsample_words(const uint32_t *keep_thresholds,
+                                    const vector<long>& word_idxs) {
+  vector<long> kept;
+  kept.reserve(word_idxs.size());
+  PRNG& urng(get_urng());
+  uint32_t bits[PHILOX_BUFFER_SIZE];
+  for (size_t start = 0; start < word_idxs.size();
+       start += PHILOX_BUFFER_SIZE) {
+    const size_t batch_size = min((size_t) PHILOX_BUFFER_SIZE,
+                                  word_idxs.size() - start);
+    urng.fill(bits, batch_size);
+    for (size_t j = 0; j < batch_size; ++j) {
+      const long word_idx = word_idxs[start + j];
+      if (bits[j] <= keep_thresholds[word_idx]) {
+        kept.push_back(word_idx);
+      }
+    }
+  }
+  return kept;
+}
+
+
 //
 // NaiveLanguageModel
 //
 
 
-NaiveLanguageModel::NaiveLanguageModel(float subsample_threshold):
+NaiveLanguageModel::NaiveLanguageModel(float subsample_threshold,
+                                       size_t max_types):
     _subsample_threshold(subsample_threshold),
     _size(0),
     _total(0),
     _counters(),
-    _word_ids(),
-    _words() { }
-
-pair<long,string> NaiveLanguageModel::increment(const string& word) {
-  long idx = lookup(word);
+    _words(),
+    _max_types(max_types),
+    _prune_threshold(0),
+    _max_undercount(0),
+    _keep_thresholds(),
+    _keep_threshold_refresh_counts(),
+    _keep_threshold_refresh_total(0) { }
+
+pair<long,string> NaiveLanguageModel::add(const string& word,
+                                          size_t weight,
+                                          long& word_idx) {
+  const uint64_t h = word_hash(word);
+  long idx = _words.lookup(word, h);
+  if (weight == 0) {
+    word_idx = idx;
+    return make_pair(-1L, string());
+  }
   if (idx < 0) {
     // word not in language model
-    idx = (long) _size;
-    _word_ids[word] = idx;
-    _words.push_back(word);
-    _counters.push_back(1);
+    if (_max_types > 0 && _size >= _max_types) {
+      _prune();
+    }
+    idx = _words.insert(word, h);
+    _counters.push_back(weight);
+    _keep_thresholds.push_back(0);
+    _keep_threshold_refresh_counts.push_back(0);
     ++_size;
-    ++_total;
   } else {
-    // word in language model: increment counter
-    ++_counters[idx];
-    ++_total;
+    // word in language model: add to counter
+    _counters[idx] += weight;
+  }
+  _total += weight;
+  word_idx = idx;
+  if (_total >= _keep_threshold_refresh_total) {
+    _refresh_keep_thresholds();
+  } else if (_counters[idx] >= _keep_threshold_refresh_counts[idx]) {
+    _refresh_keep_threshold(idx);
   }
   return make_pair(-1L, string());
 }
 
+void NaiveLanguageModel::increment_all(const vector<string>& words,
+                                       vector<long>& word_idxs,
+                                       vector<pair<long,string> >& ejectees) {
+  word_idxs.resize(words.size());
+  ejectees.resize(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    ejectees[i] = increment(words[i], word_idxs[i]);
+  }
+}
+
+void NaiveLanguageModel::merge(const NaiveLanguageModel& other) {
+  for (size_t other_idx = 0; other_idx < other._size; ++other_idx) {
+    const string word(other._words.get(other_idx));
+    const uint64_t h = word_hash(word);
+    long idx = _words.lookup(word, h);
+    if (idx < 0) {
+      idx = _words.insert(word, h);
+      _counters.push_back(0);
+      ++_size;
+    }
+    _counters[idx] += other._counters[other_idx];
+  }
+  _total += other._total;
+  // a word's losses in each model add up
+  _prune_threshold = max(_prune_threshold, other._prune_threshold);
+  _max_undercount += other._max_undercount;
+  if (_max_types > 0 && _size > _max_types) {
+    _prune();
+  }
+  _refresh_keep_thresholds();
+}
+
 long NaiveLanguageModel::lookup(const string& word) const {
-  auto it = _word_ids.find(word);
-  return (it == _word_ids.end()) ? -1 : it->second;
+  return _words.lookup(word);
 }
 
 string NaiveLanguageModel::reverse_lookup(long word_idx) const {
-  return _words.at(word_idx);
+  return _words.get(word_idx);
 }
 
 size_t NaiveLanguageModel::count(long word_idx) const {
@@ -77,40 +177,57 @@ size_t NaiveLanguageModel::total() const {
   return _total;
 }
 
-bool NaiveLanguageModel::subsample(long word_idx) const {
-  const float normalized_freq = count(word_idx) / (float) total();
-  uniform_real_distribution<float> d;
-  const float random_unif = d(get_urng());
-  return random_unif > 1 - sqrt(_subsample_threshold / normalized_freq);
+vector<long> NaiveLanguageModel::subsample(
+    const vector<long>& word_idxs) const {
+  return subsample_words(_keep_thresholds.data(), word_idxs);
+}
+
+void NaiveLanguageModel::reserve(size_t n) {
+  _words.reserve(n);
+  _counters.reserve(n);
+  _keep_thresholds.reserve(n);
+  _keep_threshold_refresh_counts.reserve(n);
 }
 
 void NaiveLanguageModel::truncate(size_t max_size) {
-  vector<pair<string,size_t> > _sorted_words(_size);
+  // order word indices by count (descending), ties by index, rather
+  // than copying the words: peak memory is the old vocabulary plus the
+  // kept part of it, not twice the old vocabulary (indices are 32-bit,
+  // as are vocabulary ids)
+  if (_size > Vocabulary::MAX_SIZE) {
+    throw length_error("NaiveLanguageModel::truncate: " + to_string(_size) +
+                       " words exceed vocabulary limit");
+  }
+  vector<uint32_t> idxs(_size);
   for (size_t i = 0; i < _size; ++i) {
-    _sorted_words[i] = make_pair(_words[i], _counters[i]);
+    idxs[i] = i;
   }
-  ::sort(_sorted_words.rbegin(), _sorted_words.rend(),
-         pair_second_cmp<string,size_t>);
-
-  _size = min(_size, max_size);
-
-  _sorted_words.resize(_size);
-
-  _word_ids.clear();
-  _word_ids.reserve(_size);
-  _words.clear();
-  _words.reserve(_size);
-  _counters.clear();
-  _counters.reserve(_size);
+  const size_t new_size = min(_size, max_size);
+  const vector<size_t>& counters(_counters);
+  partial_sort(idxs.begin(), idxs.begin() + new_size, idxs.end(),
+               [&counters](uint32_t x, uint32_t y) {
+    return counters[x] > counters[y] ||
+      (counters[x] == counters[y] && x < y);
+  });
+
+  Vocabulary words;
+  words.reserve(new_size);
+  vector<size_t> new_counters;
+  new_counters.reserve(new_size);
   _total = 0;
-
-  size_t i = 0;
-  for (auto it = _sorted_words.begin(); it != _sorted_words.end(); ++it, ++i) {
-    _word_ids[it->first] = i;
-    _words.push_back(it->first);
-    _counters.push_back(it->second);
-    _total += it->second;
+  for (size_t i = 0; i < new_size; ++i) {
+    words.insert(_words.get(idxs[i]));
+    new_counters.push_back(_counters[idxs[i]]);
+    _total += _counters[idxs[i]];
   }
+  _size = new_size;
+  _words = move(words);
+  _counters = move(new_counters);
+  _keep_thresholds.clear();
+  _keep_thresholds.shrink_to_fit();
+  _keep_threshold_refresh_counts.clear();
+  _keep_threshold_refresh_counts.shrink_to_fit();
+  _refresh_keep_thresholds();
 }
 
 void NaiveLanguageModel::sort() {
@@ -122,8 +239,15 @@ void NaiveLanguageModel::serialize(ostream& stream) const {
   Serializer<size_t>::serialize(_size, stream);
   Serializer<size_t>::serialize(_total, stream);
   Serializer<vector<size_t> >::serialize(_counters, stream);
-  Serializer<unordered_map<string,long> >::serialize(_word_ids, stream);
-  Serializer<vector<string> >::serialize(_words, stream);
+  // vocabulary is stored as a word-to-index map and a word list
+  unordered_map<string,long> word_ids;
+  vector<string> words(_size);
+  for (size_t i = 0; i < _size; ++i) {
+    words[i] = _words.get(i);
+    word_ids[words[i]] = i;
+  }
+  Serializer<unordered_map<string,long> >::serialize(word_ids, stream);
+  Serializer<vector<string> >::serialize(words, stream);
 }
 
 NaiveLanguageModel NaiveLanguageModel::deserialize(istream& stream) {
@@ -131,26 +255,88 @@ NaiveLanguageModel NaiveLanguageModel::deserialize(istream& stream) {
   auto size(Serializer<size_t>::deserialize(stream));
   auto total(Serializer<size_t>::deserialize(stream));
   auto counters(Serializer<vector<size_t> >::deserialize(stream));
-  auto word_ids(Serializer<unordered_map<string,long> >::deserialize(stream));
+  // word-to-index map is implied by the word list
+  Serializer<unordered_map<string,long> >::deserialize(stream);
   auto words(Serializer<vector<string> >::deserialize(stream));
+  Vocabulary vocabulary;
+  vocabulary.reserve(words.size());
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    vocabulary.insert(*it);
+  }
   return NaiveLanguageModel(
     subsample_threshold,
     size,
     total,
     move(counters),
-    move(word_ids),
-    move(words)
+    move(vocabulary)
   );
 }
 
+MemoryUsage NaiveLanguageModel::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("counters", vector_heap_size(_counters));
+  usage.add("words", _words.memory_usage());
+  usage.add("keep_thresholds", vector_heap_size(_keep_thresholds));
+  usage.add("keep_threshold_refresh_counts",
+            vector_heap_size(_keep_threshold_refresh_counts));
+  return usage;
+}
+
 bool NaiveLanguageModel::equals(const NaiveLanguageModel& other) const {
   return
     near(_subsample_threshold, other._subsample_threshold) &&
     _size == other._size &&
     _total == other._total &&
     _counters == other._counters &&
-    _word_ids == other._word_ids &&
-    _words == other._words;
+    _words.equals(other._words);
+}
+
+void NaiveLanguageModel::_refresh_keep_threshold(long word_idx) {
+  _keep_thresholds[word_idx] = keep_threshold(_subsample_threshold,
+                                              _counters[word_idx], _total);
+  _keep_threshold_refresh_counts[word_idx] =
+    keep_threshold_refresh_count(_counters[word_idx]);
+}
+
+void NaiveLanguageModel::_prune() {
+  const size_t target = _max_types * NAIVE_LM_PRUNE_TARGET_NUM /
+    NAIVE_LM_PRUNE_TARGET_DEN;
+  // smallest threshold above the previous one that leaves at most
+  // target words: words with count above the (target + 1)-th largest
+  // count
+  size_t threshold = _prune_threshold + 1;
+  if (_size > target) {
+    vector<size_t> c(_counters);
+    nth_element(c.begin(), c.begin() + target, c.end(),
+                greater<size_t>());
+    threshold = max(threshold, c[target]);
+  }
+
+  Vocabulary words;
+  words.reserve(target);
+  vector<size_t> counters;
+  counters.reserve(target);
+  for (size_t i = 0; i < _size; ++i) {
+    if (_counters[i] > threshold) {
+      words.insert(_words.get(i));
+      counters.push_back(_counters[i]);
+    }
+  }
+  _size = counters.size();
+  _words = move(words);
+  _counters = move(counters);
+  _prune_threshold = threshold;
+  _max_undercount += threshold;
+  _refresh_keep_thresholds();
+}
+
+void NaiveLanguageModel::_refresh_keep_thresholds() {
+  _keep_thresholds.resize(_size);
+  _keep_threshold_refresh_counts.resize(_size);
+  for (size_t i = 0; i < _size; ++i) {
+    _refresh_keep_threshold(i);
+  }
+  _keep_threshold_refresh_total = keep_threshold_refresh_count(_total);
 }
 
 
@@ -160,48 +346,154 @@ bool NaiveLanguageModel::equals(const NaiveLanguageModel& other) const {
 
 
 SpaceSavingLanguageModel::SpaceSavingLanguageModel(size_t num_counters,
-                                                   float subsample_threshold):
+                                                   float subsample_threshold,
+                                                   bool fingerprint_keyed):
     _subsample_threshold(subsample_threshold),
     _num_counters(num_counters),
     _size(0),
     _total(0),
     _min_idx(0),
     _counters(),
-    _word_ids(),
     _internal_ids(),
     _external_ids(),
-    _words(num_counters, string()) {
+    _words(fingerprint_keyed),
+    _keep_thresholds(num_counters, 0),
+    _keep_threshold_refresh_counts(num_counters, 0),
+    _keep_threshold_refresh_total(0) {
   _counters.reserve(_num_counters);
   _internal_ids.reserve(_num_counters);
   _external_ids.reserve(_num_counters);
+  _words.reserve(_num_counters);
 }
 
-pair<long,string> SpaceSavingLanguageModel::increment(const string& word) {
+pair<long,string> SpaceSavingLanguageModel::increment(const string& word,
+                                                      uint64_t h,
+                                                      long& word_idx) {
   ++_total;
 
-  long ext_idx = lookup(word);
+  pair<long,string> ejection;
+  long ext_idx = _words.lookup(word, h);
   if (ext_idx < 0) {
     // word not in language model
     if (_size < _num_counters) {
       // at least one unused counter: insert this word and increment
-      return _unfull_append(word);
+      ejection = _unfull_append(word, h);
+      ext_idx = (long) _size - 1;
     } else {
       // all counters in use: eject word, insert this word, and increment
-      return _full_replace(word);
+      // (the inserted word takes the ejected word's index)
+      ejection = _full_replace(word, h);
+      ext_idx = ejection.first;
     }
+    // counter is new (or inherited): threshold is out of date
+    _keep_threshold_refresh_counts[ext_idx] = 0;
   } else {
     // word in language model: increment counter
-    return _full_increment(ext_idx);
+    ejection = _full_increment(ext_idx);
+  }
+  word_idx = ext_idx;
+
+  if (_total >= _keep_threshold_refresh_total) {
+    _refresh_keep_thresholds();
+  } else if (count(ext_idx) >= _keep_threshold_refresh_counts[ext_idx]) {
+    _refresh_keep_threshold(ext_idx);
+  }
+  return ejection;
+}
+
+void SpaceSavingLanguageModel::increment_all(
+    const vector<string>& words, vector<long>& word_idxs,
+    vector<pair<long,string> >& ejectees) {
+  word_idxs.resize(words.size());
+  ejectees.resize(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    ejectees[i] = increment(words[i], word_idxs[i]);
+  }
+}
+
+void SpaceSavingLanguageModel::increment_all(
+    const vector<string>& words, const vector<uint64_t>& hashes,
+    vector<long>& word_idxs, vector<pair<long,string> >& ejectees) {
+  word_idxs.resize(words.size());
+  ejectees.resize(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    ejectees[i] = increment(words[i], hashes[i], word_idxs[i]);
+  }
+}
+
+pair<long,string> SpaceSavingLanguageModel::add(const string& word,
+                                                size_t weight,
+                                                long& word_idx) {
+  const uint64_t h = word_hash(word);
+  long ext_idx = _words.lookup(word, h);
+  if (weight == 0) {
+    word_idx = ext_idx;
+    return make_pair(-1L, string());
+  }
+  _total += weight;
+
+  pair<long,string> ejection(-1L, string());
+  size_t int_idx;
+  if (ext_idx < 0) {
+    // word not in language model
+    if (_size < _num_counters) {
+      // at least one unused counter: append this word with count zero
+      ext_idx = _words.insert(word, h);
+      _internal_ids.push_back(ext_idx);
+      _external_ids.push_back(ext_idx);
+      _counters.push_back(0);
+      int_idx = _size;
+      ++_size;
+    } else {
+      // all counters in use: this word takes over a least counter (and
+      // the ejected word's index)
+      int_idx = _min_idx;
+      ext_idx = _external_ids[int_idx];
+      ejection = make_pair(ext_idx, _words.get(ext_idx));
+      _words.replace(ext_idx, word, h);
+    }
+    // counter is new (or inherited): threshold is out of date
+    _keep_threshold_refresh_counts[ext_idx] = 0;
+  } else {
+    int_idx = _internal_ids[ext_idx];
+  }
+  _counters[int_idx] += weight;
+  _move_up(int_idx);
+  // least counters are the last run of equal counts
+  _min_idx = lower_bound(_counters.begin(), _counters.end(),
+                         _counters.back(), greater<size_t>()) -
+    _counters.begin();
+  word_idx = ext_idx;
+
+  if (_total >= _keep_threshold_refresh_total) {
+    _refresh_keep_thresholds();
+  } else if (count(ext_idx) >= _keep_threshold_refresh_counts[ext_idx]) {
+    _refresh_keep_threshold(ext_idx);
+  }
+  return ejection;
+}
+
+void SpaceSavingLanguageModel::refresh_ejected_idxs(
+    const vector<string>& words, vector<long>& word_idxs,
+    const vector<pair<long,string> >& ejectees) const {
+  vector<long> ejected_idxs;
+  for (size_t i = words.size(); i-- > 0;) {
+    if (find(ejected_idxs.begin(), ejected_idxs.end(), word_idxs[i]) !=
+          ejected_idxs.end()) {
+      word_idxs[i] = lookup(words[i]);
+    }
+    if (ejectees[i].first >= 0) {
+      ejected_idxs.push_back(ejectees[i].first);
+    }
   }
 }
 
 long SpaceSavingLanguageModel::lookup(const string& word) const {
-  auto it = _word_ids.find(word);
-  return (it == _word_ids.end()) ? -1 : _external_ids[it->second];
+  return _words.lookup(word);
 }
 
 string SpaceSavingLanguageModel::reverse_lookup(long ext_word_idx) const {
-  return _words.at(_internal_ids[ext_word_idx]);
+  return _words.get(ext_word_idx);
 }
 
 size_t SpaceSavingLanguageModel::count(long ext_word_idx) const {
@@ -232,11 +524,9 @@ size_t SpaceSavingLanguageModel::total() const {
   return _total;
 }
 
-bool SpaceSavingLanguageModel::subsample(long ext_word_idx) const {
-  const float normalized_freq = count(ext_word_idx) / (float) total();
-  uniform_real_distribution<float> d;
-  const float random_unif = d(get_urng());
-  return random_unif > 1 - sqrt(_subsample_threshold / normalized_freq);
+vector<long> SpaceSavingLanguageModel::subsample(
+    const vector<long>& ext_word_idxs) const {
+  return subsample_words(_keep_thresholds.data(), ext_word_idxs);
 }
 
 void SpaceSavingLanguageModel::truncate(size_t max_size) {
@@ -251,10 +541,18 @@ void SpaceSavingLanguageModel::serialize(ostream& stream) const {
   Serializer<size_t>::serialize(_total, stream);
   Serializer<size_t>::serialize(_min_idx, stream);
   Serializer<vector<size_t> >::serialize(_counters, stream);
-  Serializer<unordered_map<string,long> >::serialize(_word_ids, stream);
+  // vocabulary is stored as a word-to-internal-index map and a word
+  // list by internal index (padded to the number of counters)
+  unordered_map<string,long> word_ids;
+  vector<string> words(_num_counters);
+  for (size_t int_idx = 0; int_idx < _size; ++int_idx) {
+    words[int_idx] = _words.get(_external_ids[int_idx]);
+    word_ids[words[int_idx]] = int_idx;
+  }
+  Serializer<unordered_map<string,long> >::serialize(word_ids, stream);
   Serializer<vector<long> >::serialize(_internal_ids, stream);
   Serializer<vector<long> >::serialize(_external_ids, stream);
-  Serializer<vector<string> >::serialize(_words, stream);
+  Serializer<vector<string> >::serialize(words, stream);
 }
 
 SpaceSavingLanguageModel
@@ -265,10 +563,16 @@ SpaceSavingLanguageModel
   auto total(Serializer<size_t>::deserialize(stream));
   auto min_idx(Serializer<size_t>::deserialize(stream));
   auto counters(Serializer<vector<size_t> >::deserialize(stream));
-  auto word_ids(Serializer<unordered_map<string,long> >::deserialize(stream));
+  // word-to-index map is implied by the word list
+  Serializer<unordered_map<string,long> >::deserialize(stream);
   auto internal_ids(Serializer<vector<long> >::deserialize(stream));
   auto external_ids(Serializer<vector<long> >::deserialize(stream));
   auto words(Serializer<vector<string> >::deserialize(stream));
+  Vocabulary vocabulary;
+  vocabulary.reserve(num_counters);
+  for (size_t ext_idx = 0; ext_idx < size; ++ext_idx) {
+    vocabulary.insert(words.at(internal_ids.at(ext_idx)));
+  }
   return SpaceSavingLanguageModel(
     subsample_threshold,
     num_counters,
@@ -276,13 +580,24 @@ SpaceSavingLanguageModel
     total,
     min_idx,
     move(counters),
-    move(word_ids),
     move(internal_ids),
     move(external_ids),
-    move(words)
+    move(vocabulary)
   );
 }
 
+MemoryUsage SpaceSavingLanguageModel::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("counters", vector_heap_size(_counters));
+  usage.add("internal_ids", vector_heap_size(_internal_ids));
+  usage.add("external_ids", vector_heap_size(_external_ids));
+  usage.add("words", _words.memory_usage());
+  usage.add("keep_thresholds", vector_heap_size(_keep_thresholds));
+  usage.add("keep_threshold_refresh_counts",
+            vector_heap_size(_keep_threshold_refresh_counts));
+  return usage;
+}
+
 bool SpaceSavingLanguageModel::equals(const SpaceSavingLanguageModel& other) const {
   return
     near(_subsample_threshold, other._subsample_threshold) &&
@@ -291,10 +606,26 @@ bool SpaceSavingLanguageModel::equals(const SpaceSavingLanguageModel& other) con
     _total == other._total &&
     _min_idx == other._min_idx &&
     _counters == other._counters &&
-    _word_ids == other._word_ids &&
     _internal_ids == other._internal_ids &&
     _external_ids == other._external_ids &&
-    _words == other._words;
+    _words.equals(other._words);
+}
+
+void SpaceSavingLanguageModel::_refresh_keep_threshold(long ext_word_idx) {
+  const size_t c = count(ext_word_idx);
+  _keep_thresholds[ext_word_idx] = keep_threshold(_subsample_threshold, c,
+                                                  _total);
+  _keep_threshold_refresh_counts[ext_word_idx] =
+    keep_threshold_refresh_count(c);
+}
+
+void SpaceSavingLanguageModel::_refresh_keep_thresholds() {
+  _keep_thresholds.resize(_num_counters);
+  _keep_threshold_refresh_counts.resize(_num_counters);
+  for (size_t ext_idx = 0; ext_idx < _size; ++ext_idx) {
+    _refresh_keep_threshold(ext_idx);
+  }
+  _keep_threshold_refresh_total = keep_threshold_refresh_count(_total);
 }
 
 void SpaceSavingLanguageModel::_update_min_idx() {
@@ -308,13 +639,12 @@ void SpaceSavingLanguageModel::_update_min_idx() {
   }
 }
 
-pair<long,string> SpaceSavingLanguageModel::_unfull_append(const string& word) {
+pair<long,string> SpaceSavingLanguageModel::_unfull_append(const string& word,
+                                                          uint64_t h) {
   // int_idx == ext_idx
-  const long ext_idx = (long) _size;
-  _word_ids[word] = ext_idx;
+  const long ext_idx = _words.insert(word, h);
   _internal_ids.push_back(ext_idx);
   _external_ids.push_back(ext_idx);
-  _words[ext_idx] = word;
   ++_size;
   _counters.push_back(1);
   if (ext_idx == 0 || _counters[_min_idx] > 1) {
@@ -323,13 +653,12 @@ pair<long,string> SpaceSavingLanguageModel::_unfull_append(const string& word) {
   return make_pair(-1L, string());
 }
 
-pair<long,string> SpaceSavingLanguageModel::_full_replace(const string& word) {
+pair<long,string> SpaceSavingLanguageModel::_full_replace(const string& word,
+                                                         uint64_t h) {
   // int_idx == _min_idx
-  string ejectee_word(_words[_min_idx]);
   const long ext_idx = _external_ids[_min_idx];
-  _word_ids.erase(ejectee_word);
-  _word_ids[word] = _min_idx;
-  _words[_min_idx] = word;
+  string ejectee_word(_words.get(ext_idx));
+  _words.replace(ext_idx, word, h);
   ++_counters[_min_idx];
   _update_min_idx();
   return make_pair(ext_idx, ejectee_word);
@@ -349,12 +678,8 @@ pair<long,string> SpaceSavingLanguageModel::_full_increment(long ext_idx) {
     for (new_int_idx = int_idx;
          new_int_idx > 0 && new_count > _counters[new_int_idx - 1];
          --new_int_idx) { }
-    swap(_word_ids.at(_words[int_idx]),
-         _word_ids.at(_words[new_int_idx]));
     swap(_counters[int_idx],
          _counters[new_int_idx]);
-    swap(_words[int_idx],
-         _words[new_int_idx]);
     swap(_internal_ids[_external_ids[int_idx]],
          _internal_ids[_external_ids[new_int_idx]]);
     swap(_external_ids[int_idx],
@@ -363,6 +688,294 @@ pair<long,string> SpaceSavingLanguageModel::_full_increment(long ext_idx) {
   return make_pair(-1L, string());
 }
 
+void SpaceSavingLanguageModel::_move_up(size_t int_idx) {
+  const size_t new_int_idx =
+    upper_bound(_counters.begin(), _counters.begin() + int_idx,
+                _counters[int_idx], greater<size_t>()) - _counters.begin();
+  if (new_int_idx < int_idx) {
+    rotate(_counters.begin() + new_int_idx, _counters.begin() + int_idx,
+           _counters.begin() + int_idx + 1);
+    rotate(_external_ids.begin() + new_int_idx,
+           _external_ids.begin() + int_idx,
+           _external_ids.begin() + int_idx + 1);
+    for (size_t i = new_int_idx; i <= int_idx; ++i) {
+      _internal_ids[_external_ids[i]] = i;
+    }
+  }
+}
+
+
+//
+// FrozenLanguageModel
+//
+
+
+// SplitMix64 finalizer
+static uint64_t mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// return perfect hash key of word hash h under seed (word hashes are
+// already well mixed)
+static uint64_t frozen_key(uint64_t h, uint64_t seed) {
+  return h + seed * 0x9e3779b97f4a7c15ULL;
+}
+
+// return slot of key in bucket with displacement d (out of n slots)
+static uint64_t frozen_slot(uint64_t key, uint32_t d, uint64_t n) {
+  return bounded_uint64(mix64(key ^ d), n);
+}
+
+// Find a displacement for each of num_buckets buckets so that the keys
+// of all buckets map to distinct slots (largest buckets first, when
+// most slots are free); return false if some bucket cannot be placed
+// (try another seed).  On success store the key index at each slot in
+// slot_key_idxs.
+static bool frozen_place(const vector<uint64_t>& keys, size_t num_buckets,
+                         vector<uint32_t>& displacements,
+                         vector<uint32_t>& slot_key_idxs) {
+  const size_t n = keys.size();
+  // group key indices by bucket
+  vector<size_t> bucket_starts(num_buckets + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    ++bucket_starts[bounded_uint64(keys[i], num_buckets) + 1];
+  }
+  size_t max_bucket_size = 0;
+  for (size_t b = 0; b < num_buckets; ++b) {
+    max_bucket_size = max(max_bucket_size, bucket_starts[b + 1]);
+    bucket_starts[b + 1] += bucket_starts[b];
+  }
+  vector<uint32_t> bucket_key_idxs(n);
+  {
+    vector<size_t> fill(bucket_starts.begin(), bucket_starts.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+      bucket_key_idxs[fill[bounded_uint64(keys[i], num_buckets)]++] = i;
+    }
+  }
+  // order buckets by size (descending)
+  vector<vector<uint32_t> > buckets_by_size(max_bucket_size + 1);
+  for (size_t b = 0; b < num_buckets; ++b) {
+    buckets_by_size[bucket_starts[b + 1] - bucket_starts[b]].push_back(b);
+  }
+
+  const uint64_t max_tries = min((uint64_t) UINT32_MAX,
+                                 (uint64_t) 64 * n + 1024);
+  vector<bool> taken(n, false);
+  vector<uint64_t> bucket_slots(max_bucket_size);
+  displacements.assign(num_buckets, 0);
+  slot_key_idxs.assign(n, 0);
+  for (size_t s = max_bucket_size; s > 0; --s) {
+    for (auto b = buckets_by_size[s].begin(); b != buckets_by_size[s].end();
+         ++b) {
+      const uint32_t *key_idxs = &bucket_key_idxs[bucket_starts[*b]];
+      bool placed = false;
+      for (uint64_t d = 0; d < max_tries && ! placed; ++d) {
+        placed = true;
+        for (size_t j = 0; j < s && placed; ++j) {
+          bucket_slots[j] = frozen_slot(keys[key_idxs[j]], d, n);
+          placed = ! taken[bucket_slots[j]] &&
+            find(bucket_slots.begin(), bucket_slots.begin() + j,
+                 bucket_slots[j]) == bucket_slots.begin() + j;
+        }
+        if (placed) {
+          displacements[*b] = (uint32_t) d;
+          for (size_t j = 0; j < s; ++j) {
+            taken[bucket_slots[j]] = true;
+            slot_key_idxs[bucket_slots[j]] = key_idxs[j];
+          }
+        }
+      }
+      if (! placed) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// return offset rounded up to a multiple of eight bytes
+static uint64_t align8(uint64_t offset) {
+  return (offset + 7) & ~(uint64_t) 7;
+}
+
+FrozenLanguageModel::FrozenLanguageModel(
+    const NaiveLanguageModel& language_model): _blob() {
+  const size_t n = language_model.size();
+  vector<string> words(n);
+  vector<uint64_t> hashes(n);
+  size_t num_word_bytes = 0;
+  for (size_t i = 0; i < n; ++i) {
+    words[i] = language_model.reverse_lookup(i);
+    hashes[i] = word_hash(words[i]);
+    num_word_bytes += words[i].size();
+  }
+
+  const size_t num_buckets = max((size_t) 1,
+    (n + FROZEN_LM_BUCKET_SIZE - 1) / FROZEN_LM_BUCKET_SIZE);
+  vector<uint64_t> keys(n);
+  vector<uint32_t> displacements, slot_word_idxs;
+  uint64_t seed = 0;
+  while (true) {
+    for (size_t i = 0; i < n; ++i) {
+      keys[i] = frozen_key(hashes[i], seed);
+    }
+    if (frozen_place(keys, num_buckets, displacements, slot_word_idxs)) {
+      break;
+    }
+    // (placement fails every time if two words share a hash)
+    if (++seed == FROZEN_LM_MAX_SEEDS) {
+      throw runtime_error(
+        string("FrozenLanguageModel: cannot build perfect hash"));
+    }
+  }
+
+  Header header;
+  header.size = n;
+  header.total = language_model.total();
+  header.num_buckets = num_buckets;
+  header.seed = seed;
+  header.subsample_threshold = language_model.subsample_threshold();
+  header.reserved = 0;
+  uint64_t offset = align8(sizeof(Header));
+  header.displacements = offset;
+  offset = align8(offset + num_buckets * sizeof(uint32_t));
+  header.slots = offset;
+  offset = align8(offset + n * sizeof(Slot));
+  header.counts = offset;
+  offset = align8(offset + n * sizeof(uint64_t));
+  header.keep_thresholds = offset;
+  offset = align8(offset + n * sizeof(uint32_t));
+  header.word_offsets = offset;
+  offset = align8(offset + n * sizeof(uint64_t));
+  header.word_bytes = offset;
+  offset = align8(offset + n * sizeof(uint32_t) + num_word_bytes);
+
+  _blob.assign(offset / sizeof(uint64_t), 0);
+  *_mutable_section<Header>(0) = header;
+  copy(displacements.begin(), displacements.end(),
+       _mutable_section<uint32_t>(header.displacements));
+  uint64_t *counts = _mutable_section<uint64_t>(header.counts);
+  uint32_t *keep_thresholds =
+    _mutable_section<uint32_t>(header.keep_thresholds);
+  uint64_t *word_offsets = _mutable_section<uint64_t>(header.word_offsets);
+  char *word_bytes = _mutable_section<char>(header.word_bytes);
+  uint64_t word_offset = 0;
+  for (size_t i = 0; i < n; ++i) {
+    counts[i] = language_model.count(i);
+    keep_thresholds[i] = keep_threshold(header.subsample_threshold,
+                                        counts[i], header.total);
+    const uint32_t word_size = (uint32_t) words[i].size();
+    word_offsets[i] = word_offset;
+    memcpy(word_bytes + word_offset, &word_size, sizeof(uint32_t));
+    copy(words[i].begin(), words[i].end(),
+         word_bytes + word_offset + sizeof(uint32_t));
+    word_offset += sizeof(uint32_t) + word_size;
+  }
+  Slot *slots = _mutable_section<Slot>(header.slots);
+  for (size_t pos = 0; pos < n; ++pos) {
+    slots[pos].fingerprint = (uint32_t) hashes[slot_word_idxs[pos]];
+    slots[pos].word_idx = slot_word_idxs[pos];
+    slots[pos].word_offset = word_offsets[slot_word_idxs[pos]];
+  }
+}
+
+pair<long,string> FrozenLanguageModel::increment(const string& word) {
+  throw logic_error(
+    string("FrozenLanguageModel::increment: language model is frozen"));
+}
+
+long FrozenLanguageModel::lookup(const string& word) const {
+  const Header& header(_header());
+  if (header.size == 0) {
+    return -1;
+  }
+  const uint64_t h = word_hash(word),
+    key = frozen_key(h, header.seed);
+  const uint32_t d = _section<uint32_t>(header.displacements)[
+    bounded_uint64(key, header.num_buckets)];
+  const Slot& slot(_section<Slot>(header.slots)[
+    frozen_slot(key, d, header.size)]);
+  return (slot.fingerprint == (uint32_t) h &&
+          _word_equals(slot.word_offset, word)) ? (long) slot.word_idx : -1;
+}
+
+string FrozenLanguageModel::reverse_lookup(long word_idx) const {
+  if (word_idx < 0 || (size_t) word_idx >= size()) {
+    throw out_of_range("FrozenLanguageModel::reverse_lookup: index " +
+                       to_string(word_idx) + " out of range");
+  }
+  const char *entry = _section<char>(_header().word_bytes) +
+    _section<uint64_t>(_header().word_offsets)[word_idx];
+  uint32_t word_size;
+  memcpy(&word_size, entry, sizeof(uint32_t));
+  return string(entry + sizeof(uint32_t), word_size);
+}
+
+vector<size_t> FrozenLanguageModel::counts() const {
+  const uint64_t *c = _section<uint64_t>(_header().counts);
+  return vector<size_t>(c, c + size());
+}
+
+vector<size_t> FrozenLanguageModel::ordered_counts() const {
+  vector<size_t> c(counts());
+  ::sort(c.begin(), c.end());
+  reverse(c.begin(), c.end());
+  return c;
+}
+
+vector<long> FrozenLanguageModel::subsample(
+    const vector<long>& word_idxs) const {
+  return subsample_words(_section<uint32_t>(_header().keep_thresholds),
+                         word_idxs);
+}
+
+void FrozenLanguageModel::truncate(size_t max_size) {
+  throw logic_error(
+    string("FrozenLanguageModel::truncate: language model is frozen"));
+}
+
+void FrozenLanguageModel::serialize(ostream& stream) const {
+  // naive language model format
+  const size_t n = size();
+  unordered_map<string,long> word_ids;
+  vector<string> words(n);
+  for (size_t i = 0; i < n; ++i) {
+    words[i] = reverse_lookup(i);
+    word_ids[words[i]] = i;
+  }
+  Serializer<float>::serialize(subsample_threshold(), stream);
+  Serializer<size_t>::serialize(n, stream);
+  Serializer<size_t>::serialize(total(), stream);
+  Serializer<vector<size_t> >::serialize(counts(), stream);
+  Serializer<unordered_map<string,long> >::serialize(word_ids, stream);
+  Serializer<vector<string> >::serialize(words, stream);
+}
+
+FrozenLanguageModel FrozenLanguageModel::deserialize(istream& stream) {
+  return FrozenLanguageModel(NaiveLanguageModel::deserialize(stream));
+}
+
+MemoryUsage FrozenLanguageModel::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("blob", vector_heap_size(_blob));
+  return usage;
+}
+
+bool FrozenLanguageModel::equals(const FrozenLanguageModel& other) const {
+  return _blob == other._blob;
+}
+
+bool FrozenLanguageModel::_word_equals(uint64_t word_offset,
+                                       const string& word) const {
+  const char *entry = _section<char>(_header().word_bytes) + word_offset;
+  uint32_t word_size;
+  memcpy(&word_size, entry, sizeof(uint32_t));
+  return word_size == word.size() &&
+    memcmp(entry + sizeof(uint32_t), word.data(), word.size()) == 0;
+}
+
 
 //
 // WordContextFactorization
@@ -413,6 +1026,14 @@ float* WordContextFactorization::get_context_embedding(size_t word_idx) {
   return _context_embeddings.data() + word_idx * _actual_embedding_dim;
 }
 
+const float* WordContextFactorization::get_word_embedding(size_t word_idx) const {
+  return _word_embeddings.data() + word_idx * _actual_embedding_dim;
+}
+
+const float* WordContextFactorization::get_context_embedding(size_t word_idx) const {
+  return _context_embeddings.data() + word_idx * _actual_embedding_dim;
+}
+
 void WordContextFactorization::serialize(ostream& stream) const {
   Serializer<size_t>::serialize(_vocab_dim, stream);
   Serializer<size_t>::serialize(_embedding_dim, stream);
@@ -437,6 +1058,17 @@ WordContextFactorization
   );
 }
 
+MemoryUsage WordContextFactorization::memory_usage() const {
+  const size_t matrix_size = _vocab_dim * _embedding_dim * sizeof(float);
+  MemoryUsage usage;
+  usage.add("word_embeddings", matrix_size);
+  usage.add("context_embeddings", matrix_size);
+  usage.add("padding",
+    _word_embeddings.heap_size() + _context_embeddings.heap_size() -
+      2 * matrix_size);
+  return usage;
+}
+
 bool WordContextFactorization::equals(const WordContextFactorization& other) const {
   return
     _vocab_dim == other._vocab_dim &&
@@ -478,6 +1110,7 @@ void SGD::gradient_update(size_t dim, size_t n, const float *g, float *x) {
 
 void SGD::scaled_gradient_update(size_t dim, size_t n, const float *g, float *x,
                                  float alpha) {
+  TRACE_SCOPE("sgd_update");
   cblas_saxpy(n, _rho[dim] * alpha, g, 1, x, 1);
 }
 
@@ -512,6 +1145,13 @@ SGD SGD::deserialize(istream& stream) {
   );
 }
 
+MemoryUsage SGD::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("rho", vector_heap_size(_rho));
+  usage.add("t", vector_heap_size(_t));
+  return usage;
+}
+
 bool SGD::equals(const SGD& other) const {
   return
     _dimension == other._dimension &&
@@ -560,8 +1200,7 @@ bool StaticContextStrategy::equals(const StaticContextStrategy& other) const {
 
 pair<size_t,size_t> DynamicContextStrategy::size(size_t avail_left,
                                                  size_t avail_right) const {
-  uniform_int_distribution<size_t> d(1, _symm_context);
-  const size_t ctx_size = d(get_urng());
+  const size_t ctx_size = 1 + sample_uniform_index(_symm_context);
   return make_pair(min(avail_left, ctx_size),
                    min(avail_right, ctx_size));
 }
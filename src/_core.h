@@ -16,10 +16,28 @@
 #include <algorithm>
 
 #include "_math.h"
+#include "_vocab.h"
 
 
 // frequent-word subsampling threshold as defined in word2vec.
 #define DEFAULT_SUBSAMPLE_THRESHOLD 1e-3
+// subsampling keep thresholds are recomputed when a word's count, or
+// the total count, has grown by more than 1/KEEP_THRESHOLD_TOLERANCE_INV
+// since they were computed (keep probabilities then err by about half
+// that)
+#define KEEP_THRESHOLD_TOLERANCE_INV 32
+// mean number of words per bucket of the frozen language model's
+// perfect hash (fewer words per bucket: faster construction, more
+// memory)
+#define FROZEN_LM_BUCKET_SIZE 4
+// number of hash seeds to try before giving up on the frozen language
+// model's perfect hash
+#define FROZEN_LM_MAX_SEEDS 16
+// a naive language model with a type budget prunes words until at most
+// NAIVE_LM_PRUNE_TARGET_NUM / NAIVE_LM_PRUNE_TARGET_DEN of the budget
+// remain (so that pruning is rare)
+#define NAIVE_LM_PRUNE_TARGET_NUM 3
+#define NAIVE_LM_PRUNE_TARGET_DEN 4
 #define DEFAULT_VOCAB_DIM 16000
 #define DEFAULT_EMBEDDING_DIM 100
 #define DEFAULT_REFRESH_INTERVAL 0
@@ -42,21 +60,78 @@ bool pair_second_cmp(std::pair<T,U> x, std::pair<T,U> y) {
 }
 
 
-// Language model implemented naively
+// Return threshold on 32 random bits x such that x <= threshold with
+// probability min(1, sqrt(subsample_threshold / (count / total))),
+// the probability of keeping a word under frequent-word subsampling.
+uint32_t keep_threshold(float subsample_threshold, size_t count,
+                        size_t total);
+
+
+// Language model implemented naively.  If given a type budget
+// max_types (zero: none), it holds at most max_types words: a new word
+// that would exceed the budget first prunes every word whose count is
+// at most a threshold, which rises with each pruning (as word2vec's
+// ReduceVocab), until there is room.  Pruning renumbers the remaining
+// words (keeping their order), and a pruned word that reappears starts
+// over from one, so counts are underestimated by at most
+// max_undercount (the sum of the thresholds used); total still counts
+// every token.  The budget and pruning record are not serialized.
 
 class NaiveLanguageModel final {
   float _subsample_threshold;
   size_t _size;
   size_t _total;
   std::vector<size_t> _counters;
-  std::unordered_map<std::string,long> _word_ids;
-  std::vector<std::string> _words;
+  Vocabulary _words;
+  size_t _max_types;
+  // count at most which words were pruned by the latest pruning, and
+  // bound on the count lost by any word (zero if never pruned)
+  size_t _prune_threshold;
+  size_t _max_undercount;
+  // subsampling keep threshold of each word (see keep_threshold) and
+  // counts at which to recompute them
+  std::vector<uint32_t> _keep_thresholds;
+  std::vector<size_t> _keep_threshold_refresh_counts;
+  size_t _keep_threshold_refresh_total;
 
   public:
-    NaiveLanguageModel(float subsample_threshold = DEFAULT_SUBSAMPLE_THRESHOLD);
+    NaiveLanguageModel(float subsample_threshold = DEFAULT_SUBSAMPLE_THRESHOLD,
+                       size_t max_types = 0);
     // return ejected (index, word) pair
     // (index is -1 if nothing was ejected)
-    std::pair<long,std::string> increment(const std::string& word);
+    std::pair<long,std::string> increment(const std::string& word) {
+      long word_idx;
+      return increment(word, word_idx);
+    }
+    // as above, and store index of word in word_idx (hashing word once
+    // if it is already present)
+    std::pair<long,std::string> increment(const std::string& word,
+                                          long& word_idx) {
+      return add(word, 1, word_idx);
+    }
+    // increment each of words in order; store index of each word (just
+    // after its increment) in word_idxs and ejected (index, word) pair
+    // of each increment in ejectees (both resized to words.size())
+    void increment_all(const std::vector<std::string>& words,
+                       std::vector<long>& word_idxs,
+                       std::vector<std::pair<long,std::string> >& ejectees);
+    // add weight occurrences of word at once, as weight increments
+    // would (do nothing if weight is zero); return ejected (index,
+    // word) pair as increment does
+    std::pair<long,std::string> add(const std::string& word,
+                                    size_t weight) {
+      long word_idx;
+      return add(word, weight, word_idx);
+    }
+    // as above, and store index of word in word_idx (-1 if weight is
+    // zero and word is not present)
+    std::pair<long,std::string> add(const std::string& word, size_t weight,
+                                    long& word_idx);
+    // add counts of other to counts of this model (words not present
+    // are appended in other's index order, so merging the models of
+    // consecutive parts of a stream in order gives the model of the
+    // whole stream); prune afterward if over budget
+    void merge(const NaiveLanguageModel& other);
     // return index of word (-1 if does not exist)
     long lookup(const std::string& word) const;
     // return word at index (raise exception if does not exist)
@@ -71,15 +146,33 @@ class NaiveLanguageModel final {
     size_t size() const;
     // return total number of word tokens seen by language model
     size_t total() const;
+    float subsample_threshold() const { return _subsample_threshold; }
+    size_t max_types() const { return _max_types; }
+    // return count at most which the latest pruning dropped words
+    // (zero if never pruned)
+    size_t prune_threshold() const { return _prune_threshold; }
+    // return bound on the number of occurrences of any word lost to
+    // pruning
+    size_t max_undercount() const { return _max_undercount; }
     // return true if word should be kept after subsampling
     // (return true with probability
     // sqrt(subsample_threshold / f(word_idx)) where f(word_idx) is the
     // normalized frequency corresponding to word_idx)
-    bool subsample(long word_idx) const;
+    bool subsample(long word_idx) const {
+      return get_urng()() <= _keep_thresholds[word_idx];
+    }
+    // return word indices in word_idxs kept after subsampling (in
+    // order)
+    std::vector<long> subsample(const std::vector<long>& word_idxs) const;
     void truncate(size_t max_size);
+    // reserve room for n words, so that adding them does not grow the
+    // vocabulary's hash table or the per-word arrays
+    void reserve(size_t n);
     // sort language model words by count (descending)
     void sort();
 
+    MemoryUsage memory_usage() const;
+
     bool equals(const NaiveLanguageModel& other) const;
     void serialize(std::ostream& stream) const;
     static NaiveLanguageModel deserialize(std::istream& stream);
@@ -88,20 +181,39 @@ class NaiveLanguageModel final {
                   size_t size,
                   size_t total,
                   std::vector<size_t>&& counters,
-                  std::unordered_map<std::string,long>&& word_ids,
-                  std::vector<std::string>&& words):
+                  Vocabulary&& words):
         _subsample_threshold(subsample_threshold),
         _size(size),
         _total(total),
         _counters(std::move(counters)),
-        _word_ids(std::move(word_ids)),
-        _words(std::move(words)) { }
+        _words(std::move(words)),
+        _max_types(0),
+        _prune_threshold(0),
+        _max_undercount(0),
+        _keep_thresholds(),
+        _keep_threshold_refresh_counts(),
+        _keep_threshold_refresh_total(0) {
+      _refresh_keep_thresholds();
+    }
     NaiveLanguageModel(NaiveLanguageModel&& other) = default;
     NaiveLanguageModel(const NaiveLanguageModel& other) = default;
+    NaiveLanguageModel& operator=(const NaiveLanguageModel& other) = default;
+
+  private:
+    void _refresh_keep_threshold(long word_idx);
+    void _refresh_keep_thresholds();
+    // drop words with count at most a rising threshold until at most
+    // the prune target remain
+    void _prune();
 };
 
 
 // Language model implemented on SpaceSaving approximate counter.
+// If fingerprint keyed, counters are found by 64-bit word fingerprint
+// (word_hash, which the caller may pass in) and words are stored only
+// for reverse lookup (see Vocabulary); ejections then move fingerprints
+// and never compare strings.  The keying is not serialized (a loaded
+// model compares strings).
 
 class SpaceSavingLanguageModel final {
   float _subsample_threshold;
@@ -110,18 +222,71 @@ class SpaceSavingLanguageModel final {
   size_t _total;
   size_t _min_idx;
   std::vector<size_t> _counters;
-  std::unordered_map<std::string,long> _word_ids;
   std::vector<long> _internal_ids;
   std::vector<long> _external_ids;
-  std::vector<std::string> _words;
+  // words by external index (stable while the word is present, so
+  // counter reordering does not touch the vocabulary)
+  Vocabulary _words;
+  // subsampling keep threshold of each word (by external index, see
+  // keep_threshold) and counts at which to recompute them
+  std::vector<uint32_t> _keep_thresholds;
+  std::vector<size_t> _keep_threshold_refresh_counts;
+  size_t _keep_threshold_refresh_total;
 
   public:
     SpaceSavingLanguageModel(
       size_t num_counters = DEFAULT_VOCAB_DIM,
-      float subsample_threshold = DEFAULT_SUBSAMPLE_THRESHOLD);
+      float subsample_threshold = DEFAULT_SUBSAMPLE_THRESHOLD,
+      bool fingerprint_keyed = false);
     // return ejected (index, word) pair
     // (index is -1 if nothing was ejected)
-    std::pair<long,std::string> increment(const std::string& word);
+    std::pair<long,std::string> increment(const std::string& word) {
+      long word_idx;
+      return increment(word, word_idx);
+    }
+    // as above, and store index of word in word_idx (hashing word once
+    // if it is already present)
+    std::pair<long,std::string> increment(const std::string& word,
+                                          long& word_idx) {
+      return increment(word, word_hash(word), word_idx);
+    }
+    // as above, given h = word_hash(word)
+    std::pair<long,std::string> increment(const std::string& word,
+                                          uint64_t h, long& word_idx);
+    // increment each of words in order; store index of each word (just
+    // after its increment) in word_idxs and ejected (index, word) pair
+    // of each increment in ejectees (both resized to words.size())
+    void increment_all(const std::vector<std::string>& words,
+                       std::vector<long>& word_idxs,
+                       std::vector<std::pair<long,std::string> >& ejectees);
+    // as above, given hashes[i] = word_hash(words[i])
+    void increment_all(const std::vector<std::string>& words,
+                       const std::vector<uint64_t>& hashes,
+                       std::vector<long>& word_idxs,
+                       std::vector<std::pair<long,std::string> >& ejectees);
+    // given words, word_idxs and ejectees from increment_all, set
+    // the index of each word whose index was ejected later in words to
+    // the word's current index (-1 if it is no longer present), so
+    // every index refers to its word as the model now stands
+    void refresh_ejected_idxs(
+      const std::vector<std::string>& words,
+      std::vector<long>& word_idxs,
+      const std::vector<std::pair<long,std::string> >& ejectees) const;
+    // add weight occurrences of word at once (weighted Space-Saving:
+    // a new word takes over the least counter, plus weight, so every
+    // count still overestimates its word's true count by at most the
+    // least count when the word was inserted, and the counts sum to
+    // total); do nothing if weight is zero.  Return ejected (index,
+    // word) pair as increment does
+    std::pair<long,std::string> add(const std::string& word,
+                                    size_t weight) {
+      long word_idx;
+      return add(word, weight, word_idx);
+    }
+    // as above, and store index of word in word_idx (-1 if weight is
+    // zero and word is not present)
+    std::pair<long,std::string> add(const std::string& word, size_t weight,
+                                    long& word_idx);
     // return index of word (-1 if does not exist)
     long lookup(const std::string& word) const;
     // return word at index (raise exception if does not exist)
@@ -136,47 +301,169 @@ class SpaceSavingLanguageModel final {
     size_t size() const;
     // return number of word types possible language model
     size_t capacity() const;
+    bool fingerprint_keyed() const { return _words.fingerprint_keyed(); }
     // return total number of word tokens seen by language model
     size_t total() const;
     // return true if word should be kept after subsampling
     // (return true with probability
     // sqrt(subsample_threshold / f(word_idx)) where f(word_idx) is the
     // normalized frequency corresponding to word_idx)
-    bool subsample(long ext_word_idx) const;
+    bool subsample(long ext_word_idx) const {
+      return get_urng()() <= _keep_thresholds[ext_word_idx];
+    }
+    // return word indices in ext_word_idxs kept after subsampling (in
+    // order)
+    std::vector<long> subsample(const std::vector<long>& ext_word_idxs) const;
     void truncate(size_t max_size);
 
+    MemoryUsage memory_usage() const;
+
     bool equals(const SpaceSavingLanguageModel& other) const;
     void serialize(std::ostream& stream) const;
     static SpaceSavingLanguageModel deserialize(std::istream& stream);
 
+    // (words are by external index)
     SpaceSavingLanguageModel(float subsample_threshold,
                              size_t num_counters,
                              size_t size,
                              size_t total,
                              size_t min_idx,
                              std::vector<size_t>&& counters,
-                             std::unordered_map<std::string,long>&& word_ids,
                              std::vector<long>&& internal_ids,
                              std::vector<long>&& external_ids,
-                             std::vector<std::string>&& words):
+                             Vocabulary&& words):
         _subsample_threshold(subsample_threshold),
         _num_counters(num_counters),
         _size(size),
         _total(total),
         _min_idx(min_idx),
         _counters(std::move(counters)),
-        _word_ids(std::move(word_ids)),
         _internal_ids(std::move(internal_ids)),
         _external_ids(std::move(external_ids)),
-        _words(std::move(words)) { }
+        _words(std::move(words)),
+        _keep_thresholds(),
+        _keep_threshold_refresh_counts(),
+        _keep_threshold_refresh_total(0) {
+      _refresh_keep_thresholds();
+    }
     SpaceSavingLanguageModel(SpaceSavingLanguageModel&& other) = default;
     SpaceSavingLanguageModel(const SpaceSavingLanguageModel& other) = default;
+    SpaceSavingLanguageModel& operator=(const SpaceSavingLanguageModel& other) = default;
 
   private:
+    void _refresh_keep_threshold(long ext_word_idx);
+    void _refresh_keep_thresholds();
     void _update_min_idx();
-    std::pair<long,std::string> _unfull_append(const std::string& word);
-    std::pair<long,std::string> _full_replace(const std::string& word);
+    std::pair<long,std::string> _unfull_append(const std::string& word,
+                                               uint64_t h);
+    std::pair<long,std::string> _full_replace(const std::string& word,
+                                              uint64_t h);
     std::pair<long,std::string> _full_increment(long ext_idx);
+    // move counter at int_idx, which has grown, ahead of all smaller
+    // counters (after equal ones), shifting those back by one
+    void _move_up(size_t int_idx);
+};
+
+
+// Read-only language model frozen from a (truncated) naive language
+// model, for training with a fixed vocabulary.  Words are found by a
+// minimal perfect hash (hash and displace: each word's bucket stores
+// a displacement that sends all of the bucket's words to distinct
+// slots), and a slot's 32-bit fingerprint rejects almost all
+// out-of-vocabulary words without touching the word itself, so a
+// lookup is one probe.  Word indices, counts and subsampling keep
+// thresholds are those of the naive model.  All data lives in one
+// contiguous blob addressed by offsets (no pointers), so it could be
+// written out and mapped as is.  Serialized in the naive language
+// model format, so either model can load the other's output.
+
+class FrozenLanguageModel final {
+  struct Header {
+    uint64_t size;
+    uint64_t total;
+    uint64_t num_buckets;
+    uint64_t seed;
+    float subsample_threshold;
+    uint32_t reserved;
+    // byte offsets of sections in blob (each word is stored as its
+    // 32-bit size followed by its bytes, at its word offset)
+    uint64_t displacements;
+    uint64_t slots;
+    uint64_t counts;
+    uint64_t keep_thresholds;
+    uint64_t word_offsets;
+    uint64_t word_bytes;
+  };
+  struct Slot {
+    uint32_t fingerprint;
+    uint32_t word_idx;
+    // (copy of word offset, saving a load per lookup)
+    uint64_t word_offset;
+  };
+
+  // (8-byte words, so that sections are aligned)
+  std::vector<uint64_t> _blob;
+
+  public:
+    explicit FrozenLanguageModel(const NaiveLanguageModel& language_model);
+    // frozen language model cannot be incremented (raise exception)
+    std::pair<long,std::string> increment(const std::string& word);
+    // return index of word (-1 if does not exist)
+    long lookup(const std::string& word) const;
+    // return word at index (raise exception if does not exist)
+    std::string reverse_lookup(long word_idx) const;
+    // return count at word index
+    size_t count(long word_idx) const {
+      return _section<uint64_t>(_header().counts)[word_idx];
+    }
+    // return counts of all word indices
+    std::vector<size_t> counts() const;
+    // return ordered (descending) counts of all word indices
+    std::vector<size_t> ordered_counts() const;
+    // return number of word types present in language model
+    size_t size() const { return _header().size; }
+    // return total number of word tokens seen by language model
+    size_t total() const { return _header().total; }
+    float subsample_threshold() const {
+      return _header().subsample_threshold;
+    }
+    // return true if word should be kept after subsampling (see
+    // NaiveLanguageModel::subsample)
+    bool subsample(long word_idx) const {
+      return get_urng()() <=
+        _section<uint32_t>(_header().keep_thresholds)[word_idx];
+    }
+    // return word indices in word_idxs kept after subsampling (in
+    // order)
+    std::vector<long> subsample(const std::vector<long>& word_idxs) const;
+    // frozen language model cannot be truncated (raise exception)
+    void truncate(size_t max_size);
+
+    MemoryUsage memory_usage() const;
+
+    bool equals(const FrozenLanguageModel& other) const;
+    void serialize(std::ostream& stream) const;
+    static FrozenLanguageModel deserialize(std::istream& stream);
+
+    FrozenLanguageModel(FrozenLanguageModel&& other) = default;
+    FrozenLanguageModel(const FrozenLanguageModel& other) = default;
+
+  private:
+    const Header& _header() const {
+      return *reinterpret_cast<const Header*>(_blob.data());
+    }
+    template <class T>
+    const T* _section(uint64_t offset) const {
+      return reinterpret_cast<const T*>(
+        reinterpret_cast<const char*>(_blob.data()) + offset);
+    }
+    template <class T>
+    T* _mutable_section(uint64_t offset) {
+      return reinterpret_cast<T*>(
+        reinterpret_cast<char*>(_blob.data()) + offset);
+    }
+    // return true if word stored at word_offset is word
+    bool _word_equals(uint64_t word_offset, const std::string& word) const;
 };
 
 
@@ -193,6 +480,11 @@ class WordContextFactorization final {
     size_t get_vocab_dim() const;
     float* get_word_embedding(size_t word_idx);
     float* get_context_embedding(size_t word_idx);
+    const float* get_word_embedding(size_t word_idx) const;
+    const float* get_context_embedding(size_t word_idx) const;
+
+    // (padding is the part of each embedding matrix that aligns rows)
+    MemoryUsage memory_usage() const;
 
     bool equals(const WordContextFactorization& other) const;
     void serialize(std::ostream& stream) const;
@@ -210,6 +502,7 @@ class WordContextFactorization final {
         _context_embeddings(std::move(context_embeddings)) { }
     WordContextFactorization(WordContextFactorization&& other) = default;
     WordContextFactorization(const WordContextFactorization& other) = default;
+    WordContextFactorization& operator=(const WordContextFactorization& other) = default;
 };
 
 
@@ -232,6 +525,8 @@ class SGD final {
                                         float *x, float alpha);
     void reset(size_t dim);
 
+    MemoryUsage memory_usage() const;
+
     bool equals(const SGD& other) const;
     void serialize(std::ostream& stream) const;
     static SGD deserialize(std::istream& stream);
@@ -273,6 +568,8 @@ class UniformSamplingStrategy final {
     UniformSamplingStrategy(UniformSamplingStrategy&& other) = default;
     UniformSamplingStrategy(const UniformSamplingStrategy& other) = default;
 
+    MemoryUsage memory_usage() const { return MemoryUsage(); }
+
     bool equals(const UniformSamplingStrategy& other) const { return true; }
     void serialize(std::ostream& stream) const { }
     static UniformSamplingStrategy<LanguageModel> deserialize(std::istream& stream) {
@@ -313,6 +610,12 @@ class EmpiricalSamplingStrategy final {
       step(const LanguageModel& language_model, size_t word_idx);
     long sample_idx(const LanguageModel& language_model);
 
+    MemoryUsage memory_usage() const {
+      MemoryUsage usage;
+      usage.add("alias_sampler", alias_sampler.memory_usage());
+      return usage;
+    }
+
     bool equals(const EmpiricalSamplingStrategy& other) const;
     void serialize(std::ostream& stream) const;
     static EmpiricalSamplingStrategy deserialize(std::istream& stream);
@@ -356,6 +659,12 @@ class ReservoirSamplingStrategy final {
       return reservoir_sampler.sample();
     }
 
+    MemoryUsage memory_usage() const {
+      MemoryUsage usage;
+      usage.add("reservoir_sampler", reservoir_sampler.memory_usage());
+      return usage;
+    }
+
     bool equals(const ReservoirSamplingStrategy& other) const;
     void serialize(std::ostream& stream) const;
     static ReservoirSamplingStrategy deserialize(std::istream& stream);
@@ -385,6 +694,12 @@ class DiscreteSamplingStrategy final {
     DiscreteSamplingStrategy(DiscreteSamplingStrategy&& other) = default;
     DiscreteSamplingStrategy(const DiscreteSamplingStrategy& other) = default;
 
+    MemoryUsage memory_usage() const {
+      MemoryUsage usage;
+      usage.add("discretization", discretization.memory_usage());
+      return usage;
+    }
+
     bool equals(const DiscreteSamplingStrategy& other) const;
     void serialize(std::ostream& stream) const;
     static DiscreteSamplingStrategy<LanguageModel, DiscretizationType> deserialize(std::istream& stream);
@@ -443,8 +758,7 @@ class DynamicContextStrategy final {
 
 template <class LanguageModel>
 long UniformSamplingStrategy<LanguageModel>::sample_idx(const LanguageModel& language_model) {
-  std::uniform_int_distribution<long> d(0, language_model.size() - 1);
-  return d(get_urng());
+  return sample_uniform_index(language_model.size());
 }
 
 
@@ -0,0 +1,127 @@
+#include "_corpus.h"
+#include "_math.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+
+using namespace std;
+
+
+static vector<float> zipf_probabilities(size_t vocab_size, float exponent) {
+  vector<float> probabilities(vocab_size);
+  double total = 0;
+  for (size_t r = 0; r < vocab_size; ++r) {
+    total += pow(r + 1., -exponent);
+  }
+  for (size_t r = 0; r < vocab_size; ++r) {
+    probabilities[r] = pow(r + 1., -exponent) / total;
+  }
+  return probabilities;
+}
+
+
+//
+// ZipfianCorpusGenerator
+//
+
+
+ZipfianCorpusGenerator::ZipfianCorpusGenerator(
+    size_t vocab_size,
+    float exponent,
+    float mean_sentence_length,
+    int sentence_length_distribution,
+    size_t drift_interval,
+    size_t drift_swaps,
+    size_t drift_head_size):
+      _vocab_size(vocab_size),
+      _drift_interval(drift_interval),
+      _drift_swaps(drift_swaps),
+      _drift_head_size(min(drift_head_size, vocab_size)),
+      _sentence_length_distribution(sentence_length_distribution),
+      _mean_sentence_length(mean_sentence_length),
+      _rank_sampler(zipf_probabilities(vocab_size, exponent)),
+      _rank_words(vocab_size),
+      _num_tokens(0) {
+  if (vocab_size == 0) {
+    throw invalid_argument(
+      string("ZipfianCorpusGenerator::ZipfianCorpusGenerator: ") +
+      string("vocab_size must be positive"));
+  }
+  if (! (mean_sentence_length >= 1)) {
+    throw invalid_argument(
+      string("ZipfianCorpusGenerator::ZipfianCorpusGenerator: ") +
+      string("mean_sentence_length must be at least one"));
+  }
+  if (sentence_length_distribution != SENTENCE_LENGTH_FIXED &&
+      sentence_length_distribution != SENTENCE_LENGTH_POISSON &&
+      sentence_length_distribution != SENTENCE_LENGTH_GEOMETRIC) {
+    throw invalid_argument(
+      string("ZipfianCorpusGenerator::ZipfianCorpusGenerator: ") +
+      string("unknown sentence length distribution"));
+  }
+  for (size_t r = 0; r < vocab_size; ++r) {
+    _rank_words[r] = r;
+  }
+}
+
+long ZipfianCorpusGenerator::next_word_idx() {
+  if (_drift_interval > 0 && _num_tokens > 0 &&
+      _num_tokens % _drift_interval == 0) {
+    drift();
+  }
+  ++_num_tokens;
+  return _rank_words[_rank_sampler.sample()];
+}
+
+vector<long> ZipfianCorpusGenerator::next_sentence_idx() {
+  size_t length;
+  // a mean of one (the least) leaves no room for variation, and the
+  // Poisson and geometric distributions would be degenerate
+  const int distribution =
+    (_mean_sentence_length == 1) ? SENTENCE_LENGTH_FIXED :
+                                   _sentence_length_distribution;
+  switch (distribution) {
+    case SENTENCE_LENGTH_POISSON: {
+      // shift so that the mean is preserved and length is at least one
+      poisson_distribution<size_t> d(_mean_sentence_length - 1);
+      length = 1 + d(get_urng());
+      break;
+    }
+    case SENTENCE_LENGTH_GEOMETRIC: {
+      geometric_distribution<size_t> d(1. / _mean_sentence_length);
+      length = 1 + d(get_urng());
+      break;
+    }
+    default:
+      length = (size_t) round(_mean_sentence_length);
+      break;
+  }
+  vector<long> word_ids(length);
+  for (size_t i = 0; i < length; ++i) {
+    word_ids[i] = next_word_idx();
+  }
+  return word_ids;
+}
+
+vector<string> ZipfianCorpusGenerator::next_sentence() {
+  const vector<long> word_ids(next_sentence_idx());
+  vector<string> words(word_ids.size());
+  for (size_t i = 0; i < word_ids.size(); ++i) {
+    words[i] = word(word_ids[i]);
+  }
+  return words;
+}
+
+void ZipfianCorpusGenerator::drift() {
+  uniform_int_distribution<size_t> head(0, _drift_head_size - 1),
+                                   any(0, _vocab_size - 1);
+  for (size_t s = 0; s < _drift_swaps; ++s) {
+    swap(_rank_words[head(get_urng())], _rank_words[any(get_urng())]);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef ATHENA__CORPUS_H
+#define ATHENA__CORPUS_H
+
+
+#include "_math.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+#define DEFAULT_CORPUS_VOCAB_SIZE 100000
+#define DEFAULT_CORPUS_ZIPF_EXPONENT 1
+#define DEFAULT_CORPUS_SENTENCE_LENGTH 20
+#define DEFAULT_CORPUS_DRIFT_SWAPS 1
+#define DEFAULT_CORPUS_DRIFT_HEAD_SIZE 100
+
+#define SENTENCE_LENGTH_FIXED 0
+#define SENTENCE_LENGTH_POISSON 1
+#define SENTENCE_LENGTH_GEOMETRIC 2
+
+
+// Generates a synthetic token stream in which the word at popularity
+// rank r (counting from zero) is drawn with probability proportional to
+// (r + 1)^(-exponent).  Word i is written "w<i>".  Sentence lengths
+// are fixed, Poisson, or geometric with the given mean (and at least
+// one).  If drift_interval is positive, every drift_interval tokens
+// drift_swaps words in the drift_head_size most popular ranks trade
+// places with words at ranks drawn uniformly at random, so new heavy
+// hitters appear and old ones fade.  Randomness comes from get_urng,
+// so output is determined by the seed.
+
+class ZipfianCorpusGenerator final {
+  size_t _vocab_size;
+  size_t _drift_interval, _drift_swaps, _drift_head_size;
+  int _sentence_length_distribution;
+  float _mean_sentence_length;
+  AliasSampler _rank_sampler;
+  std::vector<long> _rank_words;
+  size_t _num_tokens;
+
+  public:
+    ZipfianCorpusGenerator(
+      size_t vocab_size = DEFAULT_CORPUS_VOCAB_SIZE,
+      float exponent = DEFAULT_CORPUS_ZIPF_EXPONENT,
+      float mean_sentence_length = DEFAULT_CORPUS_SENTENCE_LENGTH,
+      int sentence_length_distribution = SENTENCE_LENGTH_POISSON,
+      size_t drift_interval = 0,
+      size_t drift_swaps = DEFAULT_CORPUS_DRIFT_SWAPS,
+      size_t drift_head_size = DEFAULT_CORPUS_DRIFT_HEAD_SIZE);
+    // return index of next word in stream
+    long next_word_idx();
+    // return indices of words in next sentence
+    std::vector<long> next_sentence_idx();
+    // return next sentence
+    std::vector<std::string> next_sentence();
+    // return index of word currently at popularity rank
+    long word_idx_at_rank(size_t rank) const { return _rank_words[rank]; }
+    // return number of tokens generated so far
+    size_t num_tokens() const { return _num_tokens; }
+    // perform one drift step
+    void drift();
+    static std::string word(long word_idx) {
+      return "w" + std::to_string(word_idx);
+    }
+
+    ZipfianCorpusGenerator(ZipfianCorpusGenerator&& other) = default;
+    ZipfianCorpusGenerator(const ZipfianCorpusGenerator& other) = default;
+};
+
+
+#endif
@@ -0,0 +1,474 @@
+#include "_count.h"
+#include "_io.h"
+#include "_log.h"
+#include "_trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#define omp_get_max_threads() 1
+#else
+extern "C" {
+#include <omp.h>
+}
+#endif
+
+
+using namespace std;
+
+
+// Sorted (word, count) run on disk: records of 32-bit word size, word
+// bytes and 64-bit count, in increasing word order.  The file is
+// created (with a unique name) in dir on construction and removed on
+// destruction.  It is open only while being written (append, then
+// finish) and while being read (open, next, then close), so many runs
+// can exist without holding a descriptor each.
+
+class CountRun final {
+  string _path;
+  ofstream _out;
+  ifstream _in;
+  string _word;
+  uint64_t _count;
+
+  public:
+    CountRun(const string& dir);
+    ~CountRun() { remove(_path.c_str()); }
+    void append(const string& word, uint64_t count);
+    void finish();
+    void open();
+    // read next pair (return false at end of run)
+    bool next();
+    void close() { _in.close(); }
+    const string& word() const { return _word; }
+    size_t count() const { return _count; }
+};
+
+CountRun::CountRun(const string& dir):
+    _path(dir + "/athena-count-XXXXXX"), _out(), _in(), _word(), _count(0) {
+  // create the file exclusively (mode 0600) so the name cannot be
+  // claimed by anyone else first
+  const int fd = mkstemp(&_path[0]);
+  if (fd < 0) {
+    throw runtime_error(string("CountRun::CountRun: cannot create run in ") +
+                        dir + ": " + strerror(errno));
+  }
+  ::close(fd);
+  _out.open(_path.c_str(), ios::binary);
+  if (! _out) {
+    remove(_path.c_str());
+  }
+  stream_ready_or_throw(_out);
+}
+
+void CountRun::append(const string& word, uint64_t count) {
+  const uint32_t word_size = word.size();
+  _out.write(reinterpret_cast<const char*>(&word_size), sizeof(word_size));
+  _out.write(word.data(), word_size);
+  _out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+}
+
+void CountRun::finish() {
+  _out.flush();
+  stream_ready_or_throw(_out);
+  _out.close();
+}
+
+void CountRun::open() {
+  _in.open(_path.c_str(), ios::binary);
+  stream_ready_or_throw(_in);
+}
+
+bool CountRun::next() {
+  uint32_t word_size;
+  if (! _in.read(reinterpret_cast<char*>(&word_size), sizeof(word_size))) {
+    return false;
+  }
+  _word.resize(word_size);
+  if (word_size > 0) {
+    _in.read(&_word[0], word_size);
+  }
+  _in.read(reinterpret_cast<char*>(&_count), sizeof(_count));
+  if (! _in) {
+    throw runtime_error(string("CountRun::next: truncated run ") + _path);
+  }
+  return true;
+}
+
+// Merge runs k ways, calling emit with each (summed count, word) pair
+// in increasing word order.  The runs are open only during the merge.
+
+template <class F>
+static void merge_count_runs(const vector<shared_ptr<CountRun> >& runs,
+                             F emit) {
+  for (auto it = runs.begin(); it != runs.end(); ++it) {
+    (*it)->open();
+  }
+  // min-heap of runs by current word
+  auto run_after = [&runs](size_t x, size_t y) {
+    return runs[x]->word() > runs[y]->word();
+  };
+  vector<size_t> run_heap;
+  for (size_t r = 0; r < runs.size(); ++r) {
+    if (runs[r]->next()) {
+      run_heap.push_back(r);
+    }
+  }
+  make_heap(run_heap.begin(), run_heap.end(), run_after);
+  pair<size_t,string> current(0, string());
+  while (! run_heap.empty()) {
+    pop_heap(run_heap.begin(), run_heap.end(), run_after);
+    const size_t r = run_heap.back();
+    current.first = runs[r]->count();
+    current.second = runs[r]->word();
+    if (runs[r]->next()) {
+      push_heap(run_heap.begin(), run_heap.end(), run_after);
+    } else {
+      run_heap.pop_back();
+    }
+    // sum counts of the word across runs
+    while (! run_heap.empty() &&
+           runs[run_heap.front()]->word() == current.second) {
+      pop_heap(run_heap.begin(), run_heap.end(), run_after);
+      const size_t s = run_heap.back();
+      current.first += runs[s]->count();
+      if (runs[s]->next()) {
+        push_heap(run_heap.begin(), run_heap.end(), run_after);
+      } else {
+        run_heap.pop_back();
+      }
+    }
+    emit(current);
+  }
+  for (auto it = runs.begin(); it != runs.end(); ++it) {
+    (*it)->close();
+  }
+}
+
+
+//
+// HyperLogLog
+//
+
+
+HyperLogLog::HyperLogLog(unsigned precision):
+    _precision(precision), _registers() {
+  if (precision < 4 || precision > 18) {
+    throw invalid_argument(
+      string("HyperLogLog: precision must be between 4 and 18"));
+  }
+  _registers.assign(size_t(1) << precision, 0);
+}
+
+double HyperLogLog::estimate() const {
+  const double m = _registers.size();
+  double sum = 0;
+  size_t num_zeros = 0;
+  for (auto it = _registers.begin(); it != _registers.end(); ++it) {
+    sum += ldexp(1.0, -(int) *it);
+    if (*it == 0) {
+      ++num_zeros;
+    }
+  }
+  const double raw = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+  // small range correction (linear counting); hashes are 64 bits, so
+  // no large range correction is needed
+  if (raw <= 2.5 * m && num_zeros > 0) {
+    return m * log(m / num_zeros);
+  }
+  return raw;
+}
+
+double HyperLogLog::relative_error() const {
+  return 1.04 / sqrt((double) _registers.size());
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+  if (other._precision != _precision) {
+    throw invalid_argument(
+      string("HyperLogLog::merge: precisions differ"));
+  }
+  for (size_t j = 0; j < _registers.size(); ++j) {
+    _registers[j] = max(_registers[j], other._registers[j]);
+  }
+}
+
+
+vector<size_t> line_chunk_offsets(const string& path, size_t num_chunks) {
+  ifstream f(path.c_str(), ios::binary);
+  stream_ready_or_throw(f);
+  f.seekg(0, ios::end);
+  const size_t size = f.tellg();
+
+  vector<size_t> offsets(1, 0);
+  vector<char> buffer(COUNT_READ_BUFFER_SIZE);
+  for (size_t c = 1; c < num_chunks; ++c) {
+    // scan for the first newline at or after the byte before the
+    // nominal offset (not before the previous offset)
+    size_t pos = max(offsets.back(), size * c / num_chunks);
+    if (pos > offsets.back()) {
+      --pos;
+    }
+    size_t offset = size;
+    f.clear();
+    f.seekg(pos);
+    while (pos < size && offset == size) {
+      f.read(buffer.data(), min(buffer.size(), size - pos));
+      const size_t n = f.gcount();
+      if (n == 0) {
+        break;
+      }
+      const char *newline = find(buffer.data(), buffer.data() + n, '\n');
+      if (newline != buffer.data() + n) {
+        offset = pos + (newline - buffer.data()) + 1;
+      }
+      pos += n;
+    }
+    offsets.push_back(offset);
+  }
+  offsets.push_back(size);
+  return offsets;
+}
+
+// Call f on each word of bytes [begin, end) of the file at path (see
+// count_words).
+template <class F>
+static void for_each_word(const string& path, size_t begin, size_t end,
+                          F f) {
+  ifstream stream(path.c_str(), ios::binary);
+  stream_ready_or_throw(stream);
+  stream.seekg(begin);
+
+  vector<char> buffer(COUNT_READ_BUFFER_SIZE);
+  string word;
+  size_t pos = begin;
+  while (pos < end) {
+    stream.read(buffer.data(), min(buffer.size(), end - pos));
+    const size_t n = stream.gcount();
+    if (n == 0) {
+      break;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      const char c = buffer[i];
+      if (c == ' ' || c == '\n' || c == '\t') {
+        if (! word.empty()) {
+          f(word);
+          word.clear();
+        }
+      } else if (c != '\r') {
+        word.push_back(c);
+      }
+    }
+    pos += n;
+  }
+  if (! word.empty()) {
+    f(word);
+  }
+}
+
+HyperLogLog sketch_words(const string& path, size_t begin, size_t end) {
+  TRACE_SCOPE("sketch_words");
+  HyperLogLog sketch;
+  for_each_word(path, begin, end, [&sketch](const string& word) {
+    sketch.add(word_hash(word));
+  });
+  return sketch;
+}
+
+size_t presize_estimate(const HyperLogLog& sketch) {
+  return (size_t) ceil(sketch.estimate() *
+                       (1 + 3 * sketch.relative_error()));
+}
+
+void count_words(const string& path, size_t begin, size_t end,
+                 NaiveLanguageModel& language_model) {
+  TRACE_SCOPE("count_words");
+  for_each_word(path, begin, end, [&language_model](const string& word) {
+    language_model.increment(word);
+  });
+}
+
+NaiveLanguageModel count_words_parallel(const string& path,
+                                        float subsample_threshold,
+                                        size_t max_types,
+                                        bool prescan) {
+  const size_t num_chunks = max(1, omp_get_max_threads());
+  const vector<size_t> offsets(line_chunk_offsets(path, num_chunks));
+  // room to reserve for n word types (at most the budget, if any)
+  auto room = [max_types](size_t n) {
+    return (max_types > 0) ? min(n, max_types) : n;
+  };
+
+  vector<shared_ptr<NaiveLanguageModel> > chunk_models(num_chunks);
+  vector<shared_ptr<HyperLogLog> > chunk_sketches(num_chunks);
+  vector<exception_ptr> errors(num_chunks);
+  #pragma omp parallel for schedule(static, 1)
+  for (size_t c = 0; c < num_chunks; ++c) {
+    // (exceptions must not escape the parallel region, so each chunk
+    // keeps its own and the first is rethrown after the join)
+    try {
+      chunk_models[c] = make_shared<NaiveLanguageModel>(subsample_threshold,
+                                                        max_types);
+      if (prescan) {
+        chunk_sketches[c] = make_shared<HyperLogLog>(
+          sketch_words(path, offsets[c], offsets[c + 1]));
+        chunk_models[c]->reserve(room(presize_estimate(*chunk_sketches[c])));
+      }
+      count_words(path, offsets[c], offsets[c + 1], *chunk_models[c]);
+    } catch (...) {
+      errors[c] = current_exception();
+    }
+  }
+  for (auto it = errors.begin(); it != errors.end(); ++it) {
+    if (*it) {
+      rethrow_exception(*it);
+    }
+  }
+
+  TRACE_SCOPE("merge_counts");
+  NaiveLanguageModel language_model(move(*chunk_models[0]));
+  if (prescan) {
+    HyperLogLog& sketch(*chunk_sketches[0]);
+    for (size_t c = 1; c < num_chunks; ++c) {
+      sketch.merge(*chunk_sketches[c]);
+    }
+    info(__func__, "estimated " << (size_t) sketch.estimate() <<
+                   " word types\n");
+    language_model.reserve(room(presize_estimate(sketch)));
+  }
+  for (size_t c = 1; c < num_chunks; ++c) {
+    language_model.merge(*chunk_models[c]);
+    chunk_models[c].reset();
+  }
+  return language_model;
+}
+
+NaiveLanguageModel count_words_external(const string& path,
+                                        size_t max_size,
+                                        size_t max_types,
+                                        const string& spill_dir,
+                                        float subsample_threshold) {
+  if (max_types == 0) {
+    throw invalid_argument(
+      string("count_words_external: max_types must be positive"));
+  }
+  vector<shared_ptr<CountRun> > runs;
+  auto language_model(make_shared<NaiveLanguageModel>(subsample_threshold));
+  auto spill = [&]() {
+    TRACE_SCOPE("spill_counts");
+    vector<pair<string,size_t> > pairs(language_model->size());
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      pairs[i] = make_pair(language_model->reverse_lookup(i),
+                           language_model->count(i));
+    }
+    language_model = make_shared<NaiveLanguageModel>(subsample_threshold);
+    ::sort(pairs.begin(), pairs.end(), pair_first_cmp<string,size_t>);
+    auto run(make_shared<CountRun>(spill_dir));
+    for (auto it = pairs.begin(); it != pairs.end(); ++it) {
+      run->append(it->first, it->second);
+    }
+    run->finish();
+    runs.push_back(run);
+  };
+
+  {
+    TRACE_SCOPE("count_words");
+    for_each_word(path, 0, SIZE_MAX, [&](const string& word) {
+      language_model->increment(word);
+      if (language_model->size() == max_types) {
+        spill();
+      }
+    });
+  }
+  // heap of kept (count, word) pairs, least frequent on top
+  auto more_frequent = [](const pair<size_t,string>& x,
+                          const pair<size_t,string>& y) {
+    return x.first > y.first || (x.first == y.first && x.second < y.second);
+  };
+  vector<pair<size_t,string> > kept;
+  auto keep = [&kept, max_size, &more_frequent](pair<size_t,string>& p) {
+    if (kept.size() < max_size) {
+      kept.push_back(p);
+      push_heap(kept.begin(), kept.end(), more_frequent);
+    } else if (max_size > 0 && more_frequent(p, kept.front())) {
+      pop_heap(kept.begin(), kept.end(), more_frequent);
+      kept.back().swap(p);
+      push_heap(kept.begin(), kept.end(), more_frequent);
+    }
+  };
+  if (runs.empty()) {
+    pair<size_t,string> current(0, string());
+    // select as the merge does (ties by word), so the result does not
+    // depend on whether anything was spilled
+    for (size_t i = 0; i < language_model->size(); ++i) {
+      current.first = language_model->count(i);
+      current.second = language_model->reverse_lookup(i);
+      keep(current);
+    }
+    language_model.reset();
+  } else {
+    if (language_model->size() > 0) {
+      spill();
+    }
+    language_model.reset();
+
+    TRACE_SCOPE("merge_counts");
+    // merge at most COUNT_MAX_MERGE_RUNS runs at once, into longer
+    // runs, until one final merge is left
+    while (runs.size() > COUNT_MAX_MERGE_RUNS) {
+      vector<shared_ptr<CountRun> > merged_runs;
+      for (size_t begin = 0; begin < runs.size();
+           begin += COUNT_MAX_MERGE_RUNS) {
+        const size_t end = min(runs.size(), begin + COUNT_MAX_MERGE_RUNS);
+        if (end - begin == 1) {
+          merged_runs.push_back(runs[begin]);
+          continue;
+        }
+        auto merged(make_shared<CountRun>(spill_dir));
+        merge_count_runs(
+          vector<shared_ptr<CountRun> >(runs.begin() + begin,
+                                        runs.begin() + end),
+          [&merged](const pair<size_t,string>& p) {
+            merged->append(p.second, p.first);
+          });
+        merged->finish();
+        merged_runs.push_back(merged);
+        // remove merged runs as soon as they are consumed
+        for (size_t r = begin; r < end; ++r) {
+          runs[r].reset();
+        }
+      }
+      runs.swap(merged_runs);
+    }
+    merge_count_runs(runs, keep);
+  }
+  runs.clear();
+
+  sort_heap(kept.begin(), kept.end(), more_frequent);
+  size_t total = 0;
+  Vocabulary words;
+  words.reserve(kept.size());
+  vector<size_t> counters;
+  counters.reserve(kept.size());
+  for (auto it = kept.begin(); it != kept.end(); ++it) {
+    words.insert(it->second);
+    counters.push_back(it->first);
+    total += it->first;
+  }
+  return NaiveLanguageModel(subsample_threshold, kept.size(), total,
+                            move(counters), move(words));
+}
@@ -0,0 +1,118 @@
+#ifndef ATHENA__COUNT_H
+#define ATHENA__COUNT_H
+
+
+#include "_core.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// bytes read at a time by each counting thread
+#define COUNT_READ_BUFFER_SIZE (1 << 20)
+// base-two log of the number of HyperLogLog registers (2^14 registers
+// of one byte give a relative standard error of about 0.8%)
+#define HYPERLOGLOG_PRECISION 14
+// most run files count_words_external merges (and holds open) at once
+#define COUNT_MAX_MERGE_RUNS 64
+
+
+// HyperLogLog sketch of a set of words, given by their hashes
+// (word_hash): each hash goes to one of 2^precision registers (its top
+// precision bits), which keeps the largest position of the first one
+// bit seen in the rest.  Estimates the number of distinct words to a
+// relative standard error of 1.04 / sqrt(2^precision) in constant
+// memory; adding a hash costs a shift and a compare.
+
+class HyperLogLog final {
+  unsigned _precision;
+  std::vector<uint8_t> _registers;
+
+  public:
+    explicit HyperLogLog(unsigned precision = HYPERLOGLOG_PRECISION);
+    void add(uint64_t h) {
+      const uint64_t rest = h << _precision;
+      const uint8_t rank = (rest == 0) ? (64 - _precision + 1) :
+                                         (__builtin_clzll(rest) + 1);
+      uint8_t& reg(_registers[h >> (64 - _precision)]);
+      if (rank > reg) {
+        reg = rank;
+      }
+    }
+    // return estimated number of distinct hashes added
+    double estimate() const;
+    // return relative standard error of estimate
+    double relative_error() const;
+    unsigned precision() const { return _precision; }
+    // sketch the union of this set and other's (of equal precision)
+    void merge(const HyperLogLog& other);
+};
+
+// Return HyperLogLog sketch of the words of bytes [begin, end) of the
+// file at path (tokenized as by count_words).
+HyperLogLog sketch_words(const std::string& path, size_t begin, size_t end);
+
+// Return number of words to reserve room for, given sketch of them
+// (its estimate, plus three standard errors).
+size_t presize_estimate(const HyperLogLog& sketch);
+
+
+// Return num_chunks + 1 byte offsets splitting the file at path into
+// num_chunks chunks of about equal size, each a run of whole lines:
+// the first offset is zero, the last is the file size, and each other
+// is just past a newline (or the file size).  Chunks may be empty.
+std::vector<size_t> line_chunk_offsets(const std::string& path,
+                                       size_t num_chunks);
+
+// Increment language_model by each word of bytes [begin, end) of the
+// file at path.  Words are separated by spaces, tabs and newlines, and
+// carriage returns are dropped, as SentenceReader does.
+void count_words(const std::string& path, size_t begin, size_t end,
+                 NaiveLanguageModel& language_model);
+
+// Return naive language model of the words of the file at path,
+// counted in parallel: the file is split into one chunk of lines per
+// thread, each thread counts its chunk into a language model of its
+// own, and the chunk models are merged in file order, so the result
+// (word indices included) equals that of counting on one thread.
+// Peak memory is that of the chunk models together.  If max_types is
+// positive each chunk model, and the merged model, holds at most
+// max_types words (see NaiveLanguageModel; pruning then depends on the
+// number of threads).  If prescan is true each thread first sketches
+// its chunk (see HyperLogLog) and reserves room in its model for the
+// estimated number of word types, and the merged model is reserved
+// for the estimate over all chunks, so the tables do not grow while
+// counting; the estimate is logged.
+NaiveLanguageModel count_words_parallel(
+  const std::string& path,
+  float subsample_threshold = DEFAULT_SUBSAMPLE_THRESHOLD,
+  size_t max_types = 0,
+  bool prescan = false);
+
+
+// Return naive language model of the max_size most frequent words of
+// the file at path, holding at most max_types word types in memory at
+// once.  Whenever max_types types have been counted, their (word,
+// count) pairs are sorted by word and spilled to a run file in
+// spill_dir (briefly holding the pairs and the counts together); at
+// the end the runs are merged k ways, one pair per run in memory,
+// summing the counts of each word and keeping the max_size most
+// frequent words in a heap.  Runs are merged at most
+// COUNT_MAX_MERGE_RUNS at a time (in more than one pass if there are
+// more), so open files stay bounded.  If nothing is spilled the words are
+// selected from the in-memory counts by the same heap.  Either way
+// words are kept and ordered by count (descending), ties by word, so
+// the result does not depend on whether max_types was reached (unlike
+// NaiveLanguageModel::truncate, which breaks ties by first
+// occurrence).  Run files are removed before returning.
+NaiveLanguageModel count_words_external(
+  const std::string& path,
+  size_t max_size,
+  size_t max_types,
+  const std::string& spill_dir,
+  float subsample_threshold = DEFAULT_SUBSAMPLE_THRESHOLD);
+
+
+#endif
@@ -0,0 +1,76 @@
+#include "_eval.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+
+using namespace std;
+
+
+// return ranks (starting at 1) of values, averaging over ties
+static vector<double> average_ranks(const vector<double>& values) {
+  vector<size_t> order(values.size());
+  iota(order.begin(), order.end(), 0);
+  sort(order.begin(), order.end(), [&values](size_t i, size_t j) {
+    return values[i] < values[j];
+  });
+  vector<double> ranks(values.size());
+  size_t start = 0;
+  while (start < order.size()) {
+    size_t end = start + 1;
+    while (end < order.size() && values[order[end]] == values[order[start]]) {
+      ++end;
+    }
+    const double rank = (start + 1 + end) / 2.;
+    for (size_t i = start; i < end; ++i) {
+      ranks[order[i]] = rank;
+    }
+    start = end;
+  }
+  return ranks;
+}
+
+double spearman_correlation(const vector<double>& x,
+                            const vector<double>& y) {
+  if (x.size() != y.size()) {
+    throw invalid_argument(
+      string("spearman_correlation: vectors differ in size"));
+  }
+  const vector<double> rx(average_ranks(x)), ry(average_ranks(y));
+  const double mean = (x.size() + 1) / 2.;
+  double sxy = 0, sxx = 0, syy = 0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    sxy += (rx[i] - mean) * (ry[i] - mean);
+    sxx += (rx[i] - mean) * (rx[i] - mean);
+    syy += (ry[i] - mean) * (ry[i] - mean);
+  }
+  if (sxx == 0 || syy == 0) {
+    return (x == y) ? 1 : 0;
+  }
+  return sxy / sqrt(sxx * syy);
+}
+
+// return value (in bytes) of kB-valued field in /proc/self/status
+static size_t proc_status_bytes(const string& field) {
+  ifstream f("/proc/self/status");
+  string line;
+  while (getline(f, line)) {
+    if (line.compare(0, field.size() + 1, field + ":") == 0) {
+      return stoull(line.substr(field.size() + 1)) * 1024;
+    }
+  }
+  return 0;
+}
+
+size_t resident_memory() {
+  return proc_status_bytes("VmRSS");
+}
+
+size_t peak_resident_memory() {
+  return proc_status_bytes("VmHWM");
+}
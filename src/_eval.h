@@ -0,0 +1,124 @@
+#ifndef ATHENA__EVAL_H
+#define ATHENA__EVAL_H
+
+
+#include "_core.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+
+// Quality of an approximate language model's counts against exact
+// counts, measured on the k most frequent words.
+
+struct HeavyHitterAccuracy final {
+  // fraction of approximate top-k words that are in exact top-k
+  double precision;
+  // fraction of exact top-k words that are in approximate top-k
+  double recall;
+  // mean and max of |approximate count - exact count| / exact count
+  // over exact top-k words (approximate count is zero if untracked)
+  double mean_relative_error;
+  double max_relative_error;
+  // Spearman correlation between exact and approximate counts over
+  // exact top-k words
+  double rank_correlation;
+};
+
+
+// Return (word, count) pairs of the (at most) k most frequent words in
+// language model, by count (descending) and then word.
+template <class LanguageModel>
+std::vector<std::pair<std::string,size_t> >
+    top_words(const LanguageModel& language_model, size_t k) {
+  const std::vector<size_t> counts(language_model.counts());
+  std::vector<std::pair<std::string,size_t> > words;
+  words.reserve(counts.size());
+  for (size_t i = 0; i < counts.size(); ++i) {
+    words.push_back(
+      std::make_pair(language_model.reverse_lookup(i), counts[i]));
+  }
+  const size_t n = std::min(k, words.size());
+  std::partial_sort(words.begin(), words.begin() + n, words.end(),
+    [](const std::pair<std::string,size_t>& x,
+       const std::pair<std::string,size_t>& y) {
+      return x.second > y.second ||
+        (x.second == y.second && x.first < y.first);
+    });
+  words.resize(n);
+  return words;
+}
+
+// Return Spearman rank correlation of x and y (ties get their average
+// rank); return 1 if either is constant and they are equal, 0 if
+// either is constant otherwise.
+double spearman_correlation(const std::vector<double>& x,
+                            const std::vector<double>& y);
+
+// Return accuracy of approximate against exact counts on the k most
+// frequent words.
+template <class ExactLanguageModel, class ApproximateLanguageModel>
+HeavyHitterAccuracy heavy_hitter_accuracy(
+    const ExactLanguageModel& exact,
+    const ApproximateLanguageModel& approximate,
+    size_t k) {
+  const std::vector<std::pair<std::string,size_t> >
+    exact_top(top_words(exact, k)),
+    approximate_top(top_words(approximate, k));
+
+  std::vector<std::string> exact_top_words;
+  exact_top_words.reserve(exact_top.size());
+  for (auto it = exact_top.begin(); it != exact_top.end(); ++it) {
+    exact_top_words.push_back(it->first);
+  }
+  std::sort(exact_top_words.begin(), exact_top_words.end());
+  size_t num_hits = 0;
+  for (auto it = approximate_top.begin(); it != approximate_top.end(); ++it) {
+    if (std::binary_search(exact_top_words.begin(), exact_top_words.end(),
+                           it->first)) {
+      ++num_hits;
+    }
+  }
+
+  HeavyHitterAccuracy accuracy;
+  accuracy.precision = approximate_top.empty() ? 1 :
+    num_hits / (double) approximate_top.size();
+  accuracy.recall = exact_top.empty() ? 1 :
+    num_hits / (double) exact_top.size();
+
+  std::vector<double> exact_counts, approximate_counts;
+  exact_counts.reserve(exact_top.size());
+  approximate_counts.reserve(exact_top.size());
+  double total_relative_error = 0;
+  accuracy.max_relative_error = 0;
+  for (auto it = exact_top.begin(); it != exact_top.end(); ++it) {
+    const long word_idx = approximate.lookup(it->first);
+    const double exact_count = it->second,
+      approximate_count = (word_idx < 0) ? 0 : approximate.count(word_idx);
+    const double relative_error =
+      std::fabs(approximate_count - exact_count) / exact_count;
+    total_relative_error += relative_error;
+    accuracy.max_relative_error =
+      std::max(accuracy.max_relative_error, relative_error);
+    exact_counts.push_back(exact_count);
+    approximate_counts.push_back(approximate_count);
+  }
+  accuracy.mean_relative_error = exact_top.empty() ? 0 :
+    total_relative_error / exact_top.size();
+  accuracy.rank_correlation =
+    spearman_correlation(exact_counts, approximate_counts);
+  return accuracy;
+}
+
+
+// Return current and peak resident set size of this process in bytes
+// (from /proc/self/status; 0 if unavailable).
+size_t resident_memory();
+size_t peak_resident_memory();
+
+
+#endif
@@ -0,0 +1,208 @@
+#include "_export.h"
+#include "_format.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __APPLE__
+#define omp_get_max_threads() 1
+#else
+extern "C" {
+#include <omp.h>
+}
+#endif
+
+
+using namespace std;
+
+
+static_assert(sizeof(RawEmbeddingsHeader) == RAW_EMBEDDINGS_ALIGNMENT,
+              "raw embeddings header must fill one alignment block");
+
+
+void write_text_embeddings(ostream& stream,
+                           const WordContextFactorization& factorization,
+                           const vector<string>& words,
+                           bool with_dims,
+                           bool shortest,
+                           size_t num_rows) {
+  const size_t vocab_dim = min(num_rows, factorization.get_vocab_dim()),
+               embedding_dim = factorization.get_embedding_dim();
+  if (! words.empty() && words.size() < vocab_dim) {
+    throw logic_error(
+      string("write_text_embeddings: fewer words than embeddings"));
+  }
+
+  if (with_dims) {
+    const string dims(to_string(vocab_dim) + " " + to_string(embedding_dim) + "\n");
+    stream.write(dims.data(), dims.size());
+  }
+
+  // each round formats one chunk per thread, then writes the chunks
+  // in order
+  const size_t num_chunks = max(1, omp_get_max_threads());
+  vector<string> buffers(num_chunks);
+  for (size_t round_begin = 0; round_begin < vocab_dim;
+       round_begin += num_chunks * EXPORT_CHUNK_ROWS) {
+    #pragma omp parallel for schedule(static, 1)
+    for (size_t c = 0; c < num_chunks; ++c) {
+      const size_t row_begin = min(vocab_dim,
+                                   round_begin + c * EXPORT_CHUNK_ROWS),
+                   row_end = min(vocab_dim,
+                                 row_begin + EXPORT_CHUNK_ROWS);
+      size_t capacity = (row_end - row_begin) *
+        (embedding_dim * (FORMAT_FLOAT_MAX_SIZE + 1) + 1);
+      if (! words.empty()) {
+        for (size_t i = row_begin; i < row_end; ++i) {
+          capacity += words[i].size() + 1;
+        }
+      }
+      string& buffer(buffers[c]);
+      buffer.resize(capacity);
+      char *p = &buffer[0];
+      for (size_t i = row_begin; i < row_end; ++i) {
+        if (! words.empty()) {
+          p = copy(words[i].begin(), words[i].end(), p);
+          *p++ = ' ';
+        }
+        const float *x = factorization.get_word_embedding(i);
+        for (size_t j = 0; j < embedding_dim; ++j) {
+          p += (shortest ? format_float_shortest(x[j], p) : format_float(x[j], p));
+          *p++ = ' ';
+        }
+        *p++ = '\n';
+      }
+      buffer.resize(p - buffer.data());
+    }
+    for (size_t c = 0; c < num_chunks; ++c) {
+      stream.write(buffers[c].data(), buffers[c].size());
+    }
+  }
+}
+
+// Accumulates output and writes it to a stream in large blocks.
+
+class BlockWriter final {
+  ostream& _stream;
+  string _buffer;
+
+  public:
+    BlockWriter(ostream& stream): _stream(stream), _buffer() {
+      _buffer.reserve(EXPORT_WRITE_BUFFER_SIZE);
+    }
+    void write(const void *data, size_t n) {
+      if (_buffer.size() + n > EXPORT_WRITE_BUFFER_SIZE) {
+        flush();
+      }
+      if (n > EXPORT_WRITE_BUFFER_SIZE) {
+        _stream.write(static_cast<const char*>(data), n);
+      } else {
+        _buffer.append(static_cast<const char*>(data), n);
+      }
+    }
+    void write(const string& s) { write(s.data(), s.size()); }
+    void fill(char c, size_t n) {
+      if (_buffer.size() + n > EXPORT_WRITE_BUFFER_SIZE) {
+        flush();
+      }
+      _buffer.append(n, c);
+    }
+    void flush() {
+      _stream.write(_buffer.data(), _buffer.size());
+      _buffer.clear();
+    }
+    ~BlockWriter() { flush(); }
+};
+
+
+void write_word2vec_embeddings(ostream& stream,
+                               const WordContextFactorization& factorization,
+                               const vector<string>& words,
+                               size_t num_rows) {
+  const size_t vocab_dim = min(num_rows, factorization.get_vocab_dim()),
+               embedding_dim = factorization.get_embedding_dim();
+  if (words.size() < vocab_dim) {
+    throw logic_error(
+      string("write_word2vec_embeddings: fewer words than embeddings"));
+  }
+  BlockWriter writer(stream);
+  writer.write(to_string(vocab_dim) + " " + to_string(embedding_dim) + "\n");
+  for (size_t i = 0; i < vocab_dim; ++i) {
+    writer.write(words[i]);
+    writer.write(" ", 1);
+    writer.write(factorization.get_word_embedding(i),
+                 embedding_dim * sizeof(float));
+    writer.write("\n", 1);
+  }
+}
+
+void write_npy_embeddings(ostream& stream,
+                          const WordContextFactorization& factorization,
+                          size_t num_rows) {
+  const size_t vocab_dim = min(num_rows, factorization.get_vocab_dim()),
+               embedding_dim = factorization.get_embedding_dim();
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  const string descr(">f4");
+#else
+  const string descr("<f4");
+#endif
+  // magic, version, header length (little endian), header dict padded
+  // with spaces and a newline to a multiple of 64 bytes
+  string header("{'descr': '" + descr + "', 'fortran_order': False, " +
+                "'shape': (" + to_string(vocab_dim) + ", " +
+                to_string(embedding_dim) + "), }");
+  const size_t preamble_size = 10;
+  header.append(
+    INCREASE_TO_MULTIPLE(preamble_size + header.size() + 1, 64) -
+      (preamble_size + header.size() + 1), ' ');
+  header.push_back('\n');
+  const char preamble[preamble_size] = {
+    '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+    (char) (header.size() & 0xff), (char) ((header.size() >> 8) & 0xff)
+  };
+
+  BlockWriter writer(stream);
+  writer.write(preamble, preamble_size);
+  writer.write(header);
+  for (size_t i = 0; i < vocab_dim; ++i) {
+    writer.write(factorization.get_word_embedding(i),
+                 embedding_dim * sizeof(float));
+  }
+}
+
+void write_raw_embeddings(ostream& stream,
+                          const WordContextFactorization& factorization,
+                          size_t num_rows) {
+  const size_t vocab_dim = min(num_rows, factorization.get_vocab_dim()),
+               embedding_dim = factorization.get_embedding_dim();
+  const size_t row_stride =
+    INCREASE_TO_MULTIPLE(embedding_dim, RAW_EMBEDDINGS_ALIGNMENT / sizeof(float));
+
+  RawEmbeddingsHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RAW_EMBEDDINGS_MAGIC, sizeof(header.magic));
+  header.version = RAW_EMBEDDINGS_VERSION;
+  header.header_size = sizeof(header);
+  header.vocab_dim = vocab_dim;
+  header.embedding_dim = embedding_dim;
+  header.row_stride = row_stride;
+
+  BlockWriter writer(stream);
+  writer.write(&header, sizeof(header));
+  for (size_t i = 0; i < vocab_dim; ++i) {
+    writer.write(factorization.get_word_embedding(i),
+                 embedding_dim * sizeof(float));
+    writer.fill(0, (row_stride - embedding_dim) * sizeof(float));
+  }
+}
+
+void write_vocab(ostream& stream, const vector<string>& words) {
+  BlockWriter writer(stream);
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    writer.write(*it);
+    writer.write("\n", 1);
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef ATHENA__EXPORT_H
+#define ATHENA__EXPORT_H
+
+
+#include "_core.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+// rows formatted per chunk (per thread) before writing out
+#define EXPORT_CHUNK_ROWS 2048
+// bytes buffered per write for binary formats
+#define EXPORT_WRITE_BUFFER_SIZE (1 << 24)
+
+#define RAW_EMBEDDINGS_MAGIC "ATHENAEM"
+#define RAW_EMBEDDINGS_VERSION 1
+// raw header size and row stride are multiples of this many bytes
+#define RAW_EMBEDDINGS_ALIGNMENT 64
+
+
+// Header of raw embedding file.  The matrix starts header_size bytes
+// into the file, row i at row_stride * i floats past that, so a
+// mapped file can be used in place (with rows aligned for vector
+// loads); padding is zero.  Fields are in host byte order.
+
+struct RawEmbeddingsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t vocab_dim;
+  uint64_t embedding_dim;
+  uint64_t row_stride;
+  char reserved[24];
+};
+
+
+// Write word embeddings as text, one row per word:
+//
+//   [word ' '] x_1 ' ' x_2 ' ' ... x_D ' ' '\n'
+//
+// (the extra space at the end of each row matches word2vec),
+// preceded by a "<vocab-dim> <embedding-dim>" line if with_dims is
+// true.  Words are omitted if words is empty (otherwise it must have
+// an entry for every row).  Only the first num_rows rows (all rows
+// by default) are written and counted in the dims line.  Floats are formatted as std::ostream
+// would by default, or as the shortest string that parses back to the
+// same float if shortest is true.  Rows are formatted in parallel in
+// chunks and written in order.
+void write_text_embeddings(std::ostream& stream,
+                           const WordContextFactorization& factorization,
+                           const std::vector<std::string>& words,
+                           bool with_dims,
+                           bool shortest = false,
+                           size_t num_rows = SIZE_MAX);
+
+
+// Write word embeddings in Google word2vec binary format (words is
+// required and must have an entry for every row written).  As for
+// the other binary formats below, only the first num_rows rows are
+// written (and reported in the header), so a factorization whose
+// vocabulary is not full can be exported without its unused rows.
+void write_word2vec_embeddings(std::ostream& stream,
+                               const WordContextFactorization& factorization,
+                               const std::vector<std::string>& words,
+                               size_t num_rows = SIZE_MAX);
+
+// Write word embeddings as a NumPy .npy file (version 1.0) holding a
+// C-ordered float32 matrix of shape (num-rows, embedding-dim).
+void write_npy_embeddings(std::ostream& stream,
+                          const WordContextFactorization& factorization,
+                          size_t num_rows = SIZE_MAX);
+
+// Write word embeddings as a RawEmbeddingsHeader followed by the
+// matrix (see above).
+void write_raw_embeddings(std::ostream& stream,
+                          const WordContextFactorization& factorization,
+                          size_t num_rows = SIZE_MAX);
+
+// Write words, one per line.
+void write_vocab(std::ostream& stream, const std::vector<std::string>& words);
+
+
+#endif
@@ -0,0 +1,169 @@
+#include "_format.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+// precision used by printf("%g", ...)
+#define DEFAULT_FLOAT_PRECISION 6
+// largest precision needed to round-trip a float
+#define MAX_FLOAT_PRECISION 9
+// scaled values this close to a rounding boundary go through printf
+#define ROUNDING_TOLERANCE 1e-6
+
+
+using namespace std;
+
+
+// enough to scale any float (including subnormals) to 9 digits
+#define NUM_POWERS_OF_TEN 61
+
+static const double POWERS_OF_TEN[NUM_POWERS_OF_TEN] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+  1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23,
+  1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31, 1e32, 1e33, 1e34,
+  1e35, 1e36, 1e37, 1e38, 1e39, 1e40, 1e41, 1e42, 1e43, 1e44, 1e45,
+  1e46, 1e47, 1e48, 1e49, 1e50, 1e51, 1e52, 1e53, 1e54, 1e55, 1e56,
+  1e57, 1e58, 1e59, 1e60
+};
+
+// return v * 10^k
+static double scale_by_power_of_ten(double v, int k) {
+  return (k >= 0) ? v * POWERS_OF_TEN[k] : v / POWERS_OF_TEN[-k];
+}
+
+static size_t format_float_printf(float x, int precision, char *buf) {
+  char tmp[FORMAT_FLOAT_MAX_SIZE + 8];
+  const int n = snprintf(tmp, sizeof(tmp), "%.*g", precision, (double) x);
+  memcpy(buf, tmp, n);
+  return n;
+}
+
+size_t format_float_precision(float x, int precision, char *buf) {
+  const double v = fabs((double) x);
+  if (! (v > 0) || std::isinf(v)) {
+    // zero, infinity, nan
+    return format_float_printf(x, precision, buf);
+  }
+
+  // find exponent e and integer m with precision digits such that
+  // v ~ m * 10^(e - precision + 1)
+  // (estimate e from the binary exponent, then correct it)
+  int b;
+  frexp(v, &b);
+  int e = (int) floor((b - 1) * 0.30102999566398120);
+  double scaled = scale_by_power_of_ten(v, precision - 1 - e);
+  const double lower = POWERS_OF_TEN[precision - 1],
+               upper = POWERS_OF_TEN[precision];
+  while (scaled >= upper) {
+    ++e;
+    scaled = scale_by_power_of_ten(v, precision - 1 - e);
+  }
+  while (scaled < lower) {
+    --e;
+    scaled = scale_by_power_of_ten(v, precision - 1 - e);
+  }
+  const double floor_scaled = floor(scaled);
+  if (fabs(scaled - floor_scaled - 0.5) < ROUNDING_TOLERANCE) {
+    // too close to call: printf rounds the exact binary value
+    return format_float_printf(x, precision, buf);
+  }
+  unsigned long m = (unsigned long) floor_scaled +
+    (scaled - floor_scaled > 0.5 ? 1 : 0);
+  if (m >= (unsigned long) upper) {
+    m /= 10;
+    ++e;
+  }
+
+  char digits[MAX_FLOAT_PRECISION];
+  for (int i = precision - 1; i >= 0; --i) {
+    digits[i] = '0' + (m % 10);
+    m /= 10;
+  }
+  int num_digits = precision;
+  while (num_digits > 1 && digits[num_digits - 1] == '0') {
+    --num_digits;
+  }
+
+  char *p = buf;
+  if (x < 0) {
+    *p++ = '-';
+  }
+  if (e < -4 || e >= precision) {
+    // scientific notation: d.ddde+XX
+    *p++ = digits[0];
+    if (num_digits > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, num_digits - 1);
+      p += num_digits - 1;
+    }
+    *p++ = 'e';
+    *p++ = (e < 0 ? '-' : '+');
+    const int abs_e = (e < 0 ? -e : e);
+    if (abs_e >= 100) {
+      *p++ = '0' + abs_e / 100;
+    }
+    *p++ = '0' + (abs_e / 10) % 10;
+    *p++ = '0' + abs_e % 10;
+  } else if (e < 0) {
+    // 0.000ddd
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = -1; i > e; --i) {
+      *p++ = '0';
+    }
+    memcpy(p, digits, num_digits);
+    p += num_digits;
+  } else {
+    // ddd.ddd
+    for (int i = 0; i <= e; ++i) {
+      *p++ = (i < num_digits ? digits[i] : '0');
+    }
+    if (num_digits > e + 1) {
+      *p++ = '.';
+      memcpy(p, digits + e + 1, num_digits - e - 1);
+      p += num_digits - e - 1;
+    }
+  }
+  return p - buf;
+}
+
+size_t format_float(float x, char *buf) {
+  return format_float_precision(x, DEFAULT_FLOAT_PRECISION, buf);
+}
+
+size_t format_float_shortest(float x, char *buf) {
+  if (! std::isfinite(x)) {
+    return format_float_printf(x, DEFAULT_FLOAT_PRECISION, buf);
+  }
+  char tmp[FORMAT_FLOAT_MAX_SIZE + 1];
+  // round-tripping is monotone in precision: search down from the
+  // default precision if it round-trips, up otherwise
+  int precision = DEFAULT_FLOAT_PRECISION;
+  size_t n = format_float_precision(x, precision, buf);
+  buf[n] = '\0';
+  if (strtof(buf, 0) == x) {
+    while (precision > 1) {
+      const size_t m = format_float_precision(x, precision - 1, tmp);
+      tmp[m] = '\0';
+      if (strtof(tmp, 0) != x) {
+        break;
+      }
+      memcpy(buf, tmp, m);
+      n = m;
+      --precision;
+    }
+  } else {
+    while (precision < MAX_FLOAT_PRECISION) {
+      ++precision;
+      n = format_float_precision(x, precision, buf);
+      buf[n] = '\0';
+      if (strtof(buf, 0) == x) {
+        break;
+      }
+    }
+  }
+  return n;
+}
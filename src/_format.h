@@ -0,0 +1,29 @@
+#ifndef ATHENA__FORMAT_H
+#define ATHENA__FORMAT_H
+
+
+#include <cstddef>
+
+
+// size of buffer to pass to the functions below (output is not
+// null-terminated)
+#define FORMAT_FLOAT_MAX_SIZE 24
+
+
+// Write x to buf as printf("%g", x) (equivalently, std::ostream with
+// default flags and precision) would, and return number of characters
+// written.  Common values are formatted without going through printf;
+// values whose rounding is in doubt fall back to it, so output is
+// identical.
+size_t format_float(float x, char *buf);
+
+// Write x to buf with the fewest significant digits (in %g style) that
+// parse back to x exactly, and return number of characters written.
+size_t format_float_shortest(float x, char *buf);
+
+// Write x to buf as printf("%.<precision>g", x) would (precision
+// between 1 and 9) and return number of characters written.
+size_t format_float_precision(float x, int precision, char *buf);
+
+
+#endif
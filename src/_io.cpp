@@ -1,4 +1,6 @@
 #include "_io.h"
+#include "_trace.h"
+#include "_vocab.h"
 
 
 #include <string>
@@ -58,6 +60,8 @@ bool SentenceReader::has_next() {
 }
 
 vector<string> SentenceReader::next() {
+  // reading and tokenization happen together, a character at a time
+  TRACE_SCOPE("read");
   // if this is the first call, load a sentence
   if (! _initialized) {
     _load_next_sentence();
@@ -70,6 +74,15 @@ vector<string> SentenceReader::next() {
   return sentence;
 }
 
+vector<string> SentenceReader::next(vector<uint64_t>& hashes) {
+  vector<string> sentence(next());
+  hashes.resize(sentence.size());
+  for (size_t i = 0; i < sentence.size(); ++i) {
+    hashes[i] = word_hash(sentence[i]);
+  }
+  return sentence;
+}
+
 void SentenceReader::reset() {
   _f.seekg(0, _f.beg);
   _initialized = false;
@@ -5,6 +5,7 @@
 #include <ios>
 #include <istream>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -28,6 +29,9 @@ class SentenceReader final {
 
     bool has_next();
     std::vector<std::string> next();
+    // as above, and store word_hash of each word in hashes (resized to
+    // the sentence length)
+    std::vector<std::string> next(std::vector<uint64_t>& hashes);
     void reset();
 
   private:
@@ -1,35 +1,378 @@
 #include "_log.h"
-#include <ctime>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <sys/time.h>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <pthread.h>
 
 
 using namespace std;
 
 
-std::ostream& _log(const char *frame, const char *level) {
-  struct timeval tv;
-  char s[128];
-  int written;
-  int ret = gettimeofday(&tv, NULL);
-  if (ret == 0) {
-    /* this will often (but not always) be correct */
-    ret = strftime(s, 128, "%Y-%m-%d %H:%M:%S", localtime(&(tv.tv_sec)));
-    if (ret == 0) {
-      strcpy(s, "[time error]");
-    } else {
-      written = ret;
-      ret = snprintf(s + written, 128 - written, ".%03zu",
-                     (size_t) (tv.tv_usec / 1000));
-      if (ret < 0 || ret >= 128 - written) {
-        strcpy(s, "[time error]");
+static const char *level_names[] = {
+  "debug", "info", "warning", "error", "none"
+};
+
+
+//
+// Logger
+//
+
+
+static atomic<uint64_t> next_logger_id(1);
+
+// live loggers (for the fork handlers; constructed on first use, and
+// never destroyed, so that loggers destroyed at exit can still
+// unregister)
+static mutex& logger_registry_mutex() {
+  static mutex* m = new mutex();
+  return *m;
+}
+
+static vector<Logger*>& logger_registry() {
+  static vector<Logger*>* loggers = new vector<Logger*>();
+  return *loggers;
+}
+
+static once_flag fork_handlers_registered;
+
+Logger::Logger(ostream& stream, int level, size_t buffer_size,
+               unsigned int flush_interval):
+    _id(next_logger_id++),
+    _stream(stream),
+    _buffer_size(buffer_size),
+    _level(level),
+    _buffers_mutex(),
+    _buffers(),
+    _num_freed_dropped(0),
+    _flush_mutex(),
+    _cached_second(-1),
+    _wake_mutex(),
+    _wake(),
+    _pending(false),
+    _stop(false),
+    _flush_interval(flush_interval),
+    _flusher() {
+  _cached_time[0] = '\0';
+  call_once(fork_handlers_registered, []() {
+    pthread_atfork(&Logger::_prepare_fork, &Logger::_parent_after_fork,
+                   &Logger::_child_after_fork);
+  });
+  {
+    lock_guard<mutex> lock(logger_registry_mutex());
+    logger_registry().push_back(this);
+  }
+  if (_flush_interval > 0) {
+    _flusher = thread([this]() { _run(); });
+  }
+}
+
+Logger::ThreadBuffer& Logger::_thread_buffer() {
+  // a thread may log to more than one logger (in tests), so cache the
+  // buffer together with the (unique) id of its logger; the logger
+  // frees a buffer once its thread has exited and it is drained
+  thread_local uint64_t cached_logger_id = 0;
+  thread_local shared_ptr<ThreadBuffer> cached_buffer;
+  if (cached_logger_id != _id) {
+    cached_buffer = make_shared<ThreadBuffer>();
+    cached_buffer->data.resize(_buffer_size);
+    cached_buffer->head = 0;
+    cached_buffer->tail = 0;
+    cached_buffer->num_dropped = 0;
+    cached_buffer->num_reported_dropped = 0;
+    lock_guard<mutex> lock(_buffers_mutex);
+    _buffers.push_back(cached_buffer);
+    cached_logger_id = _id;
+  }
+  return *cached_buffer;
+}
+
+// copy n bytes from src into ring buffer data at (unwrapped) position
+static void ring_write(vector<char>& data, uint64_t pos, const void *src,
+                       size_t n) {
+  const size_t offset = pos % data.size(),
+    first = min(n, data.size() - offset);
+  memcpy(&data[offset], src, first);
+  memcpy(&data[0], static_cast<const char*>(src) + first, n - first);
+}
+
+// copy n bytes from ring buffer data at (unwrapped) position into dst
+static void ring_read(const vector<char>& data, uint64_t pos, void *dst,
+                      size_t n) {
+  const size_t offset = pos % data.size(),
+    first = min(n, data.size() - offset);
+  memcpy(dst, &data[offset], first);
+  memcpy(static_cast<char*>(dst) + first, &data[0], n - first);
+}
+
+struct RecordHeader {
+  uint64_t timestamp;
+  const char *frame;
+  int32_t level;
+  uint32_t size;
+};
+
+void Logger::log(const char *frame, int level, const string& message) {
+  ThreadBuffer& buffer(_thread_buffer());
+  RecordHeader header;
+  header.timestamp = chrono::duration_cast<chrono::nanoseconds>(
+    chrono::system_clock::now().time_since_epoch()).count();
+  header.frame = frame;
+  header.level = level;
+  header.size = min(message.size(),
+                    buffer.data.size() - min(buffer.data.size(),
+                                             sizeof(header)));
+  const uint64_t head = buffer.head.load(memory_order_relaxed),
+    tail = buffer.tail.load(memory_order_acquire);
+  if (buffer.data.size() - (head - tail) < sizeof(header) + header.size) {
+    buffer.num_dropped.fetch_add(1, memory_order_relaxed);
+  } else {
+    ring_write(buffer.data, head, &header, sizeof(header));
+    ring_write(buffer.data, head + sizeof(header), message.data(),
+               header.size);
+    buffer.head.store(head + sizeof(header) + header.size,
+                      memory_order_release);
+  }
+
+  if (level >= LOG_LEVEL_ERROR) {
+    flush();
+  } else if (_flush_interval > 0 && ! _pending.exchange(true)) {
+    _wake.notify_one();
+  }
+}
+
+void Logger::flush() {
+  lock_guard<mutex> flush_lock(_flush_mutex);
+  vector<shared_ptr<ThreadBuffer> > buffers;
+  {
+    lock_guard<mutex> lock(_buffers_mutex);
+    buffers = _buffers;
+  }
+
+  vector<Record> records;
+  size_t num_newly_dropped = 0;
+  for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+    ThreadBuffer& buffer(**it);
+    const uint64_t head = buffer.head.load(memory_order_acquire);
+    uint64_t tail = buffer.tail.load(memory_order_relaxed);
+    while (tail != head) {
+      RecordHeader header;
+      ring_read(buffer.data, tail, &header, sizeof(header));
+      Record record;
+      record.timestamp = header.timestamp;
+      record.frame = header.frame;
+      record.level = header.level;
+      record.message.resize(header.size);
+      if (header.size > 0) {
+        ring_read(buffer.data, tail + sizeof(header), &record.message[0],
+                  header.size);
       }
+      records.push_back(move(record));
+      tail += sizeof(header) + header.size;
     }
-  } else {
-    strcpy(s, "[time error]");
+    buffer.tail.store(tail, memory_order_release);
+    const uint64_t num_dropped =
+      buffer.num_dropped.load(memory_order_relaxed);
+    num_newly_dropped += num_dropped - buffer.num_reported_dropped;
+    buffer.num_reported_dropped = num_dropped;
+  }
+
+  // messages of one thread are already in order
+  stable_sort(records.begin(), records.end(),
+              [](const Record& x, const Record& y) {
+                return x.timestamp < y.timestamp;
+              });
+  for (auto it = records.begin(); it != records.end(); ++it) {
+    _write(*it);
+  }
+  if (num_newly_dropped > 0) {
+    Record record;
+    record.timestamp = chrono::duration_cast<chrono::nanoseconds>(
+      chrono::system_clock::now().time_since_epoch()).count();
+    record.frame = "Logger";
+    record.level = LOG_LEVEL_WARNING;
+    record.message = "dropped " + to_string(num_newly_dropped) +
+      " messages (log buffer full)\n";
+    _write(record);
   }
-  return std::cerr <<
-    s << ": " <<
-    frame << ": " <<
-    level << ": ";
+  _stream.flush();
+
+  // free buffers of exited threads (no longer held by their thread)
+  // once drained
+  buffers.clear();
+  lock_guard<mutex> lock(_buffers_mutex);
+  for (auto it = _buffers.begin(); it != _buffers.end();) {
+    if (it->use_count() == 1 &&
+        (*it)->head.load(memory_order_acquire) ==
+          (*it)->tail.load(memory_order_relaxed)) {
+      _num_freed_dropped += (*it)->num_dropped.load(memory_order_relaxed);
+      it = _buffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Logger::_write(const Record& record) {
+  const int64_t second = record.timestamp / 1000000000;
+  if (second != _cached_second) {
+    const time_t t = second;
+    struct tm local;
+    if (localtime_r(&t, &local) == 0 ||
+        strftime(_cached_time, sizeof(_cached_time), "%Y-%m-%d %H:%M:%S",
+                 &local) == 0) {
+      strcpy(_cached_time, "[time error]");
+    }
+    _cached_second = second;
+  }
+  char millis[8];
+  snprintf(millis, sizeof(millis), ".%03u",
+           (unsigned int) (record.timestamp / 1000000 % 1000));
+  _stream << _cached_time << millis << ": " <<
+    record.frame << ": " <<
+    level_name(record.level) << ": " <<
+    record.message;
+}
+
+size_t Logger::num_dropped() {
+  lock_guard<mutex> lock(_buffers_mutex);
+  size_t n = _num_freed_dropped;
+  for (auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+    n += (*it)->num_dropped.load(memory_order_relaxed);
+  }
+  return n;
+}
+
+void Logger::_run() {
+  while (! _stop.load()) {
+    {
+      unique_lock<mutex> lock(_wake_mutex);
+      _wake.wait_for(lock, chrono::milliseconds(_flush_interval),
+                     [this]() { return _stop.load() || _pending.load(); });
+    }
+    _pending.store(false);
+    flush();
+  }
+}
+
+Logger::~Logger() {
+  {
+    lock_guard<mutex> lock(logger_registry_mutex());
+    vector<Logger*>& loggers(logger_registry());
+    loggers.erase(remove(loggers.begin(), loggers.end(), this),
+                  loggers.end());
+  }
+  if (_flusher.joinable()) {
+    {
+      lock_guard<mutex> lock(_wake_mutex);
+      _stop.store(true);
+    }
+    _wake.notify_one();
+    _flusher.join();
+  }
+  flush();
+}
+
+void Logger::_prepare_fork() {
+  // (same order as flush)
+  logger_registry_mutex().lock();
+  vector<Logger*>& loggers(logger_registry());
+  for (auto it = loggers.begin(); it != loggers.end(); ++it) {
+    (*it)->_flush_mutex.lock();
+    (*it)->_buffers_mutex.lock();
+    (*it)->_wake_mutex.lock();
+  }
+}
+
+void Logger::_parent_after_fork() {
+  vector<Logger*>& loggers(logger_registry());
+  for (auto it = loggers.begin(); it != loggers.end(); ++it) {
+    (*it)->_wake_mutex.unlock();
+    (*it)->_buffers_mutex.unlock();
+    (*it)->_flush_mutex.unlock();
+  }
+  logger_registry_mutex().unlock();
+}
+
+void Logger::_child_after_fork() {
+  vector<Logger*>& loggers(logger_registry());
+  for (auto it = loggers.begin(); it != loggers.end(); ++it) {
+    (*it)->_wake_mutex.unlock();
+    (*it)->_buffers_mutex.unlock();
+    (*it)->_flush_mutex.unlock();
+    // the flusher thread does not exist in the child, so it cannot be
+    // joined; detach the handle inherited from the parent and stop
+    // waking it.  The condition variable may still count the flusher
+    // as a waiter (and would wait for it on destruction), so replace
+    // it by a fresh one
+    if ((*it)->_flusher.joinable()) {
+      (*it)->_flusher.detach();
+    }
+    (*it)->_flush_interval = 0;
+    new (&(*it)->_wake) condition_variable();
+  }
+  logger_registry_mutex().unlock();
+}
+
+static int global_level() {
+  const char *level_str = getenv(LOG_LEVEL_ENV);
+  if (level_str != 0) {
+    try {
+      return max(LOG_COMPILED_LEVEL, Logger::parse_level(level_str));
+    } catch (const invalid_argument&) {
+      cerr << "Logger: ignoring unknown level " << level_str << " in " <<
+        LOG_LEVEL_ENV << endl;
+    }
+  }
+  return LOG_COMPILED_LEVEL;
+}
+
+Logger& Logger::global() {
+  static Logger logger(cerr, global_level());
+  return logger;
+}
+
+int Logger::parse_level(const string& s) {
+  for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_NONE; ++level) {
+    if (s == level_names[level]) {
+      return level;
+    }
+  }
+  throw invalid_argument("Logger::parse_level: unknown level " + s);
+}
+
+const char* Logger::level_name(int level) {
+  return (level >= LOG_LEVEL_DEBUG && level <= LOG_LEVEL_NONE) ?
+    level_names[level] : "unknown";
+}
+
+
+//
+// LogMessage
+//
+
+
+ostringstream& LogMessage::_thread_stream() {
+  thread_local ostringstream stream;
+  // reset contents and any formatting left by the previous message
+  stream.str(string());
+  stream.clear();
+  stream.flags(ios_base::dec | ios_base::skipws);
+  stream.precision(6);
+  stream.width(0);
+  stream.fill(' ');
+  return stream;
 }
@@ -1,43 +1,198 @@
 #ifndef ATHENA__LOG_H
 #define ATHENA__LOG_H
 
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#define LOG_LEVEL_DEBUG   0
+#define LOG_LEVEL_INFO    1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR   3
+#define LOG_LEVEL_NONE    4
+
+// environment variable setting the initial run-time level of the
+// process-wide logger (debug, info, warning, error or none); levels
+// compiled out below cannot be enabled at run time
+#define LOG_LEVEL_ENV "ATHENA_LOG_LEVEL"
+// bytes of queued messages per thread (further messages are dropped
+// and counted until the flusher catches up)
+#define DEFAULT_LOG_BUFFER_SIZE (1 << 16)
+// milliseconds; longest the flusher sleeps while messages are queued
+#define DEFAULT_LOG_FLUSH_INTERVAL 100
+
+
 #ifdef LOG_DEBUG
-#define debug(frame, expr)   _log(frame, "debug") << expr;
-#define info(frame, expr)    _log(frame, "info") << expr;
-#define warning(frame, expr) _log(frame, "warning") << expr;
-#define error(frame, expr)   _log(frame, "error") << expr;
+#define LOG_COMPILED_LEVEL LOG_LEVEL_DEBUG
 #else
 #ifdef LOG_INFO
-#define debug(frame, expr)   ;
-#define info(frame, expr)    _log(frame, "info") << expr;
-#define warning(frame, expr) _log(frame, "warning") << expr;
-#define error(frame, expr)   _log(frame, "error") << expr;
+#define LOG_COMPILED_LEVEL LOG_LEVEL_INFO
 #else
 #ifdef LOG_WARNING
-#define debug(frame, expr)   ;
-#define info(frame, expr)    ;
-#define warning(frame, expr) _log(frame, "warning") << expr;
-#define error(frame, expr)   _log(frame, "error") << expr;
+#define LOG_COMPILED_LEVEL LOG_LEVEL_WARNING
 #else
 #ifdef LOG_ERROR
-#define debug(frame, expr)   ;
-#define info(frame, expr)    ;
-#define warning(frame, expr) ;
-#define error(frame, expr)   _log(frame, "error") << expr;
+#define LOG_COMPILED_LEVEL LOG_LEVEL_ERROR
+#else
+#define LOG_COMPILED_LEVEL LOG_LEVEL_NONE
+#endif
+#endif
+#endif
+#endif
+
+// Format expr (a chain of << operands) into a message and queue it on
+// the process-wide logger if level is enabled at run time; expr is not
+// evaluated otherwise.
+#define _LOG(frame, level, expr) \
+  do { \
+    if (Logger::global().enabled(level)) { \
+      LogMessage _log_message(Logger::global(), frame, level); \
+      _log_message.stream() << expr; \
+    } \
+  } while (0);
+
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_DEBUG
+#define debug(frame, expr)   _LOG(frame, LOG_LEVEL_DEBUG, expr)
 #else
 #define debug(frame, expr)   ;
-#define info(frame, expr)    ;
-#define warning(frame, expr) ;
-#define error(frame, expr)   ;
 #endif
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_INFO
+#define info(frame, expr)    _LOG(frame, LOG_LEVEL_INFO, expr)
+#else
+#define info(frame, expr)    ;
 #endif
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_WARNING
+#define warning(frame, expr) _LOG(frame, LOG_LEVEL_WARNING, expr)
+#else
+#define warning(frame, expr) ;
 #endif
+#if LOG_COMPILED_LEVEL <= LOG_LEVEL_ERROR
+#define error(frame, expr)   _LOG(frame, LOG_LEVEL_ERROR, expr)
+#else
+#define error(frame, expr)   ;
 #endif
 
 
-#include <iostream>
+// Asynchronous logger.  Each thread queues messages in its own
+// single-producer, single-consumer ring buffer, so logging takes no
+// lock and never waits on the output stream; a background thread
+// drains the buffers, formats timestamps (caching the date and time
+// to the second) and writes messages in time order.  If a thread's
+// buffer is full its messages are dropped and the drop is reported.
+// Errors are written before the logging call returns.  Across fork,
+// every logger's locks are held by the forking thread, so a child
+// never inherits a lock taken by a flusher; the child has no flusher
+// (it writes on flush, on errors and on destruction).
+
+class Logger final {
+  struct ThreadBuffer {
+    std::vector<char> data;
+    // bytes written by producer and read by consumer (modulo size)
+    std::atomic<uint64_t> head, tail;
+    std::atomic<uint64_t> num_dropped;
+    uint64_t num_reported_dropped;
+  };
+
+  struct Record {
+    // nanoseconds since the Unix epoch
+    uint64_t timestamp;
+    const char *frame;
+    int level;
+    std::string message;
+  };
+
+  uint64_t _id;
+  std::ostream& _stream;
+  size_t _buffer_size;
+  std::atomic<int> _level;
+  std::mutex _buffers_mutex;
+  std::vector<std::shared_ptr<ThreadBuffer> > _buffers;
+  // drops counted in buffers since freed
+  size_t _num_freed_dropped;
+  // serializes consumers (the flusher and flush callers)
+  std::mutex _flush_mutex;
+  int64_t _cached_second;
+  char _cached_time[32];
+  std::mutex _wake_mutex;
+  std::condition_variable _wake;
+  std::atomic<bool> _pending, _stop;
+  // zero if there is no flusher
+  unsigned int _flush_interval;
+  std::thread _flusher;
+
+  public:
+    // if flush_interval is zero, do not start a flusher; messages are
+    // written by flush and on destruction only
+    Logger(std::ostream& stream = std::cerr,
+           int level = LOG_COMPILED_LEVEL,
+           size_t buffer_size = DEFAULT_LOG_BUFFER_SIZE,
+           unsigned int flush_interval = DEFAULT_LOG_FLUSH_INTERVAL);
+    bool enabled(int level) const {
+      return level >= _level.load(std::memory_order_relaxed);
+    }
+    int get_level() const { return _level.load(std::memory_order_relaxed); }
+    void set_level(int level) {
+      _level.store(level, std::memory_order_relaxed);
+    }
+    // queue message on calling thread's buffer (frame must outlive the
+    // logger; messages too long for the buffer are truncated)
+    void log(const char *frame, int level, const std::string& message);
+    // write all queued messages
+    void flush();
+    // return number of messages dropped (over all threads)
+    size_t num_dropped();
+    ~Logger();
+
+    // return process-wide logger, writing to stderr at the level in
+    // ATHENA_LOG_LEVEL (default: lowest compiled-in level)
+    static Logger& global();
+    // return level named s (debug, info, warning, error or none)
+    static int parse_level(const std::string& s);
+    static const char* level_name(int level);
+
+  private:
+    ThreadBuffer& _thread_buffer();
+    void _write(const Record& record);
+    void _run();
+    // fork handlers (see pthread_atfork), applied to every logger
+    static void _prepare_fork();
+    static void _parent_after_fork();
+    static void _child_after_fork();
+    Logger(const Logger& other);
+};
+
+
+// Message under construction (see _LOG); queued on destruction.
+
+class LogMessage final {
+  Logger& _logger;
+  const char *_frame;
+  int _level;
+  std::ostringstream& _stream;
+
+  public:
+    LogMessage(Logger& logger, const char *frame, int level):
+      _logger(logger), _frame(frame), _level(level),
+      _stream(_thread_stream()) { }
+    std::ostream& stream() { return _stream; }
+    ~LogMessage() { _logger.log(_frame, _level, _stream.str()); }
 
+  private:
+    // reuse one stream per thread (constructing one per message is
+    // comparatively expensive)
+    static std::ostringstream& _thread_stream();
+    LogMessage(const LogMessage& other);
+};
 
-std::ostream& _log(const char *frame, const char *level);
 
 #endif
@@ -24,6 +24,7 @@ using namespace std;
 
 
 static vector<PRNG> prngs;
+static unsigned int prngs_seed = 0;
 static vector<float> fast_sigmoid_grid;
 
 
@@ -68,6 +69,21 @@ AlignedVector::AlignedVector(const AlignedVector& other): _data(0), _size(0) {
   memcpy(_data, other._data, other._size * sizeof(float));
 }
 
+AlignedVector& AlignedVector::operator=(const AlignedVector& other) {
+  if (this != &other) {
+    if (_data == 0 || _size != other._size) {
+      if (_data != 0) {
+        free(_data);
+        _data = 0;
+        _size = 0;
+      }
+      resize(other._size);
+    }
+    memcpy(_data, other._data, other._size * sizeof(float));
+  }
+  return *this;
+}
+
 AlignedVector::~AlignedVector() {
   if (_data != 0) {
     free(_data);
@@ -78,6 +94,11 @@ bool operator==(const AlignedVector& lhs, const AlignedVector& rhs) {
   return lhs.equals(rhs);
 }
 
+size_t AlignedVector::heap_size() const {
+  return (_data == 0) ? 0 :
+    INCREASE_TO_MULTIPLE(_size, VECTOR_ALIGNMENT) * sizeof(float);
+}
+
 bool AlignedVector::equals(const AlignedVector& other) const {
   return _size == other._size &&
     memcmp(
@@ -173,6 +194,7 @@ float fast_sigmoid(float x, size_t grid_size) {
 
 
 void seed(unsigned int s) {
+  prngs_seed = s;
   prngs.clear();
   int num_threads = 1;
   #pragma omp parallel default(shared)
@@ -182,12 +204,36 @@ void seed(unsigned int s) {
     }
   }
   for (int t = 0; t < num_threads; ++t) {
-    prngs.push_back(PRNG(s + t));
+    prngs.push_back(PRNG(stream_seed(s, t)));
   }
 }
 
-void seed_default() {
-  seed(random_device()());
+unsigned int seed_default() {
+  const unsigned int s = random_device()();
+  seed(s);
+  return s;
+}
+
+unsigned int get_seed() {
+  return prngs_seed;
+}
+
+uint64_t stream_seed(uint64_t s, uint64_t key) {
+  uint64_t z = s * 0x9e3779b97f4a7c15ULL + key;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void seed_stream(uint64_t key) {
+  get_urng().seed(stream_seed(prngs_seed, key));
+}
+
+void sample_centered_uniform_vector(size_t n, float *z) {
+  get_urng().fill_unit_float(z, n);
+  for (size_t i = 0; i < n; ++i) {
+    z[i] -= 0.5f;
+  }
 }
 
 PRNG& get_urng() {
@@ -255,8 +301,7 @@ NaiveSampler::NaiveSampler(const vector<float>& probabilities):
 }
 
 size_t NaiveSampler::sample() const {
-  uniform_real_distribution<float> d(0, 1);
-  const float target_p = d(get_urng());
+  const float target_p = sample_unit_float();
   size_t low = 0, high = _size - 1;
   while (high > low) {
     const size_t mid = (low + high) / 2;
@@ -346,13 +391,12 @@ AliasSampler::AliasSampler(const vector<float>& probabilities):
 }
 
 size_t AliasSampler::sample() const {
-  uniform_int_distribution<size_t> d(0, _size - 1);
-  const size_t i = d(get_urng());
+  const size_t i = sample_uniform_index(_size);
   if (_probability_table[i] == 1) {
     return i;
   } else {
-    bernoulli_distribution alias_d(_probability_table[i]);
-    return (alias_d(get_urng()) ? i : _alias_table[i]);
+    return (sample_unit_float() < _probability_table[i] ?
+            i : _alias_table[i]);
   }
 }
 
@@ -373,6 +417,13 @@ AliasSampler AliasSampler::deserialize(istream& stream) {
   );
 }
 
+MemoryUsage AliasSampler::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("alias_table", vector_heap_size(_alias_table));
+  usage.add("probability_table", vector_heap_size(_probability_table));
+  return usage;
+}
+
 bool AliasSampler::equals(const AliasSampler& other) const {
   return
     _size == other._size &&
@@ -438,6 +489,12 @@ Discretization Discretization::deserialize(istream& stream) {
   );
 }
 
+MemoryUsage Discretization::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("samples", vector_heap_size(_samples));
+  return usage;
+}
+
 bool Discretization::equals(const Discretization& other) const {
   return _samples == other._samples;
 }
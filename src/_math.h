@@ -3,8 +3,11 @@
 
 
 #include "_serialization.h"
+#include "_memory.h"
+#include "_random.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <cmath>
 #include <vector>
 #include <utility>
@@ -33,8 +36,7 @@
 #define DEFAULT_FAST_SIGMOID_GRID_SIZE 1000
 
 
-typedef std::linear_congruential_engine<size_t,25214903917ull,11ull,1ull<<48>
-        PRNG;
+typedef Philox4x32 PRNG;
 
 
 // Wrapper on cache-aligned floating-point vector.
@@ -47,6 +49,7 @@ class AlignedVector final {
     AlignedVector(size_t size);
     size_t size() const { return _size; }
     float* data() { return _data; }
+    const float* data() const { return _data; }
     const float& operator[](size_t i) const { return _data[i]; }
     float& operator[](size_t i) { return _data[i]; }
     void resize(size_t size);
@@ -54,6 +57,11 @@ class AlignedVector final {
 
     AlignedVector(AlignedVector&& other);
     AlignedVector(const AlignedVector& other);
+    // (reuses storage if sizes match)
+    AlignedVector& operator=(const AlignedVector& other);
+
+    // return heap bytes allocated (including alignment padding)
+    size_t heap_size() const;
 
     bool equals(const AlignedVector& other) const;
     void serialize(std::ostream& stream) const;
@@ -89,18 +97,55 @@ float sigmoid(float x);
 float fast_sigmoid(float x, size_t grid_size = DEFAULT_FAST_SIGMOID_GRID_SIZE);
 
 
-// Seed the random number generator(s).
+// Seed the random number generator(s); thread t's generator is seeded
+// with stream_seed(s, t).
 void seed(unsigned int s);
 
 
-// Seed the random number generator(s) randomly.
-void seed_default();
+// Seed the random number generator(s) randomly and return the seed
+// (log it so that the run can be repeated with seed).
+unsigned int seed_default();
+
+
+// Return seed the random number generator(s) were last seeded with.
+unsigned int get_seed();
+
+
+// Return generator seed for stream key under seed s (a SplitMix64
+// hash, so that streams of nearby seeds and keys are unrelated).
+uint64_t stream_seed(uint64_t s, uint64_t key);
+
+
+// Reseed calling thread's random number generator with
+// stream_seed(get_seed(), key).  Draws that follow then depend only on
+// the seed and key, not on which thread makes them or what it drew
+// before; keying each unit of work (e.g., sentence) by its index makes
+// a run reproducible regardless of how work is assigned to threads.
+void seed_stream(uint64_t key);
 
 
 // Get thread's random number generator.
 PRNG& get_urng();
 
 
+// Return uniformly random integer in [0, n) (n must be positive),
+// without the division a std::uniform_int_distribution takes.
+inline size_t sample_uniform_index(size_t n) {
+  PRNG& urng(get_urng());
+  if (n <= UINT32_MAX) {
+    return bounded_uint32(urng(), (uint32_t) n);
+  } else {
+    const uint64_t hi = urng();
+    return bounded_uint64((hi << 32) | urng(), n);
+  }
+}
+
+// Return uniformly random float in [0, 1).
+inline float sample_unit_float() {
+  return unit_float(get_urng()());
+}
+
+
 // Sample vector of i.i.d. Gaussian random variables.
 template <class T>
 void sample_gaussian_vector(size_t n, T *z) {
@@ -119,6 +164,9 @@ void sample_centered_uniform_vector(size_t n, T *z) {
   }
 }
 
+// (generates floats in bulk)
+void sample_centered_uniform_vector(size_t n, float *z);
+
 
 class ExponentCountNormalizer final {
   float _exponent;
@@ -168,6 +216,8 @@ class AliasSampler final {
     AliasSampler(const std::vector<float>& probabilities);
     size_t sample() const;
 
+    MemoryUsage memory_usage() const;
+
     bool equals(const AliasSampler& other) const;
     void serialize(std::ostream& stream) const;
     static AliasSampler deserialize(std::istream& stream);
@@ -197,8 +247,7 @@ class ReservoirSampler final {
   public:
     ReservoirSampler(size_t size);
     T sample() const {
-      std::uniform_int_distribution<size_t> d(0, _filled_size - 1);
-      return _reservoir[d(get_urng())];
+      return _reservoir[sample_uniform_index(_filled_size)];
     }
     const T& operator[](size_t idx) const {
       return _reservoir[idx];
@@ -208,6 +257,12 @@ class ReservoirSampler final {
     T insert(T val);
     void clear();
 
+    MemoryUsage memory_usage() const {
+      MemoryUsage usage;
+      usage.add("reservoir", vector_heap_size(_reservoir));
+      return usage;
+    }
+
     bool equals(const ReservoirSampler<T>& other) const;
     void serialize(std::ostream& stream) const;
     static ReservoirSampler<T> deserialize(std::istream& stream);
@@ -230,12 +285,13 @@ class Discretization final {
     Discretization(const std::vector<float>& probabilities,
                    size_t num_samples);
     long sample() const {
-      std::uniform_int_distribution<size_t> d(0, _samples.size() - 1);
-      return _samples[d(get_urng())];
+      return _samples[sample_uniform_index(_samples.size())];
     }
     const long& operator[](size_t idx) const { return _samples[idx]; }
     size_t num_samples() const { return _samples.size(); }
 
+    MemoryUsage memory_usage() const;
+
     bool equals(const Discretization& other) const;
     void serialize(std::ostream& stream) const;
     static Discretization deserialize(std::istream& stream);
@@ -270,8 +326,7 @@ T ReservoirSampler<T>::insert(T val) {
   } else {
     // reservoir at capacity, insert val w.p. _size/(_count+1)
     // (+1 is for val)
-    std::uniform_int_distribution<size_t> d(0, _count);
-    const size_t idx = d(get_urng());
+    const size_t idx = sample_uniform_index(_count + 1);
     if (idx < _size) {
       const T prev_val = _reservoir[idx];
       _reservoir[idx] = val;
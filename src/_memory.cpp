@@ -0,0 +1,94 @@
+#include "_memory.h"
+
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+using namespace std;
+
+
+//
+// MemoryUsage
+//
+
+
+void MemoryUsage::add(const string& component, size_t bytes) {
+  for (auto it = _components.begin(); it != _components.end(); ++it) {
+    if (it->first == component) {
+      it->second += bytes;
+      return;
+    }
+  }
+  _components.push_back(make_pair(component, bytes));
+}
+
+void MemoryUsage::add(const string& member, const MemoryUsage& other) {
+  for (auto it = other._components.begin(); it != other._components.end();
+       ++it) {
+    add(member + "." + it->first, it->second);
+  }
+}
+
+size_t MemoryUsage::get(const string& component) const {
+  for (auto it = _components.begin(); it != _components.end(); ++it) {
+    if (it->first == component) {
+      return it->second;
+    }
+  }
+  return 0;
+}
+
+size_t MemoryUsage::total() const {
+  size_t bytes = 0;
+  for (auto it = _components.begin(); it != _components.end(); ++it) {
+    bytes += it->second;
+  }
+  return bytes;
+}
+
+void MemoryUsage::write(ostream& stream) const {
+  size_t width = 5;
+  for (auto it = _components.begin(); it != _components.end(); ++it) {
+    width = max(width, it->first.size());
+  }
+  const ios_base::fmtflags flags = stream.flags();
+  const streamsize precision = stream.precision();
+  stream << fixed << setprecision(1);
+  for (auto it = _components.begin(); it != _components.end(); ++it) {
+    stream << "  " << left << setw(width) << it->first << right <<
+      setw(16) << it->second << " B" <<
+      setw(12) << it->second / 1048576. << " MiB\n";
+  }
+  stream << "  " << left << setw(width) << "total" << right <<
+    setw(16) << total() << " B" <<
+    setw(12) << total() / 1048576. << " MiB\n";
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+
+ostream& operator<<(ostream& stream, const MemoryUsage& usage) {
+  usage.write(stream);
+  return stream;
+}
+
+
+size_t string_heap_size(const string& s) {
+  const char *data = s.data(),
+    *object = reinterpret_cast<const char*>(&s);
+  if (data >= object && data < object + sizeof(s)) {
+    return 0;
+  }
+  return s.capacity() + 1;
+}
+
+size_t strings_heap_size(const vector<string>& v) {
+  size_t bytes = 0;
+  for (auto it = v.begin(); it != v.end(); ++it) {
+    bytes += string_heap_size(*it);
+  }
+  return bytes;
+}
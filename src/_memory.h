@@ -0,0 +1,61 @@
+#ifndef ATHENA__MEMORY_H
+#define ATHENA__MEMORY_H
+
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// getopt_long value of the --memory-report option of the programs
+#define MEMORY_REPORT_OPTION 256
+
+
+// Heap memory held by an object, broken down by component (in bytes
+// requested from the allocator; allocator bookkeeping and rounding are
+// not included).  Components of nested objects are named
+// "<member>.<component>".
+
+class MemoryUsage final {
+  std::vector<std::pair<std::string,size_t> > _components;
+
+  public:
+    MemoryUsage(): _components() { }
+    // add bytes to component (creating it if necessary)
+    void add(const std::string& component, size_t bytes);
+    // add all components of other, prefixed by member name
+    void add(const std::string& member, const MemoryUsage& other);
+    // return bytes in component (zero if it does not exist)
+    size_t get(const std::string& component) const;
+    // return bytes in all components
+    size_t total() const;
+    const std::vector<std::pair<std::string,size_t> >& components() const {
+      return _components;
+    }
+    // write table of components and total
+    void write(std::ostream& stream) const;
+};
+
+
+// Write table of components of usage and total (see MemoryUsage::write).
+std::ostream& operator<<(std::ostream& stream, const MemoryUsage& usage);
+
+
+// Return heap bytes held by vector (its capacity, not just its size).
+template <class T>
+size_t vector_heap_size(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+// Return heap bytes held by string (zero if it fits in the string
+// object itself).
+size_t string_heap_size(const std::string& s);
+
+// Return heap bytes held by strings in vector (not counting the string
+// objects, which vector_heap_size counts).
+size_t strings_heap_size(const std::vector<std::string>& v);
+
+
+#endif
@@ -0,0 +1,289 @@
+#include "_metrics.h"
+
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// quantiles written for each histogram
+#define PROMETHEUS_QUANTILES {0.5, 0.9, 0.99, 0.999}
+
+
+using namespace std;
+
+
+//
+// Histogram
+//
+
+
+Histogram::Histogram():
+    _num_buckets(
+      1 + (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_MIN_EXPONENT + 1) *
+        HISTOGRAM_SUB_BUCKETS),
+    _buckets(new atomic<uint64_t>[_num_buckets]),
+    _count(0),
+    _sum(0) {
+  for (size_t i = 0; i < _num_buckets; ++i) {
+    _buckets[i].store(0, memory_order_relaxed);
+  }
+}
+
+// bucket 0 holds zero; bucket 1 + (e - min exponent) * sub-buckets + s
+// holds [0.5 + s / (2 * sub-buckets), 0.5 + (s + 1) / (2 * sub-buckets))
+// times 2^e
+size_t Histogram::_bucket_idx(double x) const {
+  if (! (x > 0)) {
+    return 0;
+  }
+  int e;
+  const double m = frexp(x, &e);
+  if (e < HISTOGRAM_MIN_EXPONENT) {
+    return 1;
+  }
+  if (e > HISTOGRAM_MAX_EXPONENT) {
+    return _num_buckets - 1;
+  }
+  const size_t s = min((size_t) ((m - 0.5) * 2 * HISTOGRAM_SUB_BUCKETS),
+                       (size_t) HISTOGRAM_SUB_BUCKETS - 1);
+  return 1 + (e - HISTOGRAM_MIN_EXPONENT) * HISTOGRAM_SUB_BUCKETS + s;
+}
+
+double Histogram::_bucket_midpoint(size_t bucket_idx) const {
+  if (bucket_idx == 0) {
+    return 0;
+  }
+  const int e = (int) ((bucket_idx - 1) / HISTOGRAM_SUB_BUCKETS) +
+    HISTOGRAM_MIN_EXPONENT;
+  const size_t s = (bucket_idx - 1) % HISTOGRAM_SUB_BUCKETS;
+  return ldexp(0.5 + (s + 0.5) / (2 * HISTOGRAM_SUB_BUCKETS), e);
+}
+
+void Histogram::record(double x) {
+  _buckets[_bucket_idx(x)].fetch_add(1, memory_order_relaxed);
+  _count.fetch_add(1, memory_order_relaxed);
+  double sum = _sum.load(memory_order_relaxed);
+  while (! _sum.compare_exchange_weak(sum, sum + max(x, 0.),
+                                      memory_order_relaxed)) { }
+}
+
+double Histogram::quantile(double q) const {
+  const uint64_t n = count();
+  if (n == 0) {
+    return 0;
+  }
+  // smallest rank r (starting at 1) with r >= q n
+  const uint64_t rank = max((uint64_t) ceil(q * n), (uint64_t) 1);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < _num_buckets; ++i) {
+    cumulative += _buckets[i].load(memory_order_relaxed);
+    if (cumulative >= rank) {
+      return _bucket_midpoint(i);
+    }
+  }
+  // concurrent record updated count before its bucket was visible
+  for (size_t i = _num_buckets; i > 0; --i) {
+    if (_buckets[i - 1].load(memory_order_relaxed) > 0) {
+      return _bucket_midpoint(i - 1);
+    }
+  }
+  return 0;
+}
+
+
+//
+// MetricsRegistry
+//
+
+
+MetricsRegistry::Entry& MetricsRegistry::_entry(const string& name,
+                                                const string& help) {
+  for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+    if ((*it)->name == name) {
+      return **it;
+    }
+  }
+  _entries.push_back(unique_ptr<Entry>(new Entry()));
+  _entries.back()->name = name;
+  _entries.back()->help = help;
+  return *_entries.back();
+}
+
+Counter& MetricsRegistry::counter(const string& name, const string& help) {
+  lock_guard<mutex> lock(_mutex);
+  Entry& entry(_entry(name, help));
+  if (entry.gauge || entry.histogram) {
+    throw logic_error(
+      string("MetricsRegistry::counter: ") + name +
+      string(" is registered with another type"));
+  }
+  if (! entry.counter) {
+    entry.counter.reset(new Counter());
+  }
+  return *entry.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const string& name, const string& help) {
+  lock_guard<mutex> lock(_mutex);
+  Entry& entry(_entry(name, help));
+  if (entry.counter || entry.histogram) {
+    throw logic_error(
+      string("MetricsRegistry::gauge: ") + name +
+      string(" is registered with another type"));
+  }
+  if (! entry.gauge) {
+    entry.gauge.reset(new Gauge());
+  }
+  return *entry.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const string& name,
+                                      const string& help) {
+  lock_guard<mutex> lock(_mutex);
+  Entry& entry(_entry(name, help));
+  if (entry.counter || entry.gauge) {
+    throw logic_error(
+      string("MetricsRegistry::histogram: ") + name +
+      string(" is registered with another type"));
+  }
+  if (! entry.histogram) {
+    entry.histogram.reset(new Histogram());
+  }
+  return *entry.histogram;
+}
+
+void MetricsRegistry::write_prometheus(ostream& stream) const {
+  lock_guard<mutex> lock(_mutex);
+  const vector<double> quantiles(PROMETHEUS_QUANTILES);
+  const auto precision = stream.precision(numeric_limits<double>::digits10);
+  for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+    const Entry& entry(**it);
+    stream << "# HELP " << entry.name << " " << entry.help << "\n";
+    if (entry.counter) {
+      stream << "# TYPE " << entry.name << " counter\n";
+      stream << entry.name << " " << entry.counter->value() << "\n";
+    } else if (entry.gauge) {
+      stream << "# TYPE " << entry.name << " gauge\n";
+      stream << entry.name << " " << entry.gauge->value() << "\n";
+    } else if (entry.histogram) {
+      stream << "# TYPE " << entry.name << " summary\n";
+      for (auto q = quantiles.begin(); q != quantiles.end(); ++q) {
+        stream << entry.name << "{quantile=\"" << *q << "\"} " <<
+          entry.histogram->quantile(*q) << "\n";
+      }
+      stream << entry.name << "_sum " << entry.histogram->sum() << "\n";
+      stream << entry.name << "_count " << entry.histogram->count() << "\n";
+    }
+  }
+  stream.precision(precision);
+}
+
+
+//
+// MetricsExporter
+//
+
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& registry,
+                                 const string& path,
+                                 double interval):
+    _registry(registry),
+    _path(path),
+    _interval(interval),
+    _mutex(),
+    _stop_requested(),
+    _stopping(false),
+    _thread() {
+  write();
+  _thread = thread([this]() { _run(); });
+}
+
+void MetricsExporter::write() const {
+  const string tmp_path(_path + ".tmp");
+  ofstream f(tmp_path.c_str());
+  _registry.write_prometheus(f);
+  f.close();
+  if (! f) {
+    throw runtime_error(
+      string("MetricsExporter::write: cannot write ") + tmp_path);
+  }
+  if (rename(tmp_path.c_str(), _path.c_str()) != 0) {
+    throw runtime_error(
+      string("MetricsExporter::write: cannot rename to ") + _path);
+  }
+}
+
+void MetricsExporter::_run() {
+  unique_lock<mutex> lock(_mutex);
+  while (! _stopping) {
+    _stop_requested.wait_for(lock, chrono::duration<double>(_interval));
+    if (! _stopping) {
+      try {
+        write();
+      } catch (const exception&) {
+        // keep training; the next write may succeed
+      }
+    }
+  }
+}
+
+void MetricsExporter::stop() {
+  {
+    lock_guard<mutex> lock(_mutex);
+    if (_stopping) {
+      return;
+    }
+    _stopping = true;
+  }
+  _stop_requested.notify_all();
+  _thread.join();
+  write();
+}
+
+MetricsExporter::~MetricsExporter() {
+  try {
+    stop();
+  } catch (const exception&) { }
+}
+
+
+//
+// TrainingMetrics
+//
+
+
+TrainingMetrics::TrainingMetrics(MetricsRegistry& registry):
+  tokens(registry.counter(
+    "athena_tokens_total", "Tokens read from training text.")),
+  sentences(registry.counter(
+    "athena_sentences_total", "Sentences read from training text.")),
+  pairs_trained(registry.counter(
+    "athena_pairs_trained_total",
+    "Input-output word pairs trained on (excluding negative samples).")),
+  negative_samples(registry.counter(
+    "athena_negative_samples_total", "Negative samples drawn.")),
+  ejections(registry.counter(
+    "athena_ejections_total",
+    "Words ejected from the Space-Saving language model.")),
+  reservoir_filled_size(registry.gauge(
+    "athena_reservoir_filled_size",
+    "Number of filled slots in the negative sampling reservoir.")),
+  reservoir_size(registry.gauge(
+    "athena_reservoir_size",
+    "Number of slots in the negative sampling reservoir.")),
+  word_types(registry.gauge(
+    "athena_word_types",
+    "Estimated number of distinct words read (HyperLogLog).")),
+  sgd_rho(registry.histogram(
+    "athena_sgd_rho", "SGD learning rate of trained words.")),
+  sentence_train_seconds(registry.histogram(
+    "athena_sentence_train_seconds",
+    "Time spent training on each sentence.")) { }
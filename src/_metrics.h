@@ -0,0 +1,171 @@
+#ifndef ATHENA__METRICS_H
+#define ATHENA__METRICS_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// sub-buckets per power of two in histograms (relative error of
+// quantiles is at most 1 / (2 * HISTOGRAM_SUB_BUCKETS))
+#define HISTOGRAM_SUB_BUCKETS 16
+// range of binary exponents histograms resolve (values outside are
+// clamped into the first or last bucket)
+#define HISTOGRAM_MIN_EXPONENT -64
+#define HISTOGRAM_MAX_EXPONENT 64
+
+// seconds
+#define DEFAULT_METRICS_EXPORT_INTERVAL 10
+
+
+// Monotonically increasing count (safe to update from any thread).
+
+class Counter final {
+  std::atomic<uint64_t> _value;
+
+  public:
+    Counter(): _value(0) { }
+    void increment(uint64_t n = 1) {
+      _value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+  private:
+    Counter(const Counter& other);
+};
+
+
+// Value that can go up and down (safe to update from any thread).
+
+class Gauge final {
+  std::atomic<double> _value;
+
+  public:
+    Gauge(): _value(0) { }
+    void set(double x) { _value.store(x, std::memory_order_relaxed); }
+    double value() const { return _value.load(std::memory_order_relaxed); }
+
+  private:
+    Gauge(const Gauge& other);
+};
+
+
+// Distribution of non-negative values in log-linear buckets (as in
+// HdrHistogram): each power of two is split into HISTOGRAM_SUB_BUCKETS
+// equal parts, so any quantile is reported to within a few percent
+// over many orders of magnitude at constant memory and record cost.
+// Recording is lock-free; readers see a consistent-enough view for
+// monitoring.
+
+class Histogram final {
+  size_t _num_buckets;
+  std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+  std::atomic<uint64_t> _count;
+  std::atomic<double> _sum;
+
+  public:
+    Histogram();
+    // record value (negative values are recorded as zero)
+    void record(double x);
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    double sum() const { return _sum.load(std::memory_order_relaxed); }
+    // return approximate q-quantile (0 <= q <= 1) of recorded values
+    // (zero if none were recorded)
+    double quantile(double q) const;
+
+  private:
+    size_t _bucket_idx(double x) const;
+    double _bucket_midpoint(size_t bucket_idx) const;
+    Histogram(const Histogram& other);
+};
+
+
+// Named set of metrics, exported in Prometheus text format.  Metrics
+// are created on first request and live as long as the registry, so
+// callers can keep references to them.
+
+class MetricsRegistry final {
+  struct Entry {
+    std::string name, help;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  mutable std::mutex _mutex;
+  std::vector<std::unique_ptr<Entry> > _entries;
+
+  public:
+    MetricsRegistry(): _mutex(), _entries() { }
+    // return metric of given name, creating it if necessary (name
+    // should be a valid Prometheus metric name; raise exception if a
+    // metric of another type has this name)
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help);
+    // write all metrics in Prometheus text exposition format
+    // (histograms are written as summaries)
+    void write_prometheus(std::ostream& stream) const;
+
+  private:
+    Entry& _entry(const std::string& name, const std::string& help);
+    MetricsRegistry(const MetricsRegistry& other);
+};
+
+
+// Periodically writes a registry to a file in Prometheus text format
+// (for node_exporter's textfile collector), from a background thread.
+// The file is replaced atomically, so scrapers never see a partial
+// write.  A final write happens on stop (or destruction).
+
+class MetricsExporter final {
+  const MetricsRegistry& _registry;
+  std::string _path;
+  double _interval;
+  std::mutex _mutex;
+  std::condition_variable _stop_requested;
+  bool _stopping;
+  std::thread _thread;
+
+  public:
+    MetricsExporter(const MetricsRegistry& registry,
+                    const std::string& path,
+                    double interval = DEFAULT_METRICS_EXPORT_INTERVAL);
+    // write registry to file now (raise exception on failure)
+    void write() const;
+    void stop();
+    ~MetricsExporter();
+
+  private:
+    void _run();
+    MetricsExporter(const MetricsExporter& other);
+};
+
+
+// Metrics fed by the SGNS training programs.
+
+struct TrainingMetrics final {
+  Counter& tokens;
+  Counter& sentences;
+  Counter& pairs_trained;
+  Counter& negative_samples;
+  Counter& ejections;
+  Gauge& reservoir_filled_size;
+  Gauge& reservoir_size;
+  Gauge& word_types;
+  Histogram& sgd_rho;
+  Histogram& sentence_train_seconds;
+
+  TrainingMetrics(MetricsRegistry& registry);
+};
+
+
+#endif
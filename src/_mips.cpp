@@ -0,0 +1,235 @@
+#include "_mips.h"
+#include "_core.h"
+#include "_math.h"
+#include "_cblas.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <limits>
+
+
+// relative slack on list bounds (guards against rounding in acos/cos)
+#define MIPS_BOUND_TOLERANCE 1e-4f
+
+
+using namespace std;
+
+
+//
+// MIPSIndex
+//
+
+
+MIPSIndex::MIPSIndex(const WordContextFactorization& factorization,
+                     size_t vocab_size,
+                     size_t num_norm_buckets,
+                     size_t num_clusters,
+                     size_t num_iterations):
+    _embedding_dim(factorization.get_embedding_dim()),
+    _actual_embedding_dim(
+      INCREASE_TO_MULTIPLE(factorization.get_embedding_dim(), VECTOR_ALIGNMENT)),
+    _num_lists(0),
+    _centroids(0),
+    _max_norms(),
+    _min_norms(),
+    _cone_angles(),
+    _list_offsets(1, 0),
+    _word_ids(),
+    _embeddings(vocab_size * _actual_embedding_dim) {
+  const size_t dim = _embedding_dim;
+
+  vector<float> norms(vocab_size, 0);
+  for (size_t i = 0; i < vocab_size; ++i) {
+    norms[i] = cblas_snrm2(dim, factorization.get_word_embedding(i), 1);
+  }
+
+  // split words into buckets of (roughly) equal size by norm
+  vector<long> order(vocab_size);
+  for (size_t i = 0; i < vocab_size; ++i) {
+    order[i] = (long) i;
+  }
+  stable_sort(order.begin(), order.end(),
+              [&norms](long x, long y) { return norms[x] < norms[y]; });
+  num_norm_buckets = max((size_t) 1, min(num_norm_buckets, vocab_size));
+  num_clusters = max((size_t) 1, num_clusters);
+
+  vector<float> centroids;
+  vector<long> assignments;
+  vector<float> unit_embeddings;
+  for (size_t b = 0; b < num_norm_buckets; ++b) {
+    const size_t bucket_begin = (b * vocab_size) / num_norm_buckets;
+    const size_t bucket_end = ((b + 1) * vocab_size) / num_norm_buckets;
+    const size_t bucket_size = bucket_end - bucket_begin;
+    if (bucket_size == 0) {
+      continue;
+    }
+
+    // unit-normalize bucket members (zero vectors stay zero)
+    unit_embeddings.assign(bucket_size * dim, 0);
+    for (size_t m = 0; m < bucket_size; ++m) {
+      const long word_idx = order[bucket_begin + m];
+      if (norms[word_idx] > 0) {
+        const float *x = factorization.get_word_embedding(word_idx);
+        for (size_t j = 0; j < dim; ++j) {
+          unit_embeddings[m * dim + j] = x[j] / norms[word_idx];
+        }
+      }
+    }
+
+    // spherical k-means, initialized with evenly-spaced members
+    const size_t k = min(num_clusters, bucket_size);
+    centroids.assign(k * dim, 0);
+    for (size_t c = 0; c < k; ++c) {
+      memcpy(centroids.data() + c * dim,
+             unit_embeddings.data() + ((c * bucket_size) / k) * dim,
+             dim * sizeof(float));
+    }
+    assignments.assign(bucket_size, 0);
+    for (size_t t = 0; t <= num_iterations; ++t) {
+      #pragma omp parallel for schedule(static)
+      for (size_t m = 0; m < bucket_size; ++m) {
+        long best_c = 0;
+        float best_dot = -numeric_limits<float>::max();
+        for (size_t c = 0; c < k; ++c) {
+          const float dot = cblas_sdot(dim, unit_embeddings.data() + m * dim, 1,
+                                       centroids.data() + c * dim, 1);
+          if (dot > best_dot) {
+            best_c = (long) c;
+            best_dot = dot;
+          }
+        }
+        assignments[m] = best_c;
+      }
+
+      if (t == num_iterations) {
+        // final pass is assignment only
+        break;
+      }
+
+      vector<float> sums(k * dim, 0);
+      vector<size_t> sizes(k, 0);
+      for (size_t m = 0; m < bucket_size; ++m) {
+        cblas_saxpy(dim, 1, unit_embeddings.data() + m * dim, 1,
+                    sums.data() + assignments[m] * dim, 1);
+        ++sizes[assignments[m]];
+      }
+      for (size_t c = 0; c < k; ++c) {
+        const float norm = cblas_snrm2(dim, sums.data() + c * dim, 1);
+        if (sizes[c] > 0 && norm > 0) {
+          for (size_t j = 0; j < dim; ++j) {
+            centroids[c * dim + j] = sums[c * dim + j] / norm;
+          }
+        }
+      }
+    }
+
+    // emit one inverted list per non-empty cluster
+    for (size_t c = 0; c < k; ++c) {
+      float max_norm = 0, min_norm = numeric_limits<float>::max(),
+            min_cos = 1;
+      const size_t list_begin = _word_ids.size();
+      for (size_t m = 0; m < bucket_size; ++m) {
+        if (assignments[m] == (long) c) {
+          const long word_idx = order[bucket_begin + m];
+          max_norm = max(max_norm, norms[word_idx]);
+          min_norm = min(min_norm, norms[word_idx]);
+          min_cos = min(min_cos,
+                        cblas_sdot(dim, unit_embeddings.data() + m * dim, 1,
+                                   centroids.data() + c * dim, 1));
+          _word_ids.push_back(word_idx);
+        }
+      }
+      if (_word_ids.size() > list_begin) {
+        _centroids.resize((_num_lists + 1) * _actual_embedding_dim);
+        memset(_centroids.data() + _num_lists * _actual_embedding_dim, 0,
+               _actual_embedding_dim * sizeof(float));
+        memcpy(_centroids.data() + _num_lists * _actual_embedding_dim,
+               centroids.data() + c * dim, dim * sizeof(float));
+        _max_norms.push_back(max_norm);
+        _min_norms.push_back(min_norm);
+        _cone_angles.push_back(acos(max(-1.f, min(1.f, min_cos))));
+        _list_offsets.push_back(_word_ids.size());
+        ++_num_lists;
+      }
+    }
+  }
+
+  // copy embeddings in list order so each list is scanned contiguously
+  memset(_embeddings.data(), 0,
+         vocab_size * _actual_embedding_dim * sizeof(float));
+  for (size_t pos = 0; pos < _word_ids.size(); ++pos) {
+    memcpy(_embeddings.data() + pos * _actual_embedding_dim,
+           factorization.get_word_embedding(_word_ids[pos]),
+           dim * sizeof(float));
+  }
+}
+
+vector<pair<long,float> > MIPSIndex::search(const float *query,
+                                            size_t k,
+                                            size_t num_probes) const {
+  vector<pair<long,float> > results;
+  if (k == 0 || _num_lists == 0) {
+    return results;
+  }
+
+  // upper bound on inner product for each list
+  const float query_norm = cblas_snrm2(_embedding_dim, query, 1);
+  float max_bound_scale = 0;
+  vector<pair<float,size_t> > list_bounds(_num_lists);
+  for (size_t l = 0; l < _num_lists; ++l) {
+    const float max_norm = _max_norms[l], min_norm = _min_norms[l];
+    float cos_qc = 0;
+    if (query_norm > 0) {
+      cos_qc = cblas_sdot(_embedding_dim, query, 1, _centroid(l), 1) /
+        query_norm;
+    }
+    const float angle =
+      acos(max(-1.f, min(1.f, cos_qc))) - _cone_angles[l];
+    const float cos_bound = (angle <= 0) ? 1.f : cos(angle);
+    // a negative bound is loosest for the smallest member norm
+    list_bounds[l] = make_pair(
+      query_norm * cos_bound * (cos_bound >= 0 ? max_norm : min_norm), l);
+    max_bound_scale = max(max_bound_scale, query_norm * max_norm);
+  }
+  sort(list_bounds.begin(), list_bounds.end(),
+       [](const pair<float,size_t>& x, const pair<float,size_t>& y) {
+         return x.first > y.first;
+       });
+  const float tolerance = MIPS_BOUND_TOLERANCE * (max_bound_scale + 1e-12f);
+
+  // min-heap of (score, -word index): top is the current k-th best
+  // (ties broken in favor of the smaller word index)
+  priority_queue<pair<float,long>, vector<pair<float,long> >,
+                 greater<pair<float,long> > > heap;
+  num_probes = min(num_probes, _num_lists);
+  for (size_t p = 0; p < num_probes; ++p) {
+    if (heap.size() == k && list_bounds[p].first + tolerance < heap.top().first) {
+      // no remaining list can improve on the current top k
+      break;
+    }
+    const size_t l = list_bounds[p].second;
+    for (size_t pos = _list_offsets[l]; pos < _list_offsets[l + 1]; ++pos) {
+      const pair<float,long> entry(
+        cblas_sdot(_embedding_dim, query, 1, _embedding(pos), 1),
+        -_word_ids[pos]);
+      if (heap.size() < k) {
+        heap.push(entry);
+      } else if (heap.top() < entry) {
+        heap.pop();
+        heap.push(entry);
+      }
+    }
+  }
+
+  results.resize(heap.size());
+  for (size_t i = heap.size(); i > 0; --i) {
+    results[i - 1] = make_pair(-heap.top().second, heap.top().first);
+    heap.pop();
+  }
+  return results;
+}
@@ -0,0 +1,73 @@
+#ifndef ATHENA__MIPS_H
+#define ATHENA__MIPS_H
+
+
+#include "_core.h"
+#include "_math.h"
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+
+#define DEFAULT_MIPS_NUM_NORM_BUCKETS 4
+#define DEFAULT_MIPS_NUM_CLUSTERS 16
+#define DEFAULT_MIPS_NUM_ITERATIONS 8
+#define DEFAULT_MIPS_NUM_PROBES 8
+#define DEFAULT_MIPS_NUM_CANDIDATES 10
+
+
+// Maximum-inner-product search index over word embeddings.  Words are
+// split into buckets of similar norm, and each bucket is clustered by
+// direction (spherical k-means) into inverted lists.  Each list stores
+// a unit centroid, the largest norm of its members, and the widest
+// angle between a member and the centroid, which together give an upper
+// bound on the inner product of a query with any member (the smallest
+// member norm is kept too, for bounds that come out negative).  Queries
+// scan lists in decreasing order of that bound, stopping after
+// num_probes lists or as soon as no unscanned list can beat the current
+// top k (so probing every list returns the exact answer).
+
+class MIPSIndex final {
+  size_t _embedding_dim, _actual_embedding_dim;
+  size_t _num_lists;
+  AlignedVector _centroids;
+  std::vector<float> _max_norms;
+  std::vector<float> _min_norms;
+  std::vector<float> _cone_angles;
+  std::vector<size_t> _list_offsets;
+  std::vector<long> _word_ids;
+  AlignedVector _embeddings;
+
+  public:
+    // build index over word embeddings 0, ..., vocab_size - 1
+    MIPSIndex(const WordContextFactorization& factorization,
+              size_t vocab_size,
+              size_t num_norm_buckets = DEFAULT_MIPS_NUM_NORM_BUCKETS,
+              size_t num_clusters = DEFAULT_MIPS_NUM_CLUSTERS,
+              size_t num_iterations = DEFAULT_MIPS_NUM_ITERATIONS);
+    // return (up to) k (word index, inner product) pairs with largest
+    // inner product against query, in descending order, scanning at
+    // most num_probes inverted lists
+    std::vector<std::pair<long,float> > search(const float *query,
+                                               size_t k,
+                                               size_t num_probes) const;
+    // return number of inverted lists
+    size_t num_lists() const { return _num_lists; }
+    // return number of indexed words
+    size_t size() const { return _word_ids.size(); }
+
+    MIPSIndex(MIPSIndex&& other) = default;
+    MIPSIndex(const MIPSIndex& other) = default;
+
+  private:
+    const float* _centroid(size_t list_idx) const {
+      return _centroids.data() + list_idx * _actual_embedding_dim;
+    }
+    const float* _embedding(size_t pos) const {
+      return _embeddings.data() + pos * _actual_embedding_dim;
+    }
+};
+
+
+#endif
@@ -0,0 +1,131 @@
+#include "_random.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+
+using namespace std;
+
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+
+// Apply the rounds to PHILOX_BATCH_SIZE counters at once (in lockstep,
+// so that the inner loop vectorizes).
+static void philox_batch_rounds(uint32_t *__restrict__ c0,
+                                uint32_t *__restrict__ c1,
+                                uint32_t *__restrict__ c2,
+                                uint32_t *__restrict__ c3,
+                                uint32_t k0, uint32_t k1) {
+  for (size_t r = 0; r < PHILOX_ROUNDS; ++r) {
+    for (size_t j = 0; j < PHILOX_BATCH_SIZE; ++j) {
+      const uint64_t p0 = (uint64_t) PHILOX_M0 * c0[j],
+        p1 = (uint64_t) PHILOX_M1 * c2[j];
+      const uint32_t x0 = (uint32_t) (p1 >> 32) ^ c1[j] ^ k0,
+        x2 = (uint32_t) (p0 >> 32) ^ c3[j] ^ k1;
+      c0[j] = x0;
+      c1[j] = (uint32_t) p1;
+      c2[j] = x2;
+      c3[j] = (uint32_t) p0;
+    }
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+}
+
+// Compute num_blocks blocks for counters {first_block + j, 0, 0} and
+// write them (four outputs each) to out.
+static void philox_blocks(const uint32_t key[2], uint64_t first_block,
+                          size_t num_blocks, uint32_t *out) {
+  for (size_t start = 0; start < num_blocks; start += PHILOX_BATCH_SIZE) {
+    const size_t batch_size = min((size_t) PHILOX_BATCH_SIZE,
+                                  num_blocks - start);
+    uint32_t c0[PHILOX_BATCH_SIZE], c1[PHILOX_BATCH_SIZE],
+      c2[PHILOX_BATCH_SIZE], c3[PHILOX_BATCH_SIZE];
+    for (size_t j = 0; j < PHILOX_BATCH_SIZE; ++j) {
+      const uint64_t counter = first_block + start + j;
+      c0[j] = (uint32_t) counter;
+      c1[j] = (uint32_t) (counter >> 32);
+      c2[j] = 0;
+      c3[j] = 0;
+    }
+    philox_batch_rounds(c0, c1, c2, c3, key[0], key[1]);
+    for (size_t j = 0; j < batch_size; ++j) {
+      uint32_t *block_out = out + 4 * (start + j);
+      block_out[0] = c0[j];
+      block_out[1] = c1[j];
+      block_out[2] = c2[j];
+      block_out[3] = c3[j];
+    }
+  }
+}
+
+
+//
+// Philox4x32
+//
+
+
+void Philox4x32::seed(uint64_t s) {
+  _key[0] = (uint32_t) s;
+  _key[1] = (uint32_t) (s >> 32);
+  _counter = 0;
+  _buffer_pos = PHILOX_BUFFER_SIZE;
+}
+
+void Philox4x32::_refill() {
+  philox_blocks(_key, _counter, PHILOX_BATCH_SIZE, _buffer);
+  _counter += PHILOX_BATCH_SIZE;
+  _buffer_pos = 0;
+}
+
+void Philox4x32::fill(uint32_t *out, size_t n) {
+  size_t i = 0;
+  for (; i < n && _buffer_pos < PHILOX_BUFFER_SIZE; ++i) {
+    out[i] = _buffer[_buffer_pos++];
+  }
+  const size_t num_blocks = (n - i) / 4;
+  philox_blocks(_key, _counter, num_blocks, out + i);
+  _counter += num_blocks;
+  i += 4 * num_blocks;
+  for (; i < n; ++i) {
+    out[i] = (*this)();
+  }
+}
+
+void Philox4x32::fill_unit_float(float *out, size_t n) {
+  uint32_t bits[PHILOX_BUFFER_SIZE];
+  for (size_t start = 0; start < n; start += PHILOX_BUFFER_SIZE) {
+    const size_t batch_size = std::min((size_t) PHILOX_BUFFER_SIZE,
+                                       n - start);
+    fill(bits, batch_size);
+    for (size_t j = 0; j < batch_size; ++j) {
+      out[start + j] = unit_float(bits[j]);
+    }
+  }
+}
+
+void Philox4x32::block(const uint32_t counter[4], const uint32_t key[2],
+                       uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2],
+    c3 = counter[3], k0 = key[0], k1 = key[1];
+  for (size_t r = 0; r < PHILOX_ROUNDS; ++r) {
+    const uint64_t p0 = (uint64_t) PHILOX_M0 * c0,
+      p1 = (uint64_t) PHILOX_M1 * c2;
+    c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t) p1;
+    c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t) p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
@@ -0,0 +1,78 @@
+#ifndef ATHENA__RANDOM_H
+#define ATHENA__RANDOM_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+// blocks (of four outputs) generated together; the rounds run across
+// a batch in lockstep, which the compiler vectorizes
+#define PHILOX_BATCH_SIZE 16
+#define PHILOX_BUFFER_SIZE (4 * PHILOX_BATCH_SIZE)
+
+
+// Return integer in [0, n) from 32 uniformly random bits, by
+// multiplication and shift instead of division (bias is at most
+// n / 2^32).
+inline uint32_t bounded_uint32(uint32_t x, uint32_t n) {
+  return (uint32_t) (((uint64_t) x * n) >> 32);
+}
+
+// Return integer in [0, n) from 64 uniformly random bits (as
+// bounded_uint32).
+inline uint64_t bounded_uint64(uint64_t x, uint64_t n) {
+  __extension__ typedef unsigned __int128 uint128_t;
+  return (uint64_t) (((uint128_t) x * n) >> 64);
+}
+
+// Return float in [0, 1) from 32 uniformly random bits (the top 24,
+// so every value is exactly representable).
+inline float unit_float(uint32_t x) {
+  return (x >> 8) * (1.f / 16777216);
+}
+
+
+// Philox4x32-10 counter-based random number engine (Salmon et al.,
+// 2011).  The n-th block of four outputs is a keyed bijection of n, so
+// blocks are independent of each other and can be generated in bulk.
+// Satisfies the standard uniform random bit generator requirements.
+
+class Philox4x32 final {
+  uint32_t _key[2];
+  // index of next block to generate
+  uint64_t _counter;
+  // outputs of one batch of blocks
+  uint32_t _buffer[PHILOX_BUFFER_SIZE];
+  // index of next output in buffer (PHILOX_BUFFER_SIZE if empty)
+  unsigned int _buffer_pos;
+
+  public:
+    typedef uint32_t result_type;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    explicit Philox4x32(uint64_t s = 0) { seed(s); }
+    void seed(uint64_t s);
+    result_type operator()() {
+      if (_buffer_pos == PHILOX_BUFFER_SIZE) {
+        _refill();
+      }
+      return _buffer[_buffer_pos++];
+    }
+    // write next n outputs to out (the same outputs n calls to
+    // operator() would return)
+    void fill(uint32_t *out, size_t n);
+    // write unit_float of next n outputs to out
+    void fill_unit_float(float *out, size_t n);
+
+    // compute one block: ten rounds on counter under key
+    static void block(const uint32_t counter[4], const uint32_t key[2],
+                      uint32_t out[4]);
+
+  private:
+    void _refill();
+};
+
+
+#endif
@@ -2,6 +2,8 @@
 #define ATHENA__SERIALIZATION_H
 
 
+#include "_trace.h"
+
 #include <vector>
 #include <unordered_map>
 #include <map>
@@ -214,6 +216,7 @@ class FileSerializer final {
     FileSerializer(const std::string& path): _path(path) { }
 
     void dump(const T& obj) const {
+      TRACE_SCOPE("serialize");
       std::ofstream output_file;
       output_file.open(_path.c_str());
       if (output_file) {
@@ -227,6 +230,7 @@ class FileSerializer final {
     }
 
     T load() const {
+      TRACE_SCOPE("deserialize");
       std::ifstream input_file;
       input_file.open(_path.c_str());
       if (input_file) {
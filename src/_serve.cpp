@@ -0,0 +1,359 @@
+#include "_serve.h"
+#include "_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+using namespace std;
+
+
+bool read_fully(int fd, void *buf, size_t n) {
+  char *p = static_cast<char*>(buf);
+  while (n > 0) {
+    const ssize_t r = recv(fd, p, n, 0);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+bool write_fully(int fd, const void *buf, size_t n) {
+  const char *p = static_cast<const char*>(buf);
+  while (n > 0) {
+    const ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+// Wait until fd is ready for events (return false on error or once
+// deadline has passed).
+static bool wait_until_ready(int fd, short events,
+                             chrono::steady_clock::time_point deadline) {
+  while (true) {
+    const auto remaining = chrono::duration_cast<chrono::milliseconds>(
+      deadline - chrono::steady_clock::now()).count();
+    if (remaining <= 0) {
+      return false;
+    }
+    pollfd p;
+    p.fd = fd;
+    p.events = events;
+    p.revents = 0;
+    const int r = poll(&p, 1, (int) min<long long>(remaining, 1000));
+    if (r < 0 && errno != EINTR) {
+      return false;
+    }
+    if (r > 0) {
+      return true;
+    }
+  }
+}
+
+bool read_fully(int fd, void *buf, size_t n,
+                chrono::steady_clock::time_point deadline) {
+  char *p = static_cast<char*>(buf);
+  while (n > 0) {
+    if (! wait_until_ready(fd, POLLIN, deadline)) {
+      return false;
+    }
+    const ssize_t r = recv(fd, p, n, MSG_DONTWAIT);
+    if (r < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+bool write_fully(int fd, const void *buf, size_t n,
+                 chrono::steady_clock::time_point deadline) {
+  const char *p = static_cast<const char*>(buf);
+  while (n > 0) {
+    if (! wait_until_ready(fd, POLLOUT, deadline)) {
+      return false;
+    }
+    const ssize_t r = send(fd, p, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (r < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+      continue;
+    }
+    if (r <= 0) {
+      return false;
+    }
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+
+//
+// QueryServer
+//
+
+
+QueryServer::QueryServer(const string& socket_path,
+                         QueryHandler handler,
+                         size_t num_workers):
+    _socket_path(socket_path),
+    _num_workers(num_workers == 0 ? 1 : num_workers),
+    _handler(handler),
+    _listen_fd(-1),
+    _stopping(false) {
+  if (pipe(_wake_fds) != 0) {
+    throw runtime_error(string("QueryServer::QueryServer: pipe failed: ") +
+                        strerror(errno));
+  }
+  for (size_t i = 0; i < 2; ++i) {
+    fcntl(_wake_fds[i], F_SETFL, fcntl(_wake_fds[i], F_GETFL) | O_NONBLOCK);
+  }
+}
+
+void QueryServer::listen() {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  if (_socket_path.size() >= sizeof(addr.sun_path)) {
+    throw runtime_error(string("QueryServer::listen: socket path too long: ") +
+                        _socket_path);
+  }
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, _socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (_listen_fd < 0) {
+    throw runtime_error(string("QueryServer::listen: socket failed: ") +
+                        strerror(errno));
+  }
+  unlink(_socket_path.c_str());
+  if (::bind(_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(_listen_fd, SOMAXCONN) != 0) {
+    const string reason(strerror(errno));
+    close(_listen_fd);
+    _listen_fd = -1;
+    throw runtime_error(string("QueryServer::listen: cannot bind ") +
+                        _socket_path + ": " + reason);
+  }
+  info(__func__, "listening on " << _socket_path << "\n");
+}
+
+void QueryServer::stop() {
+  _stopping = true;
+  const char c = 0;
+  // write is async-signal-safe; a full pipe already means a wakeup
+  // is pending
+  if (write(_wake_fds[1], &c, 1) < 0) { }
+}
+
+bool QueryServer::_serve_request(int fd, MessageWriter& response) {
+  // one deadline covers the whole exchange, so a client that trickles
+  // its request or stops reading its response cannot hold the worker
+  const auto deadline = chrono::steady_clock::now() +
+    chrono::seconds(QUERY_REQUEST_TIMEOUT);
+  uint32_t header[2];
+  if (! read_fully(fd, header, sizeof(header), deadline)) {
+    return false;
+  }
+  const uint32_t op = header[0], size = header[1];
+  if (size > QUERY_MAX_PAYLOAD_SIZE) {
+    warning(__func__, "request payload too large: " << size << "\n");
+    return false;
+  }
+  string payload(size, '\0');
+  if (size > 0 && ! read_fully(fd, &payload[0], size, deadline)) {
+    return false;
+  }
+
+  response.clear();
+  MessageReader request(payload);
+  uint32_t status;
+  try {
+    status = _handler(op, request, response);
+    if (status == QUERY_STATUS_OK && ! request.done()) {
+      status = QUERY_STATUS_BAD_REQUEST;
+    }
+  } catch (const exception& ex) {
+    // (truncated payloads raise runtime_error; anything else, e.g.
+    // bad_alloc, is still answered rather than killing the worker)
+    status = (dynamic_cast<const runtime_error*>(&ex) != 0) ?
+      QUERY_STATUS_BAD_REQUEST : QUERY_STATUS_ERROR;
+  }
+  if (status != QUERY_STATUS_OK) {
+    response.clear();
+  }
+
+  const uint32_t response_header[2] = {
+    status, (uint32_t) response.str().size()
+  };
+  return write_fully(fd, response_header, sizeof(response_header),
+                     deadline) &&
+    write_fully(fd, response.str().data(), response.str().size(), deadline);
+}
+
+void QueryServer::run() {
+  if (_listen_fd < 0) {
+    listen();
+  }
+
+  // connections with a pending request, and connections handed back
+  // by workers after answering it
+  mutex queue_mutex;
+  condition_variable queue_cv;
+  deque<int> ready_fds, returned_fds;
+  bool shutting_down = false;
+
+  vector<thread> workers;
+  for (size_t i = 0; i < _num_workers; ++i) {
+    workers.push_back(thread([&]() {
+      MessageWriter response;
+      while (true) {
+        int fd;
+        {
+          unique_lock<mutex> lock(queue_mutex);
+          queue_cv.wait(lock, [&]() {
+            return shutting_down || ! ready_fds.empty();
+          });
+          if (ready_fds.empty()) {
+            return;
+          }
+          fd = ready_fds.front();
+          ready_fds.pop_front();
+        }
+        if (_serve_request(fd, response)) {
+          {
+            lock_guard<mutex> lock(queue_mutex);
+            returned_fds.push_back(fd);
+          }
+          const char c = 0;
+          if (write(_wake_fds[1], &c, 1) < 0) { }
+        } else {
+          close(fd);
+        }
+      }
+    }));
+  }
+
+  // poll set: wake pipe, listening socket, then idle connections
+  vector<pollfd> fds(2);
+  fds[0].fd = _wake_fds[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = _listen_fd;
+  fds[1].events = POLLIN;
+
+  while (! _stopping) {
+    for (auto it = fds.begin(); it != fds.end(); ++it) {
+      it->revents = 0;
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw runtime_error(string("QueryServer::run: poll failed: ") +
+                          strerror(errno));
+    }
+
+    vector<int> dispatch_fds;
+    size_t num_idle = fds.size();
+    for (size_t i = 2; i < num_idle; ) {
+      if (fds[i].revents & POLLIN) {
+        dispatch_fds.push_back(fds[i].fd);
+        fds[i] = fds[--num_idle];
+      } else if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+        close(fds[i].fd);
+        fds[i] = fds[--num_idle];
+      } else {
+        ++i;
+      }
+    }
+    fds.resize(num_idle);
+
+    if (fds[1].revents & POLLIN) {
+      const int fd = accept(_listen_fd, 0, 0);
+      if (fd >= 0) {
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        fds.push_back(p);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char buf[64];
+      while (read(_wake_fds[0], buf, sizeof(buf)) > 0) { }
+    }
+
+    {
+      lock_guard<mutex> lock(queue_mutex);
+      for (auto it = returned_fds.begin(); it != returned_fds.end(); ++it) {
+        pollfd p;
+        p.fd = *it;
+        p.events = POLLIN;
+        p.revents = 0;
+        fds.push_back(p);
+      }
+      returned_fds.clear();
+      ready_fds.insert(ready_fds.end(), dispatch_fds.begin(), dispatch_fds.end());
+    }
+    if (! dispatch_fds.empty()) {
+      queue_cv.notify_all();
+    }
+  }
+
+  // finish in-flight requests, then close everything
+  {
+    lock_guard<mutex> lock(queue_mutex);
+    shutting_down = true;
+  }
+  queue_cv.notify_all();
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    it->join();
+  }
+  for (auto it = returned_fds.begin(); it != returned_fds.end(); ++it) {
+    close(*it);
+  }
+  for (size_t i = 2; i < fds.size(); ++i) {
+    close(fds[i].fd);
+  }
+  info(__func__, "stopped\n");
+}
+
+QueryServer::~QueryServer() {
+  if (_listen_fd >= 0) {
+    close(_listen_fd);
+    unlink(_socket_path.c_str());
+  }
+  close(_wake_fds[0]);
+  close(_wake_fds[1]);
+}
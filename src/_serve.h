@@ -0,0 +1,464 @@
+#ifndef ATHENA__SERVE_H
+#define ATHENA__SERVE_H
+
+
+#include "_core.h"
+#include "_math.h"
+#include "_mips.h"
+#include "_sgns.h"
+#include "_cblas.h"
+#include "_snapshot.h"
+
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+
+// Query protocol.  Every request is a frame
+//
+//   uint32 op, uint32 payload size, payload
+//
+// and is answered by a frame
+//
+//   uint32 status, uint32 payload size, payload
+//
+// with integers and floats in host byte order (the socket is local) and
+// strings written as a uint32 size followed by that many bytes.
+//
+//   op          request payload              response payload
+//   similarity  word, word                   float cosine similarity
+//   neighbors   word, uint32 k               uint32 n, n x (word, float)
+//   vector      word                         uint32 dim, dim x float
+//   context     uint32 left, uint32 right,   word, float score
+//               (left + right) x word
+//
+// Out-of-vocabulary query words yield QUERY_STATUS_UNKNOWN_WORD with an
+// empty payload (out-of-vocabulary context words are skipped).  A
+// server that has no model to query yet answers QUERY_STATUS_UNAVAILABLE,
+// and a request the server fails to answer QUERY_STATUS_ERROR.
+
+#define QUERY_OP_SIMILARITY 1
+#define QUERY_OP_NEIGHBORS 2
+#define QUERY_OP_VECTOR 3
+#define QUERY_OP_CONTEXT 4
+
+#define QUERY_STATUS_OK 0
+#define QUERY_STATUS_UNKNOWN_WORD 1
+#define QUERY_STATUS_BAD_REQUEST 2
+#define QUERY_STATUS_UNAVAILABLE 3
+#define QUERY_STATUS_ERROR 4
+
+#define QUERY_MAX_PAYLOAD_SIZE (1 << 24)
+#define QUERY_MAX_NEIGHBORS 10000
+#define QUERY_MAX_CONTEXT 1000
+
+#define DEFAULT_QUERY_NUM_WORKERS 4
+// seconds a worker may spend reading a request and writing its
+// response (in total) before it drops the connection
+#define QUERY_REQUEST_TIMEOUT 5
+
+
+// Serialize protocol values into a payload.
+
+class MessageWriter final {
+  std::string _buffer;
+
+  public:
+    MessageWriter(): _buffer() { }
+    void put_uint32(uint32_t x) {
+      _buffer.append(reinterpret_cast<const char*>(&x), sizeof(x));
+    }
+    void put_float(float x) {
+      _buffer.append(reinterpret_cast<const char*>(&x), sizeof(x));
+    }
+    void put_string(const std::string& s) {
+      put_uint32(s.size());
+      _buffer.append(s);
+    }
+    const std::string& str() const { return _buffer; }
+    void clear() { _buffer.clear(); }
+};
+
+
+// Deserialize protocol values from a payload (raise exception on
+// truncated input).
+
+class MessageReader final {
+  const char *_data;
+  size_t _size, _pos;
+
+  public:
+    MessageReader(const char *data, size_t size):
+      _data(data), _size(size), _pos(0) { }
+    MessageReader(const std::string& payload):
+      _data(payload.data()), _size(payload.size()), _pos(0) { }
+    uint32_t get_uint32() {
+      uint32_t x;
+      _read(&x, sizeof(x));
+      return x;
+    }
+    float get_float() {
+      float x;
+      _read(&x, sizeof(x));
+      return x;
+    }
+    std::string get_string() {
+      const uint32_t size = get_uint32();
+      if (size > _size - _pos) {
+        throw std::runtime_error(
+          std::string("MessageReader::get_string: truncated message"));
+      }
+      std::string s(_data + _pos, size);
+      _pos += size;
+      return s;
+    }
+    bool done() const { return _pos == _size; }
+
+  private:
+    void _read(void *x, size_t n) {
+      if (n > _size - _pos) {
+        throw std::runtime_error(
+          std::string("MessageReader::_read: truncated message"));
+      }
+      memcpy(x, _data + _pos, n);
+      _pos += n;
+    }
+};
+
+
+// Handler signature: read request payload for op, write response
+// payload, and return status.
+
+typedef std::function<uint32_t (uint32_t op, MessageReader& request,
+                                MessageWriter& response)> QueryHandler;
+
+
+// Answers protocol requests against a word-context factorization and
+// the language model that indexes it.  Holds references to both, which
+// must outlive the handler and must not change while it is in use;
+// handle is safe to call concurrently.
+
+template <class LanguageModel>
+class EmbeddingQueryHandler final {
+  const WordContextFactorization& _factorization;
+  const LanguageModel& _language_model;
+  size_t _vocab_dim, _embedding_dim;
+  AlignedVector _normalized_embeddings;
+  MIPSIndex _index;
+  size_t _num_candidates, _num_probes;
+
+  public:
+    EmbeddingQueryHandler(const WordContextFactorization& factorization,
+                          const LanguageModel& language_model,
+                          size_t num_candidates = DEFAULT_MIPS_NUM_CANDIDATES,
+                          size_t num_probes = DEFAULT_MIPS_NUM_PROBES);
+    uint32_t handle(uint32_t op, MessageReader& request,
+                    MessageWriter& response) const;
+    // return up to k (word index, cosine similarity) pairs closest to
+    // word_idx (excluding word_idx itself), in descending order
+    std::vector<std::pair<long,float> > neighbors(long word_idx,
+                                                  size_t k) const;
+    float similarity(long word1_idx, long word2_idx) const;
+
+    EmbeddingQueryHandler(EmbeddingQueryHandler&& other) = default;
+
+  private:
+    long _lookup(const std::string& word) const {
+      const long word_idx = _language_model.lookup(word);
+      return (word_idx >= 0 && (size_t) word_idx < _vocab_dim) ? word_idx : -1;
+    }
+    const float* _normalized(long word_idx) const {
+      return _normalized_embeddings.data() +
+        word_idx * INCREASE_TO_MULTIPLE(_embedding_dim, VECTOR_ALIGNMENT);
+    }
+};
+
+
+// Answers protocol requests against the latest snapshot published by
+// a SnapshotPublisher.  An EmbeddingQueryHandler (and its index) is
+// built, outside the lock, by the first request that sees a new
+// snapshot; meanwhile other requests are answered from the previous
+// snapshot, and requests already in progress finish against the
+// snapshot they started with.  handle is safe to call concurrently.
+
+template <class LanguageModel>
+class SnapshotQueryHandler final {
+  struct Entry {
+    std::shared_ptr<const ModelSnapshot<LanguageModel> > snapshot;
+    EmbeddingQueryHandler<LanguageModel> handler;
+
+    Entry(std::shared_ptr<const ModelSnapshot<LanguageModel> > snapshot_,
+          size_t num_candidates, size_t num_probes):
+        snapshot(snapshot_),
+        handler(snapshot->factorization, snapshot->language_model,
+                num_candidates, num_probes) { }
+  };
+
+  const SnapshotPublisher<LanguageModel>& _publisher;
+  size_t _num_candidates, _num_probes;
+  std::shared_ptr<const Entry> _entry;
+  // version of the newest entry being built (-1 if none)
+  long _building_version;
+  std::mutex _entry_mutex;
+
+  public:
+    SnapshotQueryHandler(const SnapshotPublisher<LanguageModel>& publisher,
+                         size_t num_candidates = DEFAULT_MIPS_NUM_CANDIDATES,
+                         size_t num_probes = DEFAULT_MIPS_NUM_PROBES):
+      _publisher(publisher),
+      _num_candidates(num_candidates),
+      _num_probes(num_probes),
+      _entry(),
+      _building_version(-1),
+      _entry_mutex() { }
+    uint32_t handle(uint32_t op, MessageReader& request,
+                    MessageWriter& response) {
+      std::shared_ptr<const ModelSnapshot<LanguageModel> > snapshot(
+        _publisher.latest());
+      if (! snapshot) {
+        return QUERY_STATUS_UNAVAILABLE;
+      }
+      std::shared_ptr<const Entry> entry;
+      bool build = false;
+      {
+        std::lock_guard<std::mutex> lock(_entry_mutex);
+        entry = _entry;
+        // build unless another request is building this snapshot (or a
+        // newer one) and there is a previous entry to answer from
+        if ((! entry || entry->snapshot->version < snapshot->version) &&
+            (! entry || _building_version < (long) snapshot->version)) {
+          _building_version = std::max(_building_version,
+                                       (long) snapshot->version);
+          build = true;
+        }
+      }
+      if (build) {
+        std::shared_ptr<const Entry> built;
+        try {
+          built = std::make_shared<const Entry>(snapshot, _num_candidates,
+                                                _num_probes);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(_entry_mutex);
+          if (_building_version == (long) snapshot->version) {
+            _building_version = -1;
+          }
+          throw;
+        }
+        std::lock_guard<std::mutex> lock(_entry_mutex);
+        if (! _entry || _entry->snapshot->version < snapshot->version) {
+          _entry = built;
+        }
+        entry = _entry;
+      }
+      return entry->handler.handle(op, request, response);
+    }
+    // return version of snapshot last queried (-1 if none)
+    long version() {
+      std::lock_guard<std::mutex> lock(_entry_mutex);
+      return _entry ? (long) _entry->snapshot->version : -1;
+    }
+
+  private:
+    SnapshotQueryHandler(const SnapshotQueryHandler& other);
+};
+
+
+// Serve requests over a Unix domain socket.  One thread runs a poll
+// loop that accepts connections and waits for requests on idle
+// connections; a connection with a pending request is handed to one
+// of num_workers worker threads, which reads the request, calls the
+// handler, writes the response, and hands the connection back.
+// Requests on one connection are answered in order, requests on
+// different connections concurrently.
+
+class QueryServer final {
+  std::string _socket_path;
+  size_t _num_workers;
+  QueryHandler _handler;
+  int _listen_fd;
+  int _wake_fds[2];
+  std::atomic<bool> _stopping;
+
+  public:
+    QueryServer(const std::string& socket_path,
+                QueryHandler handler,
+                size_t num_workers = DEFAULT_QUERY_NUM_WORKERS);
+    // bind socket (raise exception on failure)
+    void listen();
+    // serve until stop is called
+    void run();
+    // ask run to return (safe to call from a signal handler)
+    void stop();
+    ~QueryServer();
+
+  private:
+    QueryServer(const QueryServer& other);
+    bool _serve_request(int fd, MessageWriter& response);
+};
+
+
+// Read exactly n bytes (return false on EOF or error).
+bool read_fully(int fd, void *buf, size_t n);
+
+// Write exactly n bytes (return false on error).
+bool write_fully(int fd, const void *buf, size_t n);
+
+// As above, but also return false once deadline has passed.
+bool read_fully(int fd, void *buf, size_t n,
+                std::chrono::steady_clock::time_point deadline);
+bool write_fully(int fd, const void *buf, size_t n,
+                 std::chrono::steady_clock::time_point deadline);
+
+
+//
+// EmbeddingQueryHandler
+//
+
+
+template <class LanguageModel>
+EmbeddingQueryHandler<LanguageModel>::EmbeddingQueryHandler(
+    const WordContextFactorization& factorization,
+    const LanguageModel& language_model,
+    size_t num_candidates,
+    size_t num_probes):
+  _factorization(factorization),
+  _language_model(language_model),
+  _vocab_dim(std::min(language_model.size(), factorization.get_vocab_dim())),
+  _embedding_dim(factorization.get_embedding_dim()),
+  _normalized_embeddings(
+    _vocab_dim *
+      INCREASE_TO_MULTIPLE(factorization.get_embedding_dim(), VECTOR_ALIGNMENT)),
+  _index(factorization, _vocab_dim),
+  _num_candidates(num_candidates),
+  _num_probes(num_probes) {
+  // initialize fast_sigmoid grid before any concurrent use
+  fast_sigmoid(0);
+  for (size_t i = 0; i < _vocab_dim; ++i) {
+    float *x = const_cast<float*>(_normalized(i));
+    memcpy(x, factorization.get_word_embedding(i),
+           _embedding_dim * sizeof(float));
+    const float norm = cblas_snrm2(_embedding_dim, x, 1);
+    if (norm > 0) {
+      cblas_sscal(_embedding_dim, 1. / norm, x, 1);
+    }
+  }
+}
+
+template <class LanguageModel>
+float EmbeddingQueryHandler<LanguageModel>::similarity(long word1_idx,
+                                                       long word2_idx) const {
+  return cblas_sdot(_embedding_dim,
+                    _normalized(word1_idx), 1,
+                    _normalized(word2_idx), 1);
+}
+
+template <class LanguageModel>
+std::vector<std::pair<long,float> >
+    EmbeddingQueryHandler<LanguageModel>::neighbors(long word_idx,
+                                                    size_t k) const {
+  std::vector<std::pair<long,float> > scores;
+  scores.reserve(_vocab_dim);
+  for (size_t i = 0; i < _vocab_dim; ++i) {
+    if ((long) i != word_idx) {
+      scores.push_back(std::make_pair((long) i, similarity(i, word_idx)));
+    }
+  }
+  k = std::min(k, scores.size());
+  auto cmp = [](const std::pair<long,float>& x,
+                const std::pair<long,float>& y) {
+    return x.second > y.second || (x.second == y.second && x.first < y.first);
+  };
+  std::partial_sort(scores.begin(), scores.begin() + k, scores.end(), cmp);
+  scores.resize(k);
+  return scores;
+}
+
+template <class LanguageModel>
+uint32_t EmbeddingQueryHandler<LanguageModel>::handle(
+    uint32_t op, MessageReader& request, MessageWriter& response) const {
+  switch (op) {
+    case QUERY_OP_SIMILARITY: {
+      const long word1_idx = _lookup(request.get_string());
+      const long word2_idx = _lookup(request.get_string());
+      if (word1_idx < 0 || word2_idx < 0) {
+        return QUERY_STATUS_UNKNOWN_WORD;
+      }
+      response.put_float(similarity(word1_idx, word2_idx));
+      return QUERY_STATUS_OK;
+    }
+
+    case QUERY_OP_NEIGHBORS: {
+      const long word_idx = _lookup(request.get_string());
+      const uint32_t k = request.get_uint32();
+      if (k > QUERY_MAX_NEIGHBORS) {
+        return QUERY_STATUS_BAD_REQUEST;
+      }
+      if (word_idx < 0) {
+        return QUERY_STATUS_UNKNOWN_WORD;
+      }
+      auto results(neighbors(word_idx, k));
+      response.put_uint32(results.size());
+      for (auto it = results.begin(); it != results.end(); ++it) {
+        response.put_string(_language_model.reverse_lookup(it->first));
+        response.put_float(it->second);
+      }
+      return QUERY_STATUS_OK;
+    }
+
+    case QUERY_OP_VECTOR: {
+      const long word_idx = _lookup(request.get_string());
+      if (word_idx < 0) {
+        return QUERY_STATUS_UNKNOWN_WORD;
+      }
+      response.put_uint32(_embedding_dim);
+      const float *x = _factorization.get_word_embedding(word_idx);
+      for (size_t j = 0; j < _embedding_dim; ++j) {
+        response.put_float(x[j]);
+      }
+      return QUERY_STATUS_OK;
+    }
+
+    case QUERY_OP_CONTEXT: {
+      const uint32_t left_context = request.get_uint32();
+      const uint32_t right_context = request.get_uint32();
+      // (checked separately so the sum cannot wrap)
+      if (left_context > QUERY_MAX_CONTEXT ||
+          right_context > QUERY_MAX_CONTEXT - left_context) {
+        return QUERY_STATUS_BAD_REQUEST;
+      }
+      std::vector<long> word_ids(left_context + 1 + right_context, -1);
+      for (size_t i = 0; i < word_ids.size(); ++i) {
+        if (i != left_context) {
+          word_ids[i] = _lookup(request.get_string());
+        }
+      }
+      const long word_idx = find_context_nearest_neighbor_idx(
+        _factorization, left_context, right_context, word_ids.data(),
+        _index, _num_candidates, _num_probes);
+      if (word_idx < 0) {
+        return QUERY_STATUS_UNKNOWN_WORD;
+      }
+      response.put_string(_language_model.reverse_lookup(word_idx));
+      response.put_float(context_score(_factorization, word_idx,
+                                       left_context, right_context,
+                                       word_ids.data()));
+      return QUERY_STATUS_OK;
+    }
+
+    default:
+      return QUERY_STATUS_BAD_REQUEST;
+  }
+}
+
+
+#endif
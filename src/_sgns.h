@@ -6,7 +6,9 @@
 #include "_cblas.h"
 #include "_log.h"
 #include "_math.h"
+#include "_mips.h"
 #include "_serialization.h"
+#include "_trace.h"
 
 #include <fstream>
 #include <cstring>
@@ -16,6 +18,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <algorithm>
 
 
 // Core SGNS implementation.  At training time takes a single input-output
@@ -54,9 +57,31 @@ class SGNSTokenLearner final {
     long find_context_nearest_neighbor_idx(size_t left_context,
                                            size_t right_context,
                                            const long *word_ids);
+    // approximate find_context_nearest_neighbor_idx: take the
+    // num_candidates words whose embeddings have the largest inner
+    // product with the sum of the context embeddings (searching
+    // num_probes lists of index) and return the best of those under the
+    // exact score
+    long find_context_nearest_neighbor_idx(size_t left_context,
+                                           size_t right_context,
+                                           const long *word_ids,
+                                           const MIPSIndex& index,
+                                           size_t num_candidates =
+                                             DEFAULT_MIPS_NUM_CANDIDATES,
+                                           size_t num_probes =
+                                             DEFAULT_MIPS_NUM_PROBES);
     bool context_contains_oov(const long* ctx_word_ids, size_t ctx_size) const;
     ~SGNSTokenLearner() { }
 
+    MemoryUsage memory_usage() const {
+      MemoryUsage usage;
+      usage.add("factorization", factorization.memory_usage());
+      usage.add("neg_sampling_strategy", neg_sampling_strategy.memory_usage());
+      usage.add("language_model", language_model.memory_usage());
+      usage.add("sgd", sgd.memory_usage());
+      return usage;
+    }
+
     bool equals(const SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>& other) const;
     void serialize(std::ostream& stream) const;
     static SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType> deserialize(std::istream& stream);
@@ -87,9 +112,13 @@ class SGNSSentenceLearner final {
       token_learner(std::move(token_learner_)),
       ctx_strategy(std::move(ctx_strategy_)),
       neg_samples(neg_samples_) { }
-    void sentence_train(const std::vector<long>& word_ids);
+    // train on all contexts in sentence, return number of
+    // (input, output) word pairs trained on
+    size_t sentence_train(const std::vector<long>& word_ids);
     ~SGNSSentenceLearner() { }
 
+    MemoryUsage memory_usage() const { return token_learner.memory_usage(); }
+
     bool equals(const SGNSSentenceLearner<SGNSTokenLearnerType,ContextStrategy>& other) const;
     void serialize(std::ostream& stream) const;
     static SGNSSentenceLearner<SGNSTokenLearnerType,ContextStrategy>
@@ -100,6 +129,85 @@ class SGNSSentenceLearner final {
 };
 
 
+//
+// context prediction
+//
+
+
+// Return score of candidate input word against the context word_ids
+// (left_context words, a placeholder, then right_context words; negative
+// ids are out of vocabulary and skipped).
+inline float context_score(const WordContextFactorization& factorization,
+                           size_t candidate_word_idx,
+                           size_t left_context,
+                           size_t right_context,
+                           const long *word_ids) {
+  // should we try to take a MAP estimate here?
+  float log_prob_ctx_given_candidate = 0;
+  for (size_t i = 0; i < left_context + 1 + right_context; ++i) {
+    // for all output words...
+    if (i != left_context) {
+      const long output_word_idx = word_ids[i];
+      if (output_word_idx >= 0) {
+        log_prob_ctx_given_candidate += fast_sigmoid(
+          cblas_sdot(
+            factorization.get_embedding_dim(),
+            factorization.get_word_embedding(candidate_word_idx), 1,
+            factorization.get_context_embedding(output_word_idx), 1
+          )
+        );
+      }
+    }
+  }
+  return log_prob_ctx_given_candidate;
+}
+
+// Return the best-scoring of the num_candidates words whose embeddings
+// have the largest inner product with the sum of the context embeddings
+// (searching num_probes lists of index); -1 if there are no candidates.
+inline long find_context_nearest_neighbor_idx(
+    const WordContextFactorization& factorization,
+    size_t left_context,
+    size_t right_context,
+    const long *word_ids,
+    const MIPSIndex& index,
+    size_t num_candidates,
+    size_t num_probes) {
+  // query is the sum of the (in-vocabulary) context embeddings
+  AlignedVector query(factorization.get_embedding_dim());
+  memset(query.data(), 0,
+         sizeof(float) * factorization.get_embedding_dim());
+  for (size_t i = 0; i < left_context + 1 + right_context; ++i) {
+    if (i != left_context && word_ids[i] >= 0) {
+      cblas_saxpy(
+        factorization.get_embedding_dim(),
+        1,
+        factorization.get_context_embedding(word_ids[i]), 1,
+        query.data(), 1
+      );
+    }
+  }
+
+  std::vector<std::pair<long,float> > candidates(
+    index.search(query.data(), num_candidates, num_probes));
+  // rescore in index order so ties resolve as in the exact search
+  std::sort(candidates.begin(), candidates.end());
+
+  long best_candidate_word_idx = -1;
+  float best_score = -std::numeric_limits<float>::max();
+  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+    const float score = context_score(factorization, it->first,
+                                      left_context, right_context, word_ids);
+    if (score > best_score) {
+      best_candidate_word_idx = it->first;
+      best_score = score;
+    }
+  }
+
+  return best_candidate_word_idx;
+}
+
+
 //
 // SGNSTokenLearner
 //
@@ -126,33 +234,30 @@ long SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>::find_context_near
   for (size_t candidate_word_idx = 0;
        candidate_word_idx < language_model.size();
        ++candidate_word_idx) {
-    // should we try to take a MAP estimate here?
-    float log_prob_ctx_given_candidate = 0;
-    for (size_t i = 0; i < left_context + 1 + right_context; ++i) {
-      // for all output words...
-      if (i != left_context) {
-        const long output_word_idx = word_ids[i];
-        if (output_word_idx >= 0) {
-          log_prob_ctx_given_candidate += fast_sigmoid(
-            cblas_sdot(
-              factorization.get_embedding_dim(),
-              factorization.get_word_embedding(candidate_word_idx), 1,
-              factorization.get_context_embedding(output_word_idx), 1
-            )
-          );
-        }
-      }
-    }
-
-    if (log_prob_ctx_given_candidate > best_score) {
+    const float score = context_score(factorization, candidate_word_idx,
+                                      left_context, right_context, word_ids);
+    if (score > best_score) {
       best_candidate_word_idx = (long) candidate_word_idx;
-      best_score = log_prob_ctx_given_candidate;
+      best_score = score;
     }
   }
 
   return best_candidate_word_idx;
 }
 
+template <class LanguageModel, class SamplingStrategy, class SGDType>
+long SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>::find_context_nearest_neighbor_idx(size_t left_context,
+                                                    size_t right_context,
+                                                    const long *word_ids,
+                                                    const MIPSIndex& index,
+                                                    size_t num_candidates,
+                                                    size_t num_probes) {
+  return ::find_context_nearest_neighbor_idx(factorization,
+                                             left_context, right_context,
+                                             word_ids, index,
+                                             num_candidates, num_probes);
+}
+
 template <class LanguageModel, class SamplingStrategy, class SGDType>
 float SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>::compute_similarity(size_t word1_idx,
                                            size_t word2_idx) {
@@ -195,6 +300,7 @@ template <class LanguageModel, class SamplingStrategy, class SGDType>
 float SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>::compute_gradient_coeff(long input_word_idx,
                                            long output_word_idx,
                                            bool negative_sample) {
+  TRACE_SCOPE("gradient");
   return (negative_sample ? 0 : 1) - fast_sigmoid(cblas_sdot(
     factorization.get_embedding_dim(),
     factorization.get_word_embedding(input_word_idx), 1,
@@ -244,8 +350,11 @@ void SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>::token_train(size_
   for (size_t j = 0; j < neg_samples; ++j) {
     // compute contribution of neg-sample word to input word
     // gradient, take neg-sample word gradient step
-    const long neg_sample_word_idx =
-      neg_sampling_strategy.sample_idx(language_model);
+    long neg_sample_word_idx;
+    {
+      TRACE_SCOPE("negative_sampling");
+      neg_sample_word_idx = neg_sampling_strategy.sample_idx(language_model);
+    }
 
     const float coeff = compute_gradient_coeff(input_word_idx,
                                                neg_sample_word_idx, true);
@@ -311,8 +420,10 @@ bool SGNSTokenLearner<LanguageModel,SamplingStrategy,SGDType>::equals(const SGNS
 
 
 template <class SGNSTokenLearnerType, class ContextStrategy>
-void SGNSSentenceLearner<SGNSTokenLearnerType,ContextStrategy>::sentence_train(
+size_t SGNSSentenceLearner<SGNSTokenLearnerType,ContextStrategy>::sentence_train(
     const std::vector<long>& word_ids) {
+  TRACE_SCOPE("sentence_train");
+  size_t num_pairs = 0;
   // loop over all contexts, training on each non-empty one
   for (size_t input_word_pos = 0; input_word_pos < word_ids.size();
        ++input_word_pos) {
@@ -331,9 +442,11 @@ void SGNSSentenceLearner<SGNSTokenLearnerType,ContextStrategy>::sentence_train(
       if (output_word_pos != input_word_pos) {
         token_learner.token_train(word_ids[input_word_pos],
                                     word_ids[output_word_pos], neg_samples);
+        ++num_pairs;
       }
     }
   }
+  return num_pairs;
 }
 
 template <class SGNSTokenLearnerType, class ContextStrategy>
@@ -0,0 +1,122 @@
+#ifndef ATHENA__SNAPSHOT_H
+#define ATHENA__SNAPSHOT_H
+
+
+#include "_core.h"
+
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+
+// seconds
+#define DEFAULT_SNAPSHOT_MAX_STALENESS 5
+
+
+// Immutable copy of a model taken between training steps.
+
+template <class LanguageModel>
+struct ModelSnapshot final {
+  WordContextFactorization factorization;
+  LanguageModel language_model;
+  // number of snapshots published before this one
+  size_t version;
+  std::chrono::steady_clock::time_point published;
+
+  ModelSnapshot(const WordContextFactorization& factorization_,
+                const LanguageModel& language_model_,
+                size_t version_):
+      factorization(factorization_),
+      language_model(language_model_),
+      version(version_),
+      published(std::chrono::steady_clock::now()) { }
+};
+
+
+// Publishes snapshots of a model that is being trained so that other
+// threads can read a consistent, recent view of it.  The training
+// thread calls maybe_publish between updates; once the current
+// snapshot is older than max_staleness seconds a fresh copy of the
+// model is published with a single atomic pointer swap.  Readers call
+// latest and keep the returned pointer for as long as they need the
+// view, so neither side ever waits on the other.
+//
+// Snapshots are double buffered: the snapshot published before the
+// current one is kept and, once no reader holds it, overwritten in
+// place by the next publish.  The training thread then pays only for
+// copying the model into existing storage; it never allocates or
+// frees a snapshot while readers release snapshots promptly (a
+// snapshot still held when it would be reused is left to its last
+// reader to free, and a new one is allocated instead).
+
+template <class LanguageModel>
+class SnapshotPublisher final {
+  std::shared_ptr<const ModelSnapshot<LanguageModel> > _snapshot;
+  // current snapshot and the one before it (null if none), owned for
+  // reuse
+  std::shared_ptr<ModelSnapshot<LanguageModel> > _current, _retired;
+  std::chrono::duration<double> _max_staleness;
+  std::chrono::steady_clock::time_point _last_publish;
+  size_t _version;
+
+  public:
+    SnapshotPublisher(double max_staleness = DEFAULT_SNAPSHOT_MAX_STALENESS):
+      _snapshot(),
+      _current(),
+      _retired(),
+      _max_staleness(max_staleness),
+      _last_publish(),
+      _version(0) { }
+    // publish copy of model if there is no snapshot yet or the current
+    // one is older than max_staleness; return true if published
+    // (call from the training thread only)
+    bool maybe_publish(const WordContextFactorization& factorization,
+                       const LanguageModel& language_model) {
+      if (_version > 0 &&
+          std::chrono::steady_clock::now() - _last_publish < _max_staleness) {
+        return false;
+      }
+      publish(factorization, language_model);
+      return true;
+    }
+    // publish copy of model unconditionally
+    // (call from the training thread only)
+    void publish(const WordContextFactorization& factorization,
+                 const LanguageModel& language_model) {
+      std::shared_ptr<ModelSnapshot<LanguageModel> > snapshot;
+      if (_retired && _retired.use_count() == 1) {
+        // no reader holds it (and none can obtain it any more); pair
+        // with the release of the last reader's reference
+        std::atomic_thread_fence(std::memory_order_acquire);
+        snapshot.swap(_retired);
+        snapshot->factorization = factorization;
+        snapshot->language_model = language_model;
+        snapshot->version = _version;
+        snapshot->published = std::chrono::steady_clock::now();
+      } else {
+        _retired.reset();
+        snapshot = std::make_shared<ModelSnapshot<LanguageModel> >(
+          factorization, language_model, _version);
+      }
+      _last_publish = snapshot->published;
+      ++_version;
+      std::atomic_store(
+        &_snapshot,
+        std::shared_ptr<const ModelSnapshot<LanguageModel> >(snapshot));
+      _retired.swap(_current);
+      _current.swap(snapshot);
+    }
+    // return most recently published snapshot (null if none yet)
+    // (safe to call from any thread)
+    std::shared_ptr<const ModelSnapshot<LanguageModel> > latest() const {
+      return std::atomic_load(&_snapshot);
+    }
+    double get_max_staleness() const { return _max_staleness.count(); }
+
+  private:
+    SnapshotPublisher(const SnapshotPublisher& other);
+};
+
+
+#endif
@@ -0,0 +1,135 @@
+#include "_trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+
+using namespace std;
+
+
+//
+// Tracer
+//
+
+
+static atomic<uint64_t> next_tracer_id(1);
+
+Tracer::Tracer(size_t max_events, const string& path):
+    _id(next_tracer_id++),
+    _epoch(chrono::steady_clock::now()),
+    _max_events(max_events),
+    _path(path),
+    _mutex(),
+    _buffers() { }
+
+Tracer::ThreadBuffer& Tracer::_thread_buffer() {
+  // a thread may record to more than one tracer (in tests), so cache
+  // the buffer together with the (unique) id of its tracer
+  thread_local uint64_t cached_tracer_id = 0;
+  thread_local ThreadBuffer *cached_buffer = 0;
+  if (cached_tracer_id != _id) {
+    lock_guard<mutex> lock(_mutex);
+    _buffers.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+    cached_buffer = _buffers.back().get();
+    cached_buffer->thread_idx = _buffers.size() - 1;
+    cached_buffer->num_dropped = 0;
+    cached_tracer_id = _id;
+  }
+  return *cached_buffer;
+}
+
+void Tracer::record(const char *name, uint64_t start, uint64_t duration) {
+  ThreadBuffer& buffer(_thread_buffer());
+  if (buffer.events.size() < _max_events ||
+      duration >= TRACE_LONG_EVENT_DURATION) {
+    buffer.events.push_back(TraceEvent{name, start, duration});
+  } else {
+    ++buffer.num_dropped;
+  }
+}
+
+size_t Tracer::num_events() {
+  lock_guard<mutex> lock(_mutex);
+  size_t n = 0;
+  for (auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+    n += (*it)->events.size();
+  }
+  return n;
+}
+
+size_t Tracer::num_dropped() {
+  lock_guard<mutex> lock(_mutex);
+  size_t n = 0;
+  for (auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+    n += (*it)->num_dropped;
+  }
+  return n;
+}
+
+void Tracer::write_json(ostream& stream) {
+  lock_guard<mutex> lock(_mutex);
+  const long pid = getpid();
+  size_t num_dropped = 0;
+  char buf[256];
+  stream << "{\"traceEvents\":[";
+  bool first = true;
+  for (auto b = _buffers.begin(); b != _buffers.end(); ++b) {
+    const ThreadBuffer& buffer(**b);
+    num_dropped += buffer.num_dropped;
+    snprintf(buf, sizeof(buf),
+             "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,"
+             "\"tid\":%zu,\"args\":{\"name\":\"thread %zu\"}}",
+             first ? "" : ",", pid, buffer.thread_idx, buffer.thread_idx);
+    stream << buf;
+    first = false;
+    for (auto it = buffer.events.begin(); it != buffer.events.end(); ++it) {
+      // timestamps are in microseconds
+      snprintf(buf, sizeof(buf),
+               ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%zu,"
+               "\"ts\":%.3f,\"dur\":%.3f}",
+               it->name, pid, buffer.thread_idx,
+               it->start / 1e3, it->duration / 1e3);
+      stream << buf;
+    }
+  }
+  stream << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{" <<
+    "\"dropped_events\":" << num_dropped << "}}\n";
+}
+
+Tracer::~Tracer() {
+  if (_path.empty() || _buffers.empty()) {
+    return;
+  }
+  ofstream f(_path.c_str());
+  if (f) {
+    write_json(f);
+  }
+  if (! f) {
+    cerr << "Tracer: failed to write trace to " << _path << endl;
+  } else {
+    cerr << "Tracer: wrote " << num_events() << " events to " << _path;
+    if (num_dropped() > 0) {
+      cerr << " (dropped " << num_dropped() << "; raise " <<
+        TRACE_MAX_EVENTS_ENV << " to keep more)";
+    }
+    cerr << endl;
+  }
+}
+
+Tracer& Tracer::global() {
+  static Tracer tracer(
+    getenv(TRACE_MAX_EVENTS_ENV) ?
+      stoull(string(getenv(TRACE_MAX_EVENTS_ENV))) :
+      DEFAULT_TRACE_MAX_EVENTS,
+    getenv(TRACE_PATH_ENV) ?
+      string(getenv(TRACE_PATH_ENV)) :
+      string(DEFAULT_TRACE_PATH));
+  return tracer;
+}
@@ -0,0 +1,115 @@
+#ifndef ATHENA__TRACE_H
+#define ATHENA__TRACE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// environment variable naming trace output file
+#define TRACE_PATH_ENV "ATHENA_TRACE_PATH"
+#define DEFAULT_TRACE_PATH "athena-trace.json"
+// environment variable bounding number of events kept per thread
+// (later events are dropped and counted, except long ones)
+#define TRACE_MAX_EVENTS_ENV "ATHENA_TRACE_MAX_EVENTS"
+#define DEFAULT_TRACE_MAX_EVENTS (1 << 20)
+// events at least this long (in nanoseconds) are kept regardless
+#define TRACE_LONG_EVENT_DURATION 1000000
+
+
+// Time the enclosing scope, recording it under name (a string literal)
+// in the process-wide Tracer.  Compiled out unless TRACE is defined
+// (make TRACE=1).
+#ifdef TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) \
+  TraceScope TRACE_CONCAT(_trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+
+struct TraceEvent final {
+  // not owned; must outlive the tracer
+  const char *name;
+  // nanoseconds since tracer creation
+  uint64_t start;
+  uint64_t duration;
+};
+
+
+// Collects timed events into per-thread buffers (so recording takes
+// no lock) and writes them in Chrome trace-event JSON format, which
+// chrome://tracing and Perfetto (ui.perfetto.dev) open directly.
+
+class Tracer final {
+  struct ThreadBuffer {
+    size_t thread_idx;
+    std::vector<TraceEvent> events;
+    size_t num_dropped;
+  };
+
+  uint64_t _id;
+  std::chrono::steady_clock::time_point _epoch;
+  size_t _max_events;
+  std::string _path;
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<ThreadBuffer> > _buffers;
+
+  public:
+    // if path is non-empty, write trace there on destruction
+    Tracer(size_t max_events = DEFAULT_TRACE_MAX_EVENTS,
+           const std::string& path = std::string());
+    // return nanoseconds since tracer creation
+    uint64_t now() const {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - _epoch).count();
+    }
+    // record event on calling thread (if calling thread's buffer is
+    // full, only if it is long)
+    void record(const char *name, uint64_t start, uint64_t duration);
+    // return number of events recorded (over all threads)
+    size_t num_events();
+    // return number of events dropped (over all threads)
+    size_t num_dropped();
+    // write trace (call when no thread is recording)
+    void write_json(std::ostream& stream);
+    ~Tracer();
+
+    // return process-wide tracer, writing to the path in
+    // ATHENA_TRACE_PATH (default athena-trace.json) at exit
+    static Tracer& global();
+
+  private:
+    ThreadBuffer& _thread_buffer();
+    Tracer(const Tracer& other);
+};
+
+
+// Records its lifetime in the global tracer (see TRACE_SCOPE).
+
+class TraceScope final {
+  const char *_name;
+  uint64_t _start;
+
+  public:
+    TraceScope(const char *name):
+      _name(name), _start(Tracer::global().now()) { }
+    ~TraceScope() {
+      Tracer& tracer(Tracer::global());
+      tracer.record(_name, _start, tracer.now() - _start);
+    }
+
+  private:
+    TraceScope(const TraceScope& other);
+};
+
+
+#endif
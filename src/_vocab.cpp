@@ -0,0 +1,265 @@
+#include "_vocab.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+#define MURMUR_M 0xc6a4a7935bd1e995ULL
+#define MURMUR_R 47
+#define MURMUR_SEED 0x9747b28cULL
+
+
+uint64_t word_hash(const char *s, size_t n) {
+  uint64_t h = MURMUR_SEED ^ (n * MURMUR_M);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t k;
+    memcpy(&k, s + i, 8);
+    k *= MURMUR_M;
+    k ^= k >> MURMUR_R;
+    k *= MURMUR_M;
+    h ^= k;
+    h *= MURMUR_M;
+  }
+  if (i < n) {
+    uint64_t k = 0;
+    memcpy(&k, s + i, n - i);
+    h ^= k;
+    h *= MURMUR_M;
+  }
+  h ^= h >> MURMUR_R;
+  h *= MURMUR_M;
+  h ^= h >> MURMUR_R;
+  return h;
+}
+
+
+//
+// Vocabulary
+//
+
+
+Vocabulary::Vocabulary(bool fingerprint_keyed):
+    _bytes(),
+    _offsets(),
+    _sizes(),
+    _capacities(),
+    _garbage(0),
+    _table(),
+    _fingerprint_keyed(fingerprint_keyed),
+    _fingerprints() {
+  _resize_table(VOCABULARY_MIN_TABLE_SIZE);
+}
+
+long Vocabulary::lookup(const string& word, uint64_t h) const {
+  const uint32_t id = _table[_find(word, h)].id;
+  return (id == EMPTY_ID) ? -1 : (long) id;
+}
+
+long Vocabulary::insert(const string& word, uint64_t h) {
+  if (size() >= MAX_SIZE) {
+    throw length_error("Vocabulary::insert: vocabulary is full (" +
+                       to_string(MAX_SIZE) + " words)");
+  }
+  // keep load factor at most 3/4
+  if (4 * (size() + 1) > 3 * _table.size()) {
+    _resize_table(2 * _table.size());
+  }
+  const uint32_t id = (uint32_t) size();
+  const size_t offset = _append_bytes(word);
+  _offsets.push_back(offset);
+  _sizes.push_back((uint32_t) word.size());
+  _capacities.push_back((uint32_t) word.size());
+  if (_fingerprint_keyed) {
+    _fingerprints.push_back(h);
+  }
+  _table_insert(id, (uint32_t) h);
+  return id;
+}
+
+void Vocabulary::replace(long id, const string& word, uint64_t h) {
+  if (id < 0 || (size_t) id >= size()) {
+    throw out_of_range("Vocabulary::replace: id " + to_string(id) +
+                       " out of range");
+  }
+  const uint32_t old_id = (uint32_t) id;
+  const uint64_t old_h = _fingerprint_keyed ? _fingerprints[old_id] :
+    word_hash(_bytes.data() + _offsets[old_id], _sizes[old_id]);
+  _table_erase(_find_id(old_id, (uint32_t) old_h));
+  if (_fingerprint_keyed) {
+    _fingerprints[old_id] = h;
+  }
+  if (word.size() <= _capacities[old_id]) {
+    if (! word.empty()) {
+      memcpy(&_bytes[_offsets[old_id]], word.data(), word.size());
+    }
+  } else {
+    _garbage += _capacities[old_id];
+    _offsets[old_id] = _append_bytes(word);
+    _capacities[old_id] = (uint32_t) word.size();
+  }
+  _sizes[old_id] = (uint32_t) word.size();
+  _table_insert(old_id, (uint32_t) h);
+  if (_garbage > _bytes.size() / 2) {
+    _compact();
+  }
+}
+
+string Vocabulary::get(long id) const {
+  if (id < 0 || (size_t) id >= size()) {
+    throw out_of_range("Vocabulary::get: id " + to_string(id) +
+                       " out of range");
+  }
+  return string(_bytes.data() + _offsets[id], _sizes[id]);
+}
+
+void Vocabulary::clear() {
+  _bytes.clear();
+  _offsets.clear();
+  _sizes.clear();
+  _capacities.clear();
+  _garbage = 0;
+  _table.clear();
+  _fingerprints.clear();
+  _resize_table(VOCABULARY_MIN_TABLE_SIZE);
+}
+
+void Vocabulary::reserve(size_t n) {
+  _offsets.reserve(n);
+  _sizes.reserve(n);
+  _capacities.reserve(n);
+  if (_fingerprint_keyed) {
+    _fingerprints.reserve(n);
+  }
+  size_t table_size = _table.size();
+  while (4 * n > 3 * table_size) {
+    table_size *= 2;
+  }
+  if (table_size > _table.size()) {
+    _resize_table(table_size);
+  }
+}
+
+MemoryUsage Vocabulary::memory_usage() const {
+  MemoryUsage usage;
+  usage.add("bytes", vector_heap_size(_bytes));
+  usage.add("offsets", vector_heap_size(_offsets));
+  usage.add("sizes", vector_heap_size(_sizes) +
+                     vector_heap_size(_capacities));
+  usage.add("table", vector_heap_size(_table));
+  if (_fingerprint_keyed) {
+    usage.add("fingerprints", vector_heap_size(_fingerprints));
+  }
+  return usage;
+}
+
+bool Vocabulary::equals(const Vocabulary& other) const {
+  if (size() != other.size()) {
+    return false;
+  }
+  for (size_t id = 0; id < size(); ++id) {
+    if (_sizes[id] != other._sizes[id] ||
+        memcmp(_bytes.data() + _offsets[id],
+               other._bytes.data() + other._offsets[id], _sizes[id]) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Vocabulary::_word_equals(uint32_t id, const string& word) const {
+  return _sizes[id] == word.size() &&
+    memcmp(_bytes.data() + _offsets[id], word.data(), word.size()) == 0;
+}
+
+size_t Vocabulary::_find(const string& word, uint64_t h) const {
+  const size_t mask = _table.size() - 1;
+  const uint32_t short_h = (uint32_t) h;
+  size_t pos = short_h & mask;
+  while (_table[pos].id != EMPTY_ID &&
+         ! (_table[pos].hash == short_h &&
+            (_fingerprint_keyed ? _fingerprints[_table[pos].id] == h :
+                                  _word_equals(_table[pos].id, word)))) {
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+size_t Vocabulary::_find_id(uint32_t id, uint32_t h) const {
+  const size_t mask = _table.size() - 1;
+  size_t pos = h & mask;
+  while (_table[pos].id != id) {
+    pos = (pos + 1) & mask;
+  }
+  return pos;
+}
+
+void Vocabulary::_table_insert(uint32_t id, uint32_t h) {
+  const size_t mask = _table.size() - 1;
+  size_t pos = h & mask;
+  while (_table[pos].id != EMPTY_ID) {
+    pos = (pos + 1) & mask;
+  }
+  _table[pos].hash = h;
+  _table[pos].id = id;
+}
+
+void Vocabulary::_table_erase(size_t pos) {
+  // shift later entries of the probe run back over the hole, so that
+  // every entry stays reachable from its home position
+  const size_t mask = _table.size() - 1;
+  size_t hole = pos;
+  for (size_t next = (hole + 1) & mask; _table[next].id != EMPTY_ID;
+       next = (next + 1) & mask) {
+    const size_t home = _table[next].hash & mask;
+    // move entry unless its home lies cyclically in (hole, next]
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      _table[hole] = _table[next];
+      hole = next;
+    }
+  }
+  _table[hole].id = EMPTY_ID;
+}
+
+void Vocabulary::_resize_table(size_t table_size) {
+  vector<Entry> old_table;
+  old_table.swap(_table);
+  Entry empty;
+  empty.hash = 0;
+  empty.id = EMPTY_ID;
+  _table.assign(table_size, empty);
+  const size_t mask = table_size - 1;
+  for (auto it = old_table.begin(); it != old_table.end(); ++it) {
+    if (it->id != EMPTY_ID) {
+      size_t pos = it->hash & mask;
+      while (_table[pos].id != EMPTY_ID) {
+        pos = (pos + 1) & mask;
+      }
+      _table[pos] = *it;
+    }
+  }
+}
+
+size_t Vocabulary::_append_bytes(const string& word) {
+  const size_t offset = _bytes.size();
+  _bytes.insert(_bytes.end(), word.begin(), word.end());
+  return offset;
+}
+
+void Vocabulary::_compact() {
+  vector<char> bytes;
+  bytes.reserve(_bytes.size() - _garbage);
+  for (size_t id = 0; id < size(); ++id) {
+    const size_t offset = bytes.size();
+    bytes.insert(bytes.end(), _bytes.begin() + _offsets[id],
+                 _bytes.begin() + _offsets[id] + _capacities[id]);
+    _offsets[id] = offset;
+  }
+  _bytes.swap(bytes);
+  _garbage = 0;
+}
@@ -0,0 +1,119 @@
+#ifndef ATHENA__VOCAB_H
+#define ATHENA__VOCAB_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "_memory.h"
+
+
+// smallest hash table size (a power of two)
+#define VOCABULARY_MIN_TABLE_SIZE 16
+
+
+// Return 64-bit hash of the n bytes at s (MurmurHash64A).
+uint64_t word_hash(const char *s, size_t n);
+
+inline uint64_t word_hash(const std::string& word) {
+  return word_hash(word.data(), word.size());
+}
+
+
+// Interned vocabulary: words with ids 0, ..., size - 1, each stored
+// once in a contiguous byte arena, and an open-addressing (linear
+// probing) hash table from word to id that refers to words by id.
+// A word can be replaced in place by another, reusing its id and, if
+// the new word fits, its bytes.  Callers that look up a word and then
+// insert it can hash it once and pass the hash to both.
+//
+// If fingerprint keyed, words are matched by their 64-bit hash alone
+// (a fingerprint, which callers may compute once per token when
+// reading), so the arena is written on insertion and replacement and
+// read only by get; lookups touch just the table and the fingerprints.
+// Words with equal fingerprints are taken to be equal (with n words in
+// the vocabulary, a new word collides with probability about n / 2^64).
+
+class Vocabulary final {
+  struct Entry {
+    uint32_t hash;
+    // EMPTY_ID if unused
+    uint32_t id;
+  };
+  static const uint32_t EMPTY_ID = UINT32_MAX;
+
+  // word bytes (not terminated) and, per id, offset, size and bytes
+  // reserved at offset
+  std::vector<char> _bytes;
+  std::vector<size_t> _offsets;
+  std::vector<uint32_t> _sizes;
+  std::vector<uint32_t> _capacities;
+  // bytes no longer reserved by any id (reclaimed by compaction)
+  size_t _garbage;
+  std::vector<Entry> _table;
+  bool _fingerprint_keyed;
+  // fingerprint of each id (empty unless fingerprint keyed)
+  std::vector<uint64_t> _fingerprints;
+
+  public:
+    // most words a vocabulary can hold (ids are 32-bit, one value
+    // marking unused table entries)
+    static const size_t MAX_SIZE = EMPTY_ID;
+
+    explicit Vocabulary(bool fingerprint_keyed = false);
+    // return number of words
+    size_t size() const { return _offsets.size(); }
+    bool fingerprint_keyed() const { return _fingerprint_keyed; }
+    // return id of word (-1 if not present)
+    long lookup(const std::string& word) const {
+      return lookup(word, word_hash(word));
+    }
+    // as above, given h = word_hash(word)
+    long lookup(const std::string& word, uint64_t h) const;
+    // add word (which must not be present) and return its (new) id
+    // (raise length_error if the vocabulary holds MAX_SIZE words)
+    long insert(const std::string& word) {
+      return insert(word, word_hash(word));
+    }
+    // as above, given h = word_hash(word)
+    long insert(const std::string& word, uint64_t h);
+    // replace word at id by word (which must not be present), given
+    // h = word_hash(word)
+    void replace(long id, const std::string& word, uint64_t h);
+    // return word at id (raise exception if it does not exist)
+    std::string get(long id) const;
+    // remove all words
+    void clear();
+    // reserve space for n words (bytes are reserved as they come)
+    void reserve(size_t n);
+
+    MemoryUsage memory_usage() const;
+
+    // return true if other holds the same words at the same ids
+    bool equals(const Vocabulary& other) const;
+
+    Vocabulary(Vocabulary&& other) = default;
+    Vocabulary(const Vocabulary& other) = default;
+    Vocabulary& operator=(Vocabulary&& other) = default;
+    Vocabulary& operator=(const Vocabulary& other) = default;
+
+  private:
+    bool _word_equals(uint32_t id, const std::string& word) const;
+    // return table position of word, or of the empty slot ending its
+    // probe sequence if not present
+    size_t _find(const std::string& word, uint64_t h) const;
+    // return table position of id (which must be present), given hash
+    // h of its word
+    size_t _find_id(uint32_t id, uint32_t h) const;
+    void _table_insert(uint32_t id, uint32_t h);
+    void _table_erase(size_t pos);
+    void _resize_table(size_t table_size);
+    // write word at end of arena and return its offset
+    size_t _append_bytes(const std::string& word);
+    void _compact();
+};
+
+
+#endif
@@ -3,71 +3,187 @@
 #include "_serialization.h"
 #include "_log.h"
 
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 
 using namespace std;
 
 
+static bool is_space(char c) {
+  return isspace(static_cast<unsigned char>(c));
+}
+
+// parse non-negative decimal integer at data[pos], advancing pos; no
+// dimension can exceed the input size, so larger values (checked
+// digit by digit, before they could overflow) are rejected
+static long long parse_dim(const char *data, size_t size, size_t& pos) {
+  const size_t begin = pos;
+  const unsigned long long max_dim = size;
+  unsigned long long x = 0;
+  while (pos < size && data[pos] >= '0' && data[pos] <= '9') {
+    const unsigned digit = data[pos] - '0';
+    if (digit > max_dim || x > (max_dim - digit) / 10) {
+      throw runtime_error(
+        string("Word2VecModel::parse: dimension exceeds input size"));
+    }
+    x = 10 * x + digit;
+    ++pos;
+  }
+  if (pos == begin) {
+    throw runtime_error(
+      string("Word2VecModel::parse: expected integer"));
+  }
+  return x;
+}
+
+static void expect_char(const char *data, size_t size, size_t pos, char c) {
+  if (pos >= size) {
+    throw runtime_error(
+      string("Word2VecModel::parse: unexpected end of input"));
+  }
+  if (data[pos] != c) {
+    throw runtime_error(
+      string("Word2VecModel::parse: expected ") +
+      (c == ' ' ? string("space") : string("newline")) +
+      string(" but got ") + string(1, data[pos]));
+  }
+}
+
+
 void Word2VecModel::serialize(ostream& stream) const {
-  throw logic_error(string("Word2VecModel::serialize: not implemented"));
+  const size_t record_size = embedding_dim * sizeof(float);
+  string buffer(to_string(vocab_dim) + " " + to_string(embedding_dim) + "\n");
+  buffer.reserve(WORD2VEC_WRITE_BUFFER_SIZE + record_size);
+  for (long long word_num = 0; word_num < vocab_dim; ++word_num) {
+    buffer.append(vocab[word_num]);
+    buffer.push_back(' ');
+    buffer.append(
+      reinterpret_cast<const char*>(
+        word_embeddings.data() + word_num * embedding_dim),
+      record_size);
+    buffer.push_back('\n');
+    if (buffer.size() >= WORD2VEC_WRITE_BUFFER_SIZE) {
+      stream.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+  stream.write(buffer.data(), buffer.size());
 }
 
 shared_ptr<Word2VecModel> Word2VecModel::deserialize(istream& stream) {
-  auto model(make_shared<Word2VecModel>());
-  char c;
+  const string data((istreambuf_iterator<char>(stream)),
+                    istreambuf_iterator<char>());
+  return parse(data.data(), data.size());
+}
 
-  stream >> model->vocab_dim;
-  debug(__func__, "vocab_dim: " << model->vocab_dim << "\n");
-  c = stream.get();
-  if (c != ' ') {
-    throw runtime_error(
-      string("Word2VecModel::deserialize: expected space but got ") +
-      string(1, c));
+shared_ptr<Word2VecModel> Word2VecModel::load(const string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error(string("Word2VecModel::load: cannot open ") + path +
+                        ": " + strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw runtime_error(string("Word2VecModel::load: cannot stat ") + path +
+                        ": " + strerror(errno));
+  }
+  const size_t size = st.st_size;
+  if (size == 0) {
+    close(fd);
+    return parse(0, 0);
+  }
+  void *data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw runtime_error(string("Word2VecModel::load: cannot map ") + path +
+                        ": " + strerror(errno));
   }
+  madvise(data, size, MADV_WILLNEED);
 
-  stream >> model->embedding_dim;
+  shared_ptr<Word2VecModel> model;
+  try {
+    model = parse(static_cast<const char*>(data), size);
+  } catch (...) {
+    munmap(data, size);
+    throw;
+  }
+  munmap(data, size);
+  return model;
+}
+
+shared_ptr<Word2VecModel> Word2VecModel::parse(const char *data, size_t size) {
+  auto model(make_shared<Word2VecModel>());
+  size_t pos = 0;
+
+  while (pos < size && is_space(data[pos])) {
+    ++pos;
+  }
+  model->vocab_dim = parse_dim(data, size, pos);
+  debug(__func__, "vocab_dim: " << model->vocab_dim << "\n");
+  expect_char(data, size, pos++, ' ');
+  model->embedding_dim = parse_dim(data, size, pos);
   debug(__func__, "embedding_dim: " << model->embedding_dim << "\n");
-  c = stream.get();
-  if (c != '\n') {
+  expect_char(data, size, pos++, '\n');
+
+  const size_t vocab_dim = model->vocab_dim;
+  const size_t embedding_dim = model->embedding_dim;
+  // each record takes at least a space and its embedding, so check the
+  // header against the remaining input before allocating anything
+  if (embedding_dim > (size - pos) / sizeof(float) ||
+      vocab_dim > (size - pos) / (embedding_dim * sizeof(float) + 1)) {
     throw runtime_error(
-      string("Word2VecModel::deserialize: expected newline but got ") +
-      string(1, c));
+      string("Word2VecModel::parse: dimensions exceed input size"));
   }
+  const size_t record_size = embedding_dim * sizeof(float);
 
-  debug(__func__, "allocating space for model\n");
-  model->word_embeddings.resize(model->vocab_dim * model->embedding_dim);
-  model->vocab.resize(model->vocab_dim);
-
-  for (long long word_num = 0; word_num < model->vocab_dim; ++word_num) {
-    /* read word */
-    if (word_num % 1000 == 0) {
-      debug(__func__, "reading word " << word_num << "\n");
+  // records are variable-length (the word comes first), so record
+  // boundaries are found sequentially; only word bytes are scanned,
+  // embeddings are skipped over
+  debug(__func__, "indexing words\n");
+  vector<size_t> word_begins(vocab_dim), word_ends(vocab_dim);
+  for (size_t word_num = 0; word_num < vocab_dim; ++word_num) {
+    while (pos < size && is_space(data[pos])) {
+      ++pos;
+    }
+    word_begins[word_num] = pos;
+    while (pos < size && ! is_space(data[pos])) {
+      ++pos;
     }
-    stream >> model->vocab[word_num];
-    c = stream.get();
-    if (c != ' ') {
+    word_ends[word_num] = pos;
+    expect_char(data, size, pos++, ' ');
+    if (record_size > size - pos) {
       throw runtime_error(
-        string("Word2VecModel::deserialize: expected space but got ") +
-        string(1, c));
+        string("Word2VecModel::parse: unexpected end of input"));
     }
+    pos += record_size;
+  }
+
+  debug(__func__, "allocating space for model\n");
+  model->word_embeddings.resize(vocab_dim * embedding_dim);
+  model->vocab.resize(vocab_dim);
 
-    /* read word vector and l2-normalize */
-    if (word_num % 1000 == 0) {
-      debug(__func__,
-        "reading embedding for " << model->vocab[word_num] << "\n");
+  // copy words and embeddings and l2-normalize embeddings
+  debug(__func__, "copying and normalizing embeddings\n");
+  #pragma omp parallel for schedule(static)
+  for (size_t word_num = 0; word_num < vocab_dim; ++word_num) {
+    model->vocab[word_num].assign(data + word_begins[word_num],
+                                  word_ends[word_num] - word_begins[word_num]);
+    float *x = model->word_embeddings.data() + word_num * embedding_dim;
+    memcpy(x, data + word_ends[word_num] + 1, record_size);
+    const float norm = cblas_snrm2(embedding_dim, x, 1);
+    if (norm > 0) {
+      cblas_sscal(embedding_dim, 1. / norm, x, 1);
     }
-    stream.read(
-      reinterpret_cast<char*>(
-        model->word_embeddings.data() + word_num * model->embedding_dim),
-      model->embedding_dim * sizeof(float));
-    float norm = cblas_snrm2(
-      model->embedding_dim,
-      model->word_embeddings.data() + word_num * model->embedding_dim,
-      1);
-    cblas_sscal(
-      model->embedding_dim,
-      1. / norm,
-      model->word_embeddings.data() + word_num * model->embedding_dim,
-      1);
   }
 
   return model;
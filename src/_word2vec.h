@@ -2,16 +2,22 @@
 #define ATHENA__WORD2VEC_H
 
 
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <memory>
 
 
+// bytes buffered per write when serializing
+#define WORD2VEC_WRITE_BUFFER_SIZE (1 << 24)
+
+
 struct Word2VecModel;
 
 
-// word2vec model as defined in Google C code
+// word2vec model as defined in Google C code (binary format); word
+// embeddings are l2-normalized on load
 
 struct Word2VecModel {
   long long vocab_dim;
@@ -21,6 +27,12 @@ struct Word2VecModel {
 
   void serialize(std::ostream& stream) const;
   static std::shared_ptr<Word2VecModel> deserialize(std::istream& stream);
+  // load model from file by mapping it into memory (faster than
+  // deserialize; raise exception on failure)
+  static std::shared_ptr<Word2VecModel> load(const std::string& path);
+  // parse model from size bytes at data (raise exception on malformed
+  // input)
+  static std::shared_ptr<Word2VecModel> parse(const char *data, size_t size);
 };
 
 
@@ -0,0 +1,149 @@
+#include "_core.h"
+#include "_sgns.h"
+#include "_serve.h"
+#include "_log.h"
+#include "_io.h"
+#include "_serialization.h"
+
+#include <cstdlib>
+#include <csignal>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+
+typedef SGNSTokenLearner<NaiveLanguageModel, DiscreteSamplingStrategy<NaiveLanguageModel> > Word2VecTokenLearnerType;
+typedef SGNSTokenLearner<NaiveLanguageModel, EmpiricalSamplingStrategy<NaiveLanguageModel> > Word2VecAliasTokenLearnerType;
+typedef ReservoirSamplingStrategy<SpaceSavingLanguageModel, ReservoirSampler<long> > SpaceSavingNegSamplingStrategy;
+typedef SGNSTokenLearner<SpaceSavingLanguageModel, SpaceSavingNegSamplingStrategy> SpaceSavingWord2VecTokenLearnerType;
+
+using namespace std;
+
+static QueryServer *server = 0;
+
+void usage(ostream& s, const string& program) {
+  s << "Load serialized word2vec (SGNS) model and answer similarity,\n";
+  s << "nearest-neighbor, embedding, and context queries over a Unix\n";
+  s << "domain socket until interrupted.\n";
+  s << "\n";
+  s << "Usage: " << program << " [...] <input-path> <socket-path>\n";
+  s << "\n";
+  s << "Required arguments:\n";
+  s << "  <input-path>\n";
+  s << "     Path to input file (serialized word2vec model).\n";
+  s << "  <socket-path>\n";
+  s << "     Path at which to create Unix domain socket.\n";
+  s << "\n";
+  s << "Optional arguments:\n";
+  s << "  -m <type>\n";
+  s << "     Model type: word2vec (as trained by word2vec-train),\n";
+  s << "     word2vec-alias (word2vec-alias-train), or spacesaving\n";
+  s << "     (spacesaving-word2vec-train).\n";
+  s << "     Default: word2vec\n";
+  s << "  -t <n>\n";
+  s << "     Number of worker threads.\n";
+  s << "     Default: " << DEFAULT_QUERY_NUM_WORKERS << "\n";
+  s << "  -k <n>\n";
+  s << "     Number of index lists to probe for context queries.\n";
+  s << "     Default: " << DEFAULT_MIPS_NUM_PROBES << "\n";
+  s << "  -c <n>\n";
+  s << "     Number of candidates to rerank for context queries.\n";
+  s << "     Default: " << DEFAULT_MIPS_NUM_CANDIDATES << "\n";
+  s << "  -h\n";
+  s << "     Print this help and exit.\n";
+}
+
+void handle_signal(int signum) {
+  if (server != 0) {
+    server->stop();
+  }
+}
+
+template <class SGNSTokenLearnerType>
+void serve(const char *input_path, const char *socket_path,
+           size_t num_workers, size_t num_probes, size_t num_candidates) {
+  typedef SGNSSentenceLearner<SGNSTokenLearnerType, DynamicContextStrategy> SGNSSentenceLearnerType;
+  typedef decltype(SGNSTokenLearnerType::language_model) LanguageModel;
+
+  info(__func__, "loading model ...\n");
+  auto sentence_learner(FileSerializer<SGNSSentenceLearnerType>(input_path).load());
+
+  info(__func__, "building index ...\n");
+  EmbeddingQueryHandler<LanguageModel> handler(
+    sentence_learner.token_learner.factorization,
+    sentence_learner.token_learner.language_model,
+    num_candidates, num_probes);
+
+  QueryServer query_server(
+    socket_path,
+    [&handler](uint32_t op, MessageReader& request, MessageWriter& response) {
+      return handler.handle(op, request, response);
+    },
+    num_workers);
+  query_server.listen();
+
+  server = &query_server;
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+  query_server.run();
+  server = 0;
+}
+
+int main(int argc, char **argv) {
+  string model_type("word2vec");
+  size_t num_workers(DEFAULT_QUERY_NUM_WORKERS),
+    num_probes(DEFAULT_MIPS_NUM_PROBES),
+    num_candidates(DEFAULT_MIPS_NUM_CANDIDATES);
+
+  const string program(argv[0]);
+
+  int ret = 0;
+  while (ret != -1) {
+    ret = getopt(argc, argv, "m:t:k:c:h");
+    switch (ret) {
+      case 'm':
+        model_type = string(optarg);
+        break;
+      case 't':
+        num_workers = stoul(string(optarg));
+        break;
+      case 'k':
+        num_probes = stoul(string(optarg));
+        break;
+      case 'c':
+        num_candidates = stoul(string(optarg));
+        break;
+      case 'h':
+        usage(cout, program);
+        exit(0);
+      case '?':
+        usage(cerr, program);
+        exit(1);
+      case -1:
+        break;
+    }
+  }
+  if (optind + 2 != argc) {
+    usage(cerr, program);
+    exit(1);
+  }
+  const char *input_path = argv[optind];
+  const char *socket_path = argv[optind + 1];
+
+  if (model_type == "word2vec") {
+    serve<Word2VecTokenLearnerType>(
+      input_path, socket_path, num_workers, num_probes, num_candidates);
+  } else if (model_type == "word2vec-alias") {
+    serve<Word2VecAliasTokenLearnerType>(
+      input_path, socket_path, num_workers, num_probes, num_candidates);
+  } else if (model_type == "spacesaving") {
+    serve<SpaceSavingWord2VecTokenLearnerType>(
+      input_path, socket_path, num_workers, num_probes, num_candidates);
+  } else {
+    usage(cerr, program);
+    exit(1);
+  }
+
+  info(__func__, "done\n");
+}
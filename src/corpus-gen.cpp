@@ -0,0 +1,171 @@
+#include "_corpus.h"
+#include "_math.h"
+#include "_log.h"
+#include "_io.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <unistd.h>
+
+
+#define DEFAULT_NUM_TOKENS 1000000
+#define DEFAULT_SEED 0
+
+
+using namespace std;
+
+void usage(ostream& s, const string& program) {
+  s << "Generate synthetic text in which word frequencies follow a Zipf\n";
+  s << "distribution whose popularity ranking (optionally) drifts over\n";
+  s << "time, one sentence per line.\n";
+  s << "\n";
+  s << "Usage: " << program << " [...] <output-path>\n";
+  s << "\n";
+  s << "Required arguments:\n";
+  s << "  <output-path>\n";
+  s << "     Path to output file (generated text).\n";
+  s << "\n";
+  s << "Optional arguments:\n";
+  s << "  -n <num-tokens>\n";
+  s << "     Set number of tokens to generate (the last sentence is\n";
+  s << "     truncated to fit).\n";
+  s << "     Default: " << DEFAULT_NUM_TOKENS << "\n";
+  s << "  -v <vocab-size>\n";
+  s << "     Set number of word types.\n";
+  s << "     Default: " << DEFAULT_CORPUS_VOCAB_SIZE << "\n";
+  s << "  -a <exponent>\n";
+  s << "     Set Zipf exponent.\n";
+  s << "     Default: " << DEFAULT_CORPUS_ZIPF_EXPONENT << "\n";
+  s << "  -l <sentence-length>\n";
+  s << "     Set mean sentence length.\n";
+  s << "     Default: " << DEFAULT_CORPUS_SENTENCE_LENGTH << "\n";
+  s << "  -L <distribution>\n";
+  s << "     Sentence length distribution: fixed, poisson, or geometric.\n";
+  s << "     Default: poisson\n";
+  s << "  -d <drift-interval>\n";
+  s << "     Drift popularity ranking every this many tokens (0 for no\n";
+  s << "     drift).\n";
+  s << "     Default: 0\n";
+  s << "  -w <drift-swaps>\n";
+  s << "     Set number of words moved into and out of the head of the\n";
+  s << "     ranking per drift step.\n";
+  s << "     Default: " << DEFAULT_CORPUS_DRIFT_SWAPS << "\n";
+  s << "  -H <drift-head-size>\n";
+  s << "     Set number of most popular ranks that drift acts on.\n";
+  s << "     Default: " << DEFAULT_CORPUS_DRIFT_HEAD_SIZE << "\n";
+  s << "  -s <seed>\n";
+  s << "     Set random seed.\n";
+  s << "     Default: " << DEFAULT_SEED << "\n";
+  s << "  -h\n";
+  s << "     Print this help and exit.\n";
+}
+
+int main(int argc, char **argv) {
+  size_t
+    num_tokens(DEFAULT_NUM_TOKENS),
+    vocab_size(DEFAULT_CORPUS_VOCAB_SIZE),
+    drift_interval(0),
+    drift_swaps(DEFAULT_CORPUS_DRIFT_SWAPS),
+    drift_head_size(DEFAULT_CORPUS_DRIFT_HEAD_SIZE);
+  float
+    exponent(DEFAULT_CORPUS_ZIPF_EXPONENT),
+    sentence_length(DEFAULT_CORPUS_SENTENCE_LENGTH);
+  int sentence_length_distribution(SENTENCE_LENGTH_POISSON);
+  unsigned int random_seed(DEFAULT_SEED);
+
+  const string program(argv[0]);
+
+  int ret = 0;
+  while (ret != -1) {
+    ret = getopt(argc, argv, "n:v:a:l:L:d:w:H:s:h");
+    switch (ret) {
+      case 'n':
+        num_tokens = stoull(string(optarg));
+        break;
+      case 'v':
+        vocab_size = stoull(string(optarg));
+        break;
+      case 'a':
+        exponent = stof(string(optarg));
+        break;
+      case 'l':
+        sentence_length = stof(string(optarg));
+        break;
+      case 'L':
+        if (string(optarg) == "fixed") {
+          sentence_length_distribution = SENTENCE_LENGTH_FIXED;
+        } else if (string(optarg) == "poisson") {
+          sentence_length_distribution = SENTENCE_LENGTH_POISSON;
+        } else if (string(optarg) == "geometric") {
+          sentence_length_distribution = SENTENCE_LENGTH_GEOMETRIC;
+        } else {
+          usage(cerr, program);
+          exit(1);
+        }
+        break;
+      case 'd':
+        drift_interval = stoull(string(optarg));
+        break;
+      case 'w':
+        drift_swaps = stoull(string(optarg));
+        break;
+      case 'H':
+        drift_head_size = stoull(string(optarg));
+        break;
+      case 's':
+        random_seed = stoul(string(optarg));
+        break;
+      case 'h':
+        usage(cout, program);
+        exit(0);
+      case '?':
+        usage(cerr, program);
+        exit(1);
+      case -1:
+        break;
+    }
+  }
+  if (optind + 1 != argc) {
+    usage(cerr, program);
+    exit(1);
+  }
+  const char *output_path = argv[optind];
+
+  info(__func__, "seeding random number generator ...\n");
+  seed(random_seed);
+
+  info(__func__, "initializing generator ...\n");
+  ZipfianCorpusGenerator generator(
+    vocab_size, exponent, sentence_length, sentence_length_distribution,
+    drift_interval, drift_swaps, drift_head_size);
+
+  info(__func__, "generating ...\n");
+  ofstream f;
+  f.open(output_path);
+  stream_ready_or_throw(f);
+  string line;
+  size_t tokens_written = 0;
+  while (tokens_written < num_tokens) {
+    const vector<long> word_ids(generator.next_sentence_idx());
+    const size_t sentence_length = min(word_ids.size(),
+                                       num_tokens - tokens_written);
+    line.clear();
+    for (size_t i = 0; i < sentence_length; ++i) {
+      if (i > 0) {
+        line.push_back(' ');
+      }
+      line.append(ZipfianCorpusGenerator::word(word_ids[i]));
+    }
+    line.push_back('\n');
+    f << line;
+    tokens_written += sentence_length;
+  }
+  f.close();
+  stream_ready_or_throw(f);
+
+  info(__func__, "done\n");
+}
@@ -1,14 +1,17 @@
 #include "_core.h"
+#include "_count.h"
 #include "_log.h"
 #include "_io.h"
 #include "_math.h"
 #include "_serialization.h"
 
 #include <cstdlib>
+#include <memory>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <unistd.h>
+#include <getopt.h>
 
 
 using namespace std;
@@ -29,19 +32,46 @@ void usage(ostream& s, const string& program) {
   s << "     Default: " << DEFAULT_VOCAB_DIM << "\n";
   s << "  -s <subsample-threshold>\n";
   s << "     Default: " << DEFAULT_SUBSAMPLE_THRESHOLD << "\n";
+  s << "  -m <max-types>\n";
+  s << "     Hold at most this many word types in memory while\n";
+  s << "     counting, spilling sorted counts to disk beyond that\n";
+  s << "     (counts on one thread).  Default: no limit.\n";
+  s << "  -p <max-types>\n";
+  s << "     Hold at most this many word types while counting, pruning\n";
+  s << "     rare words with a rising count threshold when full (counts\n";
+  s << "     may then be underestimated; the bound is logged; not\n";
+  s << "     with -m).  Default: no limit.\n";
+  s << "  -E\n";
+  s << "     Estimate the number of word types with a HyperLogLog\n";
+  s << "     pre-scan of the input and presize the language model's\n";
+  s << "     tables from it before counting (reads the input twice;\n";
+  s << "     not with -m).\n";
+  s << "  -d <spill-dir>\n";
+  s << "     Set directory for spilled counts (see -m).\n";
+  s << "     Default: $TMPDIR, or /tmp.\n";
+  s << "  --memory-report\n";
+  s << "     Print heap memory used by each model component after\n";
+  s << "     training.\n";
   s << "  -h\n";
   s << "     Print this help and exit.\n";
 }
 
 int main(int argc, char **argv) {
-  size_t vocab_dim(DEFAULT_VOCAB_DIM);
+  size_t vocab_dim(DEFAULT_VOCAB_DIM), max_types(0), prune_max_types(0);
   float subsample_threshold(DEFAULT_SUBSAMPLE_THRESHOLD);
+  string spill_dir(getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+  bool memory_report(false), prescan(false);
 
   const string program(argv[0]);
 
+  const struct option long_options[] = {
+    {"memory-report", no_argument, 0, MEMORY_REPORT_OPTION},
+    {0, 0, 0, 0}
+  };
+
   int ret = 0;
   while (ret != -1) {
-    ret = getopt(argc, argv, "v:s:h");
+    ret = getopt_long(argc, argv, "v:s:m:p:Ed:h", long_options, 0);
     switch (ret) {
       case 'v':
         vocab_dim = stoull(string(optarg));
@@ -49,6 +79,21 @@ int main(int argc, char **argv) {
       case 's':
         subsample_threshold = stof(string(optarg));
         break;
+      case 'm':
+        max_types = stoull(string(optarg));
+        break;
+      case 'p':
+        prune_max_types = stoull(string(optarg));
+        break;
+      case 'E':
+        prescan = true;
+        break;
+      case 'd':
+        spill_dir = string(optarg);
+        break;
+      case MEMORY_REPORT_OPTION:
+        memory_report = true;
+        break;
       case 'h':
         usage(cout, program);
         exit(0);
@@ -59,6 +104,11 @@ int main(int argc, char **argv) {
         break;
     }
   }
+  if (max_types > 0 && (prune_max_types > 0 || prescan)) {
+    cerr << program << ": -p and -E cannot be used with -m\n";
+    usage(cerr, program);
+    exit(1);
+  }
   if (optind + 2 != argc) {
     usage(cerr, program);
     exit(1);
@@ -69,32 +119,31 @@ int main(int argc, char **argv) {
   info(__func__, "seeding random number generator ...\n");
   seed_default();
 
-  info(__func__, "initializing model ...\n");
-  NaiveLanguageModel language_model(subsample_threshold);
-
-  info(__func__, "loading words into vocabulary ...\n");
-  string word;
-  ifstream f;
-  f.open(input_path);
-  stream_ready_or_throw(f);
-  while (f) {
-    const char c = f.get();
-    if (c == '\r') {
-      continue;
-    }
-    if (c == ' ' || c == '\n' || c == '\t' || c == '\r') {
-      if (! word.empty()) {
-        language_model.increment(word);
-        word.clear();
-      }
-    } else {
-      word.push_back(c);
+  shared_ptr<NaiveLanguageModel> _lm;
+  if (max_types > 0) {
+    info(__func__, "counting words (at most " << max_types <<
+                   " types in memory) ...\n");
+    _lm = make_shared<NaiveLanguageModel>(count_words_external(
+      input_path, vocab_dim, max_types, spill_dir, subsample_threshold));
+  } else {
+    info(__func__, "loading words into vocabulary ...\n");
+    _lm = make_shared<NaiveLanguageModel>(count_words_parallel(
+      input_path, subsample_threshold, prune_max_types, prescan));
+    if (_lm->prune_threshold() > 0) {
+      info(__func__, "pruned words with count at most " <<
+                     _lm->prune_threshold() << "; counts are low by at most " <<
+                     _lm->max_undercount() << "\n");
     }
+
+    info(__func__, "truncating language model ...\n");
+    _lm->truncate(vocab_dim);
   }
-  f.close();
+  NaiveLanguageModel& language_model(*_lm);
 
-  info(__func__, "truncating language model ...\n");
-  language_model.truncate(vocab_dim);
+  if (memory_report) {
+    info(__func__, "memory usage after training:\n" <<
+         language_model.memory_usage());
+  }
 
   info(__func__, "saving ...\n");
   FileSerializer<NaiveLanguageModel>(output_path).dump(language_model);
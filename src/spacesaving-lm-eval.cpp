@@ -0,0 +1,329 @@
+#include "_core.h"
+#include "_eval.h"
+#include "_log.h"
+#include "_io.h"
+#include "_serve.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+#define SENTENCE_LIMIT 1000
+
+#define DEFAULT_CAPACITIES "1000,10000,100000"
+#define DEFAULT_TOP_K 1000
+
+
+using namespace std;
+
+
+// Measurements of one counting run, sent from the child process that
+// performed it to the parent.
+struct CountingResult final {
+  double seconds;
+  uint64_t tokens;
+  // growth of peak resident set size while counting
+  uint64_t peak_memory;
+  HeavyHitterAccuracy accuracy;
+  // size of serialized language model that follows (if any)
+  uint64_t payload_size;
+};
+
+struct Configuration final {
+  string name;
+  size_t capacity;
+  CountingResult result;
+};
+
+
+void usage(ostream& s, const string& program) {
+  s << "Compare Space-Saving language models of several capacities to\n";
+  s << "exact (naive) counting on the same text file: heavy-hitter\n";
+  s << "precision and recall, count error, rank correlation, throughput\n";
+  s << "and peak memory.  Each model is counted in its own process so\n";
+  s << "that memory measurements are independent.\n";
+  s << "\n";
+  s << "Usage: " << program << " [...] <input-path>\n";
+  s << "\n";
+  s << "Required arguments:\n";
+  s << "  <input-path>\n";
+  s << "     Path to input file (text, e.g. from corpus-gen).\n";
+  s << "\n";
+  s << "Optional arguments:\n";
+  s << "  -v <capacities>\n";
+  s << "     Comma-separated list of Space-Saving vocabulary dimensions.\n";
+  s << "     Default: " << DEFAULT_CAPACITIES << "\n";
+  s << "  -k <k>\n";
+  s << "     Number of most frequent words to evaluate on.\n";
+  s << "     Default: " << DEFAULT_TOP_K << "\n";
+  s << "  -o <output-path>\n";
+  s << "     Also write results as JSON to this path.\n";
+  s << "  -h\n";
+  s << "     Print this help and exit.\n";
+}
+
+vector<size_t> parse_capacities(const string& s) {
+  vector<size_t> capacities;
+  stringstream stream(s);
+  string field;
+  while (getline(stream, field, ',')) {
+    capacities.push_back(stoull(field));
+  }
+  if (capacities.empty()) {
+    throw invalid_argument("parse_capacities: no capacities given");
+  }
+  return capacities;
+}
+
+template <class LanguageModel>
+CountingResult count_stream(const char *input_path,
+                            LanguageModel& language_model) {
+  const size_t baseline_memory = resident_memory();
+  ifstream f;
+  f.open(input_path);
+  stream_ready_or_throw(f);
+  SentenceReader reader(f, SENTENCE_LIMIT);
+  size_t tokens = 0;
+  const auto start = chrono::steady_clock::now();
+  while (reader.has_next()) {
+    const vector<string> sentence(reader.next());
+    for (auto it = sentence.begin(); it != sentence.end(); ++it) {
+      language_model.increment(*it);
+    }
+    tokens += sentence.size();
+  }
+  const chrono::duration<double> elapsed(
+    chrono::steady_clock::now() - start);
+  f.close();
+
+  CountingResult result;
+  result.seconds = elapsed.count();
+  result.tokens = tokens;
+  const size_t peak_memory = peak_resident_memory();
+  result.peak_memory =
+    (peak_memory > baseline_memory) ? peak_memory - baseline_memory : 0;
+  result.accuracy = HeavyHitterAccuracy();
+  result.payload_size = 0;
+  return result;
+}
+
+// Run f in a child process; f returns a result and fills in payload.
+// Return the result and payload in the parent.
+template <class F>
+CountingResult run_in_child(F f, string& payload) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    throw runtime_error("run_in_child: socketpair failed");
+  }
+  const pid_t pid = fork();
+  if (pid < 0) {
+    throw runtime_error("run_in_child: fork failed");
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    int status = 0;
+    try {
+      string child_payload;
+      CountingResult result(f(child_payload));
+      result.payload_size = child_payload.size();
+      if (! write_fully(fds[1], &result, sizeof(result)) ||
+          ! write_fully(fds[1], child_payload.data(), child_payload.size())) {
+        status = 1;
+      }
+    } catch (const exception& ex) {
+      cerr << "run_in_child: " << ex.what() << endl;
+      status = 1;
+    }
+    close(fds[1]);
+    _exit(status);
+  }
+
+  close(fds[1]);
+  CountingResult result;
+  bool ok = read_fully(fds[0], &result, sizeof(result));
+  if (ok) {
+    payload.resize(result.payload_size);
+    ok = (result.payload_size == 0 ||
+          read_fully(fds[0], &payload[0], result.payload_size));
+  }
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  if (! ok || ! WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    throw runtime_error("run_in_child: child process failed");
+  }
+  return result;
+}
+
+void write_table(ostream& stream, const vector<Configuration>& configurations,
+                 size_t k) {
+  stream << left << setw(14) << "model" << right <<
+    setw(10) << "capacity" <<
+    setw(11) << ("prec@" + to_string(k)) <<
+    setw(11) << ("rec@" + to_string(k)) <<
+    setw(11) << "mean err" <<
+    setw(11) << "max err" <<
+    setw(10) << "spearman" <<
+    setw(13) << "ktokens/s" <<
+    setw(11) << "peak MiB" << "\n";
+  stream << fixed;
+  for (auto it = configurations.begin(); it != configurations.end(); ++it) {
+    const CountingResult& result(it->result);
+    stream << left << setw(14) << it->name << right <<
+      setw(10) << it->capacity <<
+      setprecision(4) <<
+      setw(11) << result.accuracy.precision <<
+      setw(11) << result.accuracy.recall <<
+      setw(11) << result.accuracy.mean_relative_error <<
+      setw(11) << result.accuracy.max_relative_error <<
+      setw(10) << result.accuracy.rank_correlation <<
+      setprecision(1) <<
+      setw(13) << result.tokens / result.seconds / 1000 <<
+      setw(11) << result.peak_memory / 1048576. << "\n";
+  }
+  stream.unsetf(ios_base::floatfield);
+}
+
+void write_json(ostream& stream, const vector<Configuration>& configurations,
+                const string& input_path, size_t k) {
+  stream << "{\n";
+  stream << "  \"input\": \"";
+  for (auto it = input_path.begin(); it != input_path.end(); ++it) {
+    if (*it == '"' || *it == '\\') {
+      stream << '\\';
+    }
+    stream << *it;
+  }
+  stream << "\",\n";
+  stream << "  \"k\": " << k << ",\n";
+  stream << "  \"results\": [";
+  for (size_t i = 0; i < configurations.size(); ++i) {
+    const Configuration& configuration(configurations[i]);
+    const CountingResult& result(configuration.result);
+    stream << (i == 0 ? "\n" : ",\n");
+    stream << "    {\n";
+    stream << "      \"model\": \"" << configuration.name << "\",\n";
+    stream << "      \"capacity\": " << configuration.capacity << ",\n";
+    stream << "      \"tokens\": " << result.tokens << ",\n";
+    stream << "      \"seconds\": " << result.seconds << ",\n";
+    stream << "      \"tokens_per_sec\": " <<
+      result.tokens / result.seconds << ",\n";
+    stream << "      \"peak_memory_bytes\": " << result.peak_memory << ",\n";
+    stream << "      \"precision\": " << result.accuracy.precision << ",\n";
+    stream << "      \"recall\": " << result.accuracy.recall << ",\n";
+    stream << "      \"mean_relative_error\": " <<
+      result.accuracy.mean_relative_error << ",\n";
+    stream << "      \"max_relative_error\": " <<
+      result.accuracy.max_relative_error << ",\n";
+    stream << "      \"rank_correlation\": " <<
+      result.accuracy.rank_correlation << "\n";
+    stream << "    }";
+  }
+  stream << "\n  ]\n";
+  stream << "}\n";
+}
+
+int main(int argc, char **argv) {
+  string capacities_str(DEFAULT_CAPACITIES), output_path;
+  size_t k(DEFAULT_TOP_K);
+
+  const string program(argv[0]);
+
+  int ret = 0;
+  while (ret != -1) {
+    ret = getopt(argc, argv, "v:k:o:h");
+    switch (ret) {
+      case 'v':
+        capacities_str = string(optarg);
+        break;
+      case 'k':
+        k = stoull(string(optarg));
+        break;
+      case 'o':
+        output_path = string(optarg);
+        break;
+      case 'h':
+        usage(cout, program);
+        exit(0);
+      case '?':
+        usage(cerr, program);
+        exit(1);
+      case -1:
+        break;
+    }
+  }
+  if (optind + 1 != argc) {
+    usage(cerr, program);
+    exit(1);
+  }
+  const char *input_path = argv[optind];
+  const vector<size_t> capacities(parse_capacities(capacities_str));
+
+  vector<Configuration> configurations;
+
+  info(__func__, "counting exactly ...\n");
+  string payload;
+  Configuration naive_configuration;
+  naive_configuration.name = "naive";
+  naive_configuration.result = run_in_child(
+    [input_path](string& child_payload) {
+      NaiveLanguageModel language_model;
+      CountingResult result(count_stream(input_path, language_model));
+      stringstream stream;
+      language_model.serialize(stream);
+      child_payload = stream.str();
+      return result;
+    },
+    payload);
+  stringstream payload_stream(payload);
+  const NaiveLanguageModel exact(
+    NaiveLanguageModel::deserialize(payload_stream));
+  payload.clear();
+  naive_configuration.capacity = exact.size();
+  naive_configuration.result.accuracy = heavy_hitter_accuracy(exact, exact, k);
+  configurations.push_back(naive_configuration);
+
+  for (auto it = capacities.begin(); it != capacities.end(); ++it) {
+    const size_t capacity = *it;
+    info(__func__, "counting with space-saving, capacity " << capacity <<
+         " ...\n");
+    Configuration configuration;
+    configuration.name = "space-saving";
+    configuration.capacity = capacity;
+    configuration.result = run_in_child(
+      [input_path, capacity, &exact, k](string& child_payload) {
+        SpaceSavingLanguageModel language_model(capacity);
+        CountingResult result(count_stream(input_path, language_model));
+        result.accuracy = heavy_hitter_accuracy(exact, language_model, k);
+        return result;
+      },
+      payload);
+    configurations.push_back(configuration);
+  }
+
+  write_table(cout, configurations, k);
+
+  if (! output_path.empty()) {
+    info(__func__, "writing " << output_path << " ...\n");
+    ofstream f;
+    f.open(output_path.c_str());
+    stream_ready_or_throw(f);
+    write_json(f, configurations, input_path, k);
+    f.close();
+  }
+
+  info(__func__, "done\n");
+}
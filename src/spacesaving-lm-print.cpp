@@ -9,6 +9,7 @@
 #include <fstream>
 #include <stdexcept>
 #include <unistd.h>
+#include <getopt.h>
 
 
 using namespace std;
@@ -27,22 +28,34 @@ void usage(ostream& s, const string& program) {
   s << "Optional arguments:\n";
   s << "  -c\n";
   s << "     Print word count next to each word (separated by a space).\n";
+  s << "  --memory-report\n";
+  s << "     Print heap memory used by each model component after\n";
+  s << "     loading.\n";
   s << "  -h\n";
   s << "     Print this help and exit.\n";
 }
 
 int main(int argc, char **argv) {
   bool with_counts(false);
+  bool memory_report(false);
 
   const string program(argv[0]);
 
+  const struct option long_options[] = {
+    {"memory-report", no_argument, 0, MEMORY_REPORT_OPTION},
+    {0, 0, 0, 0}
+  };
+
   int ret = 0;
   while (ret != -1) {
-    ret = getopt(argc, argv, "ch");
+    ret = getopt_long(argc, argv, "ch", long_options, 0);
     switch (ret) {
       case 'c':
         with_counts = true;
         break;
+      case MEMORY_REPORT_OPTION:
+        memory_report = true;
+        break;
       case 'h':
         usage(cout, program);
         exit(0);
@@ -63,6 +76,11 @@ int main(int argc, char **argv) {
   info(__func__, "loading model ...\n");
   auto language_model(FileSerializer<SpaceSavingLanguageModel>(input_path).load());
 
+  if (memory_report) {
+    info(__func__, "memory usage:\n" <<
+         language_model.memory_usage());
+  }
+
   info(__func__, "printing words in vocabulary to file ...\n");
   ofstream f;
   f.open(output_path);
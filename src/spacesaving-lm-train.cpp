@@ -1,5 +1,6 @@
 #include "_core.h"
 #include "_log.h"
+#include "_trace.h"
 #include "_io.h"
 #include "_math.h"
 #include "_serialization.h"
@@ -11,6 +12,7 @@
 #include <iostream>
 #include <fstream>
 #include <unistd.h>
+#include <getopt.h>
 
 
 #define SENTENCE_LIMIT 1000
@@ -34,6 +36,9 @@ void usage(ostream& s, const string& program) {
   s << "     Default: " << DEFAULT_VOCAB_DIM << "\n";
   s << "  -s <subsample-threshold>\n";
   s << "     Default: " << DEFAULT_SUBSAMPLE_THRESHOLD << "\n";
+  s << "  --memory-report\n";
+  s << "     Print heap memory used by each model component after\n";
+  s << "     initialization and after training.\n";
   s << "  -h\n";
   s << "     Print this help and exit.\n";
 }
@@ -41,12 +46,18 @@ void usage(ostream& s, const string& program) {
 int main(int argc, char **argv) {
   size_t vocab_dim(DEFAULT_VOCAB_DIM);
   float subsample_threshold(DEFAULT_SUBSAMPLE_THRESHOLD);
+  bool memory_report(false);
 
   const string program(argv[0]);
 
+  const struct option long_options[] = {
+    {"memory-report", no_argument, 0, MEMORY_REPORT_OPTION},
+    {0, 0, 0, 0}
+  };
+
   int ret = 0;
   while (ret != -1) {
-    ret = getopt(argc, argv, "v:s:h");
+    ret = getopt_long(argc, argv, "v:s:h", long_options, 0);
     switch (ret) {
       case 'v':
         vocab_dim = stoull(string(optarg));
@@ -54,6 +65,9 @@ int main(int argc, char **argv) {
       case 's':
         subsample_threshold = stof(string(optarg));
         break;
+      case MEMORY_REPORT_OPTION:
+        memory_report = true;
+        break;
       case 'h':
         usage(cout, program);
         exit(0);
@@ -77,6 +91,11 @@ int main(int argc, char **argv) {
   info(__func__, "initializing model ...\n");
   SpaceSavingLanguageModel language_model(vocab_dim, subsample_threshold);
 
+  if (memory_report) {
+    info(__func__, "memory usage after initialization:\n" <<
+         language_model.memory_usage());
+  }
+
   info(__func__, "training ...\n");
   size_t words_seen = 0, prev_words_seen = 0;
   ifstream f;
@@ -87,9 +106,12 @@ int main(int argc, char **argv) {
   while (reader.has_next()) {
     vector<string> sentence(reader.next());
 
-    for (auto it = sentence.begin(); it != sentence.end(); ++it) {
-      language_model.increment(*it);
-      ++words_seen;
+    {
+      TRACE_SCOPE("language_model_update");
+      for (auto it = sentence.begin(); it != sentence.end(); ++it) {
+        language_model.increment(*it);
+        ++words_seen;
+      }
     }
 
     time_t now = time(NULL);
@@ -112,6 +134,11 @@ int main(int argc, char **argv) {
 
   f.close();
 
+  if (memory_report) {
+    info(__func__, "memory usage after training:\n" <<
+         language_model.memory_usage());
+  }
+
   info(__func__, "saving ...\n");
   FileSerializer<SpaceSavingLanguageModel>(output_path).dump(language_model);
 
@@ -3,13 +3,17 @@
 #include "_log.h"
 #include "_io.h"
 #include "_serialization.h"
+#include "_export.h"
 
 #include <cstdlib>
+#include <vector>
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 #include <unistd.h>
+#include <getopt.h>
 
 
 typedef ReservoirSamplingStrategy<SpaceSavingLanguageModel, ReservoirSampler<long> > NegSamplingStrategy;
@@ -32,30 +36,60 @@ void usage(ostream& s, const string& program) {
   s << "     word2vec model).\n";
   s << "\n";
   s << "Optional arguments:\n";
+  s << "  -f <format>\n";
+  s << "     Output format: text (space-separated values), bin (word2vec\n";
+  s << "     binary format, always with words), npy (NumPy float32\n";
+  s << "     matrix), or raw (aligned float32 matrix after a 64-byte\n";
+  s << "     header).  -d and -r apply to text only.\n";
+  s << "     Default: text\n";
   s << "  -w\n";
-  s << "     Print word before embedding vector (separated by a space).\n";
+  s << "     Print word before embedding vector (separated by a space);\n";
+  s << "     for npy and raw, print words to <output-path>.vocab (one\n";
+  s << "     per line).\n";
   s << "  -d\n";
   s << "     Print vocab and embedding dimension before embeddings\n";
   s << "     (separated by a newline).\n";
+  s << "  -r\n";
+  s << "     Print each float with as many digits as needed to read it\n";
+  s << "     back exactly (default: six significant digits).\n";
+  s << "  --memory-report\n";
+  s << "     Print heap memory used by each model component after\n";
+  s << "     loading.\n";
   s << "  -h\n";
   s << "     Print this help and exit.\n";
 }
 
 int main(int argc, char **argv) {
-  bool with_words(false), with_dims(false);
+  bool with_words(false), with_dims(false), shortest(false);
+  string format("text");
+  bool memory_report(false);
 
   const string program(argv[0]);
 
+  const struct option long_options[] = {
+    {"memory-report", no_argument, 0, MEMORY_REPORT_OPTION},
+    {0, 0, 0, 0}
+  };
+
   int ret = 0;
   while (ret != -1) {
-    ret = getopt(argc, argv, "wdh");
+    ret = getopt_long(argc, argv, "f:wdrh", long_options, 0);
     switch (ret) {
+      case 'f':
+        format = string(optarg);
+        break;
       case 'w':
         with_words = true;
         break;
       case 'd':
         with_dims = true;
         break;
+      case 'r':
+        shortest = true;
+        break;
+      case MEMORY_REPORT_OPTION:
+        memory_report = true;
+        break;
       case 'h':
         usage(cout, program);
         exit(0);
@@ -66,7 +100,9 @@ int main(int argc, char **argv) {
         break;
     }
   }
-  if (optind + 2 != argc) {
+  if (optind + 2 != argc ||
+      (format != "text" && format != "bin" && format != "npy" &&
+       format != "raw")) {
     usage(cerr, program);
     exit(1);
   }
@@ -75,33 +111,50 @@ int main(int argc, char **argv) {
 
   info(__func__, "loading model ...\n");
   auto sentence_learner(FileSerializer<SGNSSentenceLearnerType>(input_path).load());
+
+  if (memory_report) {
+    info(__func__, "memory usage:\n" <<
+         sentence_learner.memory_usage());
+  }
   WordContextFactorization& factorization(sentence_learner.token_learner.factorization);
   SpaceSavingLanguageModel& language_model(sentence_learner.token_learner.language_model);
 
+  // rows past the language model size belong to no word yet (the
+  // Space-Saving vocabulary is not full), so they are not exported
+  const size_t num_rows = min(factorization.get_vocab_dim(),
+                              language_model.size());
+  vector<string> words;
+  if (with_words || format == "bin") {
+    words.reserve(num_rows);
+    for (size_t i = 0; i < num_rows; ++i) {
+      words.push_back(language_model.reverse_lookup(i));
+    }
+  }
+
   ofstream f;
-  f.open(output_path);
+  f.open(output_path, ios::out | ios::binary);
   stream_ready_or_throw(f);
-  if (with_dims) {
-    info(__func__, "printing dimensions to file ...\n");
-    f << factorization.get_vocab_dim();
-    f.write(" ", 1);
-    f << factorization.get_embedding_dim();
-    f.write("\n", 1);
-  }
   info(__func__, "printing embeddings to file ...\n");
-  for (size_t i = 0; i < factorization.get_vocab_dim(); ++i) {
-    if (with_words) {
-      string word(language_model.reverse_lookup(i));
-      f.write(word.c_str(), word.size());
-      f.write(" ", 1);
-    }
-    for (size_t j = 0; j < factorization.get_embedding_dim(); ++j) {
-      f << factorization.get_word_embedding(i)[j];
-      f.write(" ", 1); // write extra space at end, just like word2vec
-    }
-    f.write("\n", 1);
+  if (format == "bin") {
+    write_word2vec_embeddings(f, factorization, words, num_rows);
+  } else if (format == "npy") {
+    write_npy_embeddings(f, factorization, num_rows);
+  } else if (format == "raw") {
+    write_raw_embeddings(f, factorization, num_rows);
+  } else {
+    write_text_embeddings(f, factorization, words, with_dims, shortest,
+                          num_rows);
   }
   f.close();
 
+  if (with_words && (format == "npy" || format == "raw")) {
+    info(__func__, "printing vocabulary to file ...\n");
+    ofstream vocab_f;
+    vocab_f.open(string(output_path) + ".vocab");
+    stream_ready_or_throw(vocab_f);
+    write_vocab(vocab_f, words);
+    vocab_f.close();
+  }
+
   info(__func__, "done\n");
 }
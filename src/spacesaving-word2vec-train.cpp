@@ -2,18 +2,29 @@
 #include "_math.h"
 #include "_sgns.h"
 #include "_log.h"
+#include "_trace.h"
 #include "_io.h"
 #include "_math.h"
 #include "_serialization.h"
+#include "_snapshot.h"
+#include "_serve.h"
+#include "_metrics.h"
+#include "_count.h"
 
+#include <algorithm>
 #include <ctime>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <vector>
 #include <string>
 #include <utility>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <thread>
 #include <unistd.h>
+#include <getopt.h>
 
 
 #define SENTENCE_LIMIT 1000
@@ -65,12 +76,40 @@ void usage(ostream& s, const string& program) {
   s << "  -k <kappa>\n";
   s << "     Set learning rate overall multiplier.\n";
   s << "     Default: " << DEFAULT_KAPPA << "\n";
+  s << "  -q <socket-path>\n";
+  s << "     Answer queries (see athena-serve) against the model while\n";
+  s << "     training, over a Unix domain socket at this path.\n";
+  s << "  -S <max-staleness>\n";
+  s << "     Set maximum age (in seconds, positive) of the model\n";
+  s << "     snapshot that queries see.  Each publish copies the\n";
+  s << "     word and context embeddings (2 x vocab-dim x embedding-dim\n";
+  s << "     floats) and the language model on the training thread,\n";
+  s << "     into the buffer of an earlier snapshot once no query holds\n";
+  s << "     it, so training pauses for one model copy per interval.\n";
+  s << "     Default: " << DEFAULT_SNAPSHOT_MAX_STALENESS << "\n";
+  s << "  -M <metrics-path>\n";
+  s << "     Periodically write training metrics to this path in\n";
+  s << "     Prometheus text format (e.g. for node_exporter's textfile\n";
+  s << "     collector).\n";
+  s << "  -P <metrics-interval>\n";
+  s << "     Set interval (in seconds) between metrics writes.\n";
+  s << "     Default: " << DEFAULT_METRICS_EXPORT_INTERVAL << "\n";
+  s << "  -F\n";
+  s << "     Key Space-Saving counters by 64-bit word fingerprint\n";
+  s << "     (words are stored only for output; distinct words with\n";
+  s << "     equal fingerprints are counted together).\n";
+  s << "  -R <seed>\n";
+  s << "     Set random seed; runs with the same seed and input train\n";
+  s << "     identical models.  Default: random (logged).\n";
+  s << "  --memory-report\n";
+  s << "     Print heap memory used by each model component after\n";
+  s << "     initialization and after training.\n";
   s << "  -h\n";
   s << "     Print this help and exit.\n";
 }
 
 int main(int argc, char **argv) {
-  string eos_symbol;
+  string eos_symbol, socket_path, metrics_path;
   size_t
     vocab_dim(DEFAULT_VOCAB_DIM),
     embedding_dim(DEFAULT_EMBEDDING_DIM),
@@ -79,13 +118,22 @@ int main(int argc, char **argv) {
   float
     subsample_threshold(DEFAULT_SUBSAMPLE_THRESHOLD),
     tau(DEFAULT_TAU),
-    kappa(DEFAULT_KAPPA);
+    kappa(DEFAULT_KAPPA),
+    max_staleness(DEFAULT_SNAPSHOT_MAX_STALENESS),
+    metrics_interval(DEFAULT_METRICS_EXPORT_INTERVAL);
+  unsigned int random_seed(0);
+  bool seed_given(false), memory_report(false), fingerprint_keyed(false);
 
   const string program(argv[0]);
 
+  const struct option long_options[] = {
+    {"memory-report", no_argument, 0, MEMORY_REPORT_OPTION},
+    {0, 0, 0, 0}
+  };
+
   int ret = 0;
   while (ret != -1) {
-    ret = getopt(argc, argv, "v:e:s:n:c:t:k:h");
+    ret = getopt_long(argc, argv, "v:e:s:n:c:t:k:q:S:M:P:FR:h", long_options, 0);
     switch (ret) {
       case 'v':
         vocab_dim = stoull(string(optarg));
@@ -108,9 +156,31 @@ int main(int argc, char **argv) {
       case 'k':
         kappa = stof(string(optarg));
         break;
+      case 'q':
+        socket_path = string(optarg);
+        break;
+      case 'S':
+        max_staleness = stof(string(optarg));
+        break;
+      case 'M':
+        metrics_path = string(optarg);
+        break;
+      case 'P':
+        metrics_interval = stof(string(optarg));
+        break;
       case 'x':
         eos_symbol = string(optarg);
         break;
+      case 'F':
+        fingerprint_keyed = true;
+        break;
+      case 'R':
+        random_seed = stoul(string(optarg));
+        seed_given = true;
+        break;
+      case MEMORY_REPORT_OPTION:
+        memory_report = true;
+        break;
       case 'h':
         usage(cout, program);
         exit(0);
@@ -121,7 +191,7 @@ int main(int argc, char **argv) {
         break;
     }
   }
-  if (optind + 2 != argc) {
+  if (optind + 2 != argc || ! (max_staleness > 0)) {
     usage(cerr, program);
     exit(1);
   }
@@ -129,14 +199,20 @@ int main(int argc, char **argv) {
   const char *output_path = argv[optind + 1];
 
   info(__func__, "seeding random number generator ...\n");
-  seed_default();
+  if (seed_given) {
+    seed(random_seed);
+  } else {
+    random_seed = seed_default();
+  }
+  info(__func__, "random seed: " << random_seed << "\n");
 
   info(__func__, "initializing SGNS model ...\n");
   SGNSSentenceLearnerType sentence_learner(
     SGNSTokenLearnerType(
       WordContextFactorization(vocab_dim, embedding_dim),
       NegSamplingStrategy(ReservoirSampler<long>(NEG_SAMPLING_TABLE_SIZE)),
-      SpaceSavingLanguageModel(vocab_dim, subsample_threshold),
+      SpaceSavingLanguageModel(vocab_dim, subsample_threshold,
+                               fingerprint_keyed),
       SGD(vocab_dim, tau, kappa, RHO_LOWER_BOUND_FACTOR * kappa)
     ),
     DynamicContextStrategy(symm_context),
@@ -145,51 +221,131 @@ int main(int argc, char **argv) {
   SpaceSavingLanguageModel& language_model(sentence_learner.token_learner.language_model);
   NegSamplingStrategy& neg_sampling_strategy(sentence_learner.token_learner.neg_sampling_strategy);
   SGD& sgd(sentence_learner.token_learner.sgd);
+  WordContextFactorization& factorization(sentence_learner.token_learner.factorization);
+
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(max_staleness);
+  shared_ptr<SnapshotQueryHandler<SpaceSavingLanguageModel> > query_handler;
+  shared_ptr<QueryServer> query_server;
+  thread query_thread;
+  if (! socket_path.empty()) {
+    info(__func__, "starting query server ...\n");
+    query_handler = make_shared<SnapshotQueryHandler<SpaceSavingLanguageModel> >(publisher);
+    query_server = make_shared<QueryServer>(
+      socket_path,
+      [query_handler](uint32_t op, MessageReader& request, MessageWriter& response) {
+        return query_handler->handle(op, request, response);
+      });
+    query_server->listen();
+    query_thread = thread([query_server]() { query_server->run(); });
+  }
+
+  if (memory_report) {
+    info(__func__, "memory usage after initialization:\n" <<
+         sentence_learner.memory_usage());
+  }
+
+  MetricsRegistry metrics_registry;
+  shared_ptr<TrainingMetrics> metrics;
+  shared_ptr<MetricsExporter> metrics_exporter;
+  if (! metrics_path.empty()) {
+    info(__func__, "starting metrics exporter ...\n");
+    metrics = make_shared<TrainingMetrics>(metrics_registry);
+    metrics->reservoir_size.set(neg_sampling_strategy.reservoir_sampler.size());
+    metrics_exporter = make_shared<MetricsExporter>(
+      metrics_registry, metrics_path, metrics_interval);
+  }
 
   info(__func__, "training ...\n");
   size_t words_seen = 0, prev_words_seen = 0;
+  // running estimate of the number of distinct words read
+  HyperLogLog word_types;
   ifstream f;
   f.open(input_path);
   stream_ready_or_throw(f);
   SentenceReader reader(f, SENTENCE_LIMIT);
   time_t start = time(NULL), prev_now = time(NULL);
+  size_t sentence_idx = 0;
+  vector<pair<long,string> > ejectees;
+  vector<uint64_t> word_hashes;
   while (reader.has_next()) {
-    vector<string> sentence(reader.next());
+    vector<string> sentence(reader.next(word_hashes));
+    // random draws for this sentence depend only on seed and index
+    seed_stream(sentence_idx++);
 
-    for (auto it = sentence.begin(); it != sentence.end(); ++it) {
-      const pair<long,string> ejectee = language_model.increment(*it);
-      const long ejectee_idx = ejectee.first;
-      if (ejectee_idx >= 0) {
-        sentence_learner.token_learner.reset_word(ejectee_idx);
+    size_t num_ejections = 0;
+    vector<long> word_ids;
+    {
+      TRACE_SCOPE("language_model_update");
+      language_model.increment_all(sentence, word_hashes, word_ids,
+                                   ejectees);
+      for (size_t i = 0; i < sentence.size(); ++i) {
+        word_types.add(word_hashes[i]);
+        const long ejectee_idx = ejectees[i].first;
+        if (ejectee_idx >= 0) {
+          sentence_learner.token_learner.reset_word(ejectee_idx);
+          ++num_ejections;
+        }
+        neg_sampling_strategy.step(language_model, word_ids[i]);
       }
-      neg_sampling_strategy.step(language_model, language_model.lookup(*it));
     }
 
-    vector<long> word_ids;
-    word_ids.reserve(sentence.size());
-    for (auto it = sentence.begin(); it != sentence.end(); ++it) {
-      long word_id = language_model.lookup(*it);
-      if (word_id >= 0) {
-        if (language_model.subsample(word_id)) {
-          word_ids.push_back(word_id);
-        }
-        ++words_seen;
+    {
+      TRACE_SCOPE("subsample");
+      // tokens whose word was ejected later in the sentence (its index
+      // now belongs to another word) take the word's current index, or
+      // are dropped if it is gone
+      if (num_ejections > 0) {
+        language_model.refresh_ejected_idxs(sentence, word_ids, ejectees);
+        word_ids.erase(remove(word_ids.begin(), word_ids.end(), -1L),
+                       word_ids.end());
+      }
+      words_seen += word_ids.size();
+      word_ids = language_model.subsample(word_ids);
+    }
+
+    const auto train_start = chrono::steady_clock::now();
+    const size_t num_pairs = sentence_learner.sentence_train(word_ids);
+    const chrono::duration<double> train_time(
+      chrono::steady_clock::now() - train_start);
+
+    {
+      TRACE_SCOPE("sgd_step");
+      for (size_t input_word_pos = 0; input_word_pos < word_ids.size();
+           ++input_word_pos) {
+        sgd.step(word_ids[input_word_pos]);
       }
     }
 
-    sentence_learner.sentence_train(word_ids);
+    if (metrics) {
+      metrics->tokens.increment(sentence.size());
+      metrics->sentences.increment();
+      metrics->ejections.increment(num_ejections);
+      metrics->pairs_trained.increment(num_pairs);
+      metrics->negative_samples.increment(num_pairs * neg_samples);
+      metrics->reservoir_filled_size.set(
+        neg_sampling_strategy.reservoir_sampler.filled_size());
+      metrics->sentence_train_seconds.record(train_time.count());
+      for (auto it = word_ids.begin(); it != word_ids.end(); ++it) {
+        metrics->sgd_rho.record(sgd.get_rho(*it));
+      }
+    }
 
-    for (size_t input_word_pos = 0; input_word_pos < word_ids.size();
-         ++input_word_pos) {
-      sgd.step(word_ids[input_word_pos]);
+    if (query_server) {
+      publisher.maybe_publish(factorization, language_model);
     }
 
     time_t now = time(NULL);
     if (difftime(now, prev_now) >= 5) {
+      const size_t word_types_estimate = word_types.estimate();
+      if (metrics) {
+        metrics->word_types.set(word_types_estimate);
+      }
       info(__func__, "loaded " << (words_seen / 1000) << " kwords total, " <<
           round(
             (words_seen - prev_words_seen) / difftime(now, prev_now) / 1000
-          ) << " kwords/sec; training ...\n");
+          ) << " kwords/sec, about " << word_types_estimate <<
+          " word types (" << language_model.capacity() <<
+          " counters); training ...\n");
       prev_words_seen = words_seen;
       prev_now = now;
     }
@@ -199,11 +355,32 @@ int main(int argc, char **argv) {
   info(__func__, "loaded " << (words_seen / 1000) << " kwords total, " <<
       round(words_seen / difftime(now, start) / 1000) <<
       " kwords/sec overall, " << difftime(now, start) << " sec\n");
+  info(__func__, "read about " << (size_t) word_types.estimate() <<
+                 " word types\n");
+  if (metrics) {
+    metrics->word_types.set(word_types.estimate());
+  }
   prev_words_seen = words_seen;
   prev_now = now;
 
   f.close();
 
+  if (query_server) {
+    info(__func__, "stopping query server ...\n");
+    query_server->stop();
+    query_thread.join();
+  }
+
+  if (metrics_exporter) {
+    info(__func__, "stopping metrics exporter ...\n");
+    metrics_exporter->stop();
+  }
+
+  if (memory_report) {
+    info(__func__, "memory usage after training:\n" <<
+         sentence_learner.memory_usage());
+  }
+
   info(__func__, "saving ...\n");
   FileSerializer<SGNSSentenceLearnerType>(output_path).dump(sentence_learner);
 
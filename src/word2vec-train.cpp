@@ -1,12 +1,17 @@
 #include "_core.h"
+#include "_count.h"
 #include "_math.h"
 #include "_sgns.h"
 #include "_log.h"
+#include "_trace.h"
+#include "_metrics.h"
 #include "_io.h"
 #include "_math.h"
 #include "_serialization.h"
 
 #include <ctime>
+#include <chrono>
+#include <memory>
 #include <cmath>
 #include <cstdlib>
 #include <vector>
@@ -15,6 +20,7 @@
 #include <fstream>
 #include <random>
 #include <unistd.h>
+#include <getopt.h>
 
 
 #define SENTENCE_LIMIT 1000
@@ -28,8 +34,8 @@
 #define DEFAULT_KAPPA 2.5e-2
 
 
-typedef DiscreteSamplingStrategy<NaiveLanguageModel> NegSamplingStrategy;
-typedef SGNSTokenLearner<NaiveLanguageModel, NegSamplingStrategy> SGNSTokenLearnerType;
+typedef DiscreteSamplingStrategy<FrozenLanguageModel> NegSamplingStrategy;
+typedef SGNSTokenLearner<FrozenLanguageModel, NegSamplingStrategy> SGNSTokenLearnerType;
 typedef SGNSSentenceLearner<SGNSTokenLearnerType, DynamicContextStrategy> SGNSSentenceLearnerType;
 
 using namespace std;
@@ -64,14 +70,31 @@ void usage(ostream& s, const string& program) {
   s << "  -k <kappa>\n";
   s << "     Set learning rate overall multiplier.\n";
   s << "     Default: " << DEFAULT_KAPPA << "\n";
+  s << "  -E\n";
+  s << "     Estimate the number of word types with a HyperLogLog\n";
+  s << "     pre-scan of the input and presize the language model's\n";
+  s << "     tables from it before counting (reads the input twice).\n";
   s << "  -l <lm-path>\n";
   s << "     Load language model from file (rather than learning from data).\n";
+  s << "  -M <metrics-path>\n";
+  s << "     Periodically write training metrics to this path in\n";
+  s << "     Prometheus text format (e.g. for node_exporter's textfile\n";
+  s << "     collector).\n";
+  s << "  -P <metrics-interval>\n";
+  s << "     Set interval (in seconds) between metrics writes.\n";
+  s << "     Default: " << DEFAULT_METRICS_EXPORT_INTERVAL << "\n";
+  s << "  -R <seed>\n";
+  s << "     Set random seed; runs with the same seed and input train\n";
+  s << "     identical models.  Default: random (logged).\n";
+  s << "  --memory-report\n";
+  s << "     Print heap memory used by each model component after\n";
+  s << "     initialization and after training.\n";
   s << "  -h\n";
   s << "     Print this help and exit.\n";
 }
 
 int main(int argc, char **argv) {
-  string lm_path;
+  string lm_path, metrics_path;
   size_t
     vocab_dim(DEFAULT_VOCAB_DIM),
     embedding_dim(DEFAULT_EMBEDDING_DIM),
@@ -79,13 +102,21 @@ int main(int argc, char **argv) {
     symm_context(DEFAULT_SYMM_CONTEXT);
   float
     subsample_threshold(DEFAULT_SUBSAMPLE_THRESHOLD),
-    kappa(DEFAULT_KAPPA);
+    kappa(DEFAULT_KAPPA),
+    metrics_interval(DEFAULT_METRICS_EXPORT_INTERVAL);
+  unsigned int random_seed(0);
+  bool seed_given(false), memory_report(false), prescan(false);
 
   const string program(argv[0]);
 
+  const struct option long_options[] = {
+    {"memory-report", no_argument, 0, MEMORY_REPORT_OPTION},
+    {0, 0, 0, 0}
+  };
+
   int ret = 0;
   while (ret != -1) {
-    ret = getopt(argc, argv, "v:e:s:n:c:k:l:h");
+    ret = getopt_long(argc, argv, "v:e:s:n:c:k:El:M:P:R:h", long_options, 0);
     switch (ret) {
       case 'v':
         vocab_dim = stoull(string(optarg));
@@ -105,9 +136,25 @@ int main(int argc, char **argv) {
       case 'k':
         kappa = stof(string(optarg));
         break;
+      case 'E':
+        prescan = true;
+        break;
       case 'l':
         lm_path = string(optarg);
         break;
+      case 'M':
+        metrics_path = string(optarg);
+        break;
+      case 'P':
+        metrics_interval = stof(string(optarg));
+        break;
+      case 'R':
+        random_seed = stoul(string(optarg));
+        seed_given = true;
+        break;
+      case MEMORY_REPORT_OPTION:
+        memory_report = true;
+        break;
       case 'h':
         usage(cout, program);
         exit(0);
@@ -126,29 +173,29 @@ int main(int argc, char **argv) {
   const char *output_path = argv[optind + 1];
 
   info(__func__, "seeding random number generator ...\n");
-  seed_default();
+  if (seed_given) {
+    seed(random_seed);
+  } else {
+    random_seed = seed_default();
+  }
+  info(__func__, "random seed: " << random_seed << "\n");
 
   shared_ptr<NaiveLanguageModel> _lm;
 
   if (lm_path.empty()) {
-    info(__func__, "initializing language model ...\n");
-    _lm = make_shared<NaiveLanguageModel>(subsample_threshold);
-
     info(__func__, "loading words into vocabulary ...\n");
-    ifstream f;
-    f.open(input_path);
-    stream_ready_or_throw(f);
-    SentenceReader reader(f, SENTENCE_LIMIT);
-    while (reader.has_next()) {
-      vector<string> sentence(reader.next());
-      for (auto it = sentence.begin(); it != sentence.end(); ++it) {
-        _lm->increment(*it);
-      }
-    }
-    f.close();
+    _lm = make_shared<NaiveLanguageModel>(
+      count_words_parallel(input_path, subsample_threshold, 0, prescan));
 
     info(__func__, "truncating language model ...\n");
     _lm->truncate(vocab_dim);
+    if (_lm->size() < vocab_dim) {
+      // size vocabulary-sized arrays by the words actually seen
+      info(__func__, "setting vocab dim to language model size " <<
+                       _lm->size() <<
+                       " ...\n");
+      vocab_dim = _lm->size();
+    }
   } else {
     info(__func__, "loading language model ...\n");
     _lm = make_shared<NaiveLanguageModel>(move(
@@ -170,16 +217,31 @@ int main(int argc, char **argv) {
       NegSamplingStrategy(Discretization(
         ExponentCountNormalizer(SMOOTHING_EXPONENT, SMOOTHING_OFFSET).normalize(word_counts),
         NEG_SAMPLING_TABLE_SIZE)),
-      NaiveLanguageModel(move(*_lm)),
+      FrozenLanguageModel(*_lm),
       SGD(vocab_dim, total_word_count, kappa, RHO_LOWER_BOUND_FACTOR * kappa)
     ),
     DynamicContextStrategy(symm_context),
     neg_samples
   );
   _lm.reset();
-  NaiveLanguageModel& language_model(sentence_learner.token_learner.language_model);
+  FrozenLanguageModel& language_model(sentence_learner.token_learner.language_model);
   SGD& sgd(sentence_learner.token_learner.sgd);
 
+  if (memory_report) {
+    info(__func__, "memory usage after initialization:\n" <<
+         sentence_learner.memory_usage());
+  }
+
+  MetricsRegistry metrics_registry;
+  shared_ptr<TrainingMetrics> metrics;
+  shared_ptr<MetricsExporter> metrics_exporter;
+  if (! metrics_path.empty()) {
+    info(__func__, "starting metrics exporter ...\n");
+    metrics = make_shared<TrainingMetrics>(metrics_registry);
+    metrics_exporter = make_shared<MetricsExporter>(
+      metrics_registry, metrics_path, metrics_interval);
+  }
+
   info(__func__, "training ...\n");
   size_t words_seen = 0, prev_words_seen = 0;
   ifstream f;
@@ -187,26 +249,48 @@ int main(int argc, char **argv) {
   stream_ready_or_throw(f);
   SentenceReader reader(f, SENTENCE_LIMIT);
   time_t start = time(NULL), prev_now = time(NULL);
+  size_t sentence_idx = 0;
   while (reader.has_next()) {
     vector<string> sentence(reader.next());
+    // random draws for this sentence depend only on seed and index
+    seed_stream(sentence_idx++);
 
     vector<long> word_ids;
     word_ids.reserve(sentence.size());
-    for (auto it = sentence.begin(); it != sentence.end(); ++it) {
-      long word_id = language_model.lookup(*it);
-      if (word_id >= 0) {
-        if (language_model.subsample(word_id)) {
+    {
+      TRACE_SCOPE("subsample");
+      for (auto it = sentence.begin(); it != sentence.end(); ++it) {
+        long word_id = language_model.lookup(*it);
+        if (word_id >= 0) {
           word_ids.push_back(word_id);
         }
-        ++words_seen;
       }
+      words_seen += word_ids.size();
+      word_ids = language_model.subsample(word_ids);
     }
 
-    sentence_learner.sentence_train(word_ids);
+    const auto train_start = chrono::steady_clock::now();
+    const size_t num_pairs = sentence_learner.sentence_train(word_ids);
+    const chrono::duration<double> train_time(
+      chrono::steady_clock::now() - train_start);
 
-    for (size_t input_word_pos = 0; input_word_pos < word_ids.size();
-         ++input_word_pos) {
-      sgd.step(word_ids[input_word_pos]);
+    {
+      TRACE_SCOPE("sgd_step");
+      for (size_t input_word_pos = 0; input_word_pos < word_ids.size();
+           ++input_word_pos) {
+        sgd.step(word_ids[input_word_pos]);
+      }
+    }
+
+    if (metrics) {
+      metrics->tokens.increment(sentence.size());
+      metrics->sentences.increment();
+      metrics->pairs_trained.increment(num_pairs);
+      metrics->negative_samples.increment(num_pairs * neg_samples);
+      metrics->sentence_train_seconds.record(train_time.count());
+      for (auto it = word_ids.begin(); it != word_ids.end(); ++it) {
+        metrics->sgd_rho.record(sgd.get_rho(*it));
+      }
     }
 
     time_t now = time(NULL);
@@ -229,6 +313,16 @@ int main(int argc, char **argv) {
 
   f.close();
 
+  if (metrics_exporter) {
+    info(__func__, "stopping metrics exporter ...\n");
+    metrics_exporter->stop();
+  }
+
+  if (memory_report) {
+    info(__func__, "memory usage after training:\n" <<
+         sentence_learner.memory_usage());
+  }
+
   info(__func__, "saving ...\n");
   FileSerializer<SGNSSentenceLearnerType>(output_path).dump(sentence_learner);
 
@@ -76,9 +76,7 @@ int main(int argc, char **argv) {
     if (c == ' ') {
       unsigned long count = 1;
       f >> count;
-      for (size_t i = 0; i < count; ++i) {
-        language_model.increment(word);
-      }
+      language_model.add(word, count);
       if (f.get() != '\n') {
         throw runtime_error(string("malformatted vocabulary"));
       }
@@ -5,6 +5,7 @@
 #include "_math.h"
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <utility>
 #include <sstream>
 
@@ -522,6 +523,27 @@ TEST_F(DynamicContextStrategyTest, serialization_fixed_point) {
         dynamic_cast<const DynamicContextStrategy&>(from_stream)));
 }
 
+TEST(keep_threshold_test, always_keep) {
+  EXPECT_EQ(UINT32_MAX, keep_threshold(0.5, 1, 2));
+  EXPECT_EQ(UINT32_MAX, keep_threshold(0.5, 1, 4));
+  EXPECT_EQ(UINT32_MAX, keep_threshold(1e-3, 1, 1000));
+}
+
+TEST(keep_threshold_test, keep_probability) {
+  // keep probability sqrt(0.25 / 1) = 0.5
+  EXPECT_NEAR(2147483648., (double) keep_threshold(0.25, 4, 4), 1.);
+  // keep probability sqrt(0.01 / 0.25) = 0.2
+  EXPECT_NEAR(0.2 * 4294967296., (double) keep_threshold(0.01, 25, 100),
+              1e3);
+}
+
+TEST(keep_threshold_test, keep_probability_near_one) {
+  // count just above the scaled total: probability just below one
+  const size_t total = size_t(1) << 53;
+  EXPECT_EQ(UINT32_MAX, keep_threshold(1, total + 2, total));
+  EXPECT_EQ(UINT32_MAX, keep_threshold(1, total + 1024, total));
+}
+
 TEST(space_saving_language_model_test, subsample_none) {
   const float threshold = 4./7.;
 
@@ -612,6 +634,62 @@ TEST(space_saving_language_model_test, subsample_all) {
   EXPECT_NEAR(p_2, sum[2] / (float) num_samples, 6. * mean_sigma_2);
 }
 
+TEST(space_saving_language_model_test, subsample_sentence) {
+  const float threshold = 1./7.;
+
+  SpaceSavingLanguageModel lm(3, threshold);
+  lm.increment("foo");
+  lm.increment("bar");
+  lm.increment("foo");
+  lm.increment("baz");
+  lm.increment("baz");
+  lm.increment("bbq");
+  lm.increment("baz");
+
+  const size_t num_samples = 100000;
+  vector<long> word_idxs;
+  for (size_t t = 0; t < num_samples; ++t) {
+    word_idxs.push_back(2);
+    word_idxs.push_back(0);
+  }
+  const vector<long> kept(lm.subsample(word_idxs));
+  size_t sum[] = {0, 0, 0};
+  for (size_t i = 0; i < kept.size(); ++i) {
+    ++(sum[kept[i]]);
+  }
+  const float p_0 = sqrt(threshold / (2./7.));
+  const float p_2 = sqrt(threshold / (3./7.));
+  EXPECT_EQ(0, sum[1]);
+  EXPECT_NEAR(p_0, sum[0] / (float) num_samples,
+              6. * sqrt(p_0 * (1. - p_0) / num_samples));
+  EXPECT_NEAR(p_2, sum[2] / (float) num_samples,
+              6. * sqrt(p_2 * (1. - p_2) / num_samples));
+}
+
+TEST(space_saving_language_model_test, subsample_replaced) {
+  const float threshold = 0.1;
+
+  // foo is replaced by bbq, which inherits its index and count
+  SpaceSavingLanguageModel lm(2, threshold);
+  lm.increment("foo");
+  for (size_t i = 0; i < 8; ++i) {
+    lm.increment("bar");
+  }
+  lm.increment("bbq");
+  ASSERT_EQ(0, lm.lookup("bbq"));
+
+  const size_t num_samples = 100000;
+  size_t sum = 0;
+  for (size_t t = 0; t < num_samples; ++t) {
+    if (lm.subsample(0)) {
+      ++sum;
+    }
+  }
+  const float p_0 = sqrt(threshold / (2./10.));
+  EXPECT_NEAR(p_0, sum / (float) num_samples,
+              6. * sqrt(p_0 * (1. - p_0) / num_samples));
+}
+
 TEST(space_saving_language_model_test, truncate_trivial_loose) {
   const float threshold = 2.5/7.;
 
@@ -794,6 +872,180 @@ TEST_F(SpaceSavingLanguageModelTest, ordered_counts) {
   EXPECT_EQ((vector<size_t> {4, 4, 3}), lm->ordered_counts());
 }
 
+TEST_F(SpaceSavingLanguageModelTest, increment_word_idx) {
+  long word_idx = -2;
+  lm->increment("foo", word_idx);
+  EXPECT_EQ(0, word_idx);
+  lm->increment("bar", word_idx);
+  EXPECT_EQ(1, word_idx);
+  lm->increment("bar", word_idx);
+  EXPECT_EQ(1, word_idx);
+  lm->increment("baz", word_idx);
+  EXPECT_EQ(2, word_idx);
+
+  const pair<long,string> ejectee(lm->increment("bbq", word_idx));
+  EXPECT_EQ(ejectee.first, word_idx);
+  EXPECT_EQ(word_idx, lm->lookup("bbq"));
+  EXPECT_EQ(-1, lm->lookup(ejectee.second));
+}
+
+TEST_F(SpaceSavingLanguageModelTest, increment_all) {
+  vector<long> word_idxs;
+  vector<pair<long,string> > ejectees;
+  lm->increment_all(
+    vector<string>{"foo", "bar", "foo", "baz", "baz", "bbq", "baz"},
+    word_idxs, ejectees);
+  EXPECT_EQ((vector<long> {0, 1, 0, 2, 2, 1, 2}), word_idxs);
+  ASSERT_EQ(7, ejectees.size());
+  for (size_t i = 0; i < 7; ++i) {
+    if (i == 5) {
+      EXPECT_EQ(1, ejectees[i].first);
+      EXPECT_EQ("bar", ejectees[i].second);
+    } else {
+      EXPECT_EQ(-1, ejectees[i].first);
+    }
+  }
+
+  SpaceSavingLanguageModel other(3);
+  other.increment("foo");
+  other.increment("bar");
+  other.increment("foo");
+  other.increment("baz");
+  other.increment("baz");
+  other.increment("bbq");
+  other.increment("baz");
+  EXPECT_TRUE(lm->equals(other));
+}
+
+TEST_F(SpaceSavingLanguageModelTest, add) {
+  long word_idx = -2;
+  lm->add("foo", 3);
+  lm->add("bar", 1);
+  lm->add("baz", 2, word_idx);
+  EXPECT_EQ(2, word_idx);
+  EXPECT_EQ((vector<size_t> {3, 2, 1}), lm->ordered_counts());
+  EXPECT_EQ((vector<size_t> {3, 1, 2}), lm->counts());
+
+  // takes over bar's counter
+  const pair<long,string> ejectee(lm->add("bbq", 4, word_idx));
+  EXPECT_EQ(1, ejectee.first);
+  EXPECT_EQ("bar", ejectee.second);
+  EXPECT_EQ(1, word_idx);
+  EXPECT_EQ(5, lm->count(1));
+  EXPECT_EQ((vector<size_t> {5, 3, 2}), lm->ordered_counts());
+
+  lm->add("baz", 2);
+  EXPECT_EQ((vector<size_t> {5, 4, 3}), lm->ordered_counts());
+  lm->add("foo", 0, word_idx);
+  EXPECT_EQ(0, word_idx);
+  lm->add("qux", 0, word_idx);
+  EXPECT_EQ(-1, word_idx);
+  EXPECT_EQ(12, lm->total());
+
+  // unit increments continue from the least counter
+  lm->increment("foo");
+  lm->increment("foo");
+  EXPECT_EQ((vector<size_t> {5, 5, 4}), lm->ordered_counts());
+  lm->increment("qux");
+  EXPECT_EQ(-1, lm->lookup("baz"));
+  EXPECT_EQ((vector<size_t> {5, 5, 5}), lm->ordered_counts());
+}
+
+TEST(space_saving_language_model_test, add_many) {
+  SpaceSavingLanguageModel lm(10);
+  NaiveLanguageModel exact;
+  for (size_t i = 0; i < 1000; ++i) {
+    const string word("w" + to_string((i * 7919) % (1 + i % 30)));
+    const size_t weight = (i * 31) % 7;
+    lm.add(word, weight);
+    exact.add(word, weight);
+    const vector<size_t> counts(lm.ordered_counts());
+    ASSERT_TRUE(is_sorted(counts.rbegin(), counts.rend()));
+    size_t sum = 0;
+    for (auto it = counts.begin(); it != counts.end(); ++it) {
+      sum += *it;
+    }
+    ASSERT_EQ(lm.total(), sum);
+  }
+  EXPECT_EQ(exact.total(), lm.total());
+  // every count overestimates by at most total / capacity
+  for (size_t i = 0; i < lm.size(); ++i) {
+    const size_t count = exact.count(exact.lookup(lm.reverse_lookup(i)));
+    EXPECT_LE(count, lm.count(i));
+    EXPECT_LE(lm.count(i), count + lm.total() / lm.capacity());
+  }
+}
+
+TEST(space_saving_language_model_test, refresh_ejected_idxs) {
+  SpaceSavingLanguageModel lm(2);
+  const vector<string> words{"a", "b", "c", "a"};
+  vector<long> word_idxs;
+  vector<pair<long,string> > ejectees;
+  lm.increment_all(words, word_idxs, ejectees);
+  // c ejects a, then a (reinserted) ejects b
+  EXPECT_EQ((vector<long> {0, 1, 0, 1}), word_idxs);
+  EXPECT_EQ("a", ejectees[2].second);
+  EXPECT_EQ("b", ejectees[3].second);
+  lm.refresh_ejected_idxs(words, word_idxs, ejectees);
+  EXPECT_EQ((vector<long> {1, -1, 0, 1}), word_idxs);
+  for (size_t i = 0; i < words.size(); ++i) {
+    EXPECT_EQ(lm.lookup(words[i]), word_idxs[i]);
+  }
+}
+
+TEST(space_saving_language_model_test, fingerprint_keyed) {
+  // same counts, indices and ejections as the string-keyed model
+  SpaceSavingLanguageModel lm(3, DEFAULT_SUBSAMPLE_THRESHOLD, true),
+    string_lm(3);
+  EXPECT_TRUE(lm.fingerprint_keyed());
+  EXPECT_FALSE(string_lm.fingerprint_keyed());
+  const vector<string> words{"foo", "bar", "foo", "baz", "baz", "bbq",
+                             "baz", "qux", "foo"};
+  vector<uint64_t> hashes(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    hashes[i] = word_hash(words[i]);
+  }
+  vector<long> word_idxs, string_word_idxs;
+  vector<pair<long,string> > ejectees, string_ejectees;
+  lm.increment_all(words, hashes, word_idxs, ejectees);
+  string_lm.increment_all(words, string_word_idxs, string_ejectees);
+  EXPECT_EQ(string_word_idxs, word_idxs);
+  EXPECT_EQ(string_ejectees, ejectees);
+  EXPECT_TRUE(lm.equals(string_lm));
+  for (size_t i = 0; i < lm.size(); ++i) {
+    EXPECT_EQ(string_lm.reverse_lookup(i), lm.reverse_lookup(i));
+    EXPECT_EQ(i, lm.lookup(lm.reverse_lookup(i)));
+  }
+  EXPECT_EQ(string_lm.lookup("bar"), lm.lookup("bar"));
+  EXPECT_GT(lm.memory_usage().get("words.fingerprints"), 0);
+
+  stringstream stream;
+  lm.serialize(stream);
+  auto from_stream(SpaceSavingLanguageModel::deserialize(stream));
+  EXPECT_TRUE(lm.equals(from_stream));
+  EXPECT_FALSE(from_stream.fingerprint_keyed());
+}
+
+TEST_F(SpaceSavingLanguageModelTest, serialization_reordered_lookup) {
+  lm->increment("foo");
+  lm->increment("bar");
+  lm->increment("baz");
+  lm->increment("baz");
+  lm->increment("bar");
+  lm->increment("bar");
+
+  stringstream stream;
+  lm->serialize(stream);
+  auto from_stream(SpaceSavingLanguageModel::deserialize(stream));
+
+  EXPECT_EQ(0, from_stream.lookup("foo"));
+  EXPECT_EQ(1, from_stream.lookup("bar"));
+  EXPECT_EQ(2, from_stream.lookup("baz"));
+  EXPECT_EQ(3, from_stream.count(1));
+  EXPECT_EQ("baz", from_stream.reverse_lookup(2));
+  EXPECT_TRUE(lm->equals(from_stream));
+}
+
 TEST_F(SpaceSavingLanguageModelUnfullSerializationTest, fixed_point) {
   stringstream ostream;
   lm->serialize(ostream);
@@ -946,6 +1198,95 @@ TEST(naive_language_model_test, subsample_all) {
   EXPECT_NEAR(p_2, sum[2] / (float) num_samples, 6. * mean_sigma_2);
 }
 
+TEST(naive_language_model_test, subsample_sentence) {
+  const float threshold = 1./7.;
+
+  NaiveLanguageModel lm(threshold);
+  lm.increment("foo");
+  lm.increment("bbq");
+  lm.increment("foo");
+  lm.increment("baz");
+  lm.increment("baz");
+  lm.increment("baz");
+  lm.increment("bbq");
+
+  const size_t num_samples = 100000;
+  vector<long> word_idxs;
+  for (size_t t = 0; t < num_samples; ++t) {
+    word_idxs.push_back(2);
+    word_idxs.push_back(0);
+  }
+  const vector<long> kept(lm.subsample(word_idxs));
+  size_t sum[] = {0, 0, 0};
+  for (size_t i = 0; i < kept.size(); ++i) {
+    ++(sum[kept[i]]);
+  }
+  const float p_0 = sqrt(threshold / (2./7.));
+  const float p_2 = sqrt(threshold / (3./7.));
+  EXPECT_EQ(0, sum[1]);
+  EXPECT_NEAR(p_0, sum[0] / (float) num_samples,
+              6. * sqrt(p_0 * (1. - p_0) / num_samples));
+  EXPECT_NEAR(p_2, sum[2] / (float) num_samples,
+              6. * sqrt(p_2 * (1. - p_2) / num_samples));
+}
+
+TEST(naive_language_model_test, subsample_refresh) {
+  const float threshold = 0.01;
+
+  // thresholds are stale by at most KEEP_THRESHOLD_TOLERANCE_INV
+  NaiveLanguageModel lm(threshold);
+  for (size_t i = 0; i < 900; ++i) {
+    lm.increment("bar");
+  }
+  for (size_t i = 0; i < 100; ++i) {
+    lm.increment("foo");
+  }
+
+  const size_t num_samples = 100000;
+  size_t sum[] = {0, 0};
+  for (size_t t = 0; t < num_samples; ++t) {
+    for (size_t word_idx = 0; word_idx < 2; ++word_idx) {
+      if (lm.subsample(word_idx)) {
+        ++(sum[word_idx]);
+      }
+    }
+  }
+  const float p_0 = sqrt(threshold / 0.9);
+  const float p_1 = sqrt(threshold / 0.1);
+  EXPECT_NEAR(p_0, sum[0] / (float) num_samples,
+              p_0 / KEEP_THRESHOLD_TOLERANCE_INV +
+                6. * sqrt(p_0 * (1. - p_0) / num_samples));
+  EXPECT_NEAR(p_1, sum[1] / (float) num_samples,
+              p_1 / KEEP_THRESHOLD_TOLERANCE_INV +
+                6. * sqrt(p_1 * (1. - p_1) / num_samples));
+}
+
+TEST(naive_language_model_test, subsample_deserialized) {
+  NaiveLanguageModel lm(1./7.);
+  lm.increment("foo");
+  lm.increment("bbq");
+  lm.increment("foo");
+  lm.increment("baz");
+  lm.increment("baz");
+  lm.increment("baz");
+  lm.increment("bbq");
+
+  stringstream stream;
+  lm.serialize(stream);
+  auto from_stream(NaiveLanguageModel::deserialize(stream));
+
+  const size_t num_samples = 100000;
+  size_t sum = 0;
+  for (size_t t = 0; t < num_samples; ++t) {
+    if (from_stream.subsample(2)) {
+      ++sum;
+    }
+  }
+  const float p_2 = sqrt((1./7.) / (3./7.));
+  EXPECT_NEAR(p_2, sum / (float) num_samples,
+              6. * sqrt(p_2 * (1. - p_2) / num_samples));
+}
+
 TEST_F(NaiveLanguageModelTest, truncate_trivial_loose) {
   // foo: 5, bbq: 2, baz: 4, bar: 1
   lm->increment("bbq");
@@ -1200,6 +1541,147 @@ TEST_F(NaiveLanguageModelTest, ordered_counts) {
   EXPECT_EQ((vector<size_t> {4, 4, 2, 1}), lm->ordered_counts());
 }
 
+TEST_F(NaiveLanguageModelTest, increment_all) {
+  vector<long> word_idxs;
+  vector<pair<long,string> > ejectees;
+  lm->increment_all(vector<string>{"foo", "bar", "foo", "baz"},
+                    word_idxs, ejectees);
+  EXPECT_EQ((vector<long> {0, 1, 0, 2}), word_idxs);
+  ASSERT_EQ(4, ejectees.size());
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(-1, ejectees[i].first);
+  }
+  EXPECT_EQ(2, lm->count(0));
+  EXPECT_EQ(4, lm->total());
+}
+
+TEST_F(NaiveLanguageModelTest, merge) {
+  lm->increment("foo");
+  lm->increment("bar");
+  lm->increment("foo");
+  NaiveLanguageModel other;
+  other.increment("baz");
+  other.increment("foo");
+  other.increment("baz");
+  other.increment("bbq");
+  lm->merge(other);
+  EXPECT_EQ(4, lm->size());
+  EXPECT_EQ(7, lm->total());
+  EXPECT_EQ((vector<size_t> {3, 1, 2, 1}), lm->counts());
+  EXPECT_EQ("baz", lm->reverse_lookup(2));
+  EXPECT_EQ("bbq", lm->reverse_lookup(3));
+  EXPECT_EQ(4, other.total());
+
+  NaiveLanguageModel whole;
+  const vector<string> words{"foo", "bar", "foo", "baz", "foo", "baz",
+                             "bbq"};
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    whole.increment(*it);
+  }
+  EXPECT_TRUE(lm->equals(whole));
+}
+
+TEST_F(NaiveLanguageModelTest, add) {
+  long word_idx = -2;
+  lm->add("foo", 3);
+  lm->add("bar", 0, word_idx);
+  EXPECT_EQ(-1, word_idx);
+  EXPECT_EQ(1, lm->size());
+  lm->add("bar", 2, word_idx);
+  EXPECT_EQ(1, word_idx);
+  lm->add("foo", 1);
+  EXPECT_EQ((vector<size_t> {4, 2}), lm->counts());
+  EXPECT_EQ(6, lm->total());
+
+  NaiveLanguageModel other;
+  const vector<string> words{"foo", "foo", "foo", "bar", "bar", "foo"};
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    other.increment(*it);
+  }
+  EXPECT_TRUE(lm->equals(other));
+}
+
+TEST(naive_language_model_test, reserve) {
+  NaiveLanguageModel lm;
+  lm.reserve(1000);
+  const MemoryUsage before(lm.memory_usage());
+  for (size_t i = 0; i < 1000; ++i) {
+    lm.increment("w" + to_string(i));
+  }
+  const MemoryUsage after(lm.memory_usage());
+  EXPECT_EQ(before.get("words.table"), after.get("words.table"));
+  EXPECT_EQ(before.get("counters"), after.get("counters"));
+  EXPECT_EQ(1000, lm.size());
+}
+
+TEST(naive_language_model_test, prune) {
+  NaiveLanguageModel lm(DEFAULT_SUBSAMPLE_THRESHOLD, 4);
+  EXPECT_EQ(4, lm.max_types());
+  const vector<string> words{"a", "a", "a", "b", "b", "c", "d"};
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    lm.increment(*it);
+  }
+  EXPECT_EQ(4, lm.size());
+  EXPECT_EQ(0, lm.prune_threshold());
+
+  // budget is full: prune words with count at most 1
+  lm.increment("e");
+  EXPECT_EQ(3, lm.size());
+  EXPECT_EQ(1, lm.prune_threshold());
+  EXPECT_EQ(1, lm.max_undercount());
+  EXPECT_EQ((vector<size_t> {3, 2, 1}), lm.counts());
+  EXPECT_EQ(2, lm.lookup("e"));
+  EXPECT_EQ(-1, lm.lookup("c"));
+  EXPECT_EQ(8, lm.total());
+
+  // threshold rises even though the least count is still 1
+  lm.increment("c");
+  lm.increment("f");
+  EXPECT_EQ(2, lm.size());
+  EXPECT_EQ(2, lm.prune_threshold());
+  EXPECT_EQ(3, lm.max_undercount());
+  EXPECT_EQ("a", lm.reverse_lookup(0));
+  EXPECT_EQ(1, lm.lookup("f"));
+  EXPECT_EQ(10, lm.total());
+}
+
+TEST(naive_language_model_test, prune_undercount) {
+  NaiveLanguageModel exact;
+  NaiveLanguageModel pruned(DEFAULT_SUBSAMPLE_THRESHOLD, 20);
+  for (size_t i = 0; i < 2000; ++i) {
+    const string word("w" + to_string((i * 7919) % (1 + i % 50)));
+    exact.increment(word);
+    pruned.increment(word);
+    ASSERT_LE(pruned.size(), 20);
+  }
+  EXPECT_GT(pruned.prune_threshold(), 0);
+  EXPECT_EQ(exact.total(), pruned.total());
+  for (size_t i = 0; i < pruned.size(); ++i) {
+    const size_t count = exact.count(exact.lookup(pruned.reverse_lookup(i)));
+    EXPECT_LE(pruned.count(i), count);
+    EXPECT_LE(count, pruned.count(i) + pruned.max_undercount());
+  }
+}
+
+TEST(naive_language_model_test, merge_prune) {
+  NaiveLanguageModel lm(DEFAULT_SUBSAMPLE_THRESHOLD, 4);
+  NaiveLanguageModel other(DEFAULT_SUBSAMPLE_THRESHOLD, 4);
+  const vector<string> words{"a", "a", "b", "c"};
+  const vector<string> other_words{"d", "d", "d", "e", "a"};
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    lm.increment(*it);
+  }
+  for (auto it = other_words.begin(); it != other_words.end(); ++it) {
+    other.increment(*it);
+  }
+  lm.merge(other);
+  EXPECT_EQ(2, lm.size());
+  EXPECT_EQ(1, lm.prune_threshold());
+  EXPECT_EQ((vector<size_t> {3, 3}), lm.counts());
+  EXPECT_EQ("d", lm.reverse_lookup(1));
+  EXPECT_EQ(9, lm.total());
+}
+
 TEST_F(NaiveLanguageModelSerializationTest, fixed_point) {
   stringstream ostream;
   lm->serialize(ostream);
@@ -1237,6 +1719,90 @@ TEST_F(NaiveLanguageModelTest,
   EXPECT_TRUE(lm->equals(from_stream));
 }
 
+TEST_F(FrozenLanguageModelTest, lookup) {
+  EXPECT_EQ(4, lm->size());
+  EXPECT_EQ(7, lm->total());
+  const vector<string> words{"foo", "bar", "baz", "bbq"};
+  for (auto it = words.begin(); it != words.end(); ++it) {
+    const long word_idx = naive_lm->lookup(*it);
+    EXPECT_EQ(word_idx, lm->lookup(*it));
+    EXPECT_EQ(*it, lm->reverse_lookup(word_idx));
+    EXPECT_EQ(naive_lm->count(word_idx), lm->count(word_idx));
+  }
+  EXPECT_EQ(-1, lm->lookup("fo"));
+  EXPECT_EQ(-1, lm->lookup("fooo"));
+  EXPECT_EQ(-1, lm->lookup(""));
+  EXPECT_EQ(-1, lm->lookup("qux"));
+  EXPECT_THROW(lm->reverse_lookup(4), out_of_range);
+}
+
+TEST_F(FrozenLanguageModelTest, counts) {
+  EXPECT_EQ(naive_lm->counts(), lm->counts());
+  EXPECT_EQ((vector<size_t> {3, 2, 1, 1}), lm->ordered_counts());
+}
+
+TEST_F(FrozenLanguageModelTest, frozen) {
+  EXPECT_THROW(lm->increment("foo"), logic_error);
+  EXPECT_THROW(lm->truncate(2), logic_error);
+}
+
+TEST_F(FrozenLanguageModelTest, subsample) {
+  const size_t num_samples = 100000;
+  vector<long> word_idxs(num_samples, lm->lookup("baz"));
+  const size_t sum = lm->subsample(word_idxs).size();
+  size_t single_sum = 0;
+  for (size_t t = 0; t < num_samples; ++t) {
+    if (lm->subsample(lm->lookup("foo"))) {
+      ++single_sum;
+    }
+  }
+  const float p_baz = sqrt((1./7.) / (3./7.)),
+    p_foo = sqrt((1./7.) / (2./7.));
+  EXPECT_NEAR(p_baz, sum / (float) num_samples,
+              6. * sqrt(p_baz * (1. - p_baz) / num_samples));
+  EXPECT_NEAR(p_foo, single_sum / (float) num_samples,
+              6. * sqrt(p_foo * (1. - p_foo) / num_samples));
+}
+
+TEST_F(FrozenLanguageModelTest, serialization_naive_format) {
+  stringstream frozen_stream;
+  lm->serialize(frozen_stream);
+  auto naive_from_stream(NaiveLanguageModel::deserialize(frozen_stream));
+  ASSERT_EQ(EOF, frozen_stream.peek());
+  EXPECT_TRUE(naive_lm->equals(naive_from_stream));
+
+  stringstream naive_stream;
+  naive_lm->serialize(naive_stream);
+  auto from_stream(FrozenLanguageModel::deserialize(naive_stream));
+  ASSERT_EQ(EOF, naive_stream.peek());
+  EXPECT_TRUE(lm->equals(from_stream));
+}
+
+TEST(frozen_language_model_test, empty) {
+  FrozenLanguageModel lm((NaiveLanguageModel()));
+  EXPECT_EQ(0, lm.size());
+  EXPECT_EQ(-1, lm.lookup("foo"));
+}
+
+TEST(frozen_language_model_test, many_words) {
+  NaiveLanguageModel naive_lm;
+  const size_t n = 10000;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j <= i % 3; ++j) {
+      naive_lm.increment("w" + to_string(i));
+    }
+  }
+  naive_lm.sort();
+  FrozenLanguageModel lm(naive_lm);
+  for (size_t i = 0; i < n; ++i) {
+    const string word("w" + to_string(i));
+    EXPECT_EQ(naive_lm.lookup(word), lm.lookup(word));
+  }
+  for (size_t i = n; i < 2 * n; ++i) {
+    EXPECT_EQ(-1, lm.lookup("w" + to_string(i)));
+  }
+}
+
 TEST_F(WordContextFactorizationTest, dimension) {
   EXPECT_EQ(3, factorization->get_vocab_dim());
   EXPECT_EQ(2, factorization->get_embedding_dim());
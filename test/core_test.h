@@ -100,6 +100,27 @@ class NaiveLanguageModelSerializationTest: public ::testing::Test {
     virtual void TearDown() { }
 };
 
+class FrozenLanguageModelTest: public ::testing::Test {
+  protected:
+    std::shared_ptr<NaiveLanguageModel> naive_lm;
+    std::shared_ptr<FrozenLanguageModel> lm;
+
+    virtual void SetUp() {
+      // foo: 2, bar: 1, baz: 3, bbq: 1
+      naive_lm = std::make_shared<NaiveLanguageModel>(1./7.);
+      naive_lm->increment("foo");
+      naive_lm->increment("bar");
+      naive_lm->increment("foo");
+      naive_lm->increment("baz");
+      naive_lm->increment("baz");
+      naive_lm->increment("bbq");
+      naive_lm->increment("baz");
+      lm = std::make_shared<FrozenLanguageModel>(*naive_lm);
+    }
+
+    virtual void TearDown() { }
+};
+
 class WordContextFactorizationTest: public ::testing::Test {
   protected:
     std::shared_ptr<WordContextFactorization> factorization;
@@ -0,0 +1,153 @@
+#include "corpus_test.h"
+#include "_corpus.h"
+#include "_math.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+TEST_F(ZipfianCorpusGeneratorTest, word) {
+  EXPECT_EQ("w0", ZipfianCorpusGenerator::word(0));
+  EXPECT_EQ("w42", ZipfianCorpusGenerator::word(42));
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, invalid_arguments) {
+  EXPECT_THROW(ZipfianCorpusGenerator(0), invalid_argument);
+  EXPECT_THROW(ZipfianCorpusGenerator(10, 1, 0.5), invalid_argument);
+  EXPECT_THROW(ZipfianCorpusGenerator(10, 1, NAN), invalid_argument);
+  EXPECT_THROW(ZipfianCorpusGenerator(10, 1, 5, 3), invalid_argument);
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, vocab_bounds) {
+  ZipfianCorpusGenerator generator(7);
+  for (size_t i = 0; i < 1000; ++i) {
+    const long word_idx = generator.next_word_idx();
+    EXPECT_LE(0, word_idx);
+    EXPECT_GT(7, word_idx);
+  }
+  EXPECT_EQ(1000, generator.num_tokens());
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, deterministic) {
+  ZipfianCorpusGenerator generator_a(100, 1.2, 5, SENTENCE_LENGTH_POISSON,
+                                     10, 2, 5);
+  vector<vector<string> > sentences_a;
+  for (size_t i = 0; i < 50; ++i) {
+    sentences_a.push_back(generator_a.next_sentence());
+  }
+
+  seed(0);
+  ZipfianCorpusGenerator generator_b(100, 1.2, 5, SENTENCE_LENGTH_POISSON,
+                                     10, 2, 5);
+  for (size_t i = 0; i < 50; ++i) {
+    EXPECT_EQ(sentences_a[i], generator_b.next_sentence());
+  }
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, zipf_frequencies) {
+  ZipfianCorpusGenerator generator(3, 1);
+  vector<size_t> counts(3, 0);
+  for (size_t i = 0; i < 60000; ++i) {
+    ++counts[generator.next_word_idx()];
+  }
+  // probabilities 6/11, 3/11, 2/11
+  EXPECT_NEAR(6. / 11, counts[0] / 60000., 0.01);
+  EXPECT_NEAR(3. / 11, counts[1] / 60000., 0.01);
+  EXPECT_NEAR(2. / 11, counts[2] / 60000., 0.01);
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, no_drift) {
+  ZipfianCorpusGenerator generator(10);
+  for (size_t i = 0; i < 1000; ++i) {
+    generator.next_word_idx();
+  }
+  for (size_t r = 0; r < 10; ++r) {
+    EXPECT_EQ(r, generator.word_idx_at_rank(r));
+  }
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, drift_permutes_ranking) {
+  ZipfianCorpusGenerator generator(1000, 1, 20, SENTENCE_LENGTH_FIXED,
+                                   10, 1, 10);
+  for (size_t i = 0; i < 1000; ++i) {
+    generator.next_word_idx();
+  }
+  vector<bool> seen(1000, false);
+  size_t num_moved = 0;
+  for (size_t r = 0; r < 1000; ++r) {
+    const long word_idx = generator.word_idx_at_rank(r);
+    EXPECT_FALSE(seen[word_idx]);
+    seen[word_idx] = true;
+    if (word_idx != (long) r) {
+      ++num_moved;
+    }
+  }
+  EXPECT_LT(0, num_moved);
+  // the original top word is almost surely no longer on top
+  EXPECT_NE(0, generator.word_idx_at_rank(0));
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, drift_changes_heavy_hitters) {
+  ZipfianCorpusGenerator generator(10000, 1, 20, SENTENCE_LENGTH_FIXED,
+                                   1000, 20, 20);
+  vector<size_t> early_counts(10000, 0), late_counts(10000, 0);
+  for (size_t i = 0; i < 20000; ++i) {
+    ++early_counts[generator.next_word_idx()];
+  }
+  for (size_t i = 0; i < 20000; ++i) {
+    ++late_counts[generator.next_word_idx()];
+  }
+  // some frequent word in the second half was rare in the first
+  bool found = false;
+  for (size_t w = 0; w < 10000; ++w) {
+    if (late_counts[w] > 200 && early_counts[w] < 20) {
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, sentence_length_fixed) {
+  ZipfianCorpusGenerator generator(10, 1, 7, SENTENCE_LENGTH_FIXED);
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(7, generator.next_sentence_idx().size());
+  }
+  EXPECT_EQ(70, generator.num_tokens());
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, sentence_length_poisson) {
+  ZipfianCorpusGenerator generator(10, 1, 8, SENTENCE_LENGTH_POISSON);
+  size_t total = 0;
+  for (size_t i = 0; i < 5000; ++i) {
+    const size_t length = generator.next_sentence_idx().size();
+    EXPECT_LE(1, length);
+    total += length;
+  }
+  EXPECT_NEAR(8, total / 5000., 0.2);
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, sentence_length_geometric) {
+  ZipfianCorpusGenerator generator(10, 1, 8, SENTENCE_LENGTH_GEOMETRIC);
+  size_t total = 0;
+  for (size_t i = 0; i < 5000; ++i) {
+    const size_t length = generator.next_sentence_idx().size();
+    EXPECT_LE(1, length);
+    total += length;
+  }
+  EXPECT_NEAR(8, total / 5000., 0.4);
+}
+
+TEST_F(ZipfianCorpusGeneratorTest, sentence_length_one) {
+  ZipfianCorpusGenerator poisson(10, 1, 1, SENTENCE_LENGTH_POISSON),
+    geometric(10, 1, 1, SENTENCE_LENGTH_GEOMETRIC);
+  for (size_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(1, poisson.next_sentence_idx().size());
+    EXPECT_EQ(1, geometric.next_sentence_idx().size());
+  }
+}
@@ -0,0 +1,21 @@
+#ifndef ATHENA_CORPUS_TEST_H
+#define ATHENA_CORPUS_TEST_H
+
+
+#include "_corpus.h"
+#include "_math.h"
+
+#include <gtest/gtest.h>
+
+
+class ZipfianCorpusGeneratorTest: public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      seed(0);
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
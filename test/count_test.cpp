@@ -0,0 +1,188 @@
+#include "count_test.h"
+#include "_count.h"
+#include "_vocab.h"
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+TEST_F(CountWordsTest, line_chunk_offsets) {
+  for (size_t num_chunks = 1; num_chunks <= 40; ++num_chunks) {
+    const vector<size_t> offsets(line_chunk_offsets(path, num_chunks));
+    ASSERT_EQ(num_chunks + 1, offsets.size());
+    EXPECT_EQ(0, offsets.front());
+    EXPECT_EQ(text.size(), offsets.back());
+    for (size_t c = 1; c < num_chunks; ++c) {
+      EXPECT_LE(offsets[c - 1], offsets[c]);
+      if (offsets[c] < text.size()) {
+        EXPECT_EQ('\n', text[offsets[c] - 1]);
+      }
+    }
+  }
+  EXPECT_EQ((vector<size_t> {0, 26, 39, 47}), line_chunk_offsets(path, 3));
+}
+
+TEST_F(CountWordsTest, count_words) {
+  NaiveLanguageModel lm;
+  count_words(path, 0, text.size(), lm);
+  EXPECT_EQ(11, lm.total());
+  EXPECT_EQ(5, lm.size());
+  EXPECT_EQ(0, lm.lookup("foo"));
+  EXPECT_EQ(4, lm.count(lm.lookup("foo")));
+  EXPECT_EQ(1, lm.count(lm.lookup("bar")));
+  EXPECT_EQ(4, lm.count(lm.lookup("baz")));
+  EXPECT_EQ(1, lm.count(lm.lookup("bbq")));
+  EXPECT_EQ(1, lm.count(lm.lookup("qux")));
+
+  NaiveLanguageModel second_line_lm;
+  count_words(path, 12, 26, second_line_lm);
+  EXPECT_EQ(3, second_line_lm.total());
+  EXPECT_EQ(0, second_line_lm.lookup("baz"));
+}
+
+TEST_F(CountWordsTest, merged_chunks) {
+  // merging chunk counts in order gives the counts of the whole file,
+  // with the same word indices
+  NaiveLanguageModel lm;
+  count_words(path, 0, text.size(), lm);
+  for (size_t num_chunks = 1; num_chunks <= 10; ++num_chunks) {
+    const vector<size_t> offsets(line_chunk_offsets(path, num_chunks));
+    NaiveLanguageModel merged_lm;
+    for (size_t c = 0; c < num_chunks; ++c) {
+      NaiveLanguageModel chunk_lm;
+      count_words(path, offsets[c], offsets[c + 1], chunk_lm);
+      merged_lm.merge(chunk_lm);
+    }
+    EXPECT_TRUE(lm.equals(merged_lm));
+  }
+}
+
+TEST_F(CountWordsTest, count_words_parallel) {
+  NaiveLanguageModel lm(0.5);
+  count_words(path, 0, text.size(), lm);
+  EXPECT_TRUE(lm.equals(count_words_parallel(path, 0.5)));
+}
+
+TEST_F(CountWordsTest, count_words_parallel_max_types) {
+  const NaiveLanguageModel lm(count_words_parallel(path, 0.5, 4));
+  EXPECT_EQ(4, lm.max_types());
+  EXPECT_LE(lm.size(), 4);
+  EXPECT_GT(lm.prune_threshold(), 0);
+  EXPECT_EQ(11, lm.total());
+}
+
+TEST(count_words_test, missing_file) {
+  EXPECT_THROW(count_words_parallel("/nonexistent/athena-count-test.txt"),
+               runtime_error);
+}
+
+TEST_F(CountWordsTest, count_words_external) {
+  char dir_template[] = "/tmp/athena-count-test-XXXXXX";
+  const string spill_dir(mkdtemp(dir_template));
+  // foo: 4, baz: 4, bar: 1, bbq: 1, qux: 1
+  for (size_t max_types = 1; max_types <= 4; ++max_types) {
+    auto lm(count_words_external(path, 3, max_types, spill_dir));
+    EXPECT_EQ(3, lm.size());
+    EXPECT_EQ(9, lm.total());
+    EXPECT_EQ("baz", lm.reverse_lookup(0));   EXPECT_EQ(4, lm.count(0));
+    EXPECT_EQ("foo", lm.reverse_lookup(1));   EXPECT_EQ(4, lm.count(1));
+    EXPECT_EQ("bar", lm.reverse_lookup(2));   EXPECT_EQ(1, lm.count(2));
+    EXPECT_EQ(1, lm.lookup("foo"));
+    auto all_lm(count_words_external(path, 10, max_types, spill_dir));
+    EXPECT_EQ(5, all_lm.size());
+    EXPECT_EQ(11, all_lm.total());
+    EXPECT_EQ("qux", all_lm.reverse_lookup(4));
+    EXPECT_EQ(0, count_words_external(path, 0, max_types, spill_dir).size());
+  }
+  // run files are removed
+  EXPECT_EQ(0, rmdir(spill_dir.c_str()));
+}
+
+TEST_F(CountWordsTest, count_words_external_in_memory) {
+  // same words and order as when spilling (ties by word)
+  auto lm(count_words_external(path, 3, 6, "/nonexistent"));
+  EXPECT_EQ(3, lm.size());
+  EXPECT_EQ(9, lm.total());
+  EXPECT_EQ("baz", lm.reverse_lookup(0));   EXPECT_EQ(4, lm.count(0));
+  EXPECT_EQ("foo", lm.reverse_lookup(1));   EXPECT_EQ(4, lm.count(1));
+  EXPECT_EQ("bar", lm.reverse_lookup(2));   EXPECT_EQ(1, lm.count(2));
+  char dir_template[] = "/tmp/athena-count-test-XXXXXX";
+  const string spill_dir(mkdtemp(dir_template));
+  EXPECT_TRUE(lm.equals(count_words_external(path, 3, 2, spill_dir)));
+  EXPECT_EQ(0, rmdir(spill_dir.c_str()));
+  EXPECT_THROW(count_words_external(path, 3, 5, "/nonexistent"),
+               runtime_error);
+  EXPECT_THROW(count_words_external(path, 3, 0, "/tmp"), invalid_argument);
+}
+
+TEST_F(CountWordsTest, count_words_external_multi_pass) {
+  // one type per run, so more runs than one merge takes
+  {
+    ofstream f(path.c_str(), ios::binary);
+    for (size_t i = 0; i < 3 * COUNT_MAX_MERGE_RUNS; ++i) {
+      for (size_t j = 0; j <= i % 7; ++j) {
+        f << "w" << (i % (2 * COUNT_MAX_MERGE_RUNS)) << " ";
+      }
+    }
+  }
+  char dir_template[] = "/tmp/athena-count-test-XXXXXX";
+  const string spill_dir(mkdtemp(dir_template));
+  auto lm(count_words_external(path, 50, 1, spill_dir));
+  EXPECT_TRUE(lm.equals(count_words_external(path, 50, SIZE_MAX, spill_dir)));
+  EXPECT_EQ(50, lm.size());
+  EXPECT_EQ(0, rmdir(spill_dir.c_str()));
+}
+
+TEST(hyperloglog_test, estimate) {
+  HyperLogLog sketch;
+  EXPECT_EQ(HYPERLOGLOG_PRECISION, sketch.precision());
+  EXPECT_EQ(0, sketch.estimate());
+  for (size_t t = 0; t < 3; ++t) {
+    for (size_t i = 0; i < 100; ++i) {
+      sketch.add(word_hash("w" + to_string(i)));
+    }
+  }
+  EXPECT_NEAR(100, sketch.estimate(), 2);
+
+  for (size_t i = 100; i < 100000; ++i) {
+    sketch.add(word_hash("w" + to_string(i)));
+  }
+  EXPECT_NEAR(100000, sketch.estimate(),
+              100000 * 3 * sketch.relative_error());
+  EXPECT_GE(presize_estimate(sketch), sketch.estimate());
+}
+
+TEST(hyperloglog_test, merge) {
+  HyperLogLog sketch, other, whole;
+  for (size_t i = 0; i < 2000; ++i) {
+    const uint64_t h = word_hash("w" + to_string(i));
+    (i < 1500 ? sketch : other).add(h);
+    whole.add(h);
+  }
+  // overlap is not counted twice
+  for (size_t i = 1000; i < 1500; ++i) {
+    other.add(word_hash("w" + to_string(i)));
+  }
+  sketch.merge(other);
+  EXPECT_EQ(whole.estimate(), sketch.estimate());
+  EXPECT_THROW(sketch.merge(HyperLogLog(10)), invalid_argument);
+  EXPECT_THROW(HyperLogLog(3), invalid_argument);
+  EXPECT_THROW(HyperLogLog(19), invalid_argument);
+}
+
+TEST_F(CountWordsTest, sketch_words) {
+  EXPECT_NEAR(5, sketch_words(path, 0, text.size()).estimate(), 0.5);
+  EXPECT_NEAR(4, sketch_words(path, 0, 26).estimate(), 0.5);
+}
+
+TEST_F(CountWordsTest, count_words_parallel_prescan) {
+  EXPECT_TRUE(count_words_parallel(path, 0.5).equals(
+    count_words_parallel(path, 0.5, 0, true)));
+}
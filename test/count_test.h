@@ -0,0 +1,38 @@
+#ifndef ATHENA_COUNT_TEST_H
+#define ATHENA_COUNT_TEST_H
+
+
+#include "_count.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+
+
+class CountWordsTest: public ::testing::Test {
+  protected:
+    std::string path;
+    std::string text;
+
+    virtual void SetUp() {
+      path = std::string("/tmp/athena-count-test-") +
+        std::to_string(getpid()) + ".txt";
+      // carriage returns are dropped; the last word has no newline
+      text = "foo bar foo\n"
+             "baz\tbaz  bbq\r\n"
+             "\n"
+             "foo qux baz\n"
+             "ba\rz foo";
+      std::ofstream f(path.c_str(), std::ios::binary);
+      f.write(text.data(), text.size());
+    }
+
+    virtual void TearDown() {
+      remove(path.c_str());
+    }
+};
+
+
+#endif
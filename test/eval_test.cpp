@@ -0,0 +1,93 @@
+#include "eval_test.h"
+#include "_core.h"
+#include "_eval.h"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <utility>
+
+
+using namespace std;
+
+
+TEST(spearman_correlation, perfect) {
+  EXPECT_DOUBLE_EQ(1, spearman_correlation({1, 2, 3, 4}, {10, 20, 25, 100}));
+  EXPECT_DOUBLE_EQ(-1, spearman_correlation({1, 2, 3, 4}, {4, 3, 2, 1}));
+}
+
+TEST(spearman_correlation, ties) {
+  // ranks (1, 2.5, 2.5, 4) and (1, 2, 3, 4)
+  EXPECT_NEAR(0.9486833,
+              spearman_correlation({1, 2, 2, 3}, {1, 2, 3, 4}), 1e-6);
+}
+
+TEST(spearman_correlation, constant) {
+  EXPECT_DOUBLE_EQ(1, spearman_correlation({2, 2}, {2, 2}));
+  EXPECT_DOUBLE_EQ(0, spearman_correlation({2, 2}, {1, 2}));
+  EXPECT_DOUBLE_EQ(1, spearman_correlation({}, {}));
+}
+
+TEST(spearman_correlation, size_mismatch) {
+  EXPECT_THROW(spearman_correlation({1, 2}, {1}), invalid_argument);
+}
+
+TEST_F(HeavyHitterAccuracyTest, top_words) {
+  const vector<pair<string,size_t> > top(top_words(exact, 3));
+  ASSERT_EQ(3, top.size());
+  EXPECT_EQ(make_pair(string("a"), (size_t) 5), top[0]);
+  EXPECT_EQ(make_pair(string("b"), (size_t) 4), top[1]);
+  EXPECT_EQ(make_pair(string("c"), (size_t) 3), top[2]);
+  EXPECT_EQ(5, top_words(exact, 10).size());
+}
+
+TEST_F(HeavyHitterAccuracyTest, exact) {
+  const HeavyHitterAccuracy accuracy(heavy_hitter_accuracy(exact, exact, 3));
+  EXPECT_DOUBLE_EQ(1, accuracy.precision);
+  EXPECT_DOUBLE_EQ(1, accuracy.recall);
+  EXPECT_DOUBLE_EQ(0, accuracy.mean_relative_error);
+  EXPECT_DOUBLE_EQ(0, accuracy.max_relative_error);
+  EXPECT_DOUBLE_EQ(1, accuracy.rank_correlation);
+}
+
+TEST_F(HeavyHitterAccuracyTest, approximate) {
+  // approximate: a: 5, b: 4, d: 6 (c untracked)
+  NaiveLanguageModel approximate;
+  for (size_t i = 0; i < 5; ++i) {
+    approximate.increment("a");
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    approximate.increment("b");
+  }
+  for (size_t i = 0; i < 6; ++i) {
+    approximate.increment("d");
+  }
+  const HeavyHitterAccuracy accuracy(
+    heavy_hitter_accuracy(exact, approximate, 3));
+  EXPECT_DOUBLE_EQ(2. / 3, accuracy.precision);
+  EXPECT_DOUBLE_EQ(2. / 3, accuracy.recall);
+  EXPECT_DOUBLE_EQ(1. / 3, accuracy.mean_relative_error);
+  EXPECT_DOUBLE_EQ(1, accuracy.max_relative_error);
+  EXPECT_DOUBLE_EQ(1, accuracy.rank_correlation);
+}
+
+TEST_F(HeavyHitterAccuracyTest, space_saving) {
+  SpaceSavingLanguageModel approximate(2);
+  for (size_t i = 0; i < 5; ++i) {
+    approximate.increment("a");
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    approximate.increment("b");
+  }
+  const HeavyHitterAccuracy accuracy(
+    heavy_hitter_accuracy(exact, approximate, 2));
+  EXPECT_DOUBLE_EQ(1, accuracy.precision);
+  EXPECT_DOUBLE_EQ(1, accuracy.recall);
+  EXPECT_DOUBLE_EQ(0, accuracy.mean_relative_error);
+}
+
+TEST(resident_memory, positive) {
+  EXPECT_LT(0, resident_memory());
+  EXPECT_LE(resident_memory(), peak_resident_memory());
+}
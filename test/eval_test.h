@@ -0,0 +1,30 @@
+#ifndef ATHENA_EVAL_TEST_H
+#define ATHENA_EVAL_TEST_H
+
+
+#include "_core.h"
+#include "_eval.h"
+
+#include <gtest/gtest.h>
+#include <string>
+
+
+class HeavyHitterAccuracyTest: public ::testing::Test {
+  protected:
+    NaiveLanguageModel exact;
+
+    virtual void SetUp() {
+      // a: 5, b: 4, c: 3, d: 2, e: 1
+      const std::string words("abcde");
+      for (size_t i = 0; i < words.size(); ++i) {
+        for (size_t j = i; j < words.size(); ++j) {
+          exact.increment(std::string(1, words[i]));
+        }
+      }
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
@@ -0,0 +1,213 @@
+#include "export_test.h"
+#include "_core.h"
+#include "_export.h"
+#include "_word2vec.h"
+#include "_cblas.h"
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+
+using namespace std;
+
+
+// text layout as produced by writing each value to the stream
+static string reference_text(const WordContextFactorization& factorization,
+                             const vector<string>& words,
+                             bool with_dims) {
+  stringstream f;
+  if (with_dims) {
+    f << factorization.get_vocab_dim() << " " <<
+      factorization.get_embedding_dim() << "\n";
+  }
+  for (size_t i = 0; i < factorization.get_vocab_dim(); ++i) {
+    if (! words.empty()) {
+      f << words[i] << " ";
+    }
+    for (size_t j = 0; j < factorization.get_embedding_dim(); ++j) {
+      f << factorization.get_word_embedding(i)[j] << " ";
+    }
+    f << "\n";
+  }
+  return f.str();
+}
+
+
+TEST_F(ExportTest, write_text_embeddings_matches_reference) {
+  for (size_t k = 0; k < 4; ++k) {
+    const bool with_words = (k & 1), with_dims = (k & 2);
+    const vector<string> row_words(with_words ? words : vector<string>());
+    stringstream f;
+    write_text_embeddings(f, *factorization, row_words, with_dims);
+    EXPECT_EQ(reference_text(*factorization, row_words, with_dims), f.str());
+  }
+}
+
+TEST_F(ExportTest, write_text_embeddings_shortest_round_trips) {
+  stringstream f;
+  write_text_embeddings(f, *factorization, words, true, true);
+  size_t vocab_dim, embedding_dim;
+  f >> vocab_dim >> embedding_dim;
+  EXPECT_EQ(5000, vocab_dim);
+  EXPECT_EQ(7, embedding_dim);
+  for (size_t i = 0; i < vocab_dim; ++i) {
+    string word;
+    f >> word;
+    ASSERT_EQ(words[i], word);
+    for (size_t j = 0; j < embedding_dim; ++j) {
+      string value;
+      f >> value;
+      ASSERT_EQ(factorization->get_word_embedding(i)[j],
+                strtof(value.c_str(), 0));
+    }
+  }
+}
+
+TEST_F(ExportTest, write_text_embeddings_too_few_words) {
+  stringstream f;
+  words.resize(10);
+  EXPECT_THROW(write_text_embeddings(f, *factorization, words, false),
+               logic_error);
+}
+
+TEST_F(ExportTest, write_word2vec_embeddings) {
+  stringstream f;
+  write_word2vec_embeddings(f, *factorization, words);
+  const string data(f.str());
+  auto model(Word2VecModel::parse(data.data(), data.size()));
+  ASSERT_EQ(5000, model->vocab_dim);
+  ASSERT_EQ(7, model->embedding_dim);
+  EXPECT_EQ(words, model->vocab);
+  for (size_t i = 0; i < 5000; ++i) {
+    const float *x = factorization->get_word_embedding(i);
+    const float norm = cblas_snrm2(7, x, 1);
+    for (size_t j = 0; j < 7; ++j) {
+      ASSERT_NEAR(x[j] / norm, model->word_embeddings[i * 7 + j], EPS);
+    }
+  }
+}
+
+TEST_F(ExportTest, write_word2vec_embeddings_too_few_words) {
+  stringstream f;
+  words.resize(10);
+  EXPECT_THROW(write_word2vec_embeddings(f, *factorization, words),
+               logic_error);
+}
+
+TEST_F(ExportTest, write_npy_embeddings) {
+  stringstream f;
+  write_npy_embeddings(f, *factorization);
+  const string data(f.str());
+  ASSERT_LE(10, data.size());
+  EXPECT_EQ(string("\x93NUMPY\x01\x00", 8), data.substr(0, 8));
+  const size_t header_size = (unsigned char) data[8] +
+    256 * (unsigned char) data[9];
+  EXPECT_EQ(0, (10 + header_size) % 64);
+  const string header(data.substr(10, header_size));
+  EXPECT_EQ(0, header.find("{'descr': '<f4', 'fortran_order': False, "
+                           "'shape': (5000, 7), }"));
+  EXPECT_EQ('\n', header[header.size() - 1]);
+  ASSERT_EQ(10 + header_size + 5000 * 7 * sizeof(float), data.size());
+  for (size_t i = 0; i < 5000; ++i) {
+    ASSERT_EQ(0, memcmp(factorization->get_word_embedding(i),
+                        data.data() + 10 + header_size + i * 7 * sizeof(float),
+                        7 * sizeof(float)));
+  }
+}
+
+TEST_F(ExportTest, write_raw_embeddings) {
+  stringstream f;
+  write_raw_embeddings(f, *factorization);
+  const string data(f.str());
+  RawEmbeddingsHeader header;
+  ASSERT_LE(sizeof(header), data.size());
+  memcpy(&header, data.data(), sizeof(header));
+  EXPECT_EQ(0, memcmp(RAW_EMBEDDINGS_MAGIC, header.magic, 8));
+  EXPECT_EQ(RAW_EMBEDDINGS_VERSION, header.version);
+  EXPECT_EQ(64, header.header_size);
+  EXPECT_EQ(5000, header.vocab_dim);
+  EXPECT_EQ(7, header.embedding_dim);
+  EXPECT_EQ(16, header.row_stride);
+  ASSERT_EQ(64 + 5000 * 16 * sizeof(float), data.size());
+  const float *matrix = reinterpret_cast<const float*>(data.data() + 64);
+  for (size_t i = 0; i < 5000; ++i) {
+    for (size_t j = 0; j < 16; ++j) {
+      ASSERT_EQ(j < 7 ? factorization->get_word_embedding(i)[j] : 0,
+                matrix[i * 16 + j]);
+    }
+  }
+}
+
+// a Space-Saving model that is not full covers only the first rows;
+// each format must export just those
+TEST_F(ExportTest, write_embeddings_not_full) {
+  SpaceSavingLanguageModel language_model(factorization->get_vocab_dim());
+  language_model.increment("foo");
+  language_model.increment("bar");
+  language_model.increment("foo");
+  const size_t num_rows = language_model.size();
+  ASSERT_EQ(2, num_rows);
+  vector<string> row_words;
+  for (size_t i = 0; i < num_rows; ++i) {
+    row_words.push_back(language_model.reverse_lookup(i));
+  }
+
+  stringstream text_f;
+  write_text_embeddings(text_f, *factorization, row_words, true, true,
+                        num_rows);
+  size_t vocab_dim, embedding_dim;
+  text_f >> vocab_dim >> embedding_dim;
+  EXPECT_EQ(2, vocab_dim);
+  EXPECT_EQ(7, embedding_dim);
+  size_t num_lines = 0;
+  string line;
+  while (getline(text_f, line)) {
+    if (! line.empty()) {
+      ++num_lines;
+    }
+  }
+  EXPECT_EQ(2, num_lines);
+
+  stringstream bin_f;
+  write_word2vec_embeddings(bin_f, *factorization, row_words, num_rows);
+  const string bin_data(bin_f.str());
+  auto model(Word2VecModel::parse(bin_data.data(), bin_data.size()));
+  ASSERT_EQ(2, model->vocab_dim);
+  EXPECT_EQ(row_words, model->vocab);
+
+  stringstream npy_f;
+  write_npy_embeddings(npy_f, *factorization, num_rows);
+  const string npy_data(npy_f.str());
+  const size_t header_size = (unsigned char) npy_data[8] +
+    256 * (unsigned char) npy_data[9];
+  EXPECT_NE(string::npos,
+            npy_data.substr(10, header_size).find("'shape': (2, 7)"));
+  EXPECT_EQ(10 + header_size + 2 * 7 * sizeof(float), npy_data.size());
+
+  stringstream raw_f;
+  write_raw_embeddings(raw_f, *factorization, num_rows);
+  const string raw_data(raw_f.str());
+  RawEmbeddingsHeader header;
+  ASSERT_LE(sizeof(header), raw_data.size());
+  memcpy(&header, raw_data.data(), sizeof(header));
+  EXPECT_EQ(2, header.vocab_dim);
+  EXPECT_EQ(64 + 2 * 16 * sizeof(float), raw_data.size());
+}
+
+TEST_F(ExportTest, write_vocab) {
+  stringstream f;
+  write_vocab(f, words);
+  for (size_t i = 0; i < words.size(); ++i) {
+    string line;
+    ASSERT_TRUE(getline(f, line).good());
+    EXPECT_EQ(words[i], line);
+  }
+  string line;
+  EXPECT_FALSE(getline(f, line).good());
+}
@@ -0,0 +1,33 @@
+#ifndef ATHENA_EXPORT_TEST_H
+#define ATHENA_EXPORT_TEST_H
+
+
+#include "_core.h"
+#include "_math.h"
+#include "test_util.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class ExportTest: public ::testing::Test {
+  protected:
+    std::shared_ptr<WordContextFactorization> factorization;
+    std::vector<std::string> words;
+
+    virtual void SetUp() {
+      seed(5);
+      // more rows than one chunk, so chunk boundaries are exercised
+      factorization = std::make_shared<WordContextFactorization>(5000, 7);
+      for (size_t i = 0; i < factorization->get_vocab_dim(); ++i) {
+        words.push_back(std::string("w") + std::to_string(i));
+      }
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
@@ -0,0 +1,109 @@
+#include "format_test.h"
+#include "_format.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <random>
+
+
+using namespace std;
+
+
+static string ostream_format(float x) {
+  stringstream s;
+  s << x;
+  return s.str();
+}
+
+static float from_bits(uint32_t bits) {
+  float x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+
+TEST(format_float_test, special_values) {
+  const float values[] = {
+    0.f, -0.f, 1.f, -1.f, 0.1f, 0.5f, 10.f, 100000.f, 999999.f,
+    1000000.f, 999999.5f, 9999995.f, 1e-4f, 1e-5f, 0.000123456f,
+    123456.5f, 1234565.f, 0.3f, 2.5f,
+    numeric_limits<float>::max(), numeric_limits<float>::min(),
+    numeric_limits<float>::denorm_min(), -numeric_limits<float>::max(),
+    numeric_limits<float>::infinity(), -numeric_limits<float>::infinity(),
+    numeric_limits<float>::quiet_NaN()
+  };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+    EXPECT_EQ(ostream_format(values[i]), format_to_string(format_float, values[i]));
+  }
+}
+
+TEST(format_float_test, random_bits_match_ostream) {
+  mt19937 rng(7);
+  for (size_t t = 0; t < 200000; ++t) {
+    const float x = from_bits(rng());
+    ASSERT_EQ(ostream_format(x), format_to_string(format_float, x)) << t;
+  }
+}
+
+TEST(format_float_test, random_embeddings_match_ostream) {
+  mt19937 rng(11);
+  normal_distribution<float> dist(0, 0.1);
+  for (size_t t = 0; t < 200000; ++t) {
+    const float x = dist(rng);
+    ASSERT_EQ(ostream_format(x), format_to_string(format_float, x)) << t;
+  }
+}
+
+TEST(format_float_precision_test, matches_printf) {
+  mt19937 rng(13);
+  char expected[64];
+  for (int precision = 1; precision <= 9; ++precision) {
+    for (size_t t = 0; t < 20000; ++t) {
+      const float x = from_bits(rng());
+      snprintf(expected, sizeof(expected), "%.*g", precision, (double) x);
+      char buf[FORMAT_FLOAT_MAX_SIZE];
+      ASSERT_EQ(string(expected),
+                string(buf, format_float_precision(x, precision, buf)));
+    }
+  }
+}
+
+TEST(format_float_shortest_test, examples) {
+  EXPECT_EQ("0.1", format_to_string(format_float_shortest, 0.1f));
+  EXPECT_EQ("1", format_to_string(format_float_shortest, 1.f));
+  EXPECT_EQ("-0", format_to_string(format_float_shortest, -0.f));
+  EXPECT_EQ("0.1234567", format_to_string(format_float_shortest, 0.1234567f));
+  EXPECT_EQ("3.4028235e+38", format_to_string(format_float_shortest,
+                                              numeric_limits<float>::max()));
+  EXPECT_EQ("1e-45", format_to_string(format_float_shortest,
+                                      numeric_limits<float>::denorm_min()));
+}
+
+TEST(format_float_shortest_test, round_trip) {
+  mt19937 rng(17);
+  for (size_t t = 0; t < 200000; ++t) {
+    const float x = from_bits(rng());
+    if (! std::isfinite(x)) {
+      continue;
+    }
+    const string s(format_to_string(format_float_shortest, x));
+    ASSERT_EQ(x, strtof(s.c_str(), 0)) << s;
+    // no shorter precision round-trips
+    char buf[FORMAT_FLOAT_MAX_SIZE + 1];
+    for (int precision = 1; precision < 9; ++precision) {
+      const size_t n = format_float_precision(x, precision, buf);
+      buf[n] = '\0';
+      if (strtof(buf, 0) == x) {
+        ASSERT_LE(s.size(), n) << s << " " << buf;
+        break;
+      }
+    }
+  }
+}
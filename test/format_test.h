@@ -0,0 +1,18 @@
+#ifndef ATHENA_FORMAT_TEST_H
+#define ATHENA_FORMAT_TEST_H
+
+
+#include "_format.h"
+
+#include <string>
+
+
+// return output of formatter on x as a string
+template <class Formatter>
+std::string format_to_string(Formatter formatter, float x) {
+  char buf[FORMAT_FLOAT_MAX_SIZE];
+  return std::string(buf, formatter(x, buf));
+}
+
+
+#endif
@@ -2,7 +2,14 @@
 #include "_log.h"
 
 #include <gtest/gtest.h>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
 
 
 using namespace std;
@@ -23,3 +30,152 @@ TEST(log_warning, does_not_crash) {
 TEST(log_error, does_not_crash) {
   error(__func__, "test" << endl);
 }
+
+TEST_F(LoggerTest, write_on_flush) {
+  logger->log("frame", LOG_LEVEL_INFO, "hello\n");
+  EXPECT_EQ("", stream.str());
+  logger->flush();
+  const string line(stream.str());
+  // YYYY-mm-dd HH:MM:SS.mmm: frame: level: message
+  ASSERT_EQ(23 + string(": frame: info: hello\n").size(), line.size());
+  EXPECT_EQ(": frame: info: hello\n", line.substr(23));
+  EXPECT_EQ('-', line[4]);
+  EXPECT_EQ(':', line[16]);
+  EXPECT_EQ('.', line[19]);
+}
+
+TEST_F(LoggerTest, write_on_destruction) {
+  logger->log("frame", LOG_LEVEL_WARNING, "hello\n");
+  logger.reset();
+  EXPECT_NE(string::npos, stream.str().find(": frame: warning: hello\n"));
+}
+
+TEST_F(LoggerTest, error_written_immediately) {
+  logger->log("frame", LOG_LEVEL_INFO, "first\n");
+  logger->log("frame", LOG_LEVEL_ERROR, "second\n");
+  const string s(stream.str());
+  EXPECT_NE(string::npos, s.find(": frame: info: first\n"));
+  EXPECT_LT(s.find("first"), s.find(": frame: error: second\n"));
+}
+
+TEST_F(LoggerTest, levels) {
+  EXPECT_EQ(LOG_LEVEL_INFO, logger->get_level());
+  EXPECT_FALSE(logger->enabled(LOG_LEVEL_DEBUG));
+  EXPECT_TRUE(logger->enabled(LOG_LEVEL_INFO));
+  EXPECT_TRUE(logger->enabled(LOG_LEVEL_ERROR));
+  logger->set_level(LOG_LEVEL_ERROR);
+  EXPECT_FALSE(logger->enabled(LOG_LEVEL_WARNING));
+  EXPECT_TRUE(logger->enabled(LOG_LEVEL_ERROR));
+  logger->set_level(LOG_LEVEL_NONE);
+  EXPECT_FALSE(logger->enabled(LOG_LEVEL_ERROR));
+}
+
+TEST_F(LoggerTest, drop_when_full) {
+  for (size_t i = 0; i < 20; ++i) {
+    logger->log("frame", LOG_LEVEL_INFO, "message " + to_string(i) + "\n");
+  }
+  EXPECT_GT(logger->num_dropped(), 0);
+  logger->flush();
+  const string s(stream.str());
+  EXPECT_NE(string::npos, s.find(": frame: info: message 0\n"));
+  EXPECT_EQ(string::npos, s.find(": frame: info: message 19\n"));
+  EXPECT_NE(string::npos,
+            s.find("Logger: warning: dropped " +
+                   to_string(logger->num_dropped()) + " messages"));
+
+  // space is reclaimed after flush
+  stream.str("");
+  logger->log("frame", LOG_LEVEL_INFO, "again\n");
+  logger->flush();
+  EXPECT_NE(string::npos, stream.str().find(": frame: info: again\n"));
+}
+
+TEST_F(LoggerTest, truncate_long_message) {
+  logger->log("frame", LOG_LEVEL_INFO, string(1000, 'x'));
+  logger->flush();
+  const string s(stream.str());
+  EXPECT_NE(string::npos, s.find("xxx"));
+  EXPECT_LT(s.size(), 1000);
+  EXPECT_EQ(0, logger->num_dropped());
+}
+
+TEST_F(LoggerTest, message_formatting_reset) {
+  {
+    LogMessage message(*logger, "frame", LOG_LEVEL_INFO);
+    message.stream() << fixed << setprecision(2) << 1.5 << "\n";
+  }
+  {
+    LogMessage message(*logger, "frame", LOG_LEVEL_INFO);
+    message.stream() << 1.5 << "\n";
+  }
+  logger->flush();
+  const string s(stream.str());
+  EXPECT_NE(string::npos, s.find(": frame: info: 1.50\n"));
+  EXPECT_NE(string::npos, s.find(": frame: info: 1.5\n"));
+}
+
+TEST(logger, parse_level) {
+  EXPECT_EQ(LOG_LEVEL_DEBUG, Logger::parse_level("debug"));
+  EXPECT_EQ(LOG_LEVEL_INFO, Logger::parse_level("info"));
+  EXPECT_EQ(LOG_LEVEL_WARNING, Logger::parse_level("warning"));
+  EXPECT_EQ(LOG_LEVEL_ERROR, Logger::parse_level("error"));
+  EXPECT_EQ(LOG_LEVEL_NONE, Logger::parse_level("none"));
+  EXPECT_THROW(Logger::parse_level("verbose"), invalid_argument);
+  EXPECT_STREQ("warning", Logger::level_name(LOG_LEVEL_WARNING));
+}
+
+TEST(logger, threads_with_flusher) {
+  const size_t num_threads = 4, num_messages = 1000;
+  ostringstream stream;
+  {
+    Logger logger(stream, LOG_LEVEL_INFO, 1 << 20, 1);
+    vector<thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+      threads.push_back(thread([&logger, t]() {
+        for (size_t i = 0; i < num_messages; ++i) {
+          logger.log("frame", LOG_LEVEL_INFO,
+                     to_string(t) + " " + to_string(i) + "\n");
+        }
+      }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+      it->join();
+    }
+    EXPECT_EQ(0, logger.num_dropped());
+  }
+
+  // every message is written once, in order within its thread
+  vector<size_t> next(num_threads, 0);
+  istringstream lines(stream.str());
+  string line;
+  size_t num_lines = 0;
+  while (getline(lines, line)) {
+    const size_t pos = line.find(": frame: info: ");
+    ASSERT_NE(string::npos, pos);
+    istringstream fields(line.substr(pos + 15));
+    size_t t, i;
+    fields >> t >> i;
+    ASSERT_LT(t, num_threads);
+    EXPECT_EQ(next[t], i);
+    next[t] = i + 1;
+    ++num_lines;
+  }
+  EXPECT_EQ(num_threads * num_messages, num_lines);
+}
+
+TEST(logger, destroyed_in_forked_child) {
+  ostringstream stream;
+  Logger *logger = new Logger(stream, LOG_LEVEL_INFO, 1 << 10, 1);
+  const pid_t pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    logger->log("frame", LOG_LEVEL_INFO, "child\n");
+    delete logger;
+    _exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  delete logger;
+}
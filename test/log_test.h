@@ -2,4 +2,27 @@
 #define ATHENA_LOG_TEST_H
 
 
+#include "_log.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+
+
+// Logger without a flusher thread, so tests control when messages are
+// written.
+
+class LoggerTest: public ::testing::Test {
+  protected:
+    std::ostringstream stream;
+    std::shared_ptr<Logger> logger;
+
+    virtual void SetUp() {
+      logger = std::make_shared<Logger>(stream, LOG_LEVEL_INFO, 256, 0);
+    }
+
+    virtual void TearDown() { }
+};
+
+
 #endif
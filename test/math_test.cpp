@@ -164,6 +164,77 @@ TEST(seed_test, seed_reset) {
   EXPECT_EQ(u1, u3);
 }
 
+TEST(seed_test, get_seed) {
+  seed(7);
+  EXPECT_EQ(7, get_seed());
+  const unsigned int s = seed_default();
+  EXPECT_EQ(s, get_seed());
+}
+
+TEST(seed_test, stream_seed) {
+  EXPECT_EQ(stream_seed(7, 3), stream_seed(7, 3));
+  EXPECT_NE(stream_seed(7, 3), stream_seed(7, 4));
+  EXPECT_NE(stream_seed(7, 3), stream_seed(8, 3));
+  // adjacent seeds do not share streams at adjacent keys
+  EXPECT_NE(stream_seed(7, 1), stream_seed(8, 0));
+}
+
+TEST(seed_test, seed_stream) {
+  seed(7);
+  uniform_int_distribution<long> d(0, 1000000);
+  seed_stream(3);
+  const long x1 = d(get_urng()), x2 = d(get_urng());
+
+  // draws after reseeding do not depend on previous draws
+  seed_stream(4);
+  d(get_urng());
+  seed_stream(3);
+  EXPECT_EQ(x1, d(get_urng()));
+  EXPECT_EQ(x2, d(get_urng()));
+
+  seed(8);
+  seed_stream(3);
+  EXPECT_NE(x1, d(get_urng()));
+}
+
+TEST(sample_uniform_index_test, range) {
+  seed(7);
+  vector<size_t> counts(3, 0);
+  for (size_t i = 0; i < 3000; ++i) {
+    const size_t k = sample_uniform_index(3);
+    ASSERT_LT(k, 3);
+    ++counts[k];
+  }
+  for (size_t k = 0; k < 3; ++k) {
+    EXPECT_NEAR(1000, counts[k], 150);
+  }
+  EXPECT_EQ(0, sample_uniform_index(1));
+}
+
+TEST(sample_uniform_index_test, large) {
+  seed(7);
+  const size_t n = ((size_t) 1 << 40) + 3;
+  bool high = false;
+  for (size_t i = 0; i < 100; ++i) {
+    const size_t k = sample_uniform_index(n);
+    ASSERT_LT(k, n);
+    high = high || (k >= ((size_t) 1 << 32));
+  }
+  EXPECT_TRUE(high);
+}
+
+TEST(sample_unit_float_test, range) {
+  seed(7);
+  double sum = 0;
+  for (size_t i = 0; i < 10000; ++i) {
+    const float u = sample_unit_float();
+    ASSERT_GE(u, 0);
+    ASSERT_LT(u, 1);
+    sum += u;
+  }
+  EXPECT_NEAR(0.5, sum / 10000, 0.02);
+}
+
 TEST(sample_gaussian_vector_test, moments) {
   const size_t num_samples = 100000;
   vector<float> x(num_samples, 0);
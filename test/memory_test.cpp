@@ -0,0 +1,130 @@
+#include "memory_test.h"
+#include "_memory.h"
+#include "_core.h"
+#include "_math.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+TEST_F(MemoryUsageTest, get) {
+  EXPECT_EQ(10, usage.get("a"));
+  EXPECT_EQ(5, usage.get("b"));
+  EXPECT_EQ(0, usage.get("c"));
+  EXPECT_EQ(2, usage.components().size());
+}
+
+TEST_F(MemoryUsageTest, total) {
+  EXPECT_EQ(15, usage.total());
+  EXPECT_EQ(0, MemoryUsage().total());
+}
+
+TEST_F(MemoryUsageTest, add_member) {
+  MemoryUsage outer;
+  outer.add("c", 1);
+  outer.add("inner", usage);
+  EXPECT_EQ(1, outer.get("c"));
+  EXPECT_EQ(10, outer.get("inner.a"));
+  EXPECT_EQ(5, outer.get("inner.b"));
+  EXPECT_EQ(0, outer.get("a"));
+  EXPECT_EQ(16, outer.total());
+}
+
+TEST_F(MemoryUsageTest, write) {
+  stringstream stream;
+  usage.write(stream);
+  string line;
+  ASSERT_TRUE(getline(stream, line));
+  EXPECT_NE(string::npos, line.find("a"));
+  EXPECT_NE(string::npos, line.find("10 B"));
+  ASSERT_TRUE(getline(stream, line));
+  EXPECT_NE(string::npos, line.find("5 B"));
+  ASSERT_TRUE(getline(stream, line));
+  EXPECT_NE(string::npos, line.find("total"));
+  EXPECT_NE(string::npos, line.find("15 B"));
+  EXPECT_FALSE(getline(stream, line));
+}
+
+TEST(string_heap_size, short_string) {
+  EXPECT_EQ(0, string_heap_size(string()));
+  EXPECT_EQ(0, string_heap_size(string("foo")));
+}
+
+TEST(string_heap_size, long_string) {
+  const string s(100, 'x');
+  EXPECT_EQ(s.capacity() + 1, string_heap_size(s));
+  EXPECT_EQ(s.capacity() + 1,
+            strings_heap_size(vector<string>{s, string("foo")}));
+}
+
+TEST(vector_heap_size, capacity) {
+  vector<long> v;
+  v.reserve(10);
+  v.push_back(1);
+  EXPECT_EQ(10 * sizeof(long), vector_heap_size(v));
+}
+
+TEST(reservoir_sampler_memory_usage, reservoir) {
+  ReservoirSampler<long> sampler(1000);
+  EXPECT_EQ(1000 * sizeof(long), sampler.memory_usage().get("reservoir"));
+  EXPECT_EQ(1000 * sizeof(long), sampler.memory_usage().total());
+}
+
+TEST(alias_sampler_memory_usage, tables) {
+  AliasSampler sampler(vector<float>{0.5, 0.25, 0.25});
+  const MemoryUsage usage(sampler.memory_usage());
+  EXPECT_EQ(3 * sizeof(size_t), usage.get("alias_table"));
+  EXPECT_EQ(3 * sizeof(float), usage.get("probability_table"));
+}
+
+TEST(word_context_factorization_memory_usage, padding) {
+  // rows of 10 floats are padded to 64 floats
+  WordContextFactorization factorization(3, 10);
+  const MemoryUsage usage(factorization.memory_usage());
+  EXPECT_EQ(3 * 10 * sizeof(float), usage.get("word_embeddings"));
+  EXPECT_EQ(3 * 10 * sizeof(float), usage.get("context_embeddings"));
+  EXPECT_EQ(2 * 3 * (64 - 10) * sizeof(float), usage.get("padding"));
+  EXPECT_EQ(2 * 3 * 64 * sizeof(float), usage.total());
+}
+
+TEST(sgd_memory_usage, state) {
+  SGD sgd(4);
+  const MemoryUsage usage(sgd.memory_usage());
+  EXPECT_EQ(4 * sizeof(float), usage.get("rho"));
+  EXPECT_EQ(4 * sizeof(size_t), usage.get("t"));
+}
+
+TEST(naive_language_model_memory_usage, components) {
+  NaiveLanguageModel language_model;
+  language_model.increment("foo");
+  language_model.increment(string(100, 'x'));
+  const MemoryUsage usage(language_model.memory_usage());
+  EXPECT_GE(usage.get("counters"), 2 * sizeof(size_t));
+  // each word is stored once, in the vocabulary arena
+  EXPECT_GE(usage.get("words.bytes"), 103);
+  EXPECT_LT(usage.get("words.bytes"), 2 * 100);
+  EXPECT_GE(usage.get("words.offsets"), 2 * sizeof(size_t));
+  EXPECT_GT(usage.get("words.table"), 0);
+}
+
+TEST(space_saving_language_model_memory_usage, reserved) {
+  SpaceSavingLanguageModel language_model(10);
+  const MemoryUsage empty_usage(language_model.memory_usage());
+  EXPECT_EQ(10 * sizeof(size_t), empty_usage.get("words.offsets"));
+  EXPECT_EQ(10 * sizeof(long), empty_usage.get("internal_ids"));
+  EXPECT_EQ(10 * sizeof(long), empty_usage.get("external_ids"));
+  EXPECT_EQ(0, empty_usage.get("words.bytes"));
+  EXPECT_GT(empty_usage.get("words.table"), 0);
+
+  language_model.increment(string(100, 'x'));
+  const MemoryUsage usage(language_model.memory_usage());
+  EXPECT_GE(usage.get("words.bytes"), 100);
+  EXPECT_EQ(empty_usage.get("words.offsets"), usage.get("words.offsets"));
+  EXPECT_EQ(empty_usage.get("words.table"), usage.get("words.table"));
+  EXPECT_EQ(empty_usage.get("counters"), usage.get("counters"));
+}
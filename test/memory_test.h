@@ -0,0 +1,24 @@
+#ifndef ATHENA_MEMORY_TEST_H
+#define ATHENA_MEMORY_TEST_H
+
+
+#include "_memory.h"
+
+#include <gtest/gtest.h>
+
+
+class MemoryUsageTest: public ::testing::Test {
+  protected:
+    MemoryUsage usage;
+
+    virtual void SetUp() {
+      usage.add("a", 3);
+      usage.add("b", 5);
+      usage.add("a", 7);
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
@@ -0,0 +1,183 @@
+#include "metrics_test.h"
+#include "_metrics.h"
+
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace std;
+
+
+static string read_file(const string& path) {
+  ifstream f(path.c_str());
+  stringstream contents;
+  contents << f.rdbuf();
+  return contents.str();
+}
+
+
+TEST(Counter, increment) {
+  Counter counter;
+  EXPECT_EQ(0, counter.value());
+  counter.increment();
+  counter.increment(5);
+  EXPECT_EQ(6, counter.value());
+}
+
+TEST(Counter, threads) {
+  Counter counter;
+  vector<thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.push_back(thread([&counter]() {
+      for (size_t i = 0; i < 1000; ++i) {
+        counter.increment();
+      }
+    }));
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it) {
+    it->join();
+  }
+  EXPECT_EQ(4000, counter.value());
+}
+
+TEST(Gauge, set) {
+  Gauge gauge;
+  EXPECT_EQ(0, gauge.value());
+  gauge.set(2.5);
+  EXPECT_EQ(2.5, gauge.value());
+  gauge.set(-1);
+  EXPECT_EQ(-1, gauge.value());
+}
+
+TEST(Histogram, empty) {
+  Histogram histogram;
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.sum());
+  EXPECT_EQ(0, histogram.quantile(0.5));
+}
+
+TEST(Histogram, count_sum) {
+  Histogram histogram;
+  histogram.record(1);
+  histogram.record(2.5);
+  histogram.record(0);
+  EXPECT_EQ(3, histogram.count());
+  EXPECT_DOUBLE_EQ(3.5, histogram.sum());
+}
+
+TEST(Histogram, quantile_relative_error) {
+  Histogram histogram;
+  for (size_t i = 1; i <= 1000; ++i) {
+    histogram.record(i * 1e-6);
+  }
+  EXPECT_NEAR(500e-6, histogram.quantile(0.5), 500e-6 / 16);
+  EXPECT_NEAR(900e-6, histogram.quantile(0.9), 900e-6 / 16);
+  EXPECT_NEAR(990e-6, histogram.quantile(0.99), 990e-6 / 16);
+  EXPECT_NEAR(1e-6, histogram.quantile(0), 1e-6 / 16);
+  EXPECT_NEAR(1000e-6, histogram.quantile(1), 1000e-6 / 16);
+}
+
+TEST(Histogram, quantile_wide_range) {
+  Histogram histogram;
+  histogram.record(1e-9);
+  histogram.record(1e9);
+  EXPECT_NEAR(1e-9, histogram.quantile(0.5), 1e-9 / 16);
+  EXPECT_NEAR(1e9, histogram.quantile(1), 1e9 / 16);
+}
+
+TEST(Histogram, zero_and_negative) {
+  Histogram histogram;
+  histogram.record(0);
+  histogram.record(-3);
+  EXPECT_EQ(2, histogram.count());
+  EXPECT_EQ(0, histogram.sum());
+  EXPECT_EQ(0, histogram.quantile(1));
+}
+
+TEST(MetricsRegistry, same_metric) {
+  MetricsRegistry registry;
+  Counter& a(registry.counter("a_total", "A."));
+  a.increment();
+  EXPECT_EQ(&a, &registry.counter("a_total", "A."));
+  EXPECT_EQ(1, registry.counter("a_total", "A.").value());
+}
+
+TEST(MetricsRegistry, type_conflict) {
+  MetricsRegistry registry;
+  registry.counter("a", "A.");
+  EXPECT_THROW(registry.gauge("a", "A."), logic_error);
+  EXPECT_THROW(registry.histogram("a", "A."), logic_error);
+}
+
+TEST(MetricsRegistry, write_prometheus) {
+  MetricsRegistry registry;
+  registry.counter("c_total", "A counter.").increment(3);
+  registry.gauge("g", "A gauge.").set(0.25);
+  Histogram& h(registry.histogram("h_seconds", "A histogram."));
+  h.record(0);
+  h.record(0);
+  stringstream stream;
+  registry.write_prometheus(stream);
+  EXPECT_EQ(
+    "# HELP c_total A counter.\n"
+    "# TYPE c_total counter\n"
+    "c_total 3\n"
+    "# HELP g A gauge.\n"
+    "# TYPE g gauge\n"
+    "g 0.25\n"
+    "# HELP h_seconds A histogram.\n"
+    "# TYPE h_seconds summary\n"
+    "h_seconds{quantile=\"0.5\"} 0\n"
+    "h_seconds{quantile=\"0.9\"} 0\n"
+    "h_seconds{quantile=\"0.99\"} 0\n"
+    "h_seconds{quantile=\"0.999\"} 0\n"
+    "h_seconds_sum 0\n"
+    "h_seconds_count 2\n",
+    stream.str());
+}
+
+TEST(TrainingMetrics, names) {
+  MetricsRegistry registry;
+  TrainingMetrics metrics(registry);
+  metrics.tokens.increment(10);
+  EXPECT_EQ(10, registry.counter("athena_tokens_total", "").value());
+  EXPECT_EQ(&metrics.sentence_train_seconds,
+            &registry.histogram("athena_sentence_train_seconds", ""));
+}
+
+TEST_F(MetricsExporterTest, write_on_start_and_stop) {
+  MetricsRegistry registry;
+  Counter& counter(registry.counter("c_total", "A counter."));
+  MetricsExporter exporter(registry, path, 1000);
+  EXPECT_NE(string::npos, read_file(path).find("c_total 0\n"));
+  counter.increment();
+  exporter.stop();
+  EXPECT_NE(string::npos, read_file(path).find("c_total 1\n"));
+  // stopping twice is harmless
+  exporter.stop();
+}
+
+TEST_F(MetricsExporterTest, periodic_write) {
+  MetricsRegistry registry;
+  Counter& counter(registry.counter("c_total", "A counter."));
+  MetricsExporter exporter(registry, path, 0.01);
+  counter.increment(7);
+  for (size_t i = 0; i < 500; ++i) {
+    if (read_file(path).find("c_total 7\n") != string::npos) {
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  EXPECT_NE(string::npos, read_file(path).find("c_total 7\n"));
+}
+
+TEST_F(MetricsExporterTest, bad_path) {
+  MetricsRegistry registry;
+  EXPECT_THROW(MetricsExporter(registry, "/nonexistent/dir/metrics.prom"),
+               runtime_error);
+}
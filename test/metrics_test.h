@@ -0,0 +1,29 @@
+#ifndef ATHENA_METRICS_TEST_H
+#define ATHENA_METRICS_TEST_H
+
+
+#include "_metrics.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdio>
+#include <unistd.h>
+
+
+class MetricsExporterTest: public ::testing::Test {
+  protected:
+    std::string path;
+
+    virtual void SetUp() {
+      char dir_template[] = "/tmp/athena-metrics-test-XXXXXX";
+      path = std::string(mkdtemp(dir_template)) + "/metrics.prom";
+    }
+
+    virtual void TearDown() {
+      remove(path.c_str());
+      rmdir(path.substr(0, path.rfind('/')).c_str());
+    }
+};
+
+
+#endif
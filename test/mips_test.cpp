@@ -0,0 +1,133 @@
+#include "mips_test.h"
+#include "test_util.h"
+#include "_core.h"
+#include "_mips.h"
+#include "_sgns.h"
+#include "_cblas.h"
+#include "_math.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+
+using namespace std;
+
+
+static vector<pair<long,float> > brute_force_search(
+    WordContextFactorization& factorization, const float *query,
+    size_t k) {
+  vector<pair<long,float> > scores;
+  for (size_t i = 0; i < factorization.get_vocab_dim(); ++i) {
+    scores.push_back(make_pair((long) i, cblas_sdot(
+      factorization.get_embedding_dim(), query, 1,
+      factorization.get_word_embedding(i), 1)));
+  }
+  stable_sort(scores.begin(), scores.end(),
+              [](const pair<long,float>& x, const pair<long,float>& y) {
+                return x.second > y.second;
+              });
+  scores.resize(min(k, scores.size()));
+  return scores;
+}
+
+
+TEST_F(MIPSIndexTest, structure) {
+  MIPSIndex index(*factorization, 400, 4, 8);
+  EXPECT_EQ(400, index.size());
+  EXPECT_LE(1, index.num_lists());
+  EXPECT_GE(32, index.num_lists());
+}
+
+TEST_F(MIPSIndexTest, search_empty) {
+  MIPSIndex index(*factorization, 0);
+  EXPECT_EQ(0, index.size());
+  EXPECT_TRUE(index.search(factorization->get_context_embedding(0), 5, 10).empty());
+}
+
+TEST_F(MIPSIndexTest, search_all_probes_is_exact) {
+  MIPSIndex index(*factorization, 400, 4, 8);
+  for (size_t q = 0; q < 50; ++q) {
+    const float *query = factorization->get_context_embedding(q);
+    auto expected(brute_force_search(*factorization, query, 10));
+    auto actual(index.search(query, 10, index.num_lists()));
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i].first, actual[i].first);
+      EXPECT_NEAR(expected[i].second, actual[i].second, EPS);
+    }
+  }
+}
+
+TEST_F(MIPSIndexTest, search_k_exceeds_size) {
+  MIPSIndex index(*factorization, 30, 2, 4);
+  auto results(index.search(factorization->get_context_embedding(0), 100,
+                            index.num_lists()));
+  EXPECT_EQ(30, results.size());
+  for (size_t i = 1; i < results.size(); ++i) {
+    EXPECT_GE(results[i - 1].second, results[i].second);
+  }
+}
+
+TEST_F(MIPSIndexTest, search_partial_probes_recall) {
+  MIPSIndex index(*factorization, 400, 4, 8);
+  const size_t k = 10;
+  size_t hits = 0;
+  for (size_t q = 0; q < 50; ++q) {
+    const float *query = factorization->get_context_embedding(q);
+    auto expected(brute_force_search(*factorization, query, k));
+    auto actual(index.search(query, k, index.num_lists() / 4));
+    EXPECT_EQ(k, actual.size());
+    for (auto it = actual.begin(); it != actual.end(); ++it) {
+      EXPECT_NEAR(cblas_sdot(factorization->get_embedding_dim(), query, 1,
+                             factorization->get_word_embedding(it->first), 1),
+                  it->second, EPS);
+      for (auto e_it = expected.begin(); e_it != expected.end(); ++e_it) {
+        if (e_it->first == it->first) {
+          ++hits;
+        }
+      }
+    }
+  }
+  EXPECT_LE(0.5, hits / (float) (50 * k));
+}
+
+TEST_F(MIPSTokenLearnerTest, find_context_nearest_neighbor_idx_all_candidates_is_exact) {
+  MIPSIndex index(token_learner->factorization, 300);
+  long word_ids[5];
+  for (size_t t = 0; t < 40; ++t) {
+    for (size_t i = 0; i < 5; ++i) {
+      word_ids[i] = (t * 7 + i * 31) % 300;
+    }
+    word_ids[2] = -1;
+    if (t % 5 == 0) {
+      word_ids[0] = -1;
+    }
+    EXPECT_EQ(token_learner->find_context_nearest_neighbor_idx(2, 2, word_ids),
+              token_learner->find_context_nearest_neighbor_idx(
+                2, 2, word_ids, index, 300, index.num_lists()));
+  }
+}
+
+TEST_F(MIPSTokenLearnerTest, find_context_nearest_neighbor_idx_few_candidates) {
+  MIPSIndex index(token_learner->factorization, 300);
+  long word_ids[3];
+  size_t agreements = 0;
+  for (size_t t = 0; t < 40; ++t) {
+    word_ids[0] = (t * 13) % 300;
+    word_ids[1] = -1;
+    word_ids[2] = (t * 29 + 5) % 300;
+    const long exact_idx =
+      token_learner->find_context_nearest_neighbor_idx(1, 1, word_ids);
+    const long approx_idx =
+      token_learner->find_context_nearest_neighbor_idx(
+        1, 1, word_ids, index, 20, index.num_lists());
+    EXPECT_LE(0, approx_idx);
+    EXPECT_GT(300, approx_idx);
+    if (exact_idx == approx_idx) {
+      ++agreements;
+    }
+  }
+  EXPECT_LE(30, agreements);
+}
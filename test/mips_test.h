@@ -0,0 +1,62 @@
+#ifndef ATHENA_MIPS_TEST_H
+#define ATHENA_MIPS_TEST_H
+
+
+#include "_core.h"
+#include "_mips.h"
+#include "_sgns.h"
+#include "_math.h"
+#include "core_mock.h"
+#include "sgns_mock.h"
+#include "test_util.h"
+
+#include <gtest/gtest.h>
+
+
+using ::testing::Return;
+
+
+class MIPSIndexTest: public ::testing::Test {
+  protected:
+    std::shared_ptr<WordContextFactorization> factorization;
+
+    virtual void SetUp() {
+      seed(17);
+      factorization = std::make_shared<WordContextFactorization>(400, 12);
+      // spread norms out so that norm bucketing matters
+      for (size_t i = 0; i < factorization->get_vocab_dim(); ++i) {
+        sample_centered_uniform_vector(
+          factorization->get_embedding_dim(),
+          factorization->get_context_embedding(i));
+        for (size_t j = 0; j < factorization->get_embedding_dim(); ++j) {
+          factorization->get_word_embedding(i)[j] *= 1 + (i % 7);
+        }
+      }
+    }
+
+    virtual void TearDown() { }
+};
+
+class MIPSTokenLearnerTest: public ::testing::Test {
+  protected:
+    std::shared_ptr<SGNSTokenLearner<MockLanguageModel, MockSamplingStrategy> > token_learner;
+
+    virtual void SetUp() {
+      seed(23);
+      token_learner = std::make_shared<SGNSTokenLearner<MockLanguageModel, MockSamplingStrategy> >(
+        WordContextFactorization(300, 8),
+        MockSamplingStrategy(),
+        MockLanguageModel(),
+        SGD(300, 2, 0.5, 0.1));
+      EXPECT_CALL(token_learner->language_model, size()).WillRepeatedly(Return(300));
+      for (size_t i = 0; i < 300; ++i) {
+        sample_centered_uniform_vector(
+          8, token_learner->factorization.get_context_embedding(i));
+      }
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
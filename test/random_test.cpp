@@ -0,0 +1,131 @@
+#include "random_test.h"
+#include "_random.h"
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+using namespace std;
+
+
+TEST(philox4x32, block_known_answers) {
+  // Random123 known-answer tests for philox4x32_10
+  uint32_t out[4];
+
+  const uint32_t zero_counter[4] = {0, 0, 0, 0}, zero_key[2] = {0, 0};
+  Philox4x32::block(zero_counter, zero_key, out);
+  EXPECT_EQ(0x6627e8d5u, out[0]);
+  EXPECT_EQ(0xe169c58du, out[1]);
+  EXPECT_EQ(0xbc57ac4cu, out[2]);
+  EXPECT_EQ(0x9b00dbd8u, out[3]);
+
+  const uint32_t ones_counter[4] = {
+    0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu
+  }, ones_key[2] = {0xffffffffu, 0xffffffffu};
+  Philox4x32::block(ones_counter, ones_key, out);
+  EXPECT_EQ(0x408f276du, out[0]);
+  EXPECT_EQ(0x41c83b0eu, out[1]);
+  EXPECT_EQ(0xa20bc7c6u, out[2]);
+  EXPECT_EQ(0x6d5451fdu, out[3]);
+
+  const uint32_t pi_counter[4] = {
+    0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u
+  }, pi_key[2] = {0xa4093822u, 0x299f31d0u};
+  Philox4x32::block(pi_counter, pi_key, out);
+  EXPECT_EQ(0xd16cfe09u, out[0]);
+  EXPECT_EQ(0x94fdccebu, out[1]);
+  EXPECT_EQ(0x5001e420u, out[2]);
+  EXPECT_EQ(0x24126ea1u, out[3]);
+}
+
+TEST_F(Philox4x32Test, first_block) {
+  const uint32_t counter[4] = {0, 0, 0, 0}, key[2] = {42, 0};
+  uint32_t out[4];
+  Philox4x32::block(counter, key, out);
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(out[i], engine());
+  }
+}
+
+TEST_F(Philox4x32Test, seed_reset) {
+  const uint32_t x = engine(), y = engine();
+  EXPECT_NE(x, y);
+  engine.seed(42);
+  EXPECT_EQ(x, engine());
+  EXPECT_EQ(y, engine());
+  engine.seed(43);
+  EXPECT_NE(x, engine());
+}
+
+TEST_F(Philox4x32Test, fill_matches_calls) {
+  // odd offsets and lengths exercise the buffer and partial batches
+  Philox4x32 other(42);
+  for (size_t n = 0; n < 200; n += 7) {
+    vector<uint32_t> filled(n);
+    engine.fill(filled.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_EQ(other(), filled[i]);
+    }
+  }
+  EXPECT_EQ(other(), engine());
+}
+
+TEST_F(Philox4x32Test, fill_unit_float) {
+  Philox4x32 other(42);
+  vector<float> u(1000);
+  engine.fill_unit_float(u.data(), u.size());
+  double sum = 0;
+  for (size_t i = 0; i < u.size(); ++i) {
+    EXPECT_EQ(unit_float(other()), u[i]);
+    EXPECT_GE(u[i], 0);
+    EXPECT_LT(u[i], 1);
+    sum += u[i];
+  }
+  EXPECT_NEAR(0.5, sum / u.size(), 0.05);
+}
+
+TEST_F(Philox4x32Test, std_distribution) {
+  uniform_int_distribution<int> d(0, 9);
+  vector<size_t> counts(10, 0);
+  for (size_t i = 0; i < 10000; ++i) {
+    ++counts[d(engine)];
+  }
+  for (size_t k = 0; k < 10; ++k) {
+    EXPECT_NEAR(1000, counts[k], 150);
+  }
+}
+
+TEST(bounded_uint32, range) {
+  EXPECT_EQ(0, bounded_uint32(0, 10));
+  EXPECT_EQ(9, bounded_uint32(UINT32_MAX, 10));
+  EXPECT_EQ(0, bounded_uint32(UINT32_MAX, 1));
+  EXPECT_EQ(5, bounded_uint32(1u << 31, 10));
+}
+
+TEST(bounded_uint32, uniform) {
+  Philox4x32 engine(7);
+  vector<size_t> counts(7, 0);
+  for (size_t i = 0; i < 70000; ++i) {
+    ++counts[bounded_uint32(engine(), 7)];
+  }
+  for (size_t k = 0; k < 7; ++k) {
+    EXPECT_NEAR(10000, counts[k], 500);
+  }
+}
+
+TEST(bounded_uint64, range) {
+  EXPECT_EQ(0, bounded_uint64(0, 10));
+  EXPECT_EQ(9, bounded_uint64(UINT64_MAX, 10));
+  EXPECT_EQ((1ull << 40) - 1, bounded_uint64(UINT64_MAX, 1ull << 40));
+  EXPECT_EQ(1ull << 39, bounded_uint64(1ull << 63, 1ull << 40));
+}
+
+TEST(unit_float, range) {
+  EXPECT_EQ(0, unit_float(0));
+  EXPECT_EQ(0, unit_float(255));
+  EXPECT_EQ(0.5, unit_float(1u << 31));
+  EXPECT_LT(unit_float(UINT32_MAX), 1);
+  EXPECT_GT(unit_float(UINT32_MAX), 0.9999f);
+}
@@ -0,0 +1,22 @@
+#ifndef ATHENA_RANDOM_TEST_H
+#define ATHENA_RANDOM_TEST_H
+
+
+#include "_random.h"
+
+#include <gtest/gtest.h>
+
+
+class Philox4x32Test: public ::testing::Test {
+  protected:
+    Philox4x32 engine;
+
+    virtual void SetUp() {
+      engine.seed(42);
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
@@ -0,0 +1,304 @@
+#include "serve_test.h"
+#include "test_util.h"
+#include "_core.h"
+#include "_serve.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+using namespace std;
+
+
+TEST(message_test, round_trip) {
+  MessageWriter writer;
+  writer.put_uint32(7);
+  writer.put_string("foo bar");
+  writer.put_float(-1.5);
+  writer.put_string("");
+
+  MessageReader reader(writer.str());
+  EXPECT_EQ(7, reader.get_uint32());
+  EXPECT_EQ("foo bar", reader.get_string());
+  EXPECT_EQ(-1.5, reader.get_float());
+  EXPECT_EQ("", reader.get_string());
+  EXPECT_TRUE(reader.done());
+}
+
+TEST(message_test, truncated) {
+  MessageWriter writer;
+  writer.put_uint32(10);
+  writer.put_float(1);
+
+  MessageReader reader(writer.str());
+  EXPECT_THROW(reader.get_string(), runtime_error);
+
+  MessageReader short_reader(writer.str().data(), 2);
+  EXPECT_THROW(short_reader.get_uint32(), runtime_error);
+}
+
+TEST_F(EmbeddingQueryHandlerTest, similarity) {
+  MessageWriter request;
+  request.put_string("a");
+  request.put_string("d");
+  string response;
+  EXPECT_EQ(QUERY_STATUS_OK, query(QUERY_OP_SIMILARITY, request, response));
+  MessageReader reader(response);
+  EXPECT_NEAR(1, reader.get_float(), EPS);
+  EXPECT_TRUE(reader.done());
+
+  EXPECT_NEAR(0, handler->similarity(0, 1), EPS);
+  EXPECT_NEAR(1 / sqrt(2.), handler->similarity(0, 2), EPS);
+}
+
+TEST_F(EmbeddingQueryHandlerTest, similarity_unknown_word) {
+  MessageWriter request;
+  request.put_string("a");
+  request.put_string("z");
+  string response;
+  EXPECT_EQ(QUERY_STATUS_UNKNOWN_WORD,
+            query(QUERY_OP_SIMILARITY, request, response));
+  EXPECT_EQ("", response);
+}
+
+TEST_F(EmbeddingQueryHandlerTest, neighbors) {
+  MessageWriter request;
+  request.put_string("a");
+  request.put_uint32(2);
+  string response;
+  EXPECT_EQ(QUERY_STATUS_OK, query(QUERY_OP_NEIGHBORS, request, response));
+  MessageReader reader(response);
+  EXPECT_EQ(2, reader.get_uint32());
+  EXPECT_EQ("d", reader.get_string());
+  EXPECT_NEAR(1, reader.get_float(), EPS);
+  EXPECT_EQ("c", reader.get_string());
+  EXPECT_NEAR(1 / sqrt(2.), reader.get_float(), EPS);
+  EXPECT_TRUE(reader.done());
+}
+
+TEST_F(EmbeddingQueryHandlerTest, neighbors_k_exceeds_vocab) {
+  auto results(handler->neighbors(0, 100));
+  ASSERT_EQ(4, results.size());
+  EXPECT_EQ(3, results[0].first);
+  EXPECT_EQ(2, results[1].first);
+  EXPECT_EQ(1, results[2].first);
+  EXPECT_EQ(4, results[3].first);
+}
+
+TEST_F(EmbeddingQueryHandlerTest, vector) {
+  MessageWriter request;
+  request.put_string("b");
+  string response;
+  EXPECT_EQ(QUERY_STATUS_OK, query(QUERY_OP_VECTOR, request, response));
+  MessageReader reader(response);
+  EXPECT_EQ(3, reader.get_uint32());
+  EXPECT_EQ(0, reader.get_float());
+  EXPECT_EQ(2, reader.get_float());
+  EXPECT_EQ(0, reader.get_float());
+  EXPECT_TRUE(reader.done());
+}
+
+TEST_F(EmbeddingQueryHandlerTest, context) {
+  const long word_ids[] = {0, -1, 4};
+  const long expected_idx = find_context_nearest_neighbor_idx(
+    *factorization, 1, 1, word_ids, MIPSIndex(*factorization, 5), 5, 100);
+
+  MessageWriter request;
+  request.put_uint32(1);
+  request.put_uint32(1);
+  request.put_string("a");
+  request.put_string("e");
+  string response;
+  EXPECT_EQ(QUERY_STATUS_OK, query(QUERY_OP_CONTEXT, request, response));
+  MessageReader reader(response);
+  EXPECT_EQ(language_model->reverse_lookup(expected_idx), reader.get_string());
+  EXPECT_NEAR(context_score(*factorization, expected_idx, 1, 1, word_ids),
+              reader.get_float(), EPS);
+  EXPECT_TRUE(reader.done());
+}
+
+TEST_F(EmbeddingQueryHandlerTest, context_too_large) {
+  MessageWriter request;
+  request.put_uint32(0xFFFFFFFF);
+  request.put_uint32(1);
+  string response;
+  EXPECT_EQ(QUERY_STATUS_BAD_REQUEST,
+            query(QUERY_OP_CONTEXT, request, response));
+
+  MessageWriter other_request;
+  other_request.put_uint32(1);
+  other_request.put_uint32(QUERY_MAX_CONTEXT);
+  EXPECT_EQ(QUERY_STATUS_BAD_REQUEST,
+            query(QUERY_OP_CONTEXT, other_request, response));
+}
+
+TEST_F(EmbeddingQueryHandlerTest, bad_request) {
+  MessageWriter request;
+  string response;
+  EXPECT_EQ(QUERY_STATUS_BAD_REQUEST, query(99, request, response));
+  EXPECT_THROW(query(QUERY_OP_VECTOR, request, response), runtime_error);
+}
+
+TEST_F(EmbeddingQueryHandlerTest, snapshot_handler) {
+  SnapshotPublisher<NaiveLanguageModel> publisher(0);
+  SnapshotQueryHandler<NaiveLanguageModel> snapshot_handler(publisher, 5, 100);
+  MessageWriter request;
+  request.put_string("a");
+  request.put_string("b");
+  MessageWriter response;
+
+  MessageReader reader1(request.str());
+  EXPECT_EQ(QUERY_STATUS_UNAVAILABLE,
+            snapshot_handler.handle(QUERY_OP_SIMILARITY, reader1, response));
+  EXPECT_EQ(-1, snapshot_handler.version());
+
+  publisher.publish(*factorization, *language_model);
+  MessageReader reader2(request.str());
+  EXPECT_EQ(QUERY_STATUS_OK,
+            snapshot_handler.handle(QUERY_OP_SIMILARITY, reader2, response));
+  EXPECT_NEAR(0, MessageReader(response.str()).get_float(), EPS);
+  EXPECT_EQ(0, snapshot_handler.version());
+
+  // later writes are visible only after the next publish
+  factorization->get_word_embedding(1)[0] = 2;
+  response.clear();
+  MessageReader reader3(request.str());
+  EXPECT_EQ(QUERY_STATUS_OK,
+            snapshot_handler.handle(QUERY_OP_SIMILARITY, reader3, response));
+  EXPECT_NEAR(0, MessageReader(response.str()).get_float(), EPS);
+
+  publisher.publish(*factorization, *language_model);
+  response.clear();
+  MessageReader reader4(request.str());
+  EXPECT_EQ(QUERY_STATUS_OK,
+            snapshot_handler.handle(QUERY_OP_SIMILARITY, reader4, response));
+  EXPECT_NEAR(1 / sqrt(2.), MessageReader(response.str()).get_float(), EPS);
+  EXPECT_EQ(1, snapshot_handler.version());
+}
+
+TEST_F(EmbeddingQueryHandlerTest, server_round_trip) {
+  const string socket_path(
+    string("/tmp/athena-serve-test-") + to_string(getpid()) + ".sock");
+  QueryServer server(
+    socket_path,
+    [this](uint32_t op, MessageReader& request, MessageWriter& response) {
+      return handler->handle(op, request, response);
+    },
+    2);
+  server.listen();
+  thread server_thread([&server]() { server.run(); });
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_LE(0, fd);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+
+  // two requests on one connection, answered in order
+  for (size_t t = 0; t < 2; ++t) {
+    MessageWriter request;
+    request.put_string("a");
+    request.put_string(t == 0 ? "d" : "z");
+    const uint32_t header[2] = {
+      QUERY_OP_SIMILARITY, (uint32_t) request.str().size()
+    };
+    ASSERT_TRUE(write_fully(fd, header, sizeof(header)));
+    ASSERT_TRUE(write_fully(fd, request.str().data(), request.str().size()));
+
+    uint32_t response_header[2];
+    ASSERT_TRUE(read_fully(fd, response_header, sizeof(response_header)));
+    if (t == 0) {
+      EXPECT_EQ(QUERY_STATUS_OK, response_header[0]);
+      ASSERT_EQ(sizeof(float), response_header[1]);
+      float similarity;
+      ASSERT_TRUE(read_fully(fd, &similarity, sizeof(similarity)));
+      EXPECT_NEAR(1, similarity, EPS);
+    } else {
+      EXPECT_EQ(QUERY_STATUS_UNKNOWN_WORD, response_header[0]);
+      EXPECT_EQ(0, response_header[1]);
+    }
+  }
+
+  // trailing bytes make a request malformed
+  {
+    MessageWriter request;
+    request.put_string("b");
+    request.put_uint32(0);
+    const uint32_t header[2] = {
+      QUERY_OP_VECTOR, (uint32_t) request.str().size()
+    };
+    ASSERT_TRUE(write_fully(fd, header, sizeof(header)));
+    ASSERT_TRUE(write_fully(fd, request.str().data(), request.str().size()));
+    uint32_t response_header[2];
+    ASSERT_TRUE(read_fully(fd, response_header, sizeof(response_header)));
+    EXPECT_EQ(QUERY_STATUS_BAD_REQUEST, response_header[0]);
+    EXPECT_EQ(0, response_header[1]);
+  }
+
+  close(fd);
+  server.stop();
+  server_thread.join();
+}
+
+TEST(read_fully_test, deadline) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  // half a value, then nothing more: give up at the deadline
+  const uint16_t half = 1;
+  ASSERT_TRUE(write_fully(fds[1], &half, sizeof(half)));
+  uint32_t x;
+  const auto start = chrono::steady_clock::now();
+  EXPECT_FALSE(read_fully(fds[0], &x, sizeof(x),
+                          start + chrono::milliseconds(50)));
+  EXPECT_GT(chrono::seconds(2), chrono::steady_clock::now() - start);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(query_server_test, handler_error) {
+  const string socket_path(
+    string("/tmp/athena-serve-error-test-") + to_string(getpid()) + ".sock");
+  QueryServer server(
+    socket_path,
+    [](uint32_t op, MessageReader& request, MessageWriter& response) -> uint32_t {
+      response.put_uint32(op);
+      throw out_of_range("handler failed");
+    },
+    1);
+  server.listen();
+  thread server_thread([&server]() { server.run(); });
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_LE(0, fd);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+
+  // answered with an error frame, and the connection stays usable
+  for (size_t t = 0; t < 2; ++t) {
+    const uint32_t header[2] = {QUERY_OP_VECTOR, 0};
+    ASSERT_TRUE(write_fully(fd, header, sizeof(header)));
+    uint32_t response_header[2];
+    ASSERT_TRUE(read_fully(fd, response_header, sizeof(response_header)));
+    EXPECT_EQ(QUERY_STATUS_ERROR, response_header[0]);
+    EXPECT_EQ(0, response_header[1]);
+  }
+
+  close(fd);
+  server.stop();
+  server_thread.join();
+}
@@ -0,0 +1,57 @@
+#ifndef ATHENA_SERVE_TEST_H
+#define ATHENA_SERVE_TEST_H
+
+
+#include "_core.h"
+#include "_serve.h"
+#include "_math.h"
+#include "test_util.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+
+
+class EmbeddingQueryHandlerTest: public ::testing::Test {
+  protected:
+    std::shared_ptr<WordContextFactorization> factorization;
+    std::shared_ptr<NaiveLanguageModel> language_model;
+    std::shared_ptr<EmbeddingQueryHandler<NaiveLanguageModel> > handler;
+
+    virtual void SetUp() {
+      seed(31);
+      factorization = std::make_shared<WordContextFactorization>(6, 3);
+      language_model = std::make_shared<NaiveLanguageModel>();
+      const char *words[] = {"a", "b", "c", "d", "e"};
+      for (size_t i = 0; i < 5; ++i) {
+        language_model->increment(words[i]);
+        sample_centered_uniform_vector(
+          3, factorization->get_context_embedding(i));
+      }
+      // "d" is parallel to "a"; "b" is orthogonal to "a"
+      const float embeddings[5][3] = {
+        {1, 0, 0}, {0, 2, 0}, {1, 1, 0}, {3, 0, 0}, {0, 0, -1}
+      };
+      for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          factorization->get_word_embedding(i)[j] = embeddings[i][j];
+        }
+      }
+      handler = std::make_shared<EmbeddingQueryHandler<NaiveLanguageModel> >(
+        *factorization, *language_model, 5, 100);
+    }
+
+    virtual void TearDown() { }
+
+    uint32_t query(uint32_t op, const MessageWriter& request,
+                   std::string& response) {
+      MessageReader reader(request.str());
+      MessageWriter writer;
+      const uint32_t status = handler->handle(op, reader, writer);
+      response = writer.str();
+      return status;
+    }
+};
+
+
+#endif
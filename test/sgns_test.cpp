@@ -340,7 +340,7 @@ TEST_F(SGNSSentenceLearnerTest, sentence_train_zero) {
   EXPECT_CALL(sentence_learner->token_learner, reset_word(_)).Times(0);
   EXPECT_CALL(sentence_learner->token_learner, token_train(_, _, _)).Times(0);
 
-  sentence_learner->sentence_train(words);
+  EXPECT_EQ(0, sentence_learner->sentence_train(words));
 }
 
 TEST_F(SGNSSentenceLearnerTest, sentence_train_one) {
@@ -354,7 +354,7 @@ TEST_F(SGNSSentenceLearnerTest, sentence_train_one) {
   EXPECT_CALL(sentence_learner->token_learner, reset_word(_)).Times(0);
   EXPECT_CALL(sentence_learner->token_learner, token_train(_, _, _)).Times(0);
 
-  sentence_learner->sentence_train(words);
+  EXPECT_EQ(0, sentence_learner->sentence_train(words));
 }
 
 TEST_F(SGNSSentenceLearnerTest, sentence_train_empty_context) {
@@ -374,7 +374,7 @@ TEST_F(SGNSSentenceLearnerTest, sentence_train_empty_context) {
   EXPECT_CALL(sentence_learner->token_learner, reset_word(_)).Times(0);
   EXPECT_CALL(sentence_learner->token_learner, token_train(_, _, _)).Times(0);
 
-  sentence_learner->sentence_train(words);
+  EXPECT_EQ(0, sentence_learner->sentence_train(words));
 }
 
 TEST_F(SGNSSentenceLearnerTest, sentence_train_short) {
@@ -398,7 +398,7 @@ TEST_F(SGNSSentenceLearnerTest, sentence_train_short) {
   EXPECT_CALL(sentence_learner->token_learner, token_train(1, 0, 5));
   EXPECT_CALL(sentence_learner->token_learner, token_train(1, 2, 5));
 
-  sentence_learner->sentence_train(words);
+  EXPECT_EQ(6, sentence_learner->sentence_train(words));
 }
 
 TEST_F(SGNSSentenceLearnerTest, sentence_train_many) {
@@ -428,7 +428,7 @@ TEST_F(SGNSSentenceLearnerTest, sentence_train_many) {
   EXPECT_CALL(sentence_learner->ctx_strategy, size(4, 0)).
     WillOnce(Return(make_pair(size_t(0), size_t(0))));
 
-  sentence_learner->sentence_train(words);
+  EXPECT_EQ(6, sentence_learner->sentence_train(words));
 }
 
 TEST_F(SGNSSentenceLearnerSerializationTest, serialization_fixed_point) {
@@ -0,0 +1,118 @@
+#include "snapshot_test.h"
+#include "test_util.h"
+#include "_core.h"
+#include "_snapshot.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+using namespace std;
+
+
+TEST_F(SnapshotPublisherTest, latest_empty) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(0);
+  EXPECT_FALSE(publisher.latest());
+}
+
+TEST_F(SnapshotPublisherTest, publish_copies) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(1000);
+  EXPECT_TRUE(publisher.maybe_publish(*factorization, *language_model));
+  auto snapshot(publisher.latest());
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(0, snapshot->version);
+
+  factorization->get_word_embedding(0)[0] = 2;
+  language_model->increment("c");
+  EXPECT_EQ(1, snapshot->factorization.get_word_embedding(0)[0]);
+  EXPECT_EQ(2, snapshot->language_model.size());
+  EXPECT_EQ(-1, snapshot->language_model.lookup("c"));
+}
+
+TEST_F(SnapshotPublisherTest, maybe_publish_staleness) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(1000);
+  EXPECT_TRUE(publisher.maybe_publish(*factorization, *language_model));
+  factorization->get_word_embedding(0)[0] = 2;
+  EXPECT_FALSE(publisher.maybe_publish(*factorization, *language_model));
+  EXPECT_EQ(1, publisher.latest()->factorization.get_word_embedding(0)[0]);
+
+  publisher.publish(*factorization, *language_model);
+  EXPECT_EQ(1, publisher.latest()->version);
+  EXPECT_EQ(2, publisher.latest()->factorization.get_word_embedding(0)[0]);
+}
+
+TEST_F(SnapshotPublisherTest, maybe_publish_zero_staleness) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(0);
+  for (size_t t = 0; t < 3; ++t) {
+    EXPECT_TRUE(publisher.maybe_publish(*factorization, *language_model));
+    EXPECT_EQ(t, publisher.latest()->version);
+  }
+}
+
+TEST_F(SnapshotPublisherTest, old_snapshot_outlives_publish) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(0);
+  publisher.publish(*factorization, *language_model);
+  auto snapshot(publisher.latest());
+  factorization->get_word_embedding(0)[0] = 2;
+  publisher.publish(*factorization, *language_model);
+  EXPECT_EQ(0, snapshot->version);
+  EXPECT_EQ(1, snapshot->factorization.get_word_embedding(0)[0]);
+  EXPECT_EQ(2, publisher.latest()->factorization.get_word_embedding(0)[0]);
+}
+
+TEST_F(SnapshotPublisherTest, publish_reuses_released_snapshot) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(0);
+  publisher.publish(*factorization, *language_model);
+  const ModelSnapshot<SpaceSavingLanguageModel> *first =
+    publisher.latest().get();
+  publisher.publish(*factorization, *language_model);
+  factorization->get_word_embedding(0)[0] = 2;
+  language_model->increment("c");
+  publisher.publish(*factorization, *language_model);
+  auto snapshot(publisher.latest());
+  EXPECT_EQ(first, snapshot.get());
+  EXPECT_EQ(2, snapshot->version);
+  EXPECT_EQ(2, snapshot->factorization.get_word_embedding(0)[0]);
+  EXPECT_EQ(2, snapshot->language_model.lookup("c"));
+
+  // a snapshot a reader holds is not overwritten
+  publisher.publish(*factorization, *language_model);
+  factorization->get_word_embedding(0)[0] = 3;
+  publisher.publish(*factorization, *language_model);
+  EXPECT_NE(snapshot.get(), publisher.latest().get());
+  EXPECT_EQ(2, snapshot->version);
+  EXPECT_EQ(2, snapshot->factorization.get_word_embedding(0)[0]);
+  EXPECT_EQ(3, publisher.latest()->factorization.get_word_embedding(0)[0]);
+}
+
+TEST_F(SnapshotPublisherTest, concurrent_readers_see_consistent_snapshots) {
+  SnapshotPublisher<SpaceSavingLanguageModel> publisher(0);
+  factorization->get_word_embedding(1)[0] = 0;
+  factorization->get_word_embedding(1)[1] = 0;
+  publisher.publish(*factorization, *language_model);
+  atomic<bool> done(false);
+  atomic<size_t> inconsistencies(0);
+  thread reader([&]() {
+    size_t last_version = 0;
+    while (! done) {
+      auto snapshot(publisher.latest());
+      // writer sets both coordinates to the version number
+      const float *x = snapshot->factorization.get_word_embedding(1);
+      if (x[0] != x[1] || snapshot->version < last_version) {
+        ++inconsistencies;
+      }
+      last_version = snapshot->version;
+    }
+  });
+  for (size_t t = 1; t <= 200; ++t) {
+    factorization->get_word_embedding(1)[0] = t;
+    factorization->get_word_embedding(1)[1] = t;
+    publisher.publish(*factorization, *language_model);
+  }
+  done = true;
+  reader.join();
+  EXPECT_EQ(0, inconsistencies);
+  EXPECT_EQ(200, publisher.latest()->version);
+}
@@ -0,0 +1,30 @@
+#ifndef ATHENA_SNAPSHOT_TEST_H
+#define ATHENA_SNAPSHOT_TEST_H
+
+
+#include "_core.h"
+#include "_snapshot.h"
+#include "test_util.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+
+
+class SnapshotPublisherTest: public ::testing::Test {
+  protected:
+    std::shared_ptr<WordContextFactorization> factorization;
+    std::shared_ptr<SpaceSavingLanguageModel> language_model;
+
+    virtual void SetUp() {
+      factorization = std::make_shared<WordContextFactorization>(3, 2);
+      language_model = std::make_shared<SpaceSavingLanguageModel>(3);
+      language_model->increment("a");
+      language_model->increment("b");
+      factorization->get_word_embedding(0)[0] = 1;
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
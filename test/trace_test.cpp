@@ -0,0 +1,95 @@
+#include "trace_test.h"
+#include "_trace.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace std;
+
+
+TEST_F(TracerTest, empty) {
+  Tracer tracer;
+  EXPECT_EQ(0, tracer.num_events());
+  EXPECT_EQ(0, tracer.num_dropped());
+  stringstream stream;
+  tracer.write_json(stream);
+  EXPECT_EQ(0, stream.str().find("{\"traceEvents\":["));
+  EXPECT_NE(string::npos, stream.str().find("\"dropped_events\":0"));
+}
+
+TEST_F(TracerTest, now_monotone) {
+  Tracer tracer;
+  const uint64_t t0 = tracer.now();
+  EXPECT_LE(t0, tracer.now());
+}
+
+TEST_F(TracerTest, record) {
+  Tracer tracer;
+  tracer.record("read", 1500, 2000);
+  tracer.record("gradient", 4000, 10);
+  EXPECT_EQ(2, tracer.num_events());
+
+  stringstream stream;
+  tracer.write_json(stream);
+  const string json(stream.str());
+  EXPECT_NE(string::npos,
+            json.find("\"name\":\"read\",\"ph\":\"X\""));
+  EXPECT_NE(string::npos, json.find("\"ts\":1.500,\"dur\":2.000}"));
+  EXPECT_NE(string::npos,
+            json.find("\"name\":\"gradient\",\"ph\":\"X\""));
+  EXPECT_NE(string::npos, json.find("\"ts\":4.000,\"dur\":0.010}"));
+  EXPECT_NE(string::npos, json.find("\"name\":\"thread_name\""));
+}
+
+TEST_F(TracerTest, max_events) {
+  Tracer tracer(2);
+  tracer.record("a", 0, 1);
+  tracer.record("b", 1, 1);
+  tracer.record("c", 2, 1);
+  EXPECT_EQ(2, tracer.num_events());
+  EXPECT_EQ(1, tracer.num_dropped());
+  tracer.record("d", 3, TRACE_LONG_EVENT_DURATION);
+  EXPECT_EQ(3, tracer.num_events());
+  EXPECT_EQ(1, tracer.num_dropped());
+
+  stringstream stream;
+  tracer.write_json(stream);
+  EXPECT_EQ(string::npos, stream.str().find("\"name\":\"c\""));
+  EXPECT_NE(string::npos, stream.str().find("\"dropped_events\":1"));
+}
+
+TEST_F(TracerTest, threads) {
+  Tracer tracer;
+  vector<thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.push_back(thread([&tracer]() {
+      for (size_t i = 0; i < 100; ++i) {
+        tracer.record("x", tracer.now(), 1);
+      }
+    }));
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it) {
+    it->join();
+  }
+  EXPECT_EQ(400, tracer.num_events());
+
+  stringstream stream;
+  tracer.write_json(stream);
+  for (size_t t = 0; t < 4; ++t) {
+    EXPECT_NE(string::npos,
+              stream.str().find("\"tid\":" + to_string(t) + ","));
+  }
+}
+
+TEST_F(TracerTest, successive_tracers) {
+  // a thread's cached buffer must not carry over to a new tracer
+  for (size_t i = 0; i < 3; ++i) {
+    Tracer tracer;
+    tracer.record("x", 0, 1);
+    EXPECT_EQ(1, tracer.num_events());
+  }
+}
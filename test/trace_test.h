@@ -0,0 +1,17 @@
+#ifndef ATHENA_TRACE_TEST_H
+#define ATHENA_TRACE_TEST_H
+
+
+#include "_trace.h"
+
+#include <gtest/gtest.h>
+
+
+class TracerTest: public ::testing::Test {
+  protected:
+    virtual void SetUp() { }
+    virtual void TearDown() { }
+};
+
+
+#endif
@@ -0,0 +1,170 @@
+#include "vocab_test.h"
+#include "_vocab.h"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+
+
+TEST(word_hash_test, deterministic) {
+  EXPECT_EQ(word_hash("foo"), word_hash(string("foo")));
+  EXPECT_EQ(word_hash("foo", 3), word_hash(string("foobar").substr(0, 3)));
+  EXPECT_NE(word_hash("foo"), word_hash("bar"));
+  EXPECT_NE(word_hash(""), word_hash(string(1, '\0')));
+  EXPECT_NE(word_hash("abcdefgh"), word_hash("abcdefgi"));
+}
+
+TEST_F(VocabularyTest, lookup) {
+  EXPECT_EQ(3, vocabulary.size());
+  EXPECT_EQ(0, vocabulary.lookup("foo"));
+  EXPECT_EQ(1, vocabulary.lookup("bar"));
+  EXPECT_EQ(2, vocabulary.lookup(""));
+  EXPECT_EQ(-1, vocabulary.lookup("baz"));
+  EXPECT_EQ(-1, vocabulary.lookup("fo"));
+  EXPECT_EQ(-1, vocabulary.lookup("fooo"));
+  EXPECT_EQ(1, vocabulary.lookup("bar", word_hash("bar")));
+}
+
+TEST_F(VocabularyTest, get) {
+  EXPECT_EQ("foo", vocabulary.get(0));
+  EXPECT_EQ("bar", vocabulary.get(1));
+  EXPECT_EQ("", vocabulary.get(2));
+  EXPECT_THROW(vocabulary.get(3), out_of_range);
+  EXPECT_THROW(vocabulary.get(-1), out_of_range);
+}
+
+TEST_F(VocabularyTest, replace) {
+  vocabulary.replace(0, "baz", word_hash("baz"));
+  EXPECT_EQ(-1, vocabulary.lookup("foo"));
+  EXPECT_EQ(0, vocabulary.lookup("baz"));
+  EXPECT_EQ("baz", vocabulary.get(0));
+
+  // longer word moves to the end of the arena
+  vocabulary.replace(0, "bazbazbaz", word_hash("bazbazbaz"));
+  EXPECT_EQ(-1, vocabulary.lookup("baz"));
+  EXPECT_EQ(0, vocabulary.lookup("bazbazbaz"));
+  EXPECT_EQ("bazbazbaz", vocabulary.get(0));
+  EXPECT_EQ("bar", vocabulary.get(1));
+
+  vocabulary.replace(2, "x", word_hash("x"));
+  EXPECT_EQ(-1, vocabulary.lookup(""));
+  EXPECT_EQ(2, vocabulary.lookup("x"));
+  EXPECT_EQ(3, vocabulary.size());
+}
+
+TEST_F(VocabularyTest, clear) {
+  vocabulary.clear();
+  EXPECT_EQ(0, vocabulary.size());
+  EXPECT_EQ(-1, vocabulary.lookup("foo"));
+  EXPECT_EQ(0, vocabulary.insert("bar"));
+}
+
+TEST_F(VocabularyTest, equals) {
+  Vocabulary other;
+  other.insert("foo");
+  other.insert("bar");
+  EXPECT_FALSE(vocabulary.equals(other));
+  other.insert("");
+  EXPECT_TRUE(vocabulary.equals(other));
+  other.replace(1, "baz", word_hash("baz"));
+  EXPECT_FALSE(vocabulary.equals(other));
+}
+
+TEST(vocabulary_test, many_words) {
+  Vocabulary vocabulary;
+  const size_t n = 10000;
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(i, vocabulary.insert("w" + to_string(i)));
+  }
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(i, vocabulary.lookup("w" + to_string(i)));
+  }
+  EXPECT_EQ(-1, vocabulary.lookup("w" + to_string(n)));
+}
+
+TEST(vocabulary_test, many_replacements) {
+  // replacements delete from the hash table and churn the arena; every
+  // word must stay reachable
+  Vocabulary vocabulary;
+  const size_t n = 100;
+  vector<string> words(n);
+  for (size_t i = 0; i < n; ++i) {
+    words[i] = "w" + to_string(i);
+    vocabulary.insert(words[i]);
+  }
+  for (size_t t = 0; t < 5000; ++t) {
+    const size_t i = (t * 37) % n;
+    const string word(string(t % 20, 'x') + to_string(t));
+    vocabulary.replace(i, word, word_hash(word));
+    EXPECT_EQ(-1, vocabulary.lookup(words[i]));
+    words[i] = word;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(i, vocabulary.lookup(words[i]));
+    EXPECT_EQ(words[i], vocabulary.get(i));
+  }
+  // arena is compacted, so dead bytes do not accumulate
+  EXPECT_LT(vocabulary.memory_usage().get("bytes"), 4 * n * 25);
+}
+
+TEST(vocabulary_test, reserve) {
+  Vocabulary vocabulary;
+  vocabulary.reserve(1000);
+  const size_t table_bytes = vocabulary.memory_usage().get("table");
+  for (size_t i = 0; i < 1000; ++i) {
+    vocabulary.insert("w" + to_string(i));
+  }
+  EXPECT_EQ(table_bytes, vocabulary.memory_usage().get("table"));
+}
+
+TEST(vocabulary_test, fingerprint_keyed) {
+  Vocabulary vocabulary(true);
+  EXPECT_TRUE(vocabulary.fingerprint_keyed());
+  EXPECT_EQ(0, vocabulary.insert("foo"));
+  EXPECT_EQ(1, vocabulary.insert("bar"));
+  EXPECT_EQ(0, vocabulary.lookup("foo"));
+  EXPECT_EQ(-1, vocabulary.lookup("baz"));
+  // matched by fingerprint alone
+  EXPECT_EQ(1, vocabulary.lookup("", word_hash("bar")));
+  EXPECT_EQ(-1, vocabulary.lookup("bar", word_hash("baz")));
+
+  vocabulary.replace(0, "bazbazbaz", word_hash("bazbazbaz"));
+  EXPECT_EQ(-1, vocabulary.lookup("foo"));
+  EXPECT_EQ(0, vocabulary.lookup("bazbazbaz"));
+  EXPECT_EQ("bazbazbaz", vocabulary.get(0));
+  EXPECT_GE(vocabulary.memory_usage().get("fingerprints"), 8 * 2);
+
+  Vocabulary other;
+  other.insert("bazbazbaz");
+  other.insert("bar");
+  EXPECT_TRUE(vocabulary.equals(other));
+}
+
+TEST(vocabulary_test, fingerprint_keyed_many_replacements) {
+  Vocabulary vocabulary(true);
+  const size_t n = 100;
+  vector<string> words(n);
+  for (size_t i = 0; i < n; ++i) {
+    words[i] = "w" + to_string(i);
+    vocabulary.insert(words[i]);
+  }
+  for (size_t t = 0; t < 5000; ++t) {
+    const size_t i = (t * 37) % n;
+    const string word(string(t % 20, 'x') + to_string(t));
+    vocabulary.replace(i, word, word_hash(word));
+    EXPECT_EQ(-1, vocabulary.lookup(words[i]));
+    words[i] = word;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(i, vocabulary.lookup(words[i]));
+    EXPECT_EQ(words[i], vocabulary.get(i));
+  }
+  vocabulary.clear();
+  EXPECT_EQ(-1, vocabulary.lookup(words[0]));
+  EXPECT_EQ(0, vocabulary.insert(words[0]));
+  EXPECT_EQ(0, vocabulary.lookup(words[0]));
+}
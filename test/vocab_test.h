@@ -0,0 +1,24 @@
+#ifndef ATHENA_VOCAB_TEST_H
+#define ATHENA_VOCAB_TEST_H
+
+
+#include "_vocab.h"
+
+#include <gtest/gtest.h>
+
+
+class VocabularyTest: public ::testing::Test {
+  protected:
+    Vocabulary vocabulary;
+
+    virtual void SetUp() {
+      vocabulary.insert("foo");
+      vocabulary.insert("bar");
+      vocabulary.insert("");
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif
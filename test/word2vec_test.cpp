@@ -0,0 +1,91 @@
+#include "word2vec_test.h"
+#include "test_util.h"
+#include "_word2vec.h"
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdexcept>
+#include <unistd.h>
+
+
+using namespace std;
+
+
+static void expect_parsed(const Word2VecModel& model) {
+  EXPECT_EQ(2, model.vocab_dim);
+  EXPECT_EQ(2, model.embedding_dim);
+  ASSERT_EQ(2, model.vocab.size());
+  EXPECT_EQ("foo", model.vocab[0]);
+  EXPECT_EQ("bar", model.vocab[1]);
+  ASSERT_EQ(4, model.word_embeddings.size());
+  EXPECT_NEAR(0.6, model.word_embeddings[0], EPS);
+  EXPECT_NEAR(0.8, model.word_embeddings[1], EPS);
+  EXPECT_NEAR(0, model.word_embeddings[2], EPS);
+  EXPECT_NEAR(-1, model.word_embeddings[3], EPS);
+}
+
+
+TEST_F(Word2VecModelTest, parse) {
+  expect_parsed(*Word2VecModel::parse(data.data(), data.size()));
+}
+
+TEST_F(Word2VecModelTest, parse_no_trailing_newline) {
+  data.resize(data.size() - 1);
+  expect_parsed(*Word2VecModel::parse(data.data(), data.size()));
+}
+
+TEST_F(Word2VecModelTest, parse_truncated) {
+  EXPECT_THROW(Word2VecModel::parse(data.data(), data.size() - 2),
+               runtime_error);
+  EXPECT_THROW(Word2VecModel::parse(data.data(), 2), runtime_error);
+  EXPECT_THROW(Word2VecModel::parse(data.data(), 0), runtime_error);
+}
+
+TEST_F(Word2VecModelTest, parse_bad_header) {
+  data[1] = '\n';
+  EXPECT_THROW(Word2VecModel::parse(data.data(), data.size()), runtime_error);
+}
+
+TEST_F(Word2VecModelTest, parse_huge_header) {
+  // rejected before allocating vocab_dim-sized arrays
+  const string huge_vocab("99999999999999 2\nfoo ");
+  EXPECT_THROW(Word2VecModel::parse(huge_vocab.data(), huge_vocab.size()),
+               runtime_error);
+  const string huge_embedding("1 99999999999999\nfoo ");
+  EXPECT_THROW(
+    Word2VecModel::parse(huge_embedding.data(), huge_embedding.size()),
+    runtime_error);
+  // would overflow 64 bits while being parsed
+  const string overflowing("1 36893488147419103232\nfoo ");
+  EXPECT_THROW(Word2VecModel::parse(overflowing.data(), overflowing.size()),
+               runtime_error);
+}
+
+TEST_F(Word2VecModelTest, deserialize) {
+  stringstream stream(data);
+  expect_parsed(*Word2VecModel::deserialize(stream));
+}
+
+TEST_F(Word2VecModelTest, serialization_fixed_point) {
+  auto model(Word2VecModel::parse(data.data(), data.size()));
+  stringstream stream;
+  model->serialize(stream);
+  auto from_stream(Word2VecModel::deserialize(stream));
+  expect_parsed(*from_stream);
+  EXPECT_EQ(model->word_embeddings, from_stream->word_embeddings);
+}
+
+TEST_F(Word2VecModelTest, load) {
+  const string path(
+    string("/tmp/athena-word2vec-test-") + to_string(getpid()) + ".bin");
+  {
+    ofstream f(path.c_str(), ios::binary);
+    f.write(data.data(), data.size());
+  }
+  expect_parsed(*Word2VecModel::load(path));
+  remove(path.c_str());
+  EXPECT_THROW(Word2VecModel::load(path), runtime_error);
+}
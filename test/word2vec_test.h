@@ -0,0 +1,31 @@
+#ifndef ATHENA_WORD2VEC_TEST_H
+#define ATHENA_WORD2VEC_TEST_H
+
+
+#include "_word2vec.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+
+
+class Word2VecModelTest: public ::testing::Test {
+  protected:
+    std::string data;
+
+    virtual void SetUp() {
+      // two words, two dimensions, as written by Google word2vec
+      const float embeddings[] = {3, 4, 0, -2};
+      data = "2 2\n";
+      data += "foo ";
+      data.append(reinterpret_cast<const char*>(embeddings), 2 * sizeof(float));
+      data += "\nbar ";
+      data.append(reinterpret_cast<const char*>(embeddings + 2), 2 * sizeof(float));
+      data += "\n";
+    }
+
+    virtual void TearDown() { }
+};
+
+
+#endif